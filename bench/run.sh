@@ -0,0 +1,62 @@
+#!/bin/sh
+#
+# Time every program of bench/, or the ones named, in the VM with
+# --no-jit, in the VM with its JIT and as the C emitted by --emit-c, and
+# print the wall times in seconds with the JIT's speedup over the
+# interpreter and the VM's ratio to C. When perf is installed, the branches the VM retires are counted
+# too. What the programs print is discarded.
+#
+# usage: run.sh avalanche cc source_dir [name...]
+
+avalanche=$1
+cc=$2
+source_dir=$3
+shift 3
+work=$(mktemp -d)
+
+trap 'rm -rf "$work"' EXIT
+
+# Run a command with its output discarded and print its wall time.
+elapsed() {
+	start=$(date +%s%N)
+	"$@" >/dev/null 2>&1
+	end=$(date +%s%N)
+	echo "$start $end" | awk '{ printf "%.3f", ($2 - $1) / 1e9 }'
+}
+
+if [ $# -eq 0 ]; then
+	set -- $(ls "$source_dir"/bench/*.avl | xargs -n 1 basename \
+	    | sed 's/\.avl$//')
+fi
+
+# Print the ratio of two times.
+ratio() {
+	echo "$1 $2" | awk '{ printf "%.1f", ($2 > 0) ? $1 / $2 : 0 }'
+}
+
+printf "%-20s %8s %8s %8s %8s %8s" program no-jit vm c no-jit/vm vm/c
+if command -v perf >/dev/null 2>&1; then
+	printf " %14s" branches
+fi
+printf "\n"
+
+for name in "$@"; do
+	program=$source_dir/bench/$name.avl
+
+	if ! "$avalanche" --emit-c "$program" >"$work/$name.c" \
+	    || ! "$cc" -O2 -w -I"$source_dir" "$work/$name.c" \
+		 -o "$work/$name" -lm; then
+		echo "$name: the emitted C does not build"
+		continue
+	fi
+	interpreter=$(elapsed "$avalanche" --no-jit "$program")
+	vm=$(elapsed "$avalanche" "$program")
+	c=$(elapsed "$work/$name")
+	printf "%-20s %8s %8s %8s %8s %8s" "$name" "$interpreter" "$vm" "$c" \
+	    "$(ratio "$interpreter" "$vm")" "$(ratio "$vm" "$c")"
+	if command -v perf >/dev/null 2>&1; then
+		printf " %14s" "$(perf stat -x, -e branches "$avalanche" \
+		    "$program" 2>&1 >/dev/null | awk -F, '/branches/ { print $1 }')"
+	fi
+	printf "\n"
+done
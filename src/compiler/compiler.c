@@ -24,6 +24,9 @@
 #include "compiler.h"
 #include "src/scanner/scanner.h"
 
+/* defined in parser.c */
+extern struct parser parser;
+
 enum compile_error compile(char *source)
 {
 	struct scan *s = scan_init(source);
@@ -45,6 +45,7 @@ void __report__(int line, char *message)
 		break;
 	case TOKEN_NEWLINE:
 		fprintf(stderr, "[line %d] at new line: %s\n", line, message);
+		break;
 	default:
 		fprintf(stderr, "[line %d] at %s: %s\n",
 			line, sbstr2str(&parser.current_token->lexeme), message);
@@ -24,24 +24,416 @@
 #include "compiler.h"
 #include "src/value.h"
 #include "type.h"
+#include "src/vm/vm.h"
+#include "src/vm/str.h"
+#include "src/macros.h"
 
+#include <limits.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define CURRENT_TOKEN_IS(...)						\
 	__TOKEN_IS__(parser.current_token, (enum token_type[]){__VA_ARGS__, -1})
+#define NEXT_TOKEN_IS(...)						\
+	__TOKEN_IS__(parser.current_token + 1, (enum token_type[]){__VA_ARGS__, -1})
+#define IS_TYPE_TOKEN(tok)						\
+	__TOKEN_IS__((tok), (enum token_type[]){TOKEN_INT, TOKEN_UINT,	\
+			TOKEN_BYTE, TOKEN_SBYTE, TOKEN_FLOAT, TOKEN_BOOL,	\
+			TOKEN_STR, -1})
 
 struct parser parser;
 
+/* The codes a binary operator compiles to, depending on what the
+ * compiler knows of its operands' types. */
+struct typed_code {
+	enum token_type token;
+	enum op_code generic;
+	enum op_code as_int;
+	enum op_code as_float;
+	uint8_t is_comparison;
+};
+
+static const struct typed_code typed_codes[] = {
+	{TOKEN_EQUAL_EQUAL, OP_EQUAL, OP_EQUAL_INT, OP_EQUAL_FLOAT, 1},
+	{TOKEN_BANG_EQUAL, OP_NOT_EQUAL, OP_NOT_EQUAL_INT, OP_NOT_EQUAL_FLOAT, 1},
+	{TOKEN_GREATER, OP_GREATER, OP_GREATER_INT, OP_GREATER_FLOAT, 1},
+	{TOKEN_GREATER_EQUAL, OP_GREATER_EQUAL,
+	 OP_GREATER_EQUAL_INT, OP_GREATER_EQUAL_FLOAT, 1},
+	{TOKEN_LESS, OP_LESS, OP_LESS_INT, OP_LESS_FLOAT, 1},
+	{TOKEN_LESS_EQUAL, OP_LESS_EQUAL, OP_LESS_EQUAL_INT, OP_LESS_EQUAL_FLOAT, 1},
+	{TOKEN_PLUS, OP_ADD, OP_ADD_INT, OP_ADD_FLOAT, 0},
+	{TOKEN_MINUS, OP_SUBSTRACT, OP_SUBSTRACT_INT, OP_SUBSTRACT_FLOAT, 0},
+	{TOKEN_STAR, OP_MULTIPLY, OP_MULTIPLY_INT, OP_MULTIPLY_FLOAT, 0},
+	{TOKEN_SLASH, OP_DIVIDE, OP_DIVIDE_INT, OP_DIVIDE_FLOAT, 0},
+	/* there is no floating point modulo */
+	{TOKEN_PERCENT, OP_MODULO, OP_MODULO_INT, OP_MODULO, 0},
+};
+
+/* The codes reading and writing an element, by array kind. */
+static const enum op_code get_index_codes[] = {
+	[ARRAY_INT] = OP_GET_INDEX_INT,
+	[ARRAY_BYTE] = OP_GET_INDEX_BYTE,
+	[ARRAY_SBYTE] = OP_GET_INDEX_SBYTE,
+	[ARRAY_FLOAT] = OP_GET_INDEX_FLOAT,
+	[ARRAY_BOOL] = OP_GET_INDEX_BOOL,
+	[ARRAY_VALUE] = OP_GET_INDEX_VALUE,
+	[ARRAY_STRING] = OP_GET_INDEX_VALUE,
+};
+
+static const enum op_code set_index_codes[] = {
+	[ARRAY_INT] = OP_SET_INDEX_INT,
+	[ARRAY_BYTE] = OP_SET_INDEX_BYTE,
+	[ARRAY_SBYTE] = OP_SET_INDEX_SBYTE,
+	[ARRAY_FLOAT] = OP_SET_INDEX_FLOAT,
+	[ARRAY_BOOL] = OP_SET_INDEX_BOOL,
+	[ARRAY_VALUE] = OP_SET_INDEX_VALUE,
+	[ARRAY_STRING] = OP_SET_INDEX_VALUE,
+};
+
+/* indexing by a slot proven within the array's bounds */
+static const enum op_code get_unchecked_codes[] = {
+	[ARRAY_INT] = OP_GET_INDEX_INT_UNCHECKED,
+	[ARRAY_BYTE] = OP_GET_INDEX_BYTE_UNCHECKED,
+	[ARRAY_SBYTE] = OP_GET_INDEX_SBYTE_UNCHECKED,
+	[ARRAY_FLOAT] = OP_GET_INDEX_FLOAT_UNCHECKED,
+	[ARRAY_BOOL] = OP_GET_INDEX_BOOL_UNCHECKED,
+	[ARRAY_VALUE] = OP_GET_INDEX_VALUE_UNCHECKED,
+	[ARRAY_STRING] = OP_GET_INDEX_VALUE_UNCHECKED,
+};
+
+static const enum op_code set_unchecked_codes[] = {
+	[ARRAY_INT] = OP_SET_INDEX_INT_UNCHECKED,
+	[ARRAY_BYTE] = OP_SET_INDEX_BYTE_UNCHECKED,
+	[ARRAY_SBYTE] = OP_SET_INDEX_SBYTE_UNCHECKED,
+	[ARRAY_FLOAT] = OP_SET_INDEX_FLOAT_UNCHECKED,
+	[ARRAY_BOOL] = OP_SET_INDEX_BOOL_UNCHECKED,
+	[ARRAY_VALUE] = OP_SET_INDEX_VALUE_UNCHECKED,
+	[ARRAY_STRING] = OP_SET_INDEX_VALUE_UNCHECKED,
+};
+
+/* The bulk methods of arrays, each compiling to one code. */
+struct array_method {
+	const char *name;
+	enum op_code code;
+	uint8_t arity;
+};
+
+static const struct array_method array_methods[] = {
+	{"length", OP_ARRAY_LENGTH, 0},
+	{"fill", OP_ARRAY_FILL, 1},
+	{"copy", OP_ARRAY_COPY, 1},
+	{"slice", OP_ARRAY_SLICE, 2},
+	{"sum", OP_ARRAY_SUM, 0},
+	{"min", OP_ARRAY_MIN, 0},
+	{"max", OP_ARRAY_MAX, 0},
+	{"dot", OP_ARRAY_DOT, 1},
+};
+
+/* The functions of math, each compiling to one code, and folded by
+ * `unary` or `binary` when their arguments are constants. The unary
+ * ones also map float arrays. */
+struct math_function {
+	const char *name;
+	enum op_code code;
+	uint8_t arity;
+	double (*unary)(double);
+	double (*binary)(double, double);
+};
+
+static const struct math_function math_functions[] = {
+	{"sqrt", OP_MATH_SQRT, 1, sqrt, NULL},
+	{"pow", OP_MATH_POW, 2, NULL, pow},
+	{"remainder", OP_MATH_REMAINDER, 2, NULL, remainder},
+	{"floor", OP_MATH_FLOOR, 1, floor, NULL},
+	{"ceil", OP_MATH_CEIL, 1, ceil, NULL},
+	{"sin", OP_MATH_SIN, 1, sin, NULL},
+	{"cos", OP_MATH_COS, 1, cos, NULL},
+	{"exp", OP_MATH_EXP, 1, exp, NULL},
+	{"log", OP_MATH_LOG, 1, log, NULL},
+};
+
+struct math_constant {
+	const char *name;
+	double value;
+};
+
+static const struct math_constant math_constants[] = {
+	{"PI", 3.14159265358979323846},
+	{"TAU", 6.28318530717958647693},
+	{"INF", INFINITY},
+	{"NAN", NAN},
+};
+
 static struct token *advance();
 
-static struct value expression();
-static struct value equality();
-static struct value comparison();
-static struct value term();
-static struct value factor();
-static struct value unary();
-static struct value primary();
+/* Return 1 if the statement was an expression, whose value is left on
+ * the stack. */
+static int statement();
+static void declaration();
+/* Parse a `const` declaration, evaluated at compile time. */
+static void const_declaration();
+/* Parse an enum, whose members are constants. A named enum's are
+ * read as `Name.MEMBER`, and its name is the type int. */
+static void enum_declaration();
+/* Whether `name` is already declared in the current scope. */
+static int is_declared(const struct substring *name);
+static void assignment();
+static void field_assignment();
+static void index_assignment();
+/* Return 1 if the current line starts with an indexed variable
+ * followed by '='. */
+static int is_index_assignment();
+static void function_declaration();
+static void recipe_declaration();
+static void return_statement();
+static void if_statement();
+/* Compile the if at the current token as a jump table when it is a
+ * case chain. Return 0, having compiled nothing, when it is not. */
+static int if_table();
+/* Fill `chain` from the if or elif at `tok` and those following it,
+ * comparing `subject` of type `type`. Return 0 when they are not a case
+ * chain. */
+static int find_case_chain(struct token *tok, const struct token *subject,
+			   enum value_type type, struct case_chain *chain);
+/* Read the constant of a case at `tok` into `value`. Return the token
+ * following it, NULL when it is not a constant. */
+static struct token *case_constant(struct token *tok, struct value *value);
+static void match_statement();
+/* Fill `chain` from the cases of the match at the current token, of a
+ * subject of type `type`. */
+static void find_match_cases(enum value_type type, struct case_chain *chain);
+/* Compile the cases of `chain`, the subject on the stack, their bodies
+ * indented by `indent`. */
+static void case_dispatch(const struct case_chain *chain, int indent,
+			  int line);
+static void while_statement();
+static void for_statement();
+/* print and print_err take a value, or a format and its arguments. */
+static void print_statement();
+/* Push the counter, stop and step of the range loop after `range`.
+ * Return 0 after an error. */
+static int range_slots();
+/* Return the number of arguments between the current token and the
+ * matching ')'. */
+static int count_arguments();
+/* Compile a break or continue, out of or to the end of the innermost
+ * loop's body. */
+static void loop_jump();
+/* Compile the body of `lp` and point its continue jumps at the next
+ * code. */
+static void loop_body(struct loop *lp);
+/* Point the break jumps of `lp` at the next code. */
+static void patch_breaks(struct loop *lp, int line);
+/* Read the lengths and fields the loop whose header starts at `header`
+ * cannot change into hidden locals, before the loop. */
+static void hoist_invariants(struct token *header, int line);
+/* Index the array `arr`, whose length stops the range of the loop
+ * variable `var` in `slot`, without checks in the loop's body. */
+static void bound_index(struct token *arr, struct token *var, int slot,
+			struct token *header);
+/* Return the array whose length stops the range at `range`, counting
+ * up from a constant, or NULL. */
+static struct token *range_bound(struct token *range);
+/* Return the first token after the body of the loop whose header
+ * starts at `header`. */
+static struct token *loop_end(struct token *header);
+/* Return the variable `name` refers to unless the code of a loop may
+ * assign it elsewhere, through a function when `calls`, or NULL. */
+static struct variable *loop_variable(const struct token *name, int calls);
+/* Whether the tokens from `start` to `end` call a function, which may
+ * assign any global or ref. */
+static int has_calls(const struct token *start, const struct token *end);
+/* Whether the variable `name` keeps its value from `start` to `end`,
+ * every use of it reading a field, a method or an element. */
+static int is_unchanged(const struct token *name, const struct token *start,
+			const struct token *end);
+/* Whether the loop variable `var` keeps the value its range gives it
+ * from `start` to `end`. */
+static int is_counter_unchanged(const struct token *var,
+				const struct token *start,
+				const struct token *end, int calls);
+/* Whether a field named `name` is assigned from `start` to `end`. */
+static int is_field_assigned(const struct token *name,
+			     const struct token *start,
+			     const struct token *end);
+/* Whether `tok` names a variable being declared. */
+static int is_declared_name(const struct token *tok);
+/* Return the invariant of `kind` reading `member` of `name`, the
+ * innermost loop's first, or NULL. */
+static struct invariant *find_invariant(enum invariant_kind kind,
+					const struct token *name,
+					const struct token *member);
+/* Return the hoisted length or field `name` is followed by, or NULL. */
+static struct invariant *find_hoisted(const struct token *name);
+/* Compile the read of `inv` from its hidden local. */
+static struct operand hoisted(const struct invariant *inv);
+/* Whether `name` is followed by `.length()`. */
+static int is_length_call(const struct token *name);
+/* Whether `tok` calls range. */
+static int is_range(const struct token *tok);
+static int is_same_name(const struct token *name1, const struct token *name2);
+/* Compile the lines indented by `indent` tabs that follow, in a new
+ * scope. */
+static void block(int indent);
+static void begin_scope();
+/* Pop the locals of the scope being left. */
+static void end_scope();
+/* Move the instances of the locals from `first` on which never escaped
+ * out of the heap. */
+static void elide_allocations(int first);
+/* Skip the rest of the line after an error. */
+static void synchronize();
+static void end_of_line();
+/* Return the number of tabs starting the current line, without
+ * skipping them. */
+static int line_indentation();
+/* Skip the current line if it only holds tabs. Return 1 if it did. */
+static int skip_blank_line();
+static void consume(enum token_type type, const char *error);
+
+static struct operand expression();
+/* Compile the operands of `type`, and or or, each by `operand`. The
+ * first deciding the result is its value. */
+static struct operand logical(enum token_type type,
+			      struct operand (*operand)());
+static struct operand conjunction();
+static struct operand inversion();
+/* Check at run time that `val` is a bool when its type is unknown. */
+static void check_bool(const struct operand *val);
+/* Compile the condition of an if or a while, which jumps to the
+ * offsets in `cond->when_false` when false and falls through when
+ * true. */
+static void condition(struct condition *cond, int line);
+/* Compile the disjunction at the current token in `cond`. */
+static void branch_or(struct condition *cond, int line);
+static void branch_and(struct condition *cond, int line);
+static void branch_not(struct condition *cond, int line);
+/* Compile a comparison, or any bool, fused with the jump on it. */
+static void branch_operand(struct condition *cond, int line);
+/* Whether the parentheses at the current token hold a condition
+ * rather than an operand. */
+static int is_grouped_condition();
+/* Make the last jump of `cond` jump when its condition does not
+ * hold, to where `cond` is false. */
+static void invert_branch(struct condition *cond, int line);
+/* Point the jumps of `jumps` at the next code. */
+static void patch_branches(const int *jumps, int count, int line);
+static struct operand equality();
+static struct operand comparison();
+static struct operand term();
+static struct operand factor();
+static struct operand unary();
+static struct operand primary();
+/* Compile a call to the function named `name`, from its arguments. */
+static struct operand call(const struct token *name, int recipe);
+/* Compile `Recipe.function(...)` or `Recipe::function(...)`. */
+static struct operand qualified_call(const struct token *qualifier);
+/* Return whether `name` qualifies a call, naming a recipe and no
+ * variable. */
+static int is_qualifier(const struct token *name);
+/* Return the named enum `name` refers to, or -1. */
+static int find_enum(const struct token *name);
+/* Return the constant named `name` of the named enum `enumeration`,
+ * or not in one when -1, or NULL. */
+static struct variable *find_constant(int enumeration,
+				      const struct substring *name);
+/* Return the constant `name` refers to unless a variable shadows it,
+ * or NULL. */
+static struct variable *visible_constant(const struct substring *name);
+static struct operand enum_member(const struct token *name);
+/* Parse an expression the compiler evaluates and store its value,
+ * assignable to `target`, in `val`. Return 0 when it is not constant. */
+static int constant_expression(const struct variable *target,
+			       struct value *val);
+/* Push the slot of the variable passed to the ref parameter `param`.
+ * Return 1 when it is a local of the function making the call. */
+static int ref_argument(const struct variable *param);
+/* Emit the read of the variable named `name`. */
+static struct operand variable(const struct token *name);
+/* Compile the field accesses, indexes and method calls following
+ * `val`. */
+static struct operand postfix(struct operand val);
+/* Compile a call to the method named `name` of the array `arr`. */
+static struct operand array_method(const struct operand *arr,
+				   const struct token *name);
+/* Check an argument of a call to `method`, whose code starts at
+ * `start`. */
+static void array_method_argument(const struct array_method *method,
+				  const struct operand *arr,
+				  const struct operand *arg, int start);
+/* Compile an array literal whose elements are of `kind`. */
+static struct operand array_literal(enum array_kind kind);
+/* Parse a map's methods, `length()` and `has(key)`. */
+static struct operand map_method(const struct token *name);
+static struct operand map_literal();
+/* Whether the braces at the current token hold keys and values. */
+static int is_map_literal();
+/* Check a key, whose type is only known at run time when untyped. */
+static void map_key(const struct operand *key, int line);
+/* Push the string literal `tok`, its escape sequences replaced. */
+static struct operand string_literal(const struct token *tok);
+/* Return the bytes of a string token, its escapes replaced, to be
+ * freed by the caller. */
+static char *unescape(const struct token *tok, int *length);
+/* Compile the format literal at the current token and the arguments
+ * after it, checked against its conversions. Return its index. */
+static int format_arguments();
+/* Parse `chars` into `fmt`. Return 0 after reporting an error. */
+static int parse_format(const char *chars, int length, struct format *fmt,
+			int line);
+/* Compile the value stored in `target`. A literal array takes the
+ * kind of the target's elements. */
+static void initializer(const struct variable *target);
+
+/* Add `rhs`, whose code starts at `start`, to the strings joined by
+ * `chain`. Adjacent constants are joined by the compiler. */
+static struct operand concat(const struct operand *chain,
+			     const struct operand *rhs, int start);
+/* Emit the code appending the strings joined by `chain`, if more than
+ * one are left. */
+static void end_concat(struct operand *chain);
+/* Compile a call to a function of `str`, such as str.cat(). */
+static struct operand string_function();
+/* Return whether `name` is math, and no variable or recipe. */
+static int is_math(const struct token *name);
+/* Compile a constant of math, or a call to one of its functions. */
+static struct operand math_function();
+/* Convert the arguments of a math function to floats. */
+static void math_arguments(const struct math_function *fn,
+			   const struct operand *args, const int *starts);
+/* Emit the code of a binary operation whose operands' code starts at
+ * `start`. Constant operands are folded, and operands of known types
+ * get a specialized code. */
+static struct operand binary(enum token_type type, const struct operand *left,
+			     const struct operand *right, int start);
+/* Evaluate a binary operation on two constants. */
+static struct value fold(enum token_type type, const struct value *val1,
+			 const struct value *val2);
+/* Whether two constants can be folded, INT_MIN / -1 and INT_MIN % -1
+ * being left to the codes which wrap them at run time. */
+static int is_foldable(enum token_type type, const struct value *val1,
+		       const struct value *val2);
+static const struct typed_code *get_typed_code(enum token_type type);
+
+/* Emit `code` with a one byte slot, or `code_long` with a two byte
+ * slot. */
+static void emit_slot(enum op_code code, enum op_code code_long, int slot);
+/* Convert the value of `val`, whose code starts at `start`, to `type`
+ * before it is stored. Return 1 if it added code to do so. */
+static int coerce(const struct variable *target, const struct operand *val,
+		  int start);
+/* Push the value variables of `var`'s type are initialized with. */
+static void emit_default_value(const struct variable *var);
+/* Read the type at the current token into `var`. Return 0 if there
+ * is none. */
+static int parse_type(struct variable *var);
+static enum value_type get_declared_type(enum token_type type);
+static enum array_kind get_array_kind(enum token_type type);
+/* Return the operand read from an array of `kind`. */
+static struct operand get_element(enum array_kind kind);
+static const char *get_type_name(enum value_type type);
 
 static int __TOKEN_IS__(const struct token *tok, const enum token_type type[]);
 
@@ -49,130 +441,3570 @@ void parse(struct scan *sc)
 {
 	parser.current_token = sc->tokens->array;
 	parser.panic = 0;
-	struct value val = expression();
-	printf("%g\n", val.as.float_p);
+	parser.globals = variable_vector_init();
+	parser.locals = variable_vector_init();
+	parser.constants = variable_vector_init();
+	parser.enums = variable_vector_init();
+	parser.enumeration = -1;
+	parser.scope_depth = 0;
+	parser.functions = signature_vector_init();
+	parser.parameters = variable_vector_init();
+	parser.recipes = recipe_vector_init();
+	parser.function = -1;
+	parser.recipe = -1;
+	parser.indent = 0;
+	parser.loop = NULL;
+	parser.invariant_count = 0;
+
+	/* The value of a trailing expression is the program's result. */
+	int has_result = 0;
+	while (!CURRENT_TOKEN_IS(TOKEN_END_OF_FILE)) {
+		if (skip_blank_line()) continue;
+
+		if (line_indentation() > 0) {
+			COMPILER_REPORT(parser.current_token->line,
+					"Unexpected indentation.");
+			synchronize();
+			end_of_line();
+			continue;
+		}
+
+		if (has_result) vm_add_code(OP_POP);
+		has_result = statement();
+	}
+
+	vm_add_code(has_result ? OP_RETURN : OP_END_PROGRAM);
+
+	variable_vector_del(parser.globals);
+	variable_vector_del(parser.locals);
+	variable_vector_del(parser.constants);
+	variable_vector_del(parser.enums);
+	signature_vector_del(parser.functions);
+	variable_vector_del(parser.parameters);
+	recipe_vector_del(parser.recipes);
 }
 
 static struct token *advance() {
 	if (CURRENT_TOKEN_IS(TOKEN_END_OF_FILE)) {
 		return parser.current_token;
 	}
+	/* codes come from the line of the last token read */
+	vm_set_line(parser.current_token->line);
 	return parser.current_token++;
 }
 
-static struct value expression()
+static int statement()
 {
-	return equality();
+	int has_result = 0;
+
+	/* Compound statements end their own lines. */
+	if (CURRENT_TOKEN_IS(TOKEN_FUNC)) {
+		function_declaration();
+		return 0;
+	} else if (CURRENT_TOKEN_IS(TOKEN_IF)) {
+		if (!if_table()) if_statement();
+		return 0;
+	} else if (CURRENT_TOKEN_IS(TOKEN_RECIPE)) {
+		recipe_declaration();
+		return 0;
+	} else if (CURRENT_TOKEN_IS(TOKEN_MATCH)) {
+		match_statement();
+		return 0;
+	} else if (CURRENT_TOKEN_IS(TOKEN_WHILE)) {
+		while_statement();
+		return 0;
+	} else if (CURRENT_TOKEN_IS(TOKEN_FOR)) {
+		for_statement();
+		return 0;
+	}
+
+	if (CURRENT_TOKEN_IS(TOKEN_PRINT, TOKEN_PRINT_ERR)) {
+		print_statement();
+		end_of_line();
+		return 0;
+	}
+
+	if ((IS_TYPE_TOKEN(parser.current_token)
+	     && !(CURRENT_TOKEN_IS(TOKEN_STR) && NEXT_TOKEN_IS(TOKEN_DOT)))
+	    || CURRENT_TOKEN_IS(TOKEN_ARRAY, TOKEN_MAP)
+	    || (CURRENT_TOKEN_IS(TOKEN_IDENTIFIER)
+		&& NEXT_TOKEN_IS(TOKEN_IDENTIFIER))) {
+		declaration();
+	} else if (CURRENT_TOKEN_IS(TOKEN_CONST)) {
+		const_declaration();
+	} else if (CURRENT_TOKEN_IS(TOKEN_ENUM)) {
+		enum_declaration();
+	} else if (CURRENT_TOKEN_IS(TOKEN_IDENTIFIER)
+		   && NEXT_TOKEN_IS(TOKEN_EQUAL)) {
+		assignment();
+	} else if (CURRENT_TOKEN_IS(TOKEN_IDENTIFIER)
+		   && NEXT_TOKEN_IS(TOKEN_DOT)
+		   && parser.current_token[2].type == TOKEN_IDENTIFIER
+		   && parser.current_token[3].type == TOKEN_EQUAL) {
+		field_assignment();
+	} else if (is_index_assignment()) {
+		index_assignment();
+	} else if (CURRENT_TOKEN_IS(TOKEN_RETURN)) {
+		return_statement();
+	} else if (CURRENT_TOKEN_IS(TOKEN_BREAK, TOKEN_CONTINUE)) {
+		loop_jump();
+	} else if (CURRENT_TOKEN_IS(TOKEN_PASS)) {
+		advance();
+	} else if (CURRENT_TOKEN_IS(TOKEN_ELIF, TOKEN_ELSE)) {
+		COMPILER_REPORT(parser.current_token->line,
+				"Expected an if before %s.",
+				sbstr2str(&parser.current_token->lexeme));
+		synchronize();
+	} else {
+		/* a function returning nothing leaves no value */
+		has_result = !expression().is_void;
+	}
+
+	end_of_line();
+	return has_result;
 }
 
-static struct value equality()
+static void declaration()
 {
-	struct value val = comparison();
+	struct variable var = {.depth = parser.scope_depth};
+	struct token *type = parser.current_token;
+
+	if (!parse_type(&var)) {
+		synchronize();
+		return;
+	}
 
-	if (CURRENT_TOKEN_IS(TOKEN_EQUAL_EQUAL, TOKEN_BANG_EQUAL)) {
-		switch (advance()->type) {
-		case TOKEN_EQUAL_EQUAL:
-			return value_equal(val, comparison());
-		case TOKEN_BANG_EQUAL:
-			return value_not_equal(val, comparison());
-		default: break;
+	struct token *name = advance();
+	if (name->type != TOKEN_IDENTIFIER) {
+		COMPILER_REPORT(name->line, "Expected a variable name.");
+		return;
+	}
+	var.name = name->lexeme;
+
+	int slot;
+
+	if (is_declared(&var.name)) {
+		COMPILER_REPORT(name->line, "Variable already declared.");
+		return;
+	}
+
+	/* `T name = {...}` and `T name[length]` declare arrays of T,
+	 * `array name[length]` a boxed array. */
+	int is_array = IS_TYPE_TOKEN(type) && var.type != VALUE_ARRAY
+		&& (CURRENT_TOKEN_IS(TOKEN_LEFT_SQUARE)
+		    || (CURRENT_TOKEN_IS(TOKEN_EQUAL)
+			&& NEXT_TOKEN_IS(TOKEN_LEFT_BRACE)));
+	if (is_array) {
+		var.type = VALUE_ARRAY;
+		var.subtype = get_array_kind(type->type);
+	}
+
+	/* Variables are initialized to 0, 0.0, false, "" or an empty
+	 * array by default. Sized arrays get zeroed elements. */
+	if (CURRENT_TOKEN_IS(TOKEN_EQUAL)) {
+		advance();
+		initializer(&var);
+	} else if (CURRENT_TOKEN_IS(TOKEN_LEFT_SQUARE)) {
+		advance();
+		struct operand length = expression();
+		/* boxed arrays start with integer zeroes */
+		if (!is_array && type->type != TOKEN_ARRAY) {
+			COMPILER_REPORT(name->line, "Expected an element type.");
+		} else if (length.is_void || (length.is_typed
+					      && length.value.type != VALUE_INT)) {
+			COMPILER_REPORT(name->line, "Array length must be an int.");
 		}
+		consume(TOKEN_RIGHT_SQUARE, "Expected ']' after the length.");
+		vm_add_code_monadic(OP_NEW_ARRAY, var.subtype);
+	} else {
+		var.is_elidable = var.type == VALUE_RECIPE
+			&& parser.scope_depth > 0;
+		var.allocation = vm_code_offset();
+		emit_default_value(&var);
 	}
-	return val;
+
+	/* A local's value stays on the stack, in its slot. */
+	if (parser.scope_depth > 0) {
+		slot = variable_vector_add(parser.locals, var);
+		if (slot > 0xFFFF)
+			COMPILER_REPORT(name->line, "Too many local variables.");
+		return;
+	}
+
+	slot = variable_vector_add(parser.globals, var);
+	vm_add_global();
+	if (slot > 0xFFFF) {
+		COMPILER_REPORT(name->line, "Too many global variables.");
+		return;
+	}
+	emit_slot(OP_SET_GLOBAL, OP_SET_GLOBAL_LONG, slot);
 }
 
-static struct value comparison()
+static void const_declaration()
 {
-	struct value val = term();
+	struct variable var = {.depth = parser.scope_depth, .subtype = -1};
 
-	while (CURRENT_TOKEN_IS(TOKEN_GREATER, TOKEN_GREATER_EQUAL,
-			TOKEN_LESS, TOKEN_LESS_EQUAL)) {
-		switch (advance()->type) {
-		case TOKEN_GREATER:
-			return value_greater(val, term());
-		case TOKEN_GREATER_EQUAL:
-			return value_greater_or_equal(val, term());
-		case TOKEN_LESS:
-			return value_less(val, term());
-		case TOKEN_LESS_EQUAL:
-			return value_less_or_equal(val, term());
-		default: break;
+	advance();	/* const */
+	if (!parse_type(&var)) {
+		synchronize();
+		return;
+	}
+
+	struct token *name = advance();
+	if (name->type != TOKEN_IDENTIFIER) {
+		COMPILER_REPORT(name->line, "Expected a constant name.");
+		return;
+	}
+	var.name = name->lexeme;
+
+	if (var.type != VALUE_INT && var.type != VALUE_FLOAT
+	    && var.type != VALUE_BOOL && var.type != VALUE_STRING) {
+		COMPILER_REPORT(name->line, "Constants must be ints, floats,"
+				" bools or strings.");
+		return;
+	}
+	if (is_declared(&var.name)) {
+		COMPILER_REPORT(name->line, "Variable already declared.");
+		return;
+	}
+
+	/* like variables, constants default to 0, 0.0, false or "" */
+	if (CURRENT_TOKEN_IS(TOKEN_EQUAL)) {
+		advance();
+		constant_expression(&var, &var.value);
+	} else if (var.type == VALUE_STRING) {
+		var.value = vm_intern_string("", 0);
+	} else {
+		var.value = (struct value){.type = var.type};
+	}
+	var.subtype = -1;
+	variable_vector_add(parser.constants, var);
+}
+
+static void enum_declaration()
+{
+	struct token *name = NULL;
+	int enumeration = -1, next = 0;
+
+	advance();	/* enum */
+	if (CURRENT_TOKEN_IS(TOKEN_IDENTIFIER)) {
+		name = advance();
+		if (find_enum(name) != -1
+		    || recipe_vector_find(parser.recipes, &name->lexeme) != -1) {
+			COMPILER_REPORT(name->line, "Type %s already declared.",
+					sbstr2str(&name->lexeme));
 		}
+		enumeration = variable_vector_add(parser.enums, (struct variable){
+				.name = name->lexeme,
+				.depth = parser.scope_depth
+			});
 	}
-	return val;
+	consume(TOKEN_LEFT_BRACE, "Expected '{' after enum.");
+	parser.enumeration = enumeration;
+
+	/* members count up from 0, or from the value given */
+	while (!CURRENT_TOKEN_IS(TOKEN_RIGHT_BRACE, TOKEN_NEWLINE,
+				 TOKEN_END_OF_FILE)) {
+		struct token *member = advance();
+		struct variable var = {
+			.name = member->lexeme,
+			.type = VALUE_INT,
+			.subtype = enumeration,
+			.depth = parser.scope_depth
+		};
+
+		if (member->type != TOKEN_IDENTIFIER) {
+			COMPILER_REPORT(member->line, "Expected an enum member.");
+			synchronize();
+			break;
+		}
+		if (CURRENT_TOKEN_IS(TOKEN_EQUAL)) {
+			advance();
+			if (constant_expression(&var, &var.value))
+				next = var.value.as.integer;
+		}
+		if (enumeration != -1
+		    ? find_constant(enumeration, &var.name) != NULL
+		    : is_declared(&var.name)) {
+			COMPILER_REPORT(member->line, "Enum member %s already declared.",
+					sbstr2str(&var.name));
+		}
+
+		var.value = GET_VALUE_INT(next++);
+		variable_vector_add(parser.constants, var);
+
+		if (!CURRENT_TOKEN_IS(TOKEN_COMMA)) break;
+		advance();
+	}
+	parser.enumeration = -1;
+	consume(TOKEN_RIGHT_BRACE, "Expected '}' after the members.");
 }
 
-static struct value term()
+static int is_declared(const struct substring *name)
 {
-	struct value val = factor();
+	struct variable_vector *scope = (parser.scope_depth > 0)
+		? parser.locals : parser.globals;
+	int slot = variable_vector_find(scope, name);
+	struct variable *cst = find_constant(-1, name);
 
-	while (CURRENT_TOKEN_IS(TOKEN_PLUS, TOKEN_MINUS)) {
-		switch (advance()->type) {
-		case TOKEN_PLUS:
-			return value_add(val, factor());
-		case TOKEN_MINUS:
-			return value_substract(val, factor());
-		default: break;	/* should not reach here */
+	return (slot != -1 && scope->array[slot].depth == parser.scope_depth)
+		|| (cst != NULL && cst->depth == parser.scope_depth);
+}
+
+static void assignment()
+{
+	struct token *name = advance();
+	advance();		/* = */
+
+	if (visible_constant(&name->lexeme) != NULL) {
+		COMPILER_REPORT(name->line, "Cannot assign to %s, a constant.",
+				sbstr2str(&name->lexeme));
+		synchronize();
+		return;
+	}
+
+	int slot = variable_vector_find(parser.locals, &name->lexeme);
+	if (slot != -1 && parser.locals->array[slot].is_const) {
+		COMPILER_REPORT(name->line, "Cannot change %s, a const ref.",
+				sbstr2str(&name->lexeme));
+		synchronize();
+		return;
+	}
+	if (slot != -1) {
+		initializer(&parser.locals->array[slot]);
+		if (parser.locals->array[slot].is_ref)
+			vm_add_code_dyladic(OP_SET_REF, slot);
+		else
+			emit_slot(OP_SET_LOCAL, OP_SET_LOCAL_LONG, slot);
+		return;
+	}
+
+	slot = variable_vector_find(parser.globals, &name->lexeme);
+	if (slot != -1) {
+		initializer(&parser.globals->array[slot]);
+		emit_slot(OP_SET_GLOBAL, OP_SET_GLOBAL_LONG, slot);
+		return;
+	}
+
+	COMPILER_REPORT(name->line, "Undefined variable %s.",
+			sbstr2str(&name->lexeme));
+	synchronize();
+}
+
+static void field_assignment()
+{
+	struct operand instance = variable(advance());
+	advance();		/* . */
+	struct token *name = advance();
+	advance();		/* = */
+
+	if (!instance.is_typed || instance.value.type != VALUE_RECIPE) {
+		COMPILER_REPORT(name->line, "Only recipes have fields.");
+		synchronize();
+		return;
+	}
+	if (instance.is_const) {
+		COMPILER_REPORT(name->line, "Cannot change a field of a const ref.");
+		synchronize();
+		return;
+	}
+
+	struct field *fd = recipe_find_field(
+		&parser.recipes->array[instance.subtype], &name->lexeme);
+	if (fd == NULL) {
+		COMPILER_REPORT(name->line, "No field named %s.",
+				sbstr2str(&name->lexeme));
+		synchronize();
+		return;
+	}
+
+	int start = vm_code_offset();
+	struct operand val = expression();
+	struct variable target = {.type = fd->type};
+
+	coerce(&target, &val, start);
+	vm_add_code_dyladic(fd->set_code, fd->offset);
+}
+
+static void index_assignment()
+{
+	struct token *name = parser.current_token;
+	struct operand arr = variable(advance());
+	advance();		/* [ */
+
+	int is_map = arr.is_typed && arr.value.type == VALUE_MAP;
+	if (!is_map && (!arr.is_typed || arr.value.type != VALUE_ARRAY)) {
+		COMPILER_REPORT(name->line, "Only arrays and maps can be indexed.");
+		synchronize();
+		return;
+	}
+	if (arr.is_const) {
+		COMPILER_REPORT(name->line, "Cannot change an element of a const ref.");
+		synchronize();
+		return;
+	}
+
+	/* maps hold values of any type */
+	if (is_map) {
+		struct operand key = expression();
+		map_key(&key, name->line);
+		consume(TOKEN_RIGHT_SQUARE, "Expected ']' after the key.");
+		consume(TOKEN_EQUAL, "Expected '=' after the key.");
+		if (expression().is_void)
+			COMPILER_REPORT(name->line, "Function does not return a value.");
+		vm_add_code(OP_SET_KEY);
+		return;
+	}
+
+	/* the range of a loop keeps the index within bounds */
+	struct invariant *inv = (name[3].type == TOKEN_RIGHT_SQUARE)
+		? find_invariant(INVARIANT_INDEX, name, name + 2) : NULL;
+	if (inv != NULL) {
+		parser.current_token += 2;
+	} else {
+		struct operand index = expression();
+		if (index.is_void || (index.is_typed
+				      && index.value.type != VALUE_INT))
+			COMPILER_REPORT(name->line, "Index must be an int.");
+		consume(TOKEN_RIGHT_SQUARE, "Expected ']' after the index.");
+	}
+	consume(TOKEN_EQUAL, "Expected '=' after the index.");
+
+	struct operand element = get_element(arr.subtype);
+	struct variable target = {
+		.type = element.value.type,
+		.subtype = element.subtype
+	};
+	int start = vm_code_offset();
+	struct operand val = expression();
+
+	/* boxed arrays hold values of any type */
+	if (element.is_typed)
+		coerce(&target, &val, start);
+	else if (val.is_void)
+		COMPILER_REPORT(name->line, "Function does not return a value.");
+	if (inv != NULL)
+		vm_add_code_dyladic(set_unchecked_codes[arr.subtype],
+				    inv->slot);
+	else
+		vm_add_code(set_index_codes[arr.subtype]);
+}
+
+static int is_index_assignment()
+{
+	struct token *tok = parser.current_token;
+	int depth = 0;
+
+	if (tok->type != TOKEN_IDENTIFIER || tok[1].type != TOKEN_LEFT_SQUARE)
+		return 0;
+
+	for (tok++; tok->type != TOKEN_NEWLINE
+		     && tok->type != TOKEN_END_OF_FILE; tok++) {
+		if (tok->type == TOKEN_LEFT_SQUARE) depth++;
+		if (tok->type == TOKEN_RIGHT_SQUARE && --depth == 0)
+			return tok[1].type == TOKEN_EQUAL;
+	}
+	return 0;
+}
+
+static void function_declaration()
+{
+	int line = advance()->line;	/* func */
+
+	if (parser.function != -1 || parser.scope_depth > 0) {
+		COMPILER_REPORT(line, "Functions must be declared at the top level.");
+		synchronize();
+		end_of_line();
+		return;
+	}
+
+	struct token *name = advance();
+	if (name->type != TOKEN_IDENTIFIER) {
+		COMPILER_REPORT(name->line, "Expected a function name.");
+		synchronize();
+		end_of_line();
+		return;
+	}
+	if (signature_vector_find(parser.functions, parser.recipe,
+				  &name->lexeme) != -1) {
+		COMPILER_REPORT(name->line, "Function %s already declared.",
+				sbstr2str(&name->lexeme));
+	}
+
+	struct signature sig = {
+		.name = name->lexeme,
+		.recipe = parser.recipe,
+		.parameters = parser.parameters->count
+	};
+
+	/* The parameters are the function's first locals, where the
+	 * caller leaves the arguments. */
+	parser.scope_depth = 1;
+	consume(TOKEN_LEFT_PAREN, "Expected '(' after the function name.");
+	while (!CURRENT_TOKEN_IS(TOKEN_RIGHT_PAREN, TOKEN_NEWLINE,
+				 TOKEN_END_OF_FILE)) {
+		struct variable param = {.depth = parser.scope_depth};
+
+		if (CURRENT_TOKEN_IS(TOKEN_CONST)) {
+			advance();
+			param.is_const = 1;
+			if (!CURRENT_TOKEN_IS(TOKEN_REF)) {
+				COMPILER_REPORT(parser.current_token->line,
+						"Expected ref after const.");
+				break;
+			}
+		}
+		if (CURRENT_TOKEN_IS(TOKEN_REF)) {
+			advance();
+			param.is_ref = 1;
+		}
+
+		if (!parse_type(&param)) break;
+
+		struct token *param_name = advance();
+		if (param_name->type != TOKEN_IDENTIFIER) {
+			COMPILER_REPORT(param_name->line,
+					"Expected a parameter name.");
+			break;
 		}
+		if (sig.arity == SIGNATURE_MAX_ARITY) {
+			COMPILER_REPORT(param_name->line, "Too many parameters.");
+			break;
+		}
+
+		param.name = param_name->lexeme;
+		sig.arity++;
+		variable_vector_add(parser.parameters, param);
+		/* cleared by the first use which lets the instance escape */
+		param.is_elidable = param.is_ref;
+		variable_vector_add(parser.locals, param);
+
+		if (!CURRENT_TOKEN_IS(TOKEN_COMMA)) break;
+		advance();
 	}
-	return val;
+	consume(TOKEN_RIGHT_PAREN, "Expected ')' after the parameters.");
+
+	struct variable returned = {0};
+	if (CURRENT_TOKEN_IS(TOKEN_ARROW)) {
+		advance();
+		if (parse_type(&returned)) {
+			sig.return_type = returned.type;
+			sig.return_subtype = returned.subtype;
+			sig.returns_value = 1;
+		}
+	}
+	consume(TOKEN_COLON, "Expected ':' after the function's signature.");
+
+	/* The body only runs through calls. */
+	int jump = vm_add_jump(OP_JUMP);
+	int index = vm_add_function(sig.arity, sig.returns_value);
+	signature_vector_add(parser.functions, sig);
+
+	if (index > 0xFFFF)
+		COMPILER_REPORT(name->line, "Too many functions.");
+
+	parser.function = index;
+	end_of_line();
+	block(parser.indent + 1);
+
+	/* Falling off the end returns the return type's default value. */
+	if (sig.returns_value) {
+		emit_default_value(&returned);
+		vm_add_code(OP_RETURN);
+	} else {
+		vm_add_code(OP_RETURN_VOID);
+	}
+
+	vm_end_function(index);
+	if (!vm_patch_jump(jump))
+		COMPILER_REPORT(name->line, "Function body too large.");
+
+	elide_allocations(0);
+	for (int i = 0; i < sig.arity; i++) {
+		parser.parameters->array[sig.parameters + i].is_elidable =
+			parser.locals->array[i].is_elidable;
+	}
+	parser.locals->count = 0;
+	parser.scope_depth = 0;
+	parser.function = -1;
 }
 
-static struct value factor()
+static void recipe_declaration()
 {
-	struct value val = unary();
+	int line = advance()->line;	/* recipe */
 
-	while (CURRENT_TOKEN_IS(TOKEN_STAR, TOKEN_SLASH, TOKEN_PERCENT)) {
-		switch (advance()->type) {
-		case TOKEN_STAR:
-			return value_multiply(val, unary());
-		case TOKEN_SLASH:
-			return value_divide(val, unary());
-		case TOKEN_PERCENT:
-			return value_modulo(val, unary());
-		default: break;	/* should not reach here */ 
+	if (parser.function != -1 || parser.scope_depth > 0) {
+		COMPILER_REPORT(line, "Recipes must be declared at the top level.");
+		synchronize();
+		end_of_line();
+		return;
+	}
+
+	struct token *name = advance();
+	if (name->type != TOKEN_IDENTIFIER) {
+		COMPILER_REPORT(name->line, "Expected a recipe name.");
+		synchronize();
+		end_of_line();
+		return;
+	}
+	if (recipe_vector_find(parser.recipes, &name->lexeme) != -1) {
+		COMPILER_REPORT(name->line, "Recipe %s already declared.",
+				sbstr2str(&name->lexeme));
+	}
+
+	consume(TOKEN_COLON, "Expected ':' after the recipe's name.");
+	end_of_line();
+
+	/* Added before its fields are read, the recipe gets no field of
+	 * its own type. */
+	int index = recipe_vector_add(parser.recipes, name->lexeme);
+	int function_count = 0;
+
+	/* The body is one field declaration per line, then the recipe's
+	 * static functions. */
+	while (!CURRENT_TOKEN_IS(TOKEN_END_OF_FILE)) {
+		if (skip_blank_line()) continue;
+
+		int tabs = line_indentation();
+		if (tabs == 0) break;
+		parser.current_token += tabs;
+
+		if (tabs == 1 && CURRENT_TOKEN_IS(TOKEN_FUNC)) {
+			parser.recipe = index;
+			parser.indent = 1;
+			function_declaration();
+			parser.indent = 0;
+			parser.recipe = -1;
+			function_count++;
+			continue;
+		}
+
+		struct recipe *rc = &parser.recipes->array[index];
+		struct field fd = {0};
+		struct token *type = parser.current_token;
+
+		/* the functions' instances have the size known to them */
+		if (function_count > 0) {
+			COMPILER_REPORT(type->line, "Fields must be declared"
+					" before the recipe's functions.");
+			synchronize();
+			end_of_line();
+			continue;
+		}
+
+		switch (type->type) {
+		case TOKEN_INT:
+		case TOKEN_UINT:
+			fd = (struct field){.get_code = OP_GET_FIELD_INT,
+				.set_code = OP_SET_FIELD_INT, .width = 4};
+			break;
+		case TOKEN_BYTE:
+			fd = (struct field){.get_code = OP_GET_FIELD_BYTE,
+				.set_code = OP_SET_FIELD_BYTE, .width = 1};
+			break;
+		case TOKEN_SBYTE:
+			fd = (struct field){.get_code = OP_GET_FIELD_SBYTE,
+				.set_code = OP_SET_FIELD_SBYTE, .width = 1};
+			break;
+		case TOKEN_FLOAT:
+			fd = (struct field){.get_code = OP_GET_FIELD_FLOAT,
+				.set_code = OP_SET_FIELD_FLOAT, .width = 8};
+			break;
+		case TOKEN_BOOL:
+			fd = (struct field){.get_code = OP_GET_FIELD_BOOL,
+				.set_code = OP_SET_FIELD_BOOL, .width = 1};
+			break;
+		default:
+			COMPILER_REPORT(type->line,
+					"Recipe fields must be numbers or bools.");
+			synchronize();
+			end_of_line();
+			continue;
 		}
+		advance();
+
+		struct token *field_name = advance();
+		if (tabs != 1 || field_name->type != TOKEN_IDENTIFIER) {
+			COMPILER_REPORT(field_name->line, "Expected a field name.");
+			synchronize();
+			end_of_line();
+			continue;
+		}
+		if (recipe_find_field(rc, &field_name->lexeme) != NULL) {
+			COMPILER_REPORT(field_name->line, "Field %s already declared.",
+					sbstr2str(&field_name->lexeme));
+		}
+
+		fd.name = field_name->lexeme;
+		fd.type = get_declared_type(type->type);
+		if (recipe_add_field(rc, fd) + fd.width > 0xFFFF)
+			COMPILER_REPORT(field_name->line, "Recipe too large.");
+		end_of_line();
 	}
-	return val;
+
+	if (parser.recipes->array[index].field_count == 0
+	    && function_count == 0) {
+		COMPILER_REPORT(name->line, "Expected the recipe's fields.");
+	}
+}
+
+static void return_statement()
+{
+	int line = advance()->line;	/* return */
+
+	if (parser.function == -1) {
+		COMPILER_REPORT(line, "Cannot return from the top level.");
+		synchronize();
+		return;
+	}
+
+	struct signature *sig = &parser.functions->array[parser.function];
+
+	if (CURRENT_TOKEN_IS(TOKEN_NEWLINE, TOKEN_END_OF_FILE)) {
+		if (sig->returns_value)
+			COMPILER_REPORT(line, "Expected a return value.");
+		vm_add_code(OP_RETURN_VOID);
+		return;
+	}
+
+	if (!sig->returns_value) {
+		COMPILER_REPORT(line, "Function does not return a value.");
+		synchronize();
+		return;
+	}
+
+	int start = vm_code_offset();
+	struct operand val = expression();
+	struct variable returned = {
+		.type = sig->return_type,
+		.subtype = sig->return_subtype
+	};
+
+	/* A call returned as is reuses the frame of the function making
+	 * it, so recursion through it runs in constant stack. */
+	if (!coerce(&returned, &val, start) && val.is_call) {
+		vm_patch_code(vm_code_offset() - 3, OP_TAIL_CALL);
+		return;
+	}
+
+	vm_add_code(OP_RETURN);
+}
+
+static void if_statement()
+{
+	advance();	/* if or elif */
+
+	int line = parser.current_token->line;
+	struct condition cond;
+
+	condition(&cond, line);
+	consume(TOKEN_COLON, "Expected ':' after the condition.");
+	end_of_line();
+	block(parser.indent + 1);
+
+	/* elif and else lines are indented like their if */
+	int indent = parser.indent;
+	struct token *next = parser.current_token + indent;
+	if (line_indentation() != indent
+	    || (next->type != TOKEN_ELIF && next->type != TOKEN_ELSE)) {
+		patch_branches(cond.when_false, cond.false_count, line);
+		return;
+	}
+
+	int exit = vm_add_jump(OP_JUMP);
+	patch_branches(cond.when_false, cond.false_count, line);
+	parser.current_token = next;
+
+	if (next->type == TOKEN_ELIF) {
+		if (!if_table()) if_statement();
+	} else {
+		advance();	/* else */
+		consume(TOKEN_COLON, "Expected ':' after else.");
+		end_of_line();
+		block(indent + 1);
+	}
+
+	if (!vm_patch_jump(exit))
+		COMPILER_REPORT(line, "Block too large.");
 }
 
-static struct value unary()
+static int if_table()
 {
-	if (CURRENT_TOKEN_IS(TOKEN_MINUS, TOKEN_BANG)) {
-		switch (advance()->type) {
-		case TOKEN_MINUS:
-			return value_negate(unary());
-		case TOKEN_BANG:
-			return value_logical_not(unary());
-		default: break;	/* should not reach here */
+	struct case_chain chain;
+	const struct token *subject = parser.current_token + 1;
+	int line = parser.current_token->line;
+
+	if (subject->type != TOKEN_IDENTIFIER
+	    || visible_constant(&subject->lexeme) != NULL)
+		return 0;
+
+	int slot = variable_vector_find(parser.locals, &subject->lexeme);
+	struct variable *var = (slot != -1) ? &parser.locals->array[slot] : NULL;
+	if (var == NULL) {
+		slot = variable_vector_find(parser.globals, &subject->lexeme);
+		var = (slot != -1) ? &parser.globals->array[slot] : NULL;
+	}
+	if (var == NULL || var->is_untyped
+	    || (var->type != VALUE_INT && var->type != VALUE_STRING)
+	    || !find_case_chain(parser.current_token, subject, var->type,
+				&chain))
+		return 0;
+
+	variable(subject);
+	case_dispatch(&chain, parser.indent + 1, line);
+	return 1;
+}
+
+static int find_case_chain(struct token *tok, const struct token *subject,
+			   enum value_type type, struct case_chain *chain)
+{
+	int indent = parser.indent, length = SUBSTRING_LENGTH(subject->lexeme);
+
+	chain->count = 0;
+	chain->value_count = 0;
+	chain->otherwise = NULL;
+
+	for (;;) {
+		struct value *value = &chain->values[chain->count];
+
+		if (chain->count == CASE_CHAIN_MAX
+		    || tok[1].type != TOKEN_IDENTIFIER
+		    || SUBSTRING_LENGTH(tok[1].lexeme) != length
+		    || memcmp(tok[1].lexeme.start, subject->lexeme.start,
+			      length - 1) != 0
+		    || tok[2].type != TOKEN_EQUAL_EQUAL
+		    || (tok = case_constant(tok + 3, value)) == NULL
+		    || value->type != type
+		    || tok[0].type != TOKEN_COLON || tok[1].type != TOKEN_NEWLINE)
+			return 0;
+		chain->cases[chain->value_count++] = chain->count;
+		chain->bodies[chain->count++] = tok + 1;
+
+		/* skip the case's block to the next line as indented */
+		int tabs;
+		tok += 2;
+		for (;;) {
+			for (tabs = 0; tok[tabs].type == TOKEN_TAB; tabs++)
+				;
+			if (tok[tabs].type == TOKEN_END_OF_FILE
+			    || (tok[tabs].type != TOKEN_NEWLINE && tabs <= indent))
+				break;
+			while (tok->type != TOKEN_NEWLINE
+			       && tok->type != TOKEN_END_OF_FILE)
+				tok++;
+			if (tok->type == TOKEN_NEWLINE) tok++;
 		}
+		if (tabs != indent) break;
+
+		tok += indent;
+		if (tok->type == TOKEN_ELSE) chain->otherwise = tok;
+		if (tok->type != TOKEN_ELIF) break;
 	}
-	return primary();
+
+	return chain->count >= CASE_CHAIN_MIN;
 }
 
-static struct value primary()
+static struct token *case_constant(struct token *tok, struct value *value)
 {
-	struct token* t = advance();
+	struct variable *cst;
 
-        switch (t->type) {
+	if (tok->type == TOKEN_MINUS && tok[1].type == TOKEN_CONSTANT_INT) {
+		*value = GET_VALUE_INT(-atoi(sbstr2str(&tok[1].lexeme)));
+		return tok + 2;
+	}
+
+	switch (tok->type) {
 	case TOKEN_CONSTANT_INT:
-		return GET_VALUE_INT(atoi(sbstr2str(&t->lexeme)));
-	case TOKEN_CONSTANT_FLOAT:
-		return GET_VALUE_FLOAT(atof(sbstr2str(&t->lexeme)));
-	case TOKEN_LEFT_PAREN: {
-		/* advance the current token
-		 * `t` is now obsolete */
-		struct value value = expression(); 	
-		if (advance()->type != TOKEN_RIGHT_PAREN) {
-			COMPILER_REPORT(parser.current_token->line,
-				"Expected ')' after expression.");
-		}
-		return value;
+		*value = GET_VALUE_INT(atoi(sbstr2str(&tok->lexeme)));
+		return tok + 1;
+	case TOKEN_STRING: {
+		int length;
+		char *chars = unescape(tok, &length);
+
+		*value = vm_intern_string(chars, length);
+		free(chars);
+		return tok + 1;
 	}
+	case TOKEN_IDENTIFIER:
+		if (tok[1].type == TOKEN_DOT && find_enum(tok) != -1) {
+			cst = find_constant(find_enum(tok), &tok[2].lexeme);
+			if (tok[2].type != TOKEN_IDENTIFIER || cst == NULL)
+				return NULL;
+			*value = cst->value;
+			return tok + 3;
+		}
+		cst = visible_constant(&tok->lexeme);
+		if (cst == NULL) return NULL;
+		*value = cst->value;
+		return tok + 1;
 	default:
-		COMPILER_REPORT(t->line, "No expression found.");
+		return NULL;
+	}
+}
+
+static void match_statement()
+{
+	struct case_chain chain;
+	int line = advance()->line;	/* match */
+	struct operand subject = expression();
+
+	if (subject.is_void || !subject.is_typed
+	    || (subject.value.type != VALUE_INT
+		&& subject.value.type != VALUE_STRING))
+		COMPILER_REPORT(line, "Only ints and strs can be matched.");
+	consume(TOKEN_COLON, "Expected ':' after the matched value.");
+	end_of_line();
+
+	find_match_cases(subject.value.type, &chain);
+	case_dispatch(&chain, parser.indent + 2, line);
+}
+
+static void find_match_cases(enum value_type type, struct case_chain *chain)
+{
+	int indent = parser.indent + 1;
+	struct token *tok = parser.current_token;
+
+	chain->count = 0;
+	chain->value_count = 0;
+	chain->otherwise = NULL;
+
+	for (;;) {
+		int tabs;
+
+		for (tabs = 0; tok[tabs].type == TOKEN_TAB; tabs++)
+			;
+		if (tok[tabs].type == TOKEN_END_OF_FILE || tabs < indent)
+			break;
+		if (tok[tabs].type == TOKEN_NEWLINE || tabs > indent) {
+			while (tok->type != TOKEN_NEWLINE
+			       && tok->type != TOKEN_END_OF_FILE)
+				tok++;
+			if (tok->type == TOKEN_NEWLINE) tok++;
+			continue;
+		}
+
+		tok += tabs;
+		if (tok->type == TOKEN_ELSE) {
+			chain->otherwise = tok;
+			break;
+		}
+		if (tok->type != TOKEN_CASE) {
+			COMPILER_REPORT(tok->line, "Expected a case.");
+			break;
+		}
+		if (chain->count == CASE_CHAIN_MAX) {
+			COMPILER_REPORT(tok->line, "Too many cases.");
+			break;
+		}
+
+		/* a case's line ending, the rest of its block is skipped */
+		do {
+			struct value *value = &chain->values[chain->value_count];
+			struct token *next = case_constant(tok + 1, value);
+
+			if (next == NULL) {
+				COMPILER_REPORT(tok[1].line,
+						"Cases must be constants.");
+				break;
+			}
+			/* a value matched by nothing was already reported */
+			if (value->type != type
+			    && (type == VALUE_INT || type == VALUE_STRING)) {
+				COMPILER_REPORT(tok[1].line,
+						"Cases must be %ss like the matched value.",
+						get_type_name(type));
+			} else if (chain->value_count < CASE_CHAIN_MAX) {
+				chain->cases[chain->value_count++] = chain->count;
+			}
+			tok = next;
+		} while (tok->type == TOKEN_COMMA);
+
+		while (tok->type != TOKEN_COLON && tok->type != TOKEN_NEWLINE
+		       && tok->type != TOKEN_END_OF_FILE)
+			tok++;
+		if (tok->type != TOKEN_COLON || tok[1].type != TOKEN_NEWLINE)
+			COMPILER_REPORT(tok->line, "Expected ':' after the case.");
+		while (tok->type != TOKEN_NEWLINE && tok->type != TOKEN_END_OF_FILE)
+			tok++;
+		chain->bodies[chain->count++] = tok;
+		if (tok->type == TOKEN_NEWLINE) tok++;
+	}
+
+	if (chain->count == 0 && chain->otherwise == NULL)
+		COMPILER_REPORT(parser.current_token->line, "Expected a case.");
+}
+
+static void case_dispatch(const struct case_chain *chain, int indent,
+			  int line)
+{
+	struct value keys[CASE_CHAIN_MAX];
+	int targets[CASE_CHAIN_MAX], exits[CASE_CHAIN_MAX];
+	int key_cases[CASE_CHAIN_MAX];
+	int count = 0, table = -1, match = -1;
+	int64_t min = 0, max = 0;
+
+	/* the first of equal cases is the one taken, interned strings
+	 * being equal when their words are */
+	for (int i = 0; i < chain->value_count; i++) {
+		const struct value *value = &chain->values[i];
+		int is_first = 1;
+
+		for (int j = 0; j < count; j++) {
+			if (value->type == VALUE_INT)
+				is_first &= value->as.integer != keys[j].as.integer;
+			else
+				is_first &= value->as.string != keys[j].as.string;
+		}
+		if (!is_first) continue;
+
+		key_cases[count] = chain->cases[i];
+		keys[count++] = *value;
+		if (value->type == VALUE_INT && (count == 1 || value->as.integer < min))
+			min = value->as.integer;
+		if (value->type == VALUE_INT && (count == 1 || value->as.integer > max))
+			max = value->as.integer;
+	}
+
+	/* a dense range of ints is indexed, any other case hashed */
+	if (count == 0)
+		vm_add_code(OP_POP);
+	else if (keys[0].type == VALUE_INT && max - min < 0xFFFF
+		 && max - min + 1 <= 3 * count)
+		table = vm_add_jump_table(min, max - min + 1);
+	else
+		match = vm_add_match();
+
+	for (int i = 0; i < chain->count; i++) {
+		for (int j = 0; j < count; j++) {
+			if (key_cases[j] != i) continue;
+			targets[j] = vm_code_offset();
+			if (table != -1
+			    && !vm_patch_jump_table(table, keys[j].as.integer - min))
+				COMPILER_REPORT(line, "Block too large.");
+		}
+
+		parser.current_token = chain->bodies[i];
+		end_of_line();
+		block(indent);
+
+		if (i < chain->count - 1 || chain->otherwise != NULL)
+			exits[i] = vm_add_jump(OP_JUMP);
+	}
+
+	/* the values between the cases land with the others on else */
+	if (table != -1) {
+		for (int entry = 0; entry < max - min + 1; entry++) {
+			int is_case = 0;
+
+			for (int j = 0; j < count; j++)
+				is_case |= keys[j].as.integer - min == entry;
+			if (!is_case && !vm_patch_jump_table(table, entry))
+				COMPILER_REPORT(line, "Block too large.");
+		}
+		if (!vm_patch_jump_table(table, max - min + 1))
+			COMPILER_REPORT(line, "Block too large.");
+	} else if (match != -1) {
+		vm_set_match(match, keys, targets, count, vm_code_offset());
+	}
+
+	if (chain->otherwise != NULL) {
+		parser.current_token = chain->otherwise;
+		advance();	/* else */
+		consume(TOKEN_COLON, "Expected ':' after else.");
+		end_of_line();
+		block(indent);
+	}
+
+	for (int i = 0; i < chain->count; i++) {
+		if ((i < chain->count - 1 || chain->otherwise != NULL)
+		    && !vm_patch_jump(exits[i]))
+			COMPILER_REPORT(line, "Block too large.");
+	}
+}
+
+static void while_statement()
+{
+	int line = advance()->line;	/* while */
+	int invariants = parser.invariant_count;
+	struct condition cond;
+
+	/* the hoisted reads are locals of a scope around the loop */
+	begin_scope();
+	hoist_invariants(parser.current_token, line);
+	int start = vm_code_offset();
+
+	condition(&cond, line);
+	consume(TOKEN_COLON, "Expected ':' after the condition.");
+	end_of_line();
+
+	struct loop lp = {.depth = parser.scope_depth, .start = start};
+
+	loop_body(&lp);
+	if (!vm_add_loop(OP_LOOP, 0, start))
+		COMPILER_REPORT(line, "Loop body too large.");
+	patch_branches(cond.when_false, cond.false_count, line);
+	patch_breaks(&lp, line);
+	parser.invariant_count = invariants;
+	end_scope();
+}
+
+static void for_statement()
+{
+	int line = advance()->line;	/* for */
+	struct token *name = advance();
+
+	if (name->type != TOKEN_IDENTIFIER) {
+		COMPILER_REPORT(name->line, "Expected the loop's variable.");
+		synchronize();
+		end_of_line();
+		return;
+	}
+	consume(TOKEN_IN, "Expected 'in' after the loop's variable.");
+
+	/* The loop's slots are locals with an empty name, which no
+	 * identifier finds. Its variable comes last. */
+	begin_scope();
+	int slot = parser.locals->count;
+	struct variable hidden = {.type = VALUE_INT, .depth = parser.scope_depth};
+	struct variable var = hidden;
+	enum op_code prep;
+
+	struct token *tok = parser.current_token, *bound = NULL;
+	if (is_range(tok)) {
+		/* counted without materializing the range */
+		bound = range_bound(tok);
+		parser.current_token += 2;
+		range_slots();
+		for (int i = 0; i < 3; i++)
+			variable_vector_add(parser.locals, hidden);
+		prep = OP_FOR_RANGE_PREP;
+	} else {
+		/* arrays are read in place, by index, maps by entry */
+		struct operand arr = expression();
+		int is_map = !arr.is_void && arr.is_typed
+			&& arr.value.type == VALUE_MAP;
+		if (!is_map && (arr.is_void || !arr.is_typed
+				|| arr.value.type != VALUE_ARRAY)) {
+			COMPILER_REPORT(line, "Only ranges, arrays and maps can"
+					" be iterated over.");
+			arr = (struct operand){.subtype = ARRAY_VALUE};
+		}
+		vm_add_constant(GET_VALUE_INT(0));
+
+		/* a map's keys are iterated, of any type */
+		struct operand element = is_map ? (struct operand){0}
+			: get_element(arr.subtype);
+		variable_vector_add(parser.locals, (struct variable){
+				.type = is_map ? VALUE_MAP : VALUE_ARRAY,
+				.subtype = arr.subtype,
+				.depth = parser.scope_depth
+			});
+		variable_vector_add(parser.locals, hidden);
+		var.type = element.value.type;
+		var.is_untyped = !element.is_typed;
+		prep = is_map ? OP_FOR_MAP_PREP : OP_FOR_ARRAY_PREP;
+	}
+
+	/* set by the loop before every iteration */
+	vm_add_constant(GET_VALUE_INT(0));
+	var.name = name->lexeme;
+	int var_slot = variable_vector_add(parser.locals, var);
+	if (var_slot > 0xFFFF)
+		COMPILER_REPORT(line, "Too many local variables.");
+	consume(TOKEN_COLON, "Expected ':' after the loop's iterable.");
+	end_of_line();
+
+	int invariants = parser.invariant_count;
+	hoist_invariants(name, line);
+	if (bound != NULL) bound_index(bound, name, var_slot, name);
+
+	int skip = vm_add_for_prep(prep, slot);
+	int body = vm_code_offset();
+	struct loop lp = {.depth = parser.scope_depth, .start = -1};
+
+	loop_body(&lp);
+	/* the step follows its prep */
+	if (!vm_add_loop(prep + 1, slot, body))
+		COMPILER_REPORT(line, "Loop body too large.");
+	if (!vm_patch_jump(skip))
+		COMPILER_REPORT(line, "Loop body too large.");
+	patch_breaks(&lp, line);
+	parser.invariant_count = invariants;
+	end_scope();
+}
+
+static void print_statement()
+{
+	int stream = advance()->type == TOKEN_PRINT_ERR;
+	int line = parser.current_token->line;
+
+	consume(TOKEN_LEFT_PAREN, "Expected '(' after print.");
+
+	/* print("%d days\n", n) is formatted as the compiler parsed it */
+	if (CURRENT_TOKEN_IS(TOKEN_STRING)
+	    && NEXT_TOKEN_IS(TOKEN_COMMA, TOKEN_RIGHT_PAREN)) {
+		vm_add_code_triadic(OP_PRINT_FORMAT, stream, format_arguments());
+	} else {
+		if (expression().is_void)
+			COMPILER_REPORT(line, "Function does not return a value.");
+		vm_add_code_monadic(OP_PRINT, stream);
+	}
+
+	consume(TOKEN_RIGHT_PAREN, "Expected ')' after the arguments.");
+}
+
+static int range_slots()
+{
+	int line = parser.current_token->line;
+	int argc = count_arguments();
+
+	if (argc < 1 || argc > 3) {
+		COMPILER_REPORT(line, "range takes 1 to 3 arguments, %d given.",
+				argc);
+		while (!CURRENT_TOKEN_IS(TOKEN_COLON, TOKEN_NEWLINE,
+					 TOKEN_END_OF_FILE))
+			advance();
+		vm_add_constant(GET_VALUE_INT(0));
+		vm_add_constant(GET_VALUE_INT(0));
+		vm_add_constant(GET_VALUE_INT(1));
+		return 0;
+	}
+
+	/* range(stop) counts from 0, and steps by 1 unless told */
+	if (argc == 1) vm_add_constant(GET_VALUE_INT(0));
+	for (int i = 0; i < argc; i++) {
+		struct operand val = expression();
+
+		if (val.is_void || (val.is_typed && val.value.type != VALUE_INT))
+			COMPILER_REPORT(line, "range arguments must be ints.");
+		if (i == 2 && val.is_constant && val.value.as.integer == 0)
+			COMPILER_REPORT(line, "Range step cannot be zero.");
+		if (i < argc - 1)
+			consume(TOKEN_COMMA, "Expected ',' between the arguments.");
+	}
+	consume(TOKEN_RIGHT_PAREN, "Expected ')' after the arguments.");
+	if (argc < 3) vm_add_constant(GET_VALUE_INT(1));
+	return 1;
+}
+
+static int count_arguments()
+{
+	struct token *tok = parser.current_token;
+	int depth = 0, count = 0;
+
+	if (tok->type == TOKEN_RIGHT_PAREN) return 0;
+
+	for (; tok->type != TOKEN_NEWLINE && tok->type != TOKEN_END_OF_FILE;
+	     tok++) {
+		if (tok->type == TOKEN_LEFT_PAREN || tok->type == TOKEN_LEFT_SQUARE
+		    || tok->type == TOKEN_LEFT_BRACE) {
+			depth++;
+		} else if (tok->type == TOKEN_RIGHT_PAREN
+			   || tok->type == TOKEN_RIGHT_SQUARE
+			   || tok->type == TOKEN_RIGHT_BRACE) {
+			if (depth-- == 0) break;
+		} else if (tok->type == TOKEN_COMMA && depth == 0) {
+			count++;
+		}
+	}
+	return count + 1;
+}
+
+static void loop_jump()
+{
+	struct token *tok = advance();
+	struct loop *lp = parser.loop;
+	struct variable_vector *locals = parser.locals;
+
+	if (lp == NULL) {
+		COMPILER_REPORT(tok->line, "%s outside of a loop.",
+				sbstr2str(&tok->lexeme));
+		return;
+	}
+
+	/* The body's locals stay declared for the code that follows. */
+	for (int i = locals->count - 1;
+	     i >= 0 && locals->array[i].depth > lp->depth; i--)
+		vm_add_code(OP_POP);
+
+	if (tok->type == TOKEN_CONTINUE && lp->start != -1) {
+		if (!vm_add_loop(OP_LOOP, 0, lp->start))
+			COMPILER_REPORT(tok->line, "Loop body too large.");
+		return;
+	}
+
+	int *jumps = (tok->type == TOKEN_BREAK) ? lp->breaks : lp->continues;
+	int *count = (tok->type == TOKEN_BREAK)
+		? &lp->break_count : &lp->continue_count;
+
+	if (*count == LOOP_JUMP_MAX) {
+		COMPILER_REPORT(tok->line, "Too many %s statements in a loop.",
+				sbstr2str(&tok->lexeme));
+		return;
+	}
+	jumps[(*count)++] = vm_add_jump(OP_JUMP);
+}
+
+static void loop_body(struct loop *lp)
+{
+	int line = parser.current_token->line;
+
+	lp->enclosing = parser.loop;
+	parser.loop = lp;
+	block(parser.indent + 1);
+	parser.loop = lp->enclosing;
+
+	for (int i = 0; i < lp->continue_count; i++) {
+		if (!vm_patch_jump(lp->continues[i]))
+			COMPILER_REPORT(line, "Loop body too large.");
+	}
+}
+
+static void patch_breaks(struct loop *lp, int line)
+{
+	for (int i = 0; i < lp->break_count; i++) {
+		if (!vm_patch_jump(lp->breaks[i]))
+			COMPILER_REPORT(line, "Loop body too large.");
+	}
+}
+
+static void hoist_invariants(struct token *header, int line)
+{
+	struct token *end = loop_end(header);
+	int calls = has_calls(header, end);
+
+	for (struct token *tok = header; tok < end; tok++) {
+		if (tok->type != TOKEN_IDENTIFIER || tok[1].type != TOKEN_DOT
+		    || tok[2].type != TOKEN_IDENTIFIER
+		    || tok[3].type == TOKEN_EQUAL
+		    || tok[-1].type == TOKEN_DOT
+		    || tok[-1].type == TOKEN_COLON_COLON
+		    || find_hoisted(tok) != NULL)
+			continue;
+
+		struct variable *var = loop_variable(tok, calls);
+		struct invariant inv = {.name = tok, .member = tok + 2};
+		struct field *fd = NULL;
+
+		if (var == NULL || !is_unchanged(tok, header, end))
+			continue;
+
+		/* a field may be assigned through another instance, or
+		 * by a function */
+		if (var->type == VALUE_ARRAY && is_length_call(tok)) {
+			inv.kind = INVARIANT_LENGTH;
+			inv.type = VALUE_INT;
+		} else if (var->type == VALUE_RECIPE && !calls
+			   && !is_field_assigned(tok + 2, header, end)
+			   && (fd = recipe_find_field(
+				       &parser.recipes->array[var->subtype],
+				       &tok[2].lexeme)) != NULL) {
+			inv.kind = INVARIANT_FIELD;
+			inv.type = fd->type;
+		} else {
+			continue;
+		}
+		if (parser.invariant_count == INVARIANT_MAX) return;
+
+		/* read as the loop would, the variable followed by its
+		 * field */
+		struct token *current = parser.current_token;
+		parser.current_token = tok + 1;
+		variable(tok);
+		parser.current_token = current;
+		if (fd != NULL)
+			vm_add_code_dyladic(fd->get_code, fd->offset);
+		else
+			vm_add_code(OP_ARRAY_LENGTH);
+
+		inv.slot = variable_vector_add(parser.locals, (struct variable){
+				.type = inv.type,
+				.depth = parser.scope_depth
+			});
+		if (inv.slot > 0xFFFF)
+			COMPILER_REPORT(line, "Too many local variables.");
+		parser.invariants[parser.invariant_count++] = inv;
+	}
+}
+
+static void bound_index(struct token *arr, struct token *var, int slot,
+			struct token *header)
+{
+	struct token *end = loop_end(header);
+	int calls = has_calls(header, end);
+	struct variable *array = loop_variable(arr, calls);
+
+	if (array == NULL || array->type != VALUE_ARRAY
+	    || !is_unchanged(arr, header, end)
+	    || !is_counter_unchanged(var, parser.current_token, end, calls)
+	    || parser.invariant_count == INVARIANT_MAX)
+		return;
+
+	parser.invariants[parser.invariant_count++] = (struct invariant){
+		.kind = INVARIANT_INDEX,
+		.name = arr,
+		.member = var,
+		.type = VALUE_INT,
+		.slot = slot
+	};
+}
+
+static struct token *range_bound(struct token *range)
+{
+	struct token *tok = range + 2;	/* after ( */
+	int has_start = tok[0].type == TOKEN_CONSTANT_INT
+		&& tok[1].type == TOKEN_COMMA;
+
+	if (has_start) tok += 2;
+	if (tok->type != TOKEN_IDENTIFIER || !is_length_call(tok))
+		return NULL;
+
+	struct token *arr = tok;
+	tok += 5;
+	if (has_start && tok[0].type == TOKEN_COMMA
+	    && tok[1].type == TOKEN_CONSTANT_INT
+	    && atoi(sbstr2str(&tok[1].lexeme)) > 0)
+		tok += 2;
+	return tok->type == TOKEN_RIGHT_PAREN ? arr : NULL;
+}
+
+static struct token *loop_end(struct token *header)
+{
+	struct token *tok = header;
+
+	while (tok->type != TOKEN_NEWLINE && tok->type != TOKEN_END_OF_FILE)
+		tok++;
+
+	/* the body's lines are indented deeper than the loop, blank
+	 * ones aside */
+	while (tok->type == TOKEN_NEWLINE) {
+		struct token *line = tok + 1;
+		int tabs = 0;
+
+		while (line[tabs].type == TOKEN_TAB)
+			tabs++;
+		if (line[tabs].type != TOKEN_NEWLINE && tabs <= parser.indent)
+			return line;
+
+		tok = line + tabs;
+		while (tok->type != TOKEN_NEWLINE
+		       && tok->type != TOKEN_END_OF_FILE)
+			tok++;
+	}
+	return tok;
+}
+
+static struct variable *loop_variable(const struct token *name, int calls)
+{
+	if (visible_constant(&name->lexeme) != NULL) return NULL;
+
+	int slot = variable_vector_find(parser.locals, &name->lexeme);
+	struct variable *var = (slot != -1) ? &parser.locals->array[slot] : NULL;
+	if (var == NULL) {
+		slot = variable_vector_find(parser.globals, &name->lexeme);
+		var = (slot != -1) ? &parser.globals->array[slot] : NULL;
+	}
+
+	if (var == NULL || var->is_untyped
+	    || (calls && (var->depth == 0 || var->is_ref)))
+		return NULL;
+	return var;
+}
+
+static int has_calls(const struct token *start, const struct token *end)
+{
+	for (const struct token *tok = start; tok < end; tok++) {
+		if (tok->type != TOKEN_IDENTIFIER
+		    || tok[1].type != TOKEN_LEFT_PAREN || is_range(tok))
+			continue;
+
+		/* the methods of arrays, maps, str and math assign no
+		 * variable, the functions of recipes may */
+		if (tok[-1].type != TOKEN_DOT
+		    && tok[-1].type != TOKEN_COLON_COLON)
+			return 1;
+		if (tok[-2].type == TOKEN_IDENTIFIER && is_qualifier(tok - 2))
+			return 1;
+	}
+	return 0;
+}
+
+static int is_unchanged(const struct token *name, const struct token *start,
+			const struct token *end)
+{
+	for (const struct token *tok = start; tok < end; tok++) {
+		if (tok->type != TOKEN_IDENTIFIER || !is_same_name(tok, name)
+		    || tok[-1].type == TOKEN_DOT
+		    || tok[-1].type == TOKEN_COLON_COLON)
+			continue;
+		if (is_declared_name(tok)
+		    || (tok[1].type != TOKEN_DOT
+			&& tok[1].type != TOKEN_LEFT_SQUARE))
+			return 0;
+	}
+	return 1;
+}
+
+static int is_counter_unchanged(const struct token *var,
+				const struct token *start,
+				const struct token *end, int calls)
+{
+	for (const struct token *tok = start; tok < end; tok++) {
+		if (tok->type != TOKEN_IDENTIFIER || !is_same_name(tok, var)
+		    || tok[-1].type == TOKEN_DOT
+		    || tok[-1].type == TOKEN_COLON_COLON)
+			continue;
+		if (is_declared_name(tok) || tok[1].type == TOKEN_EQUAL
+		    || tok[1].type == TOKEN_IN)
+			return 0;
+
+		/* passed on alone, perhaps to a ref */
+		if (calls && (tok[-1].type == TOKEN_LEFT_PAREN
+			      || tok[-1].type == TOKEN_COMMA)
+		    && (tok[1].type == TOKEN_RIGHT_PAREN
+			|| tok[1].type == TOKEN_COMMA))
+			return 0;
+	}
+	return 1;
+}
+
+static int is_field_assigned(const struct token *name,
+			     const struct token *start,
+			     const struct token *end)
+{
+	for (const struct token *tok = start; tok < end; tok++) {
+		if (tok->type == TOKEN_IDENTIFIER && is_same_name(tok, name)
+		    && tok[-1].type == TOKEN_DOT && tok[1].type == TOKEN_EQUAL)
+			return 1;
+	}
+	return 0;
+}
+
+static int is_declared_name(const struct token *tok)
+{
+	return IS_TYPE_TOKEN(tok - 1)
+		|| __TOKEN_IS__(tok - 1, (enum token_type[]){TOKEN_IDENTIFIER,
+				TOKEN_RIGHT_SQUARE, TOKEN_ARRAY, TOKEN_MAP,
+				TOKEN_CONST, TOKEN_ENUM, -1});
+}
+
+static struct invariant *find_invariant(enum invariant_kind kind,
+					const struct token *name,
+					const struct token *member)
+{
+	for (int i = parser.invariant_count - 1; i >= 0; i--) {
+		struct invariant *inv = &parser.invariants[i];
+
+		if (inv->kind == kind && is_same_name(inv->name, name)
+		    && is_same_name(inv->member, member))
+			return inv;
+	}
+	return NULL;
+}
+
+static struct invariant *find_hoisted(const struct token *name)
+{
+	struct invariant *inv = find_invariant(INVARIANT_FIELD, name, name + 2);
+
+	if (inv != NULL) return inv;
+	inv = find_invariant(INVARIANT_LENGTH, name, name + 2);
+	return (inv != NULL && is_length_call(name)) ? inv : NULL;
+}
+
+static struct operand hoisted(const struct invariant *inv)
+{
+	/* .field or .length() */
+	parser.current_token += (inv->kind == INVARIANT_LENGTH) ? 4 : 2;
+	emit_slot(OP_GET_LOCAL, OP_GET_LOCAL_LONG, inv->slot);
+	return (struct operand){.value.type = inv->type, .is_typed = 1};
+}
+
+static int is_length_call(const struct token *name)
+{
+	return name[1].type == TOKEN_DOT && name[2].type == TOKEN_IDENTIFIER
+		&& SUBSTRING_LENGTH(name[2].lexeme) == sizeof("length")
+		&& memcmp(name[2].lexeme.start, "length",
+			  sizeof("length") - 1) == 0
+		&& name[3].type == TOKEN_LEFT_PAREN
+		&& name[4].type == TOKEN_RIGHT_PAREN;
+}
+
+static int is_range(const struct token *tok)
+{
+	return tok->type == TOKEN_IDENTIFIER && tok[1].type == TOKEN_LEFT_PAREN
+		&& tok[-1].type == TOKEN_IN
+		&& SUBSTRING_LENGTH(tok->lexeme) == sizeof("range")
+		&& memcmp(tok->lexeme.start, "range", sizeof("range") - 1) == 0;
+}
+
+static int is_same_name(const struct token *name1, const struct token *name2)
+{
+	int length = SUBSTRING_LENGTH(name1->lexeme);
+
+	return SUBSTRING_LENGTH(name2->lexeme) == length
+		&& memcmp(name1->lexeme.start, name2->lexeme.start,
+			  length - 1) == 0;
+}
+
+static void block(int indent)
+{
+	int outer = parser.indent, count = 0;
+
+	parser.indent = indent;
+	begin_scope();
+
+	while (!CURRENT_TOKEN_IS(TOKEN_END_OF_FILE)) {
+		if (skip_blank_line()) continue;
+
+		int tabs = line_indentation();
+		if (tabs < indent) break;
+
+		parser.current_token += tabs;
+		if (tabs > indent) {
+			COMPILER_REPORT(parser.current_token->line,
+					"Unexpected indentation.");
+			synchronize();
+			end_of_line();
+			continue;
+		}
+
+		if (statement()) vm_add_code(OP_POP);
+		count++;
+	}
+
+	if (count == 0) {
+		COMPILER_REPORT(parser.current_token->line,
+				"Expected an indented block.");
+	}
+
+	end_scope();
+	parser.indent = outer;
+}
+
+static void begin_scope()
+{
+	parser.scope_depth++;
+}
+
+static void end_scope()
+{
+	struct variable_vector *locals = parser.locals;
+	int count = locals->count;
+
+	parser.scope_depth--;
+	while (count > 0 && locals->array[count - 1].depth > parser.scope_depth)
+		count--;
+
+	while (parser.constants->count > 0
+	       && parser.constants->array[parser.constants->count - 1].depth
+	       > parser.scope_depth)
+		parser.constants->count--;
+	while (parser.enums->count > 0
+	       && parser.enums->array[parser.enums->count - 1].depth
+	       > parser.scope_depth)
+		parser.enums->count--;
+
+	elide_allocations(count);
+	for (; locals->count > count; locals->count--)
+		vm_add_code(OP_POP);
+}
+
+static void elide_allocations(int first)
+{
+	for (int i = first; i < parser.locals->count; i++) {
+		if (parser.locals->array[i].is_elidable
+		    && !parser.locals->array[i].is_ref)
+			vm_frame_recipe(parser.function,
+					parser.locals->array[i].allocation);
+	}
+}
+
+static void synchronize()
+{
+	while (!CURRENT_TOKEN_IS(TOKEN_NEWLINE, TOKEN_END_OF_FILE))
+		advance();
+}
+
+static void end_of_line()
+{
+	if (CURRENT_TOKEN_IS(TOKEN_END_OF_FILE)) return;
+
+	if (!CURRENT_TOKEN_IS(TOKEN_NEWLINE)) {
+		COMPILER_REPORT(parser.current_token->line,
+				"Expected end of line.");
+		synchronize();
+	}
+	advance();
+}
+
+static int line_indentation()
+{
+	int tabs = 0;
+
+	while (parser.current_token[tabs].type == TOKEN_TAB)
+		tabs++;
+	return tabs;
+}
+
+static int skip_blank_line()
+{
+	int tabs = line_indentation();
+
+	switch (parser.current_token[tabs].type) {
+	case TOKEN_NEWLINE:
+		parser.current_token += tabs + 1;
+		return 1;
+	case TOKEN_END_OF_FILE:
+		parser.current_token += tabs;
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static void consume(enum token_type type, const char *error)
+{
+	if (CURRENT_TOKEN_IS(type)) {
+		advance();
+		return;
+	}
+	COMPILER_REPORT(parser.current_token->line, "%s", error);
+}
+
+static struct operand expression()
+{
+	return logical(TOKEN_OR, conjunction);
+}
+
+static struct operand logical(enum token_type type,
+			      struct operand (*operand)())
+{
+	struct operand val = operand();
+
+	while (CURRENT_TOKEN_IS(type)) {
+		struct token *tok = advance();
+
+		check_bool(&val);
+		int jump = vm_add_jump(type == TOKEN_AND ? OP_JUMP_IF_FALSE_OR_POP
+				       : OP_JUMP_IF_TRUE_OR_POP);
+		struct operand rhs = operand();
+
+		check_bool(&rhs);
+		int is_bool = !val.is_void && !rhs.is_void
+			&& (!val.is_typed || val.value.type == VALUE_BOOL)
+			&& (!rhs.is_typed || rhs.value.type == VALUE_BOOL);
+
+		if (!is_bool) {
+			COMPILER_REPORT(tok->line, "Operands of %s must be bools.",
+					sbstr2str(&tok->lexeme));
+		}
+		if (!vm_patch_jump(jump))
+			COMPILER_REPORT(tok->line, "Expression too large.");
+		val = (struct operand){.value.type = VALUE_BOOL, .is_typed = 1};
+	}
+	return val;
+}
+
+static struct operand conjunction()
+{
+	return logical(TOKEN_AND, inversion);
+}
+
+static struct operand inversion()
+{
+	if (!CURRENT_TOKEN_IS(TOKEN_NOT)) return equality();
+
+	int line = advance()->line;	/* not */
+	int start = vm_code_offset();
+	struct operand val = inversion();
+
+	if (val.is_void || (val.is_typed && val.value.type != VALUE_BOOL)) {
+		COMPILER_REPORT(line, "Operand of not must be a bool.");
+		return (struct operand){};
+	}
+	if (val.is_constant) {
+		val.value = value_logical_not(&val.value);
+		vm_rewind_code(start);
+		vm_add_constant(val.value);
+		return val;
+	}
+	check_bool(&val);
+	vm_add_code(OP_LOGICAL_NOT);
+	return (struct operand){.value.type = VALUE_BOOL, .is_typed = 1};
+}
+
+static void check_bool(const struct operand *val)
+{
+	if (!val->is_typed && !val->is_void) vm_add_code(OP_TO_BOOL);
+}
+
+static void condition(struct condition *cond, int line)
+{
+	branch_or(cond, line);
+	invert_branch(cond, line);
+	patch_branches(cond->when_true, cond->true_count, line);
+}
+
+static void branch_or(struct condition *cond, int line)
+{
+	branch_and(cond, line);
+
+	while (CURRENT_TOKEN_IS(TOKEN_OR)) {
+		struct condition rhs;
+
+		advance();
+		/* the left operand false, the right one decides */
+		patch_branches(cond->when_false, cond->false_count, line);
+		branch_and(&rhs, line);
+
+		if (cond->true_count + rhs.true_count > CONDITION_JUMP_MAX) {
+			COMPILER_REPORT(line, "Condition too long.");
+			return;
+		}
+		memcpy(cond->when_true + cond->true_count, rhs.when_true,
+		       rhs.true_count * sizeof(int));
+		cond->true_count += rhs.true_count;
+		memcpy(cond->when_false, rhs.when_false,
+		       rhs.false_count * sizeof(int));
+		cond->false_count = rhs.false_count;
+	}
+}
+
+static void branch_and(struct condition *cond, int line)
+{
+	branch_not(cond, line);
+
+	while (CURRENT_TOKEN_IS(TOKEN_AND)) {
+		struct condition rhs;
+
+		advance();
+		/* the left operand true, the right one decides */
+		invert_branch(cond, line);
+		patch_branches(cond->when_true, cond->true_count, line);
+		branch_not(&rhs, line);
+
+		if (cond->false_count + rhs.false_count > CONDITION_JUMP_MAX) {
+			COMPILER_REPORT(line, "Condition too long.");
+			return;
+		}
+		memcpy(cond->when_false + cond->false_count, rhs.when_false,
+		       rhs.false_count * sizeof(int));
+		cond->false_count += rhs.false_count;
+		memcpy(cond->when_true, rhs.when_true,
+		       rhs.true_count * sizeof(int));
+		cond->true_count = rhs.true_count;
+	}
+}
+
+static void branch_not(struct condition *cond, int line)
+{
+	struct condition operand;
+
+	if (!CURRENT_TOKEN_IS(TOKEN_NOT)) {
+		branch_operand(cond, line);
+		return;
+	}
+
+	advance();	/* not */
+	branch_not(&operand, line);
+	/* where the operand is false, the inversion is true */
+	invert_branch(&operand, line);
+	memcpy(cond->when_true, operand.when_false,
+	       operand.false_count * sizeof(int));
+	cond->true_count = operand.false_count;
+	memcpy(cond->when_false, operand.when_true,
+	       operand.true_count * sizeof(int));
+	cond->false_count = operand.true_count;
+}
+
+static void branch_operand(struct condition *cond, int line)
+{
+	static const enum op_code fused[][2] = {
+		{OP_EQUAL_INT, OP_JUMP_IF_EQUAL_INT},
+		{OP_NOT_EQUAL_INT, OP_JUMP_IF_NOT_EQUAL_INT},
+		{OP_GREATER_INT, OP_JUMP_IF_GREATER_INT},
+		{OP_GREATER_EQUAL_INT, OP_JUMP_IF_GREATER_EQUAL_INT},
+		{OP_LESS_INT, OP_JUMP_IF_LESS_INT},
+		{OP_LESS_EQUAL_INT, OP_JUMP_IF_LESS_EQUAL_INT},
+	};
+
+	cond->true_count = 0;
+	cond->false_count = 0;
+
+	if (is_grouped_condition()) {
+		advance();	/* ( */
+		branch_or(cond, line);
+		consume(TOKEN_RIGHT_PAREN, "Expected ')' after expression.");
+		return;
+	}
+
+	struct operand val = equality();
+	enum op_code jump = OP_JUMP_IF_TRUE;
+
+	if (val.is_void || (val.is_typed && val.value.type != VALUE_BOOL))
+		COMPILER_REPORT(line, "Condition must be a bool.");
+	check_bool(&val);
+
+	if (val.is_int_comparison) {
+		int offset = vm_code_offset() - 1;
+
+		for (size_t i = 0; i < sizeof(fused) / sizeof(fused[0]); i++) {
+			if (vm_code_at(offset) == fused[i][0])
+				jump = fused[i][1];
+		}
+		vm_rewind_code(offset);
+	}
+	cond->when_true[cond->true_count++] = vm_add_jump(jump);
+}
+
+static int is_grouped_condition()
+{
+	const struct token *tok = parser.current_token;
+	int depth = 0;
+
+	if (tok->type != TOKEN_LEFT_PAREN) return 0;
+
+	for (;; tok++) {
+		if (tok->type == TOKEN_NEWLINE || tok->type == TOKEN_END_OF_FILE)
+			return 0;
+		if (tok->type == TOKEN_LEFT_PAREN) depth++;
+		if (tok->type == TOKEN_RIGHT_PAREN && --depth == 0) break;
+	}
+	return __TOKEN_IS__(tok + 1, (enum token_type[]){TOKEN_AND, TOKEN_OR,
+			TOKEN_COLON, TOKEN_RIGHT_PAREN, -1});
+}
+
+static void invert_branch(struct condition *cond, int line)
+{
+	static const enum op_code opposites[][2] = {
+		{OP_JUMP_IF_TRUE, OP_JUMP_IF_FALSE},
+		{OP_JUMP_IF_EQUAL_INT, OP_JUMP_IF_NOT_EQUAL_INT},
+		{OP_JUMP_IF_GREATER_INT, OP_JUMP_IF_LESS_EQUAL_INT},
+		{OP_JUMP_IF_LESS_INT, OP_JUMP_IF_GREATER_EQUAL_INT},
+	};
+
+	if (cond->true_count == 0) return;	/* after an error */
+	if (cond->false_count == CONDITION_JUMP_MAX) {
+		COMPILER_REPORT(line, "Condition too long.");
+		return;
+	}
+
+	int jump = cond->when_true[--cond->true_count];
+	enum op_code code = vm_code_at(jump);
+
+	for (size_t i = 0; i < sizeof(opposites) / sizeof(opposites[0]); i++) {
+		if (code == opposites[i][0]) vm_patch_code(jump, opposites[i][1]);
+		if (code == opposites[i][1]) vm_patch_code(jump, opposites[i][0]);
+	}
+	cond->when_false[cond->false_count++] = jump;
+}
+
+static void patch_branches(const int *jumps, int count, int line)
+{
+	for (int i = 0; i < count; i++) {
+		if (!vm_patch_jump(jumps[i]))
+			COMPILER_REPORT(line, "Block too large.");
+	}
+}
+
+static struct operand equality()
+{
+	int start = vm_code_offset();
+	struct operand val = comparison();
+
+	while (CURRENT_TOKEN_IS(TOKEN_EQUAL_EQUAL, TOKEN_BANG_EQUAL)) {
+		enum token_type type = advance()->type;
+		struct operand rhs = comparison();
+		val = binary(type, &val, &rhs, start);
+	}
+	return val;
+}
+
+static struct operand comparison()
+{
+	int start = vm_code_offset();
+	struct operand val = term();
+
+	while (CURRENT_TOKEN_IS(TOKEN_GREATER, TOKEN_GREATER_EQUAL,
+			TOKEN_LESS, TOKEN_LESS_EQUAL)) {
+		enum token_type type = advance()->type;
+		struct operand rhs = term();
+		val = binary(type, &val, &rhs, start);
+	}
+	return val;
+}
+
+static struct operand term()
+{
+	int start = vm_code_offset();
+	struct operand val = factor();
+
+	val.concat_tail = val.is_constant ? start : -1;
+	while (CURRENT_TOKEN_IS(TOKEN_PLUS, TOKEN_MINUS)) {
+		enum token_type type = advance()->type;
+		int rhs_start = vm_code_offset();
+		struct operand rhs = factor();
+
+		/* a + b + c appends its strings at once, with no
+		 * intermediate string */
+		if (type == TOKEN_PLUS && !val.is_void && val.is_typed
+		    && val.value.type == VALUE_STRING) {
+			val = concat(&val, &rhs, rhs_start);
+			continue;
+		}
+		val = binary(type, &val, &rhs, start);
+	}
+
+	end_concat(&val);
+	return val;
+}
+
+static struct operand concat(const struct operand *chain,
+			     const struct operand *rhs, int start)
+{
+	struct operand val = *chain;
+	int line = parser.current_token->line;
+
+	if (val.concat == 0) val.concat = 1;
+	val.is_call = 0;
+
+	if (rhs->is_void) {
+		COMPILER_REPORT(line, "Function does not return a value.");
+		return val;
+	}
+	if (rhs->is_typed && rhs->value.type != VALUE_STRING) {
+		COMPILER_REPORT(line, "Only strings can be appended to strings.");
+		return val;
+	}
+
+	if (!rhs->is_constant || val.concat_tail == -1) {
+		val.concat++;
+		val.is_constant = 0;
+		val.concat_tail = rhs->is_constant ? start : -1;
+		val.value = rhs->is_constant ? rhs->value
+			: (struct value){.type = VALUE_STRING};
+		if (val.concat > 0xFFFF)
+			COMPILER_REPORT(line, "Too many strings appended.");
+		return val;
+	}
+
+	char buffer1[STRING_SHORT_MAX], buffer2[STRING_SHORT_MAX];
+	const char *chars1 = NULL, *chars2 = NULL;
+	int length1 = string_bytes(&val.value, buffer1, &chars1);
+	int length2 = string_bytes(&rhs->value, buffer2, &chars2);
+
+	/* only flattening a heap string fails, when out of memory */
+	ASSERT(length1 >= 0 && length2 >= 0,
+	       "Unable to allocate memory for a string literal.");
+	char *chars = malloc((size_t)length1 + length2 + 1);
+
+	ASSERT(chars != NULL, "Unable to allocate memory for a string literal.");
+
+	memcpy(chars, chars1, length1);
+	memcpy(chars + length1, chars2, length2);
+	val.value = vm_intern_string(chars, length1 + length2);
+	free(chars);
+
+	/* the constant replaces the tail's */
+	vm_rewind_code(val.concat_tail);
+	vm_add_constant(val.value);
+	return val;
+}
+
+static void end_concat(struct operand *chain)
+{
+	if (chain->concat > 1) {
+		vm_add_code_dyladic(OP_CONCAT, chain->concat);
+		chain->is_constant = 0;
+	}
+	chain->concat = 0;
+}
+
+static struct operand factor()
+{
+	int start = vm_code_offset();
+	struct operand val = unary();
+
+	while (CURRENT_TOKEN_IS(TOKEN_STAR, TOKEN_SLASH, TOKEN_PERCENT)) {
+		enum token_type type = advance()->type;
+		struct operand rhs = unary();
+		val = binary(type, &val, &rhs, start);
+	}
+	return val;
+}
+
+static struct operand unary()
+{
+	if (!CURRENT_TOKEN_IS(TOKEN_MINUS, TOKEN_BANG))
+		return primary();
+
+	enum token_type type = advance()->type;
+	int start = vm_code_offset();
+	struct operand val = unary();
+
+	if (val.is_void) {
+		COMPILER_REPORT(parser.current_token->line,
+				"Function does not return a value.");
+		return (struct operand){};
+	}
+	val.is_call = 0;
+
+	if (val.is_typed && (val.value.type == VALUE_RECIPE
+			     || val.value.type == VALUE_ARRAY
+			     || val.value.type == VALUE_MAP
+			     || val.value.type == VALUE_STRING)) {
+		COMPILER_REPORT(parser.current_token->line,
+				"Operand must be a number or a bool.");
+		return (struct operand){};
+	}
+
+	if (val.is_constant) {
+		val.value = (type == TOKEN_MINUS)
+			? value_negate(&val.value)
+			: value_logical_not(&val.value);
+		vm_rewind_code(start);
+		vm_add_constant(val.value);
+		return val;
+	}
+
+	if (type == TOKEN_BANG) {
+		vm_add_code(OP_LOGICAL_NOT);
+		return (struct operand){.value.type = VALUE_BOOL, .is_typed = 1};
+	}
+
+	if (!val.is_typed) {
+		vm_add_code(OP_NEGATE);
+		return val;
+	}
+
+	switch (val.value.type) {
+	case VALUE_INT: vm_add_code(OP_NEGATE_INT); break;
+	case VALUE_FLOAT: vm_add_code(OP_NEGATE_FLOAT); break;
+	default:
+		COMPILER_REPORT(parser.current_token->line,
+				"Negation invalid, value is not a number.");
+	}
+	return val;
+}
+
+static struct operand primary()
+{
+	struct token* t = advance();
+	struct operand val = {.is_constant = 1, .is_typed = 1};
+	struct invariant *inv;
+
+        switch (t->type) {
+	case TOKEN_CONSTANT_INT:
+		val.value = GET_VALUE_INT(atoi(sbstr2str(&t->lexeme)));
+		break;
+	case TOKEN_CONSTANT_FLOAT:
+		val.value = GET_VALUE_FLOAT(atof(sbstr2str(&t->lexeme)));
+		break;
+	case TOKEN_TRUE:
+		val.value = GET_VALUE_BOOL(1);
+		break;
+	case TOKEN_FALSE:
+		val.value = GET_VALUE_BOOL(0);
+		break;
+	case TOKEN_STRING:
+		return string_literal(t);
+	case TOKEN_STR:
+		return postfix(string_function());
+	case TOKEN_IDENTIFIER:
+		if (CURRENT_TOKEN_IS(TOKEN_LEFT_PAREN))
+			val = call(t, -1);
+		else if (CURRENT_TOKEN_IS(TOKEN_DOT, TOKEN_COLON_COLON)
+			 && is_qualifier(t))
+			val = qualified_call(t);
+		else if (CURRENT_TOKEN_IS(TOKEN_DOT) && is_math(t))
+			val = math_function();
+		else if (CURRENT_TOKEN_IS(TOKEN_DOT) && find_enum(t) != -1)
+			val = enum_member(t);
+		else if (CURRENT_TOKEN_IS(TOKEN_DOT)
+			 && (inv = find_hoisted(t)) != NULL)
+			val = hoisted(inv);
+		else
+			val = variable(t);
+
+		/* a call's value is no longer returned as is */
+		if (CURRENT_TOKEN_IS(TOKEN_DOT, TOKEN_LEFT_SQUARE))
+			return postfix(val);
+		return val;
+	case TOKEN_LEFT_BRACE:
+		/* without a declared type, the elements are boxed */
+		parser.current_token--;
+		if (is_map_literal())
+			return postfix(map_literal());
+		return postfix(array_literal(ARRAY_VALUE));
+	case TOKEN_LEFT_PAREN: {
+		/* advance the current token
+		 * `t` is now obsolete */
+		val = expression();
+		if (advance()->type != TOKEN_RIGHT_PAREN) {
+			COMPILER_REPORT(parser.current_token->line,
+				"Expected ')' after expression.");
+		}
+		return val;
+	}
+	default:
+		COMPILER_REPORT(t->line, "No expression found.");
+		return (struct operand){};
+	}
+
+	vm_add_constant(val.value);
+	return val;
+}
+
+static struct operand call(const struct token *name, int recipe)
+{
+	advance();	/* ( */
+
+	/* Unqualified names are the enclosing recipe's functions first.
+	 * Either way the callee is known here, no name is looked up at
+	 * run time. */
+	int index = -1;
+	if (recipe != -1 || parser.recipe != -1) {
+		index = signature_vector_find(parser.functions,
+			recipe != -1 ? recipe : parser.recipe, &name->lexeme);
+	}
+	if (index == -1 && recipe == -1)
+		index = signature_vector_find(parser.functions, -1, &name->lexeme);
+	if (index == -1) {
+		COMPILER_REPORT(name->line, "Undefined function %s.",
+				sbstr2str(&name->lexeme));
+	}
+
+	/* Functions are only declared at the top level, so none are
+	 * added while the arguments are compiled. */
+	struct signature *sig = (index != -1)
+		? &parser.functions->array[index] : NULL;
+	int argc = 0;
+	int refers_to_locals = 0;
+
+	while (!CURRENT_TOKEN_IS(TOKEN_RIGHT_PAREN, TOKEN_NEWLINE,
+				 TOKEN_END_OF_FILE)) {
+		struct variable *param = (sig != NULL && argc < sig->arity)
+			? &parser.parameters->array[sig->parameters + argc] : NULL;
+
+		if (param != NULL && param->is_ref)
+			refers_to_locals |= ref_argument(param);
+		else if (param != NULL)
+			initializer(param);
+		else
+			expression();
+		argc++;
+
+		if (!CURRENT_TOKEN_IS(TOKEN_COMMA)) break;
+		advance();
+	}
+	consume(TOKEN_RIGHT_PAREN, "Expected ')' after the arguments.");
+
+	if (sig == NULL) return (struct operand){};
+
+	if (argc != sig->arity) {
+		COMPILER_REPORT(name->line, "%s takes %d arguments, %d given.",
+				sbstr2str(&name->lexeme), sig->arity, argc);
+	}
+
+	vm_add_code_dyladic(OP_CALL, index);
+	/* a tail call would reuse the slots the arguments refer to */
+	return (struct operand){
+		.value.type = sig->return_type,
+		.is_typed = 1,
+		.subtype = sig->return_subtype,
+		.is_void = !sig->returns_value,
+		.is_call = !refers_to_locals
+	};
+}
+
+static struct operand qualified_call(const struct token *qualifier)
+{
+	int recipe = recipe_vector_find(parser.recipes, &qualifier->lexeme);
+	advance();	/* . or :: */
+
+	struct token *name = advance();
+	if (name->type != TOKEN_IDENTIFIER
+	    || !CURRENT_TOKEN_IS(TOKEN_LEFT_PAREN)) {
+		COMPILER_REPORT(name->line, "Expected a function of %s.",
+				sbstr2str(&qualifier->lexeme));
+		synchronize();
+		return (struct operand){};
+	}
+	return call(name, recipe);
+}
+
+static int is_qualifier(const struct token *name)
+{
+	return variable_vector_find(parser.locals, &name->lexeme) == -1
+		&& variable_vector_find(parser.globals, &name->lexeme) == -1
+		&& recipe_vector_find(parser.recipes, &name->lexeme) != -1;
+}
+
+static int find_enum(const struct token *name)
+{
+	if (variable_vector_find(parser.locals, &name->lexeme) != -1
+	    || variable_vector_find(parser.globals, &name->lexeme) != -1)
+		return -1;
+	return variable_vector_find(parser.enums, &name->lexeme);
+}
+
+static struct variable *find_constant(int enumeration,
+				      const struct substring *name)
+{
+	int length = SUBSTRING_LENGTH(*name);
+
+	/* the innermost first, like locals */
+	for (int i = parser.constants->count - 1; i >= 0; i--) {
+		struct variable *cst = &parser.constants->array[i];
+
+		if (cst->subtype == enumeration
+		    && SUBSTRING_LENGTH(cst->name) == length
+		    && memcmp(cst->name.start, name->start, length - 1) == 0)
+			return cst;
+	}
+	return NULL;
+}
+
+static struct variable *visible_constant(const struct substring *name)
+{
+	struct variable *cst = find_constant(-1, name);
+	int slot = variable_vector_find(parser.locals, name);
+
+	/* a named enum's members are read unqualified in its own */
+	if (parser.enumeration != -1
+	    && find_constant(parser.enumeration, name) != NULL)
+		return find_constant(parser.enumeration, name);
+
+	/* a global and a constant of the top level never share a name */
+	if (cst == NULL
+	    || (slot != -1 && parser.locals->array[slot].depth > cst->depth))
+		return NULL;
+	return cst;
+}
+
+static struct operand enum_member(const struct token *name)
+{
+	int enumeration = find_enum(name);
+	struct token *member;
+	struct variable *cst;
+
+	advance();	/* . */
+	member = advance();
+	cst = find_constant(enumeration, &member->lexeme);
+	if (member->type != TOKEN_IDENTIFIER || cst == NULL) {
+		COMPILER_REPORT(member->line, "Expected a member of %s.",
+				sbstr2str(&name->lexeme));
+		return (struct operand){};
+	}
+
+	vm_add_constant(cst->value);
+	return (struct operand){
+		.value = cst->value,
+		.is_constant = 1,
+		.is_typed = 1
+	};
+}
+
+static int ref_argument(const struct variable *param)
+{
+	struct token *name = parser.current_token;
+
+	if (name->type != TOKEN_IDENTIFIER
+	    || !(NEXT_TOKEN_IS(TOKEN_COMMA, TOKEN_RIGHT_PAREN))) {
+		COMPILER_REPORT(name->line,
+				"Expected a variable for a ref parameter.");
+		expression();
+		return 0;
+	}
+	advance();
+
+	if (visible_constant(&name->lexeme) != NULL) {
+		COMPILER_REPORT(name->line, "Cannot pass %s, a constant, to a ref.",
+				sbstr2str(&name->lexeme));
+		return 0;
+	}
+
+	int slot = variable_vector_find(parser.locals, &name->lexeme);
+	struct variable *var = (slot != -1) ? &parser.locals->array[slot] : NULL;
+
+	if (var == NULL) {
+		slot = variable_vector_find(parser.globals, &name->lexeme);
+		var = (slot != -1) ? &parser.globals->array[slot] : NULL;
+	}
+	if (var == NULL) {
+		COMPILER_REPORT(name->line, "Undefined variable %s.",
+				sbstr2str(&name->lexeme));
+		return 0;
+	}
+
+	/* the callee writes the variable as its own type */
+	if (var->type != param->type || var->is_untyped
+	    || ((var->type == VALUE_RECIPE || var->type == VALUE_ARRAY)
+		&& var->subtype != param->subtype)) {
+		COMPILER_REPORT(name->line,
+				"Cannot pass %s to a ref of another type.",
+				sbstr2str(&name->lexeme));
+	}
+	if (var->is_const && !param->is_const) {
+		COMPILER_REPORT(name->line,
+				"Cannot pass %s, a const ref, to a ref.",
+				sbstr2str(&name->lexeme));
+	}
+
+	if (var->depth == 0) {
+		vm_add_code_dyladic(OP_REF_GLOBAL, slot);
+		return 0;
+	}
+
+	if (!param->is_elidable) var->is_elidable = 0;
+	/* a ref parameter passes on the slot it holds */
+	if (var->is_ref) {
+		emit_slot(OP_GET_LOCAL, OP_GET_LOCAL_LONG, slot);
+		return 0;
+	}
+	vm_add_code_dyladic(OP_REF_LOCAL, slot);
+	return 1;
+}
+
+static struct operand variable(const struct token *name)
+{
+	struct operand val = {.is_typed = 1};
+	struct variable *cst = visible_constant(&name->lexeme);
+
+	/* never read from a slot, folded like a literal */
+	if (cst != NULL) {
+		vm_add_constant(cst->value);
+		return (struct operand){
+			.value = cst->value,
+			.is_constant = 1,
+			.is_typed = 1
+		};
+	}
+
+	int slot = variable_vector_find(parser.locals, &name->lexeme);
+	if (slot != -1) {
+		struct variable *var = &parser.locals->array[slot];
+
+		/* a local used other than for its fields may outlive it */
+		if (!CURRENT_TOKEN_IS(TOKEN_DOT))
+			var->is_elidable = 0;
+		val.value.type = var->type;
+		val.subtype = var->subtype;
+		val.is_typed = !var->is_untyped;
+		val.is_const = var->is_const;
+		if (var->is_ref)
+			vm_add_code_dyladic(OP_GET_REF, slot);
+		else
+			emit_slot(OP_GET_LOCAL, OP_GET_LOCAL_LONG, slot);
+		return val;
+	}
+
+	slot = variable_vector_find(parser.globals, &name->lexeme);
+	if (slot != -1) {
+		val.value.type = parser.globals->array[slot].type;
+		val.subtype = parser.globals->array[slot].subtype;
+		val.is_typed = !parser.globals->array[slot].is_untyped;
+		emit_slot(OP_GET_GLOBAL, OP_GET_GLOBAL_LONG, slot);
+		return val;
+	}
+
+	COMPILER_REPORT(name->line, "Undefined variable %s.",
+			sbstr2str(&name->lexeme));
+	return val;
+}
+
+static struct operand postfix(struct operand val)
+{
+	while (CURRENT_TOKEN_IS(TOKEN_DOT, TOKEN_LEFT_SQUARE)) {
+		struct token *tok = advance();
+		int is_array = !val.is_void && val.is_typed
+			&& val.value.type == VALUE_ARRAY;
+		int is_map = !val.is_void && val.is_typed
+			&& val.value.type == VALUE_MAP;
+
+		/* a map's values are of any type */
+		if (tok->type == TOKEN_LEFT_SQUARE && is_map) {
+			struct operand key = expression();
+			map_key(&key, tok->line);
+			consume(TOKEN_RIGHT_SQUARE, "Expected ']' after the key.");
+			vm_add_code(OP_GET_KEY);
+			val = (struct operand){0};
+			continue;
+		}
+
+		if (tok->type == TOKEN_LEFT_SQUARE) {
+			if (!is_array) {
+				COMPILER_REPORT(tok->line, "Only arrays and maps can be indexed.");
+				return (struct operand){};
+			}
+
+			/* a[i], i counting over a range within a's bounds */
+			struct invariant *inv = (tok[2].type == TOKEN_RIGHT_SQUARE)
+				? find_invariant(INVARIANT_INDEX, tok - 1, tok + 1)
+				: NULL;
+			if (inv != NULL && tok[-2].type != TOKEN_DOT
+			    && tok[-2].type != TOKEN_COLON_COLON) {
+				parser.current_token += 2;
+				vm_add_code_dyladic(get_unchecked_codes[val.subtype],
+						    inv->slot);
+				val = get_element(val.subtype);
+				continue;
+			}
+
+			struct operand index = expression();
+			if (index.is_void || (index.is_typed
+					      && index.value.type != VALUE_INT))
+				COMPILER_REPORT(tok->line, "Index must be an int.");
+			consume(TOKEN_RIGHT_SQUARE, "Expected ']' after the index.");
+
+			vm_add_code(get_index_codes[val.subtype]);
+			val = get_element(val.subtype);
+			continue;
+		}
+
+		struct token *name = advance();
+
+		if (is_array) {
+			val = array_method(&val, name);
+			continue;
+		}
+		if (is_map) {
+			val = map_method(name);
+			continue;
+		}
+
+		if (val.is_void || !val.is_typed
+		    || val.value.type != VALUE_RECIPE) {
+			COMPILER_REPORT(name->line, "Only recipes have fields.");
+			return (struct operand){};
+		}
+
+		/* The offset is resolved here, the VM only adds it. */
+		struct field *fd = recipe_find_field(
+			&parser.recipes->array[val.subtype], &name->lexeme);
+		if (fd == NULL) {
+			COMPILER_REPORT(name->line, "No field named %s.",
+					sbstr2str(&name->lexeme));
+			return (struct operand){};
+		}
+
+		vm_add_code_dyladic(fd->get_code, fd->offset);
+		val = (struct operand){.value.type = fd->type, .is_typed = 1};
+	}
+	return val;
+}
+
+static struct operand array_method(const struct operand *arr,
+				   const struct token *name)
+{
+	const struct array_method *method = NULL;
+	char *method_name = sbstr2str(&name->lexeme);
+
+	for (size_t i = 0; i < sizeof(array_methods) / sizeof(array_methods[0]); i++) {
+		if (strcmp(array_methods[i].name, method_name) == 0)
+			method = &array_methods[i];
+	}
+	if (method == NULL) {
+		COMPILER_REPORT(name->line, "Arrays have no method %s.",
+				method_name);
+		return (struct operand){};
+	}
+	if (arr->is_const && (method->code == OP_ARRAY_FILL
+			      || method->code == OP_ARRAY_COPY)) {
+		COMPILER_REPORT(name->line, "Cannot change the elements of a const ref.");
+	}
+
+	consume(TOKEN_LEFT_PAREN, "Expected '(' after the method's name.");
+	int argc = 0;
+	while (!CURRENT_TOKEN_IS(TOKEN_RIGHT_PAREN, TOKEN_NEWLINE,
+				 TOKEN_END_OF_FILE)) {
+		int start = vm_code_offset();
+		struct operand arg;
+
+		/* a literal array argument takes the kind of `arr` */
+		if (CURRENT_TOKEN_IS(TOKEN_LEFT_BRACE)
+		    && (method->code == OP_ARRAY_COPY || method->code == OP_ARRAY_DOT))
+			arg = postfix(array_literal(arr->subtype));
+		else
+			arg = expression();
+
+		if (argc < method->arity)
+			array_method_argument(method, arr, &arg, start);
+		argc++;
+
+		if (!CURRENT_TOKEN_IS(TOKEN_COMMA)) break;
+		advance();
+	}
+	consume(TOKEN_RIGHT_PAREN, "Expected ')' after the arguments.");
+
+	if (argc != method->arity) {
+		COMPILER_REPORT(name->line, "%s takes %d arguments, %d given.",
+				method->name, method->arity, argc);
+	}
+
+	vm_add_code(method->code);
+
+	switch (method->code) {
+	case OP_ARRAY_LENGTH:
+		return (struct operand){.value.type = VALUE_INT, .is_typed = 1};
+	case OP_ARRAY_FILL:
+	case OP_ARRAY_COPY:
+		return (struct operand){.is_void = 1};
+	case OP_ARRAY_SLICE:
+		return *arr;
+	default:
+		break;
+	}
+
+	/* min, max, sum and dot */
+	if (arr->subtype == ARRAY_STRING
+	    || (arr->subtype == ARRAY_BOOL && method->code != OP_ARRAY_SUM)) {
+		COMPILER_REPORT(name->line, "Elements must be numbers.");
+		return (struct operand){};
+	}
+	if (method->code == OP_ARRAY_MIN || method->code == OP_ARRAY_MAX)
+		return get_element(arr->subtype);
+
+	/* bytes and bools are summed as integers */
+	struct operand result = get_element(arr->subtype);
+	if (result.is_typed && result.value.type == VALUE_BOOL)
+		result.value.type = VALUE_INT;
+	return result;
+}
+
+static void array_method_argument(const struct array_method *method,
+				  const struct operand *arr,
+				  const struct operand *arg, int start)
+{
+	int line = parser.current_token->line;
+
+	if (arg->is_void) {
+		COMPILER_REPORT(line, "Function does not return a value.");
+		return;
+	}
+
+	switch (method->code) {
+	case OP_ARRAY_FILL: {
+		struct operand element = get_element(arr->subtype);
+		struct variable target = {.type = element.value.type};
+		if (element.is_typed) coerce(&target, arg, start);
+		break;
+	}
+	case OP_ARRAY_SLICE:
+		if (arg->is_typed && arg->value.type != VALUE_INT)
+			COMPILER_REPORT(line, "Slice bounds must be ints.");
+		break;
+	/* copy and dot take an array of the same kind */
+	default:
+		if (!arg->is_typed || arg->value.type != VALUE_ARRAY
+		    || arg->subtype != arr->subtype) {
+			COMPILER_REPORT(line, "%s expects an array of the same"
+					" element type.", method->name);
+		}
+		break;
+	}
+}
+
+static struct operand array_literal(enum array_kind kind)
+{
+	int line = advance()->line;	/* { */
+	int count = 0;
+	struct operand element = get_element(kind);
+	struct variable target = {.type = element.value.type};
+
+	while (!CURRENT_TOKEN_IS(TOKEN_RIGHT_BRACE, TOKEN_NEWLINE,
+				 TOKEN_END_OF_FILE)) {
+		int start = vm_code_offset();
+		struct operand val = expression();
+
+		if (element.is_typed)
+			coerce(&target, &val, start);
+		else if (val.is_void)
+			COMPILER_REPORT(line, "Function does not return a value.");
+		count++;
+
+		if (!CURRENT_TOKEN_IS(TOKEN_COMMA)) break;
+		advance();
+	}
+	consume(TOKEN_RIGHT_BRACE, "Expected '}' after the elements.");
+
+	if (count > 0xFFFF)
+		COMPILER_REPORT(line, "Too many elements.");
+
+	vm_add_code_triadic(OP_ARRAY_LITERAL, kind, count);
+	return (struct operand){
+		.value.type = VALUE_ARRAY,
+		.is_typed = 1,
+		.subtype = kind
+	};
+}
+
+static struct operand map_method(const struct token *name)
+{
+	int is_has = SUBSTRING_LENGTH(name->lexeme) == sizeof("has")
+		&& memcmp(name->lexeme.start, "has", sizeof("has") - 1) == 0;
+	int is_length = SUBSTRING_LENGTH(name->lexeme) == sizeof("length")
+		&& memcmp(name->lexeme.start, "length", sizeof("length") - 1) == 0;
+
+	if (!is_has && !is_length) {
+		COMPILER_REPORT(name->line, "Maps have no method %s.",
+				sbstr2str(&name->lexeme));
+		return (struct operand){};
+	}
+
+	consume(TOKEN_LEFT_PAREN, "Expected '(' after the method's name.");
+	if (is_has) {
+		struct operand key = expression();
+		map_key(&key, name->line);
+		vm_add_code(OP_MAP_HAS);
+	} else {
+		vm_add_code(OP_MAP_LENGTH);
+	}
+	consume(TOKEN_RIGHT_PAREN, "Expected ')' after the arguments.");
+
+	return (struct operand){
+		.value.type = is_has ? VALUE_BOOL : VALUE_INT,
+		.is_typed = 1
+	};
+}
+
+static struct operand map_literal()
+{
+	int line = advance()->line;	/* { */
+	int count = 0;
+
+	while (!CURRENT_TOKEN_IS(TOKEN_RIGHT_BRACE, TOKEN_NEWLINE,
+				 TOKEN_END_OF_FILE)) {
+		struct operand key = expression();
+		map_key(&key, line);
+		consume(TOKEN_COLON, "Expected ':' after the key.");
+		if (expression().is_void)
+			COMPILER_REPORT(line, "Function does not return a value.");
+		count++;
+
+		if (!CURRENT_TOKEN_IS(TOKEN_COMMA)) break;
+		advance();
+	}
+	consume(TOKEN_RIGHT_BRACE, "Expected '}' after the entries.");
+
+	if (count > 0x7FFF)
+		COMPILER_REPORT(line, "Too many entries.");
+
+	vm_add_code_dyladic(OP_MAP_LITERAL, count);
+	return (struct operand){.value.type = VALUE_MAP, .is_typed = 1};
+}
+
+static int is_map_literal()
+{
+	int depth = 0;
+
+	for (struct token *tok = parser.current_token;
+	     tok->type != TOKEN_NEWLINE && tok->type != TOKEN_END_OF_FILE;
+	     tok++) {
+		switch (tok->type) {
+		case TOKEN_LEFT_BRACE:
+		case TOKEN_LEFT_PAREN:
+		case TOKEN_LEFT_SQUARE:
+			depth++;
+			break;
+		case TOKEN_RIGHT_BRACE:
+		case TOKEN_RIGHT_PAREN:
+		case TOKEN_RIGHT_SQUARE:
+			if (--depth == 0) return 0;
+			break;
+		case TOKEN_COLON:
+			if (depth == 1) return 1;
+			break;
+		default:
+			break;
+		}
+	}
+	return 0;
+}
+
+static void map_key(const struct operand *key, int line)
+{
+	if (key->is_void) {
+		COMPILER_REPORT(line, "Function does not return a value.");
+	} else if (key->is_typed && key->value.type != VALUE_INT
+		   && key->value.type != VALUE_STRING
+		   && key->value.type != VALUE_BOOL) {
+		COMPILER_REPORT(line, "Map keys must be ints, strings or bools.");
+	}
+}
+
+static struct operand string_literal(const struct token *tok)
+{
+	int length;
+	char *chars = unescape(tok, &length);
+	struct operand val = {
+		.value = vm_intern_string(chars, length),
+		.is_constant = 1,
+		.is_typed = 1
+	};
+
+	free(chars);
+	vm_add_constant(val.value);
+	return val;
+}
+
+static char *unescape(const struct token *tok, int *length)
+{
+	/* the lexeme keeps its quotes */
+	const char *src = tok->lexeme.start + 1;
+	int src_length = SUBSTRING_LENGTH(tok->lexeme) - 3;
+	char *chars = malloc(src_length > 0 ? src_length : 1);
+
+	*length = 0;
+
+	ASSERT(chars != NULL, "Unable to allocate memory for a string literal.");
+
+	for (int i = 0; i < src_length; i++) {
+		if (src[i] != '\\') {
+			chars[(*length)++] = src[i];
+			continue;
+		}
+
+		switch (src[++i]) {
+		case 'n': chars[(*length)++] = '\n'; break;
+		case 't': chars[(*length)++] = '\t'; break;
+		case 'r': chars[(*length)++] = '\r'; break;
+		case '0': chars[(*length)++] = '\0'; break;
+		case '\\': chars[(*length)++] = '\\'; break;
+		case '"': chars[(*length)++] = '"'; break;
+		default:
+			COMPILER_REPORT(tok->line, "Unknown escape sequence \\%c.",
+					src[i]);
+			break;
+		}
+	}
+	return chars;
+}
+
+static int format_arguments()
+{
+	struct token *tok = advance();
+	struct format fmt = {0};
+	int length, argc = 0, index;
+	char *chars = unescape(tok, &length);
+	int is_parsed = parse_format(chars, length, &fmt, tok->line);
+
+	free(chars);
+
+	/* the conversions' types are checked here when the arguments'
+	 * are known, at run time otherwise */
+	for (int i = 0; CURRENT_TOKEN_IS(TOKEN_COMMA); i++) {
+		int line = advance()->line;
+		struct operand arg = expression();
+		const struct format_segment *seg;
+		const char *expected;
+
+		while (i < fmt.count && fmt.segments[i].conversion == FORMAT_TEXT)
+			i++;
+		argc++;
+		if (arg.is_void) {
+			COMPILER_REPORT(line, "Function does not return a value.");
+			continue;
+		}
+		if (i >= fmt.count || !arg.is_typed) continue;
+
+		seg = &fmt.segments[i];
+		switch (seg->conversion) {
+		case FORMAT_INT:
+		case FORMAT_UINT:
+			expected = arg.value.type == VALUE_INT ? NULL : "an int";
+			break;
+		case FORMAT_FLOAT:
+			/* ints are converted */
+			expected = arg.value.type == VALUE_FLOAT
+				|| arg.value.type == VALUE_INT ? NULL : "a float";
+			break;
+		case FORMAT_STRING:
+			expected = arg.value.type == VALUE_STRING ? NULL : "a str";
+			break;
+		default:
+			expected = NULL;
+			break;
+		}
+		if (expected != NULL)
+			COMPILER_REPORT(line, "Format %s expects %s, got %s.",
+					seg->text, expected,
+					get_type_name(arg.value.type));
+	}
+
+	if (is_parsed && argc != fmt.argc)
+		COMPILER_REPORT(tok->line, "Format expects %d arguments, got %d.",
+				fmt.argc, argc);
+	if ((index = vm_add_format(fmt)) > 0xFFFF)
+		COMPILER_REPORT(tok->line, "Too many formats.");
+	return index;
+}
+
+static int parse_format(const char *chars, int length, struct format *fmt,
+			int line)
+{
+	/* at worst a conversion follows each literal byte */
+	struct format_segment *segments =
+		malloc(sizeof(struct format_segment) * (length + 1));
+	char *text = malloc(length > 0 ? length : 1);
+	int count = 0, text_length = 0, is_valid = 1;
+
+	ASSERT(text != NULL && segments != NULL,
+	       "Unable to allocate memory for a format.");
+	*fmt = (struct format){.segments = segments};
+
+	for (int i = 0; i <= length && is_valid; i++) {
+		if (i < length && chars[i] != '%') {
+			text[text_length++] = chars[i];
+			continue;
+		}
+		if (i + 1 < length && chars[i + 1] == '%') {
+			text[text_length++] = chars[i++];
+			continue;
+		}
+
+		/* the literal bytes before the conversion, or the end */
+		if (text_length > 0) {
+			char *copy = malloc(text_length);
+
+			ASSERT(copy != NULL, "Unable to allocate memory for a format.");
+			memcpy(copy, text, text_length);
+			segments[count++] = (struct format_segment){
+				FORMAT_TEXT, text_length, copy
+			};
+			text_length = 0;
+		}
+		if (i == length) break;
+
+		/* %[flags][width][.precision]conversion, the width and
+		 * precision of at most three digits */
+		int start = i++, width = 0, precision = 0;
+		while (i < length && chars[i] != '\0'
+		       && strchr("-+ #0", chars[i]) != NULL)
+			i++;
+		for (; i < length && chars[i] >= '0' && chars[i] <= '9'; i++)
+			width++;
+		if (i < length && chars[i] == '.')
+			for (i++; i < length && chars[i] >= '0' && chars[i] <= '9'; i++)
+				precision++;
+
+		enum format_conversion conversion = FORMAT_TEXT;
+		switch (i < length ? chars[i] : '\0') {
+		case 'd': case 'i': case 'c':
+			conversion = FORMAT_INT; break;
+		case 'u': case 'o': case 'x': case 'X':
+			conversion = FORMAT_UINT; break;
+		case 'f': case 'F': case 'e': case 'E':
+		case 'g': case 'G': case 'a': case 'A':
+			conversion = FORMAT_FLOAT; break;
+		case 's':
+			conversion = FORMAT_STRING; break;
+		case 'v':
+			conversion = FORMAT_VALUE; break;
+		}
+
+		int spec_length = (i < length ? i + 1 : i) - start;
+		if (conversion == FORMAT_TEXT) {
+			COMPILER_REPORT(line, "Unknown format conversion %.*s.",
+					spec_length, chars + start);
+			is_valid = 0;
+		} else if (width > 3 || precision > 3) {
+			COMPILER_REPORT(line, "Format %.*s is too wide.",
+					spec_length, chars + start);
+			is_valid = 0;
+		} else if (conversion == FORMAT_VALUE && spec_length > 2) {
+			COMPILER_REPORT(line, "Format %%v takes no flags.");
+			is_valid = 0;
+		} else {
+			char *spec = malloc(spec_length + 1);
+
+			ASSERT(spec != NULL, "Unable to allocate memory for a format.");
+			memcpy(spec, chars + start, spec_length);
+			spec[spec_length] = '\0';
+			segments[count++] = (struct format_segment){
+				conversion, spec_length, spec
+			};
+			fmt->argc++;
+		}
+	}
+
+	free(text);
+	fmt->count = count;
+	if (!is_valid) {
+		for (int i = 0; i < count; i++)
+			free((char *)segments[i].text);
+		free(segments);
+		*fmt = (struct format){0};
+	}
+	return is_valid;
+}
+
+static struct operand string_function()
+{
+	int line = parser.current_token->line;
+
+	consume(TOKEN_DOT, "Expected '.' after str.");
+	struct token *name = advance();
+	int is_fmt = name->type == TOKEN_IDENTIFIER
+		&& SUBSTRING_LENGTH(name->lexeme) == sizeof("fmt")
+		&& memcmp(name->lexeme.start, "fmt", sizeof("fmt") - 1) == 0;
+	if (!is_fmt && (name->type != TOKEN_IDENTIFIER
+			|| SUBSTRING_LENGTH(name->lexeme) != sizeof("cat")
+			|| memcmp(name->lexeme.start, "cat",
+				  sizeof("cat") - 1) != 0)) {
+		COMPILER_REPORT(line, "str has no function %s.",
+				sbstr2str(&name->lexeme));
+		synchronize();
+		return (struct operand){};
+	}
+	consume(TOKEN_LEFT_PAREN, "Expected '(' after the function's name.");
+
+	/* str.fmt("%d days", n) takes a literal, parsed here */
+	if (is_fmt) {
+		if (!CURRENT_TOKEN_IS(TOKEN_STRING)) {
+			COMPILER_REPORT(line, "str.fmt expects a literal format.");
+			synchronize();
+			return (struct operand){};
+		}
+		vm_add_code_dyladic(OP_FORMAT, format_arguments());
+		consume(TOKEN_RIGHT_PAREN, "Expected ')' after the arguments.");
+		return (struct operand){
+			.value.type = VALUE_STRING,
+			.is_typed = 1
+		};
+	}
+
+	/* str.cat(a, b, c) is a + b + c */
+	struct operand val = {0};
+	int argc = 0;
+
+	while (!CURRENT_TOKEN_IS(TOKEN_RIGHT_PAREN, TOKEN_NEWLINE,
+				 TOKEN_END_OF_FILE)) {
+		int start = vm_code_offset();
+		struct operand arg = expression();
+
+		if (argc++ > 0) {
+			val = concat(&val, &arg, start);
+		} else if (arg.is_void || (arg.is_typed
+					   && arg.value.type != VALUE_STRING)) {
+			COMPILER_REPORT(line, "Only strings can be appended"
+					" to strings.");
+		} else {
+			val = arg;
+			val.is_typed = 1;
+			val.value.type = VALUE_STRING;
+			val.concat_tail = arg.is_constant ? start : -1;
+		}
+
+		if (!CURRENT_TOKEN_IS(TOKEN_COMMA)) break;
+		advance();
+	}
+	consume(TOKEN_RIGHT_PAREN, "Expected ')' after the arguments.");
+
+	if (argc == 0) {
+		val = (struct operand){
+			.value = vm_intern_string("", 0),
+			.is_constant = 1,
+			.is_typed = 1
+		};
+		vm_add_constant(val.value);
+	}
+	end_concat(&val);
+	return val;
+}
+
+static int is_math(const struct token *name)
+{
+	return SUBSTRING_LENGTH(name->lexeme) == sizeof("math")
+		&& memcmp(name->lexeme.start, "math", sizeof("math") - 1) == 0
+		&& variable_vector_find(parser.locals, &name->lexeme) == -1
+		&& variable_vector_find(parser.globals, &name->lexeme) == -1
+		&& recipe_vector_find(parser.recipes, &name->lexeme) == -1;
+}
+
+static struct operand math_function()
+{
+	int line = advance()->line;	/* . */
+	struct token *name = advance();
+	int length = SUBSTRING_LENGTH(name->lexeme) - 1;
+	const struct math_function *fn = NULL;
+
+	for (size_t i = 0; i < sizeof(math_constants)
+		     / sizeof(math_constants[0]); i++) {
+		if ((int)strlen(math_constants[i].name) == length
+		    && memcmp(name->lexeme.start, math_constants[i].name,
+			      length) == 0) {
+			struct operand val = {
+				.value = GET_VALUE_FLOAT(math_constants[i].value),
+				.is_constant = 1,
+				.is_typed = 1
+			};
+			vm_add_constant(val.value);
+			return val;
+		}
+	}
+	for (size_t i = 0; i < sizeof(math_functions)
+		     / sizeof(math_functions[0]); i++) {
+		if ((int)strlen(math_functions[i].name) == length
+		    && memcmp(name->lexeme.start, math_functions[i].name,
+			      length) == 0)
+			fn = &math_functions[i];
+	}
+	if (fn == NULL || !CURRENT_TOKEN_IS(TOKEN_LEFT_PAREN)) {
+		COMPILER_REPORT(line, "math has no function %s.",
+				sbstr2str(&name->lexeme));
+		synchronize();
+		return (struct operand){};
+	}
+	advance();	/* ( */
+
+	int start = vm_code_offset(), argc = 0;
+	struct operand args[2];
+	int starts[2];
+
+	while (!CURRENT_TOKEN_IS(TOKEN_RIGHT_PAREN, TOKEN_NEWLINE,
+				 TOKEN_END_OF_FILE)) {
+		if (argc < fn->arity) {
+			starts[argc] = vm_code_offset();
+			args[argc] = expression();
+		} else {
+			expression();
+		}
+		argc++;
+
+		if (!CURRENT_TOKEN_IS(TOKEN_COMMA)) break;
+		advance();
+	}
+	consume(TOKEN_RIGHT_PAREN, "Expected ')' after the arguments.");
+
+	if (argc != fn->arity) {
+		COMPILER_REPORT(line, "math.%s takes %d arguments, %d given.",
+				fn->name, fn->arity, argc);
+		return (struct operand){};
+	}
+
+	struct operand result = {.value.type = VALUE_FLOAT, .is_typed = 1};
+
+	/* a float array is mapped in one code */
+	if (fn->arity == 1 && args[0].is_typed
+	    && args[0].value.type == VALUE_ARRAY) {
+		if (args[0].subtype != ARRAY_FLOAT) {
+			COMPILER_REPORT(line, "math.%s takes a float array.",
+					fn->name);
+		}
+		vm_add_code_monadic(OP_ARRAY_MATH, fn->code);
+		result.value.type = VALUE_ARRAY;
+		result.subtype = ARRAY_FLOAT;
+		return result;
+	}
+
+	int is_constant = 1;
+	for (int i = 0; i < argc; i++) {
+		is_constant &= args[i].is_constant
+			&& (args[i].value.type == VALUE_INT
+			    || args[i].value.type == VALUE_FLOAT);
+	}
+	if (is_constant) {
+		double x[2] = {0, 0};
+		for (int i = 0; i < argc; i++) {
+			x[i] = args[i].value.type == VALUE_INT
+				? args[i].value.as.integer
+				: args[i].value.as.float_p;
+		}
+		result.value = GET_VALUE_FLOAT(fn->arity == 1 ? fn->unary(x[0])
+					       : fn->binary(x[0], x[1]));
+		result.is_constant = 1;
+		vm_rewind_code(start);
+		vm_add_constant(result.value);
+		return result;
+	}
+
+	math_arguments(fn, args, starts);
+	vm_add_code(fn->code);
+	return result;
+}
+
+static void math_arguments(const struct math_function *fn,
+			   const struct operand *args, const int *starts)
+{
+	/* from the last, whose constant code may be rewound */
+	for (int i = fn->arity - 1; i >= 0; i--) {
+		int depth = fn->arity - 1 - i;
+
+		if (args[i].is_void) {
+			COMPILER_REPORT(parser.current_token->line,
+					"Function does not return a value.");
+		} else if (!args[i].is_typed) {
+			vm_add_code_monadic(OP_TO_FLOAT, depth);
+		} else if (args[i].value.type == VALUE_INT
+			   && args[i].is_constant && depth == 0) {
+			/* the last argument's code is the constant alone */
+			vm_rewind_code(starts[i]);
+			vm_add_constant(GET_VALUE_FLOAT(
+				args[i].value.as.integer));
+		} else if (args[i].value.type == VALUE_INT) {
+			vm_add_code_monadic(OP_INT_TO_FLOAT, depth);
+		} else if (args[i].value.type != VALUE_FLOAT) {
+			COMPILER_REPORT(parser.current_token->line,
+					"math.%s takes numbers.", fn->name);
+		}
+	}
+}
+
+static int constant_expression(const struct variable *target,
+			       struct value *val)
+{
+	int start = vm_code_offset(), line = parser.current_token->line;
+	struct operand op = expression();
+	int is_cast = coerce(target, &op, start);
+
+	vm_rewind_code(start);
+	if (!op.is_constant) {
+		COMPILER_REPORT(line, "Constants must be known at compile time.");
+		return 0;
+	}
+
+	*val = is_cast ? GET_VALUE_FLOAT(op.value.as.integer) : op.value;
+	return 1;
+}
+
+static void initializer(const struct variable *target)
+{
+	int start = vm_code_offset();
+	struct operand val;
+
+	if (target->type == VALUE_ARRAY && CURRENT_TOKEN_IS(TOKEN_LEFT_BRACE))
+		val = postfix(array_literal(target->subtype));
+	else if (target->type == VALUE_MAP
+		 && CURRENT_TOKEN_IS(TOKEN_LEFT_BRACE))
+		val = postfix(map_literal());
+	else
+		val = expression();
+	coerce(target, &val, start);
+}
+
+static struct operand binary(enum token_type type, const struct operand *left,
+			     const struct operand *right, int start)
+{
+	const struct typed_code *code = get_typed_code(type);
+
+	if (left->is_void || right->is_void) {
+		COMPILER_REPORT(parser.current_token->line,
+				"Function does not return a value.");
+		return (struct operand){};
+	}
+
+	/* Strings are appended at run time. */
+	if (left->is_constant && right->is_constant
+	    && left->value.type != VALUE_STRING
+	    && right->value.type != VALUE_STRING
+	    && is_foldable(type, &left->value, &right->value)) {
+		struct value val = fold(type, &left->value, &right->value);
+		vm_rewind_code(start);
+		vm_add_constant(val);
+		return (struct operand){
+			.value = val,
+			.is_constant = 1,
+			.is_typed = 1
+		};
+	}
+
+	/* Comparisons always give a boolean, whatever their operands. */
+	struct operand result = {
+		.value.type = VALUE_BOOL,
+		.is_typed = code->is_comparison
+	};
+
+	if (!left->is_typed || !right->is_typed) {
+		vm_add_code(code->generic);
+		return result;
+	}
+
+	enum value_type type1 = left->value.type, type2 = right->value.type;
+	result.is_typed = 1;
+
+	/* Recipe instances, arrays and maps are only compared by
+	 * identity. */
+	if (type1 == VALUE_RECIPE || type2 == VALUE_RECIPE
+	    || type1 == VALUE_ARRAY || type2 == VALUE_ARRAY
+	    || type1 == VALUE_MAP || type2 == VALUE_MAP) {
+		if (type1 != type2 || left->subtype != right->subtype
+		    || (type != TOKEN_EQUAL_EQUAL && type != TOKEN_BANG_EQUAL)) {
+			COMPILER_REPORT(parser.current_token->line,
+					"%ss can only be compared with == and !=.",
+					type1 == VALUE_ARRAY ? "Array"
+					: type1 == VALUE_MAP ? "Map" : "Recipe");
+		}
+		vm_add_code(code->generic);
+		return result;
+	}
+
+	/* strings are appended by term() */
+	if (type1 == VALUE_STRING || type2 == VALUE_STRING) {
+		if (type1 != type2 || (type != TOKEN_EQUAL_EQUAL
+				       && type != TOKEN_BANG_EQUAL)) {
+			COMPILER_REPORT(parser.current_token->line,
+					"Strings can only be appended with +"
+					" and compared with == and !=.");
+		}
+		vm_add_code(code->generic);
+		if (code->is_comparison) return result;
+		return (struct operand){.value.type = VALUE_STRING, .is_typed = 1};
+	}
+
+	if (type1 == VALUE_BOOL || type2 == VALUE_BOOL) {
+		if (type1 != type2 || (type != TOKEN_EQUAL_EQUAL
+				       && type != TOKEN_BANG_EQUAL)) {
+			COMPILER_REPORT(parser.current_token->line,
+					"Operands must be numbers.");
+		}
+		vm_add_code(code->generic);
+		return result;
+	}
+
+	if (type1 == VALUE_INT && type2 == VALUE_INT) {
+		vm_add_code(code->as_int);
+		if (!code->is_comparison)
+			result.value.type = VALUE_INT;
+		result.is_int_comparison = code->is_comparison;
+		return result;
+	}
+
+	if (type == TOKEN_PERCENT) {
+		COMPILER_REPORT(parser.current_token->line,
+				"Modulo operands must be integers.");
+		return result;
+	}
+
+	/* Promote the integer operand, the left one being second from
+	 * the stack's top. */
+	if (type1 != type2)
+		vm_add_code_monadic(OP_INT_TO_FLOAT, type1 == VALUE_INT ? 1 : 0);
+
+	vm_add_code(code->as_float);
+	if (!code->is_comparison)
+		result.value.type = VALUE_FLOAT;
+	return result;
+}
+
+static struct value fold(enum token_type type, const struct value *val1,
+			 const struct value *val2)
+{
+	switch (type) {
+	case TOKEN_EQUAL_EQUAL: return value_equal(val1, val2);
+	case TOKEN_BANG_EQUAL: return value_not_equal(val1, val2);
+	case TOKEN_GREATER: return value_greater(val1, val2);
+	case TOKEN_GREATER_EQUAL: return value_greater_or_equal(val1, val2);
+	case TOKEN_LESS: return value_less(val1, val2);
+	case TOKEN_LESS_EQUAL: return value_less_or_equal(val1, val2);
+	case TOKEN_PLUS: return value_add(val1, val2);
+	case TOKEN_MINUS: return value_substract(val1, val2);
+	case TOKEN_STAR: return value_multiply(val1, val2);
+	case TOKEN_SLASH: return value_divide(val1, val2);
+	case TOKEN_PERCENT: return value_modulo(val1, val2);
+	default: return (struct value){};	/* should not reach here */
+	}
+}
+
+static int is_foldable(enum token_type type, const struct value *val1,
+		       const struct value *val2)
+{
+	return (type != TOKEN_SLASH && type != TOKEN_PERCENT)
+		|| val1->type != VALUE_INT || val2->type != VALUE_INT
+		|| val1->as.integer != INT_MIN || val2->as.integer != -1;
+}
+
+static const struct typed_code *get_typed_code(enum token_type type)
+{
+	for (size_t i = 0; i < sizeof(typed_codes) / sizeof(typed_codes[0]); i++) {
+		if (typed_codes[i].token == type) return &typed_codes[i];
+	}
+	return NULL;	/* should not reach here */
+}
+
+static void emit_slot(enum op_code code, enum op_code code_long, int slot)
+{
+	if (slot < 0x100)
+		vm_add_code_monadic(code, slot);
+	else
+		vm_add_code_dyladic(code_long, slot);
+}
+
+static int coerce(const struct variable *target, const struct operand *val,
+		  int start)
+{
+	enum value_type type = target->type;
+
+	if (val->is_void) {
+		COMPILER_REPORT(parser.current_token->line,
+				"Function does not return a value.");
+		return 0;
+	}
+
+	if (target->is_untyped) return 0;
+
+	if (type == VALUE_RECIPE && val->value.type == VALUE_RECIPE
+	    && target->subtype != val->subtype) {
+		COMPILER_REPORT(parser.current_token->line,
+				"Cannot assign an instance of %s to another recipe.",
+				sbstr2str(&parser.recipes->array[val->subtype].name));
+		return 0;
+	}
+
+	if (type == VALUE_ARRAY && val->value.type == VALUE_ARRAY
+	    && target->subtype != val->subtype) {
+		COMPILER_REPORT(parser.current_token->line,
+				"Cannot assign an array of another element type.");
+		return 0;
+	}
+
+	if (!val->is_typed || val->value.type == type) return 0;
+
+	if (type != VALUE_FLOAT || val->value.type != VALUE_INT) {
+		COMPILER_REPORT(parser.current_token->line,
+				"Cannot assign a %s to a %s variable.",
+				get_type_name(val->value.type),
+				get_type_name(type));
+		return 0;
+	}
+
+	/* Implicit cast of an integer into a float. */
+	if (val->is_constant) {
+		vm_rewind_code(start);
+		vm_add_constant(GET_VALUE_FLOAT(val->value.as.integer));
+	} else {
+		vm_add_code_monadic(OP_INT_TO_FLOAT, 0);
+	}
+	return 1;
+}
+
+static void emit_default_value(const struct variable *var)
+{
+	switch (var->type) {
+	case VALUE_INT: vm_add_constant(GET_VALUE_INT(0)); break;
+	case VALUE_FLOAT: vm_add_constant(GET_VALUE_FLOAT(0)); break;
+	case VALUE_BOOL: vm_add_constant(GET_VALUE_BOOL(0)); break;
+	case VALUE_STRING: vm_add_constant(vm_intern_string("", 0)); break;
+	/* a new instance, its fields zeroed */
+	case VALUE_RECIPE:
+		vm_add_code_dyladic(OP_NEW_RECIPE,
+				    parser.recipes->array[var->subtype].size);
+		break;
+	/* a new empty array */
+	case VALUE_ARRAY:
+		vm_add_code_triadic(OP_ARRAY_LITERAL, var->subtype, 0);
+		break;
+	case VALUE_MAP:
+		vm_add_code_dyladic(OP_MAP_LITERAL, 0);
+		break;
+	/* only the type of what a variable refers to is declared */
+	case VALUE_REF:
+		break;
+	}
+}
+
+static int parse_type(struct variable *var)
+{
+	struct token *tok = parser.current_token;
+
+	if (tok->type == TOKEN_ARRAY) {
+		advance();
+		var->type = VALUE_ARRAY;
+		var->subtype = ARRAY_VALUE;
+		return 1;
+	}
+
+	if (tok->type == TOKEN_MAP) {
+		advance();
+		var->type = VALUE_MAP;
+		return 1;
+	}
+
+	if (IS_TYPE_TOKEN(tok)) {
+		var->type = get_declared_type(advance()->type);
+
+		/* T[] is an array of T */
+		if (CURRENT_TOKEN_IS(TOKEN_LEFT_SQUARE)
+		    && NEXT_TOKEN_IS(TOKEN_RIGHT_SQUARE)) {
+			parser.current_token += 2;
+			var->type = VALUE_ARRAY;
+			var->subtype = get_array_kind(tok->type);
+		}
+		return 1;
+	}
+
+	/* enum values are ints */
+	if (tok->type == TOKEN_IDENTIFIER && find_enum(tok) != -1) {
+		advance();
+		var->type = VALUE_INT;
+		return 1;
+	}
+
+	var->subtype = (tok->type == TOKEN_IDENTIFIER)
+		? recipe_vector_find(parser.recipes, &tok->lexeme) : -1;
+	if (var->subtype == -1) {
+		COMPILER_REPORT(tok->line, "Unknown type %s.",
+				sbstr2str(&tok->lexeme));
+		return 0;
+	}
+
+	advance();
+	var->type = VALUE_RECIPE;
+	return 1;
+}
+
+static enum value_type get_declared_type(enum token_type type)
+{
+	switch (type) {
+	case TOKEN_FLOAT: return VALUE_FLOAT;
+	case TOKEN_BOOL: return VALUE_BOOL;
+	case TOKEN_STR: return VALUE_STRING;
+	/* byte, sbyte and uint are stored as integers */
+	default: return VALUE_INT;
+	}
+}
+
+static enum array_kind get_array_kind(enum token_type type)
+{
+	switch (type) {
+	case TOKEN_BYTE: return ARRAY_BYTE;
+	case TOKEN_SBYTE: return ARRAY_SBYTE;
+	case TOKEN_FLOAT: return ARRAY_FLOAT;
+	case TOKEN_BOOL: return ARRAY_BOOL;
+	case TOKEN_STR: return ARRAY_STRING;
+	default: return ARRAY_INT;
+	}
+}
+
+static struct operand get_element(enum array_kind kind)
+{
+	switch (kind) {
+	case ARRAY_FLOAT:
+		return (struct operand){.value.type = VALUE_FLOAT, .is_typed = 1};
+	case ARRAY_BOOL:
+		return (struct operand){.value.type = VALUE_BOOL, .is_typed = 1};
+	case ARRAY_STRING:
+		return (struct operand){.value.type = VALUE_STRING, .is_typed = 1};
+	case ARRAY_VALUE:
+		return (struct operand){0};
+	default:
+		return (struct operand){.value.type = VALUE_INT, .is_typed = 1};
+	}
+}
+
+static const char *get_type_name(enum value_type type)
+{
+	switch (type) {
+	case VALUE_INT: return "int";
+	case VALUE_FLOAT: return "float";
+	case VALUE_BOOL: return "bool";
+	case VALUE_RECIPE: return "recipe";
+	case VALUE_ARRAY: return "array";
+	case VALUE_MAP: return "map";
+	case VALUE_STRING: return "str";
+	case VALUE_REF: return "ref";
 	}
-	return (struct value){};
+	return "unknown type";
 }
 
 static int __TOKEN_IS__(const struct token *tok, const enum token_type type[])
@@ -24,12 +24,114 @@
 #pragma once
 
 #include "src/scanner/scanner.h"
+#include "variable_vector.h"
+#include "signature_vector.h"
+#include "recipe_vector.h"
 
 #include <stdint.h>
 
+#define LOOP_JUMP_MAX 256
+
+/* A loop being compiled, for the break and continue statements of its
+ * body. */
+struct loop {
+	struct loop *enclosing;
+	/* scope depth of the loop's own slots, the deeper locals are
+	 * popped when jumping out of the body */
+	int depth;
+	/* offset continue jumps back to, or -1 when it jumps forward to
+	 * the loop's step */
+	int start;
+	int breaks[LOOP_JUMP_MAX];
+	int break_count;
+	int continues[LOOP_JUMP_MAX];
+	int continue_count;
+};
+
+#define INVARIANT_MAX 64
+
+enum invariant_kind {
+	INVARIANT_LENGTH,
+	INVARIANT_FIELD,
+	INVARIANT_INDEX
+};
+
+/* A read in a loop which the loop cannot change. The length of an
+ * array or the field of an instance is read once before the loop into
+ * a hidden local. An array indexed by the variable of a range within
+ * its bounds is indexed without checks. */
+struct invariant {
+	enum invariant_kind kind;
+	/* the variable read */
+	const struct token *name;
+	/* the length or the field, or the range's variable */
+	const struct token *member;
+	enum value_type type;
+	/* the hidden local, or the range's variable */
+	int slot;
+};
+
+#define CONDITION_JUMP_MAX 256
+
+/* The jumps of a condition being compiled, to where it is true and to
+ * where it is false. The condition falls through when false, the last
+ * code being the last of the jumps to where it is true. */
+struct condition {
+	int when_true[CONDITION_JUMP_MAX];
+	int true_count;
+	int when_false[CONDITION_JUMP_MAX];
+	int false_count;
+};
+
+#define CASE_CHAIN_MAX 256
+/* shorter if chains are left to compare one by one */
+#define CASE_CHAIN_MIN 4
+
+/* The cases of a match, or an if and its elifs each comparing one
+ * variable to a constant, dispatched on through a jump table or a
+ * match. */
+struct case_chain {
+	/* the constants of every case, ints or strings */
+	struct value values[CASE_CHAIN_MAX];
+	/* the case of each value */
+	uint16_t cases[CASE_CHAIN_MAX];
+	int value_count;
+	/* the newline ending each case's line */
+	struct token *bodies[CASE_CHAIN_MAX];
+	int count;
+	/* the else, NULL without one */
+	struct token *otherwise;
+};
+
 struct parser {
 	struct token *current_token;
 	uint8_t panic;
+	/* variables resolved to VM slots at compile time */
+	struct variable_vector *globals;
+	struct variable_vector *locals;
+	/* `const` declarations and enum members, which take no slot */
+	struct variable_vector *constants;
+	/* names of the named enums */
+	struct variable_vector *enums;
+	/* named enum whose members are being declared, -1 elsewhere */
+	int enumeration;
+	int scope_depth;
+	struct signature_vector *functions;
+	/* parameters of every function, in order */
+	struct variable_vector *parameters;
+	struct recipe_vector *recipes;
+	/* function being compiled, -1 at the top level */
+	int function;
+	/* recipe whose functions are being compiled, -1 elsewhere */
+	int recipe;
+	/* number of tabs the current block is indented by */
+	int indent;
+	/* innermost loop being compiled, NULL outside of loops */
+	struct loop *loop;
+	/* reads hoisted out of the loops being compiled, the innermost
+	 * loop's last */
+	struct invariant invariants[INVARIANT_MAX];
+	int invariant_count;
 };
 
 void parse(struct scan *sc);
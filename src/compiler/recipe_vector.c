@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "recipe_vector.h"
+#include "src/macros.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void recipe_vector_grow(struct recipe_vector *ra);
+static int substring_equal(const struct substring *s1,
+			   const struct substring *s2);
+
+struct recipe_vector *recipe_vector_init()
+{
+	struct recipe_vector *ra = malloc(sizeof(struct recipe_vector));
+
+	ASSERT(ra != NULL, "Unable to allocate memory for recipe_vector.");
+
+	ra->count = 0;
+	ra->size = RECIPE_VECTOR_BUFFER_COUNT * sizeof(struct recipe);
+	ra->array = malloc(ra->size);
+
+	ASSERT(ra->array != NULL, "Unable to allocate memory for recipe_vector.");
+
+	return ra;
+}
+
+int recipe_vector_add(struct recipe_vector *ra, struct substring name)
+{
+	if (ra->count == (ra->size / sizeof(struct recipe)))
+		recipe_vector_grow(ra);
+
+	struct recipe *rc = &ra->array[ra->count];
+	rc->name = name;
+	rc->field_count = 0;
+	rc->field_size = RECIPE_FIELDS_BUFFER_COUNT * sizeof(struct field);
+	rc->fields = malloc(rc->field_size);
+	rc->size = 0;
+	rc->alignment = 1;
+
+	ASSERT(rc->fields != NULL, "Unable to allocate memory for recipe fields.");
+
+	return ra->count++;
+}
+
+int recipe_vector_find(struct recipe_vector *ra, const struct substring *name)
+{
+	for (int i = 0; i < ra->count; i++) {
+		if (substring_equal(&ra->array[i].name, name)) return i;
+	}
+	return -1;
+}
+
+void recipe_vector_del(struct recipe_vector *ra)
+{
+	for (int i = 0; i < ra->count; i++)
+		free(ra->array[i].fields);
+	free(ra->array);
+	free(ra);
+	ra = NULL;
+}
+
+int recipe_add_field(struct recipe *rc, struct field fd)
+{
+	int end = 0, width = fd.width;
+
+	if (rc->field_count == (rc->field_size / sizeof(struct field))) {
+		rc->field_size += RECIPE_FIELDS_BUFFER_COUNT * sizeof(struct field);
+		rc->fields = realloc(rc->fields, rc->field_size);
+		ASSERT(rc->fields != NULL, "Unable to grow recipe fields.");
+	}
+
+	if (rc->field_count > 0) {
+		struct field *last = &rc->fields[rc->field_count - 1];
+		end = last->offset + last->width;
+	}
+
+	/* Fields are aligned on their width, and the instance on its
+	 * widest field, so an array of instances keeps them aligned. */
+	fd.offset = (end + width - 1) / width * width;
+	if (width > rc->alignment) rc->alignment = width;
+	end = fd.offset + width;
+	rc->size = (end + rc->alignment - 1) / rc->alignment * rc->alignment;
+
+	rc->fields[rc->field_count++] = fd;
+	return fd.offset;
+}
+
+struct field *recipe_find_field(struct recipe *rc, const struct substring *name)
+{
+	for (int i = 0; i < rc->field_count; i++) {
+		if (substring_equal(&rc->fields[i].name, name))
+			return &rc->fields[i];
+	}
+	return NULL;
+}
+
+static void recipe_vector_grow(struct recipe_vector *ra)
+{
+	ra->size += RECIPE_VECTOR_BUFFER_COUNT * sizeof(struct recipe);
+	ra->array = realloc(ra->array, ra->size);
+
+	ASSERT(ra->array != NULL, "Unable to grow recipe_vector.");
+}
+
+static int substring_equal(const struct substring *s1,
+			   const struct substring *s2)
+{
+	int length = SUBSTRING_LENGTH(*s1);
+
+	return SUBSTRING_LENGTH(*s2) == length
+		&& memcmp(s1->start, s2->start, length - 1) == 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "src/scanner/substring.h"
+#include "src/value.h"
+#include "src/vm/opcode.h"
+
+#define RECIPE_VECTOR_BUFFER_COUNT 8
+#define RECIPE_FIELDS_BUFFER_COUNT 4
+
+/* A field of a recipe, at a fixed offset of every instance. */
+struct field {
+	struct substring name;
+	enum value_type type;
+	/* codes reading and writing the field, which depend on its width */
+	enum op_code get_code;
+	enum op_code set_code;
+	int offset;
+	int width;
+};
+
+/* A recipe known to the compiler. Its fields are laid out like the
+ * members of a C struct, each aligned on its own width. */
+struct recipe {
+	struct substring name;
+	struct field *fields;
+	int field_count;
+	int field_size;
+	/* bytes per instance, padding included */
+	int size;
+	int alignment;
+};
+
+struct recipe_vector {
+	struct recipe *array;
+	int size;
+	int count;
+};
+
+struct recipe_vector *recipe_vector_init();
+/* Add an empty recipe and return its index. */
+int recipe_vector_add(struct recipe_vector *ra, struct substring name);
+/* Return the index of the recipe named `name`, or -1. */
+int recipe_vector_find(struct recipe_vector *ra, const struct substring *name);
+void recipe_vector_del(struct recipe_vector *ra);
+
+/* Lay out `fd` after the last field of `rc`, and return its offset. */
+int recipe_add_field(struct recipe *rc, struct field fd);
+/* Return the field of `rc` named `name`, or NULL. */
+struct field *recipe_find_field(struct recipe *rc, const struct substring *name);
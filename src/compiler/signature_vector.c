@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "signature_vector.h"
+#include "src/macros.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void signature_vector_grow(struct signature_vector *sa);
+
+struct signature_vector *signature_vector_init()
+{
+	struct signature_vector *sa = malloc(sizeof(struct signature_vector));
+
+	ASSERT(sa != NULL, "Unable to allocate memory for signature_vector.");
+
+	sa->count = 0;
+	sa->size = SIGNATURE_VECTOR_BUFFER_COUNT * sizeof(struct signature);
+	sa->array = malloc(sa->size);
+
+	ASSERT(sa->array != NULL, "Unable to allocate memory for signature_vector.");
+
+	return sa;
+}
+
+int signature_vector_add(struct signature_vector *sa, struct signature s)
+{
+	if (sa->count == (sa->size / sizeof(struct signature)))
+		signature_vector_grow(sa);
+	sa->array[sa->count] = s;
+
+	return sa->count++;
+}
+
+int signature_vector_find(struct signature_vector *sa, int recipe,
+			  const struct substring *name)
+{
+	int length = SUBSTRING_LENGTH(*name);
+
+	for (int i = 0; i < sa->count; i++) {
+		struct substring *other = &sa->array[i].name;
+
+		if (sa->array[i].recipe == recipe
+		    && SUBSTRING_LENGTH(*other) == length
+		    && memcmp(other->start, name->start, length - 1) == 0)
+			return i;
+	}
+	return -1;
+}
+
+static void signature_vector_grow(struct signature_vector *sa)
+{
+	sa->size += SIGNATURE_VECTOR_BUFFER_COUNT * sizeof(struct signature);
+	sa->array = realloc(sa->array, sa->size);
+
+	ASSERT(sa->array != NULL, "Unable to grow signature_vector.");
+}
+
+void signature_vector_del(struct signature_vector *sa)
+{
+	free(sa->array);
+	free(sa);
+	sa = NULL;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "src/scanner/substring.h"
+#include "src/value.h"
+
+#include <stdint.h>
+
+#define SIGNATURE_VECTOR_BUFFER_COUNT 8
+#define SIGNATURE_MAX_ARITY 255
+
+/* A function known to the compiler. Its index in the vector is the
+ * index of the VM function it compiles to. */
+struct signature {
+	struct substring name;
+	/* recipe the function is declared in, -1 for none */
+	int recipe;
+	enum value_type return_type;
+	/* see `struct variable` */
+	int return_subtype;
+	uint8_t returns_value;
+	uint8_t arity;
+	/* index of the first parameter in the compiler's parameters */
+	int parameters;
+};
+
+struct signature_vector {
+	struct signature *array;
+	int size;
+	int count;
+};
+
+struct signature_vector *signature_vector_init();
+/* Return the signature's index. */
+int signature_vector_add(struct signature_vector *sa, struct signature s);
+/* Return the index of the function of `recipe` named `name`, or -1.
+ * Free functions belong to recipe -1. */
+int signature_vector_find(struct signature_vector *sa, int recipe,
+			  const struct substring *name);
+void signature_vector_del(struct signature_vector *sa);
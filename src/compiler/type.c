@@ -23,19 +23,50 @@
 
 #include "parser.h"
 #include "error.h"
+#include "type.h"
 #include "src/value.h"
+#include "src/vm/operation.h"
 #include "src/macros.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 
+#define IS_NUMBER(val) ((val)->type == VALUE_INT || (val)->type == VALUE_FLOAT)
+#define AS_FLOAT(val)							\
+	((val)->type == VALUE_INT ? (double)(val)->as.integer : (val)->as.float_p)
+
+/* Both operands must be numbers. The result is an integer only when
+ * both operands are integers, otherwise it is promoted to a float. */
+#define ARITHMETIC_OPERATION(val1, op, int_operation, val2)		\
+	do {								\
+		if (!IS_NUMBER(val1) || !IS_NUMBER(val2)) {		\
+			COMPILER_REPORT(parser.current_token->line,	\
+					"Value not a number.");		\
+			return (struct value){};			\
+		}							\
+		if ((val1)->type == VALUE_INT && (val2)->type == VALUE_INT) \
+			return GET_VALUE_INT(int_operation((val1)->as.integer, \
+							   (val2)->as.integer)); \
+		return GET_VALUE_FLOAT(AS_FLOAT(val1) op AS_FLOAT(val2)); \
+	} while (0)
+
+#define COMPARISON_OPERATION(val1, op, val2)				\
+	do {								\
+		if (!IS_NUMBER(val1) || !IS_NUMBER(val2)) {		\
+			COMPILER_REPORT(parser.current_token->line,	\
+					"Value not a number.");		\
+			return (struct value){};			\
+		}							\
+		return GET_VALUE_BOOL(AS_FLOAT(val1) op AS_FLOAT(val2)); \
+	} while (0)
+
 /* defined in parser.c */
 extern struct parser parser;
 
 struct value value_negate(const struct value *val)
 {
 	switch (val->type) {
-	case VALUE_INT: return GET_VALUE_INT(-val->as.integer);
+	case VALUE_INT: return GET_VALUE_INT(operation_int_negate(val->as.integer));
 	case VALUE_FLOAT: return GET_VALUE_FLOAT(-val->as.float_p);
 	/* TODO: complete error reporting for other types */
 	default:
@@ -48,8 +79,8 @@ struct value value_negate(const struct value *val)
 struct value value_logical_not(const struct value *val)
 {
 	switch (val->type) {
-	case VALUE_INT: return GET_VALUE_INT(!val->as.integer);
-	case VALUE_FLOAT: return GET_VALUE_FLOAT(!val->as.float_p);
+	case VALUE_INT: return GET_VALUE_BOOL(!val->as.integer);
+	case VALUE_FLOAT: return GET_VALUE_BOOL(!val->as.float_p);
 	case VALUE_BOOL: return GET_VALUE_BOOL(!val->as.bool);
 	/* TODO: complete error reporting for other types */
 	default:
@@ -61,110 +92,84 @@ struct value value_logical_not(const struct value *val)
 
 struct value value_add(const struct value *val1, const struct value *val2)
 {
-	switch (val1->type) {
-	case VALUE_INT:
-		if (val2->type == VALUE_INT) {
-			return GET_VALUE_INT(val1->as.integer
-					+ val2->as.integer);
-		}
-		if (val2->type == VALUE_FLOAT) {
-			return GET_VALUE_FLOAT(val1->as.integer
-					+ val2->as.float_p); 
-		}
-	case VALUE_FLOAT: return GET_VALUE_FLOAT(!val->as.float_p);
-	case VALUE_BOOL: return GET_VALUE_BOOL(!val->as.bool);
-	/* TODO: complete error reporting for other types */
-	default:
-		COMPILER_REPORT(parser.current_token->line,
-				"Value not a number.");
-		return (struct value){};
-	}
+	ARITHMETIC_OPERATION(val1, +, operation_int_add, val2);
 }
 
-struct value value_substract(struct value val1, struct value val2)
+struct value value_substract(const struct value *val1, const struct value *val2)
 {
-	ASSERT(val1.type == VALUE_NUMBER
-		&& val2.type == VALUE_NUMBER, "Value not a number.");
-	val1.as.number -= val2.as.number;
-	return val1;
+	ARITHMETIC_OPERATION(val1, -, operation_int_substract, val2);
 }
 
-struct value value_multiply(struct value val1, struct value val2)
+struct value value_multiply(const struct value *val1, const struct value *val2)
 {
-	ASSERT(val1.type == VALUE_NUMBER
-		&& val2.type == VALUE_NUMBER, "Value not a number.");
-	val1.as.number *= val2.as.number;
-	return val1;
+	ARITHMETIC_OPERATION(val1, *, operation_int_multiply, val2);
 }
 
-struct value value_divide(struct value val1, struct value val2)
+struct value value_divide(const struct value *val1, const struct value *val2)
 {
-	ASSERT(val1.type == VALUE_NUMBER
-		&& val2.type == VALUE_NUMBER, "Value not a number.");
-	val1.as.number /= val2.as.number;
-	return val1;
+	if (val2->type == VALUE_INT && val2->as.integer == 0
+	    && val1->type == VALUE_INT) {
+		COMPILER_REPORT(parser.current_token->line,
+				"Integer division by zero.");
+		return (struct value){};
+	}
+	ARITHMETIC_OPERATION(val1, /, operation_int_divide, val2);
 }
 
-struct value value_modulo(struct value val1, struct value val2)
+struct value value_modulo(const struct value *val1, const struct value *val2)
 {
-	ASSERT(val1.type == VALUE_NUMBER
-		&& val2.type == VALUE_NUMBER, "Value not a number.");
-	val1.as.number = (int)val1.as.number % (int)val2.as.number;
-	return val1;
+	if (val1->type != VALUE_INT || val2->type != VALUE_INT) {
+		COMPILER_REPORT(parser.current_token->line,
+				"Modulo operands must be integers.");
+		return (struct value){};
+	}
+	if (val2->as.integer == 0) {
+		COMPILER_REPORT(parser.current_token->line,
+				"Integer modulo by zero.");
+		return (struct value){};
+	}
+	return GET_VALUE_INT(operation_int_modulo(val1->as.integer,
+						  val2->as.integer));
 }
 
-struct value value_greater(struct value val1, struct value val2)
+struct value value_greater(const struct value *val1, const struct value *val2)
 {
-	ASSERT(val1.type == VALUE_NUMBER
-		&& val2.type == VALUE_NUMBER, "Value not a number.");
-	return GET_VALUE_BOOL(val1.as.number > val2.as.number);
+	COMPARISON_OPERATION(val1, >, val2);
 }
 
-struct value value_greater_or_equal(struct value val1, struct value val2)
+struct value value_greater_or_equal(const struct value *val1,
+				    const struct value *val2)
 {
-	ASSERT(val1.type == VALUE_NUMBER
-		&& val2.type == VALUE_NUMBER, "Value not a number.");
-	return GET_VALUE_BOOL(val1.as.number >= val2.as.number);
+	COMPARISON_OPERATION(val1, >=, val2);
 }
 
-struct value value_less(struct value val1, struct value val2)
+struct value value_less(const struct value *val1, const struct value *val2)
 {
-	ASSERT(val1.type == VALUE_NUMBER
-		&& val2.type == VALUE_NUMBER, "Value not a number.");
-	return GET_VALUE_BOOL(val1.as.number < val2.as.number);
+	COMPARISON_OPERATION(val1, <, val2);
 }
 
-struct value value_less_or_equal(struct value val1, struct value val2)
+struct value value_less_or_equal(const struct value *val1,
+				 const struct value *val2)
 {
-	ASSERT(val1.type == VALUE_NUMBER
-		&& val2.type == VALUE_NUMBER, "Value not a number.");
-	return GET_VALUE_BOOL(val1.as.number <= val2.as.number);
+	COMPARISON_OPERATION(val1, <=, val2);
 }
 
-struct value value_equal(struct value val1, struct value val2)
+struct value value_equal(const struct value *val1, const struct value *val2)
 {
-	ASSERT((val1.type == VALUE_NUMBER
-		&& val2.type == VALUE_NUMBER
-			|| (val1.type == VALUE_BOOL
-				&& val2.type == VALUE_BOOL)),
-		"Value not a boolean.");
-	if (val1.type == VALUE_NUMBER) {
-		return GET_VALUE_BOOL(val1.as.number == val2.as.number);
-	}
+	if (IS_NUMBER(val1) && IS_NUMBER(val2))
+		return GET_VALUE_BOOL(AS_FLOAT(val1) == AS_FLOAT(val2));
+
+	if (val1->type == VALUE_BOOL && val2->type == VALUE_BOOL)
+		return GET_VALUE_BOOL(val1->as.bool == val2->as.bool);
 
-	return GET_VALUE_BOOL(val1.as.bool == val2.as.bool);
+	COMPILER_REPORT(parser.current_token->line,
+			"Values are not comparable.");
+	return (struct value){};
 }
 
-struct value value_not_equal(struct value val1, struct value val2)
+struct value value_not_equal(const struct value *val1, const struct value *val2)
 {
-	ASSERT((val1.type == VALUE_NUMBER
-		&& val2.type == VALUE_NUMBER
-			|| (val1.type == VALUE_BOOL
-				&& val2.type == VALUE_BOOL)),
-		"Value not a boolean.");
-	if (val1.type == VALUE_NUMBER) {
-		return GET_VALUE_BOOL(val1.as.number != val2.as.number);
-	}
-
-	return GET_VALUE_BOOL(val1.as.bool != val2.as.bool);
+	struct value val = value_equal(val1, val2);
+	val.as.bool = !val.as.bool;
+	return val;
 }
@@ -2,16 +2,49 @@
 
 #include "src/value.h"
 
-struct value value_negate(struct value val);
-struct value value_logical_not(struct value val);
-struct value value_add(struct value val1, struct value val2);
-struct value value_substract(struct value val1, struct value val2);
-struct value value_multiply(struct value val1, struct value val2);
-struct value value_divide(struct value val1, struct value val2);
-struct value value_modulo(struct value val1, struct value val2);
-struct value value_greater(struct value val1, struct value val2);
-struct value value_greater_or_equal(struct value val1, struct value val2);
-struct value value_less(struct value val1, struct value val2);
-struct value value_less_or_equal(struct value val1, struct value val2);
-struct value value_equal(struct value val1, struct value val2);
-struct value value_not_equal(struct value val1, struct value val2);
+#include <stdint.h>
+
+/*
+ * An expression as seen by the compiler. `value.type` is the static
+ * type of the expression when `is_typed` is set, `subtype` being the
+ * index of its recipe or the kind of its array elements, and `value.as`
+ * holds its value when `is_constant` is set. `is_void` marks a call to
+ * a function returning nothing, and `is_call` an expression that is
+ * nothing but a call, last of its code. `is_const` marks a const ref
+ * parameter, which cannot be changed.
+ *
+ * While `term()` compiles strings joined by +, `concat` counts those
+ * left on the stack for one code to append, and `concat_tail` is the
+ * offset of the last one's code when it is a constant, held by
+ * `value`, or -1.
+ */
+struct operand {
+	struct value value;
+	uint8_t is_constant;
+	uint8_t is_typed;
+	int subtype;
+	uint8_t is_void;
+	uint8_t is_call;
+	uint8_t is_const;
+	/* the value was just computed by a comparison of two ints, the
+	 * last code emitted, which a branch on it absorbs */
+	uint8_t is_int_comparison;
+	int concat;
+	int concat_tail;
+};
+
+struct value value_negate(const struct value *val);
+struct value value_logical_not(const struct value *val);
+struct value value_add(const struct value *val1, const struct value *val2);
+struct value value_substract(const struct value *val1, const struct value *val2);
+struct value value_multiply(const struct value *val1, const struct value *val2);
+struct value value_divide(const struct value *val1, const struct value *val2);
+struct value value_modulo(const struct value *val1, const struct value *val2);
+struct value value_greater(const struct value *val1, const struct value *val2);
+struct value value_greater_or_equal(const struct value *val1,
+				    const struct value *val2);
+struct value value_less(const struct value *val1, const struct value *val2);
+struct value value_less_or_equal(const struct value *val1,
+				 const struct value *val2);
+struct value value_equal(const struct value *val1, const struct value *val2);
+struct value value_not_equal(const struct value *val1, const struct value *val2);
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "variable_vector.h"
+#include "src/macros.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void variable_vector_grow(struct variable_vector *va);
+
+struct variable_vector *variable_vector_init()
+{
+	struct variable_vector *va = malloc(sizeof(struct variable_vector));
+
+	ASSERT(va != NULL, "Unable to allocate memory for variable_vector.");
+
+	va->count = 0;
+	va->size = VARIABLE_VECTOR_BUFFER_COUNT * sizeof(struct variable);
+	va->array = malloc(va->size);
+
+	ASSERT(va->array != NULL, "Unable to allocate memory for variable_vector.");
+
+	return va;
+}
+
+int variable_vector_add(struct variable_vector *va, struct variable v)
+{
+	if (va->count == (va->size / sizeof(struct variable)))
+		variable_vector_grow(va);
+	va->array[va->count] = v;
+
+	return va->count++;
+}
+
+int variable_vector_find(struct variable_vector *va,
+			 const struct substring *name)
+{
+	int length = SUBSTRING_LENGTH(*name);
+
+	/* Search backwards so inner locals shadow outer ones. */
+	for (int i = va->count - 1; i >= 0; i--) {
+		struct substring *other = &va->array[i].name;
+
+		if (SUBSTRING_LENGTH(*other) == length
+		    && memcmp(other->start, name->start, length - 1) == 0)
+			return i;
+	}
+	return -1;
+}
+
+static void variable_vector_grow(struct variable_vector *va)
+{
+	va->size += VARIABLE_VECTOR_BUFFER_COUNT * sizeof(struct variable);
+	va->array = realloc(va->array, va->size);
+
+	ASSERT(va->array != NULL, "Unable to grow variable_vector.");
+}
+
+void variable_vector_del(struct variable_vector *va)
+{
+	free(va->array);
+	free(va);
+	va = NULL;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "src/scanner/substring.h"
+#include "src/value.h"
+
+#define VARIABLE_VECTOR_BUFFER_COUNT 8
+
+/* A variable known to the compiler. Its index in the vector is the
+ * slot the VM reads it from. */
+struct variable {
+	struct substring name;
+	/* static type of the variable */
+	enum value_type type;
+	/* index of the variable's recipe for VALUE_RECIPE, or the kind
+	 * of its elements for VALUE_ARRAY. For a constant, the index of
+	 * its named enum, or -1. */
+	int subtype;
+	/* scope depth of a local, 0 for globals */
+	int depth;
+	/* set when the type is only known at runtime, like the elements
+	 * of a boxed array */
+	uint8_t is_untyped;
+	/* set for ref parameters, which hold the slot of the variable
+	 * passed, that `is_const` ones cannot change */
+	uint8_t is_ref;
+	uint8_t is_const;
+	/* Set while the instance a local recipe was declared with, made
+	 * by the OP_NEW_RECIPE at `allocation`, was only used for its
+	 * fields. It then never escapes the function, which makes it in
+	 * its frame. Set on a ref parameter when the instance passed to
+	 * it never escapes the call. */
+	uint8_t is_elidable;
+	int allocation;
+	/* the value of a constant, inlined wherever it is read */
+	struct value value;
+};
+
+struct variable_vector {
+	struct variable *array;
+	int size;
+	int count;
+};
+
+struct variable_vector *variable_vector_init();
+/* Return the variable's slot. */
+int variable_vector_add(struct variable_vector *va, struct variable v);
+/* Return the slot of the last variable named `name`, or -1. */
+int variable_vector_find(struct variable_vector *va,
+			 const struct substring *name);
+void variable_vector_del(struct variable_vector *va);
@@ -28,8 +28,37 @@
 #include "macros.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <sysexits.h>
+
+static void usage(const char *program)
+{
+	fprintf(stderr, "Usage: %s [--emit-c | --no-jit] file\n", program);
+	exit(EXIT_FAILURE);
+}
+
+/* The status a program exits with, the same for the VM and the C
+ * emitted by --emit-c. */
+static int exit_status(enum interpret_result result)
+{
+	switch (result) {
+	case INTERPRET_COMPILE_ERROR: return EX_DATAERR;
+	case INTERPRET_RUNTIME_ERROR: return EX_SOFTWARE;
+	default: return EXIT_SUCCESS;
+	}
+}
 
 int main(int argc, char **argv)
 {
-	interpret(argv[1]);
+	if (argc == 3 && strcmp(argv[1], "--emit-c") == 0)
+		return exit_status(compile_to_c(argv[2], stdout));
+
+	/* the interpreter alone, to compare with the JIT */
+	if (argc == 3 && strcmp(argv[1], "--no-jit") == 0)
+		return exit_status(interpret(argv[2], 0));
+
+	if (argc != 2)
+		usage(argv[0]);
+
+	return exit_status(interpret(argv[1], 1));
 }
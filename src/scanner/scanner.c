@@ -39,7 +39,7 @@
 			.line = scanner.line		\
 			}
 #define IS_DIGIT(d) (d >= '0' && d <= '9')
-#define IS_ALPHA(c) ((c >= 'A' && c <= 'z') || c == '_')
+#define IS_ALPHA(c) ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_')
 
 struct scanner {
 	/* start of the lexeme to be included in the next token
@@ -54,7 +54,7 @@ struct scanner {
 static struct scanner scanner = (struct scanner){
 	.start = 0,
 	.current = 0,
-	.line = 0,
+	.line = 1,
 };
 
 /* fill up `ta` with the tokens from the source file
@@ -122,7 +122,7 @@ static struct token get_token()
 	case '(': advance(); return GET_TOKEN(TOKEN_LEFT_PAREN);
 	case ')': advance(); return GET_TOKEN(TOKEN_RIGHT_PAREN);
 	case '{': advance(); return GET_TOKEN(TOKEN_LEFT_BRACE);
-	case '}': advance(); return GET_TOKEN(TOKEN_RIGHT_PAREN);
+	case '}': advance(); return GET_TOKEN(TOKEN_RIGHT_BRACE);
 	case '[': advance(); return GET_TOKEN(TOKEN_LEFT_SQUARE);
 	case ']': advance(); return GET_TOKEN(TOKEN_RIGHT_SQUARE);
 	case ',': advance(); return GET_TOKEN(TOKEN_COMMA);
@@ -166,6 +166,25 @@ static struct token get_token()
 			return GET_TOKEN(TOKEN_BANG_EQUAL);
 		}
 		return GET_TOKEN(TOKEN_BANG);
+	/* && and || spell and and or, there are no bitwise operators */
+	case '&':
+		advance();
+		if (scanner.current[0] == '&') {
+			advance();
+			return GET_TOKEN(TOKEN_AND);
+		}
+		fprintf(stderr, "Unexpected character & at line %d.\n",
+			scanner.line);
+		return GET_TOKEN(TOKEN_INVALID);
+	case '|':
+		advance();
+		if (scanner.current[0] == '|') {
+			advance();
+			return GET_TOKEN(TOKEN_OR);
+		}
+		fprintf(stderr, "Unexpected character | at line %d.\n",
+			scanner.line);
+		return GET_TOKEN(TOKEN_INVALID);
 	case '=':
 		advance();
 		if (scanner.current[0] == '=') {
@@ -259,6 +278,7 @@ static struct token digit()
 
         /* disallow defining a float as 'n.' */
 	if (!IS_DIGIT(scanner.current[1])) goto return_invalid;
+	advance();
 
 	while (IS_DIGIT(scanner.current[0])) {
 		advance();
@@ -327,6 +347,8 @@ static enum token_type get_keyword_type(const char *str) {
 		default: return TOKEN_IDENTIFIER;
 		}
 	case 'c':
+		if (str[1] == 'a') return keywordcmp(2, "se", TOKEN_CASE); /* case */
+
 		/* compare 'on' in 'const' and 'continue' */
 		if (strncmp(scanner.start + 1, str + 1, 2) != 0) return TOKEN_IDENTIFIER;
 
@@ -337,7 +359,9 @@ static enum token_type get_keyword_type(const char *str) {
 		}
 	case 'e':
 		switch (str[1]) {
-		case 'l': return keywordcmp(2, "se", TOKEN_ELSE); /* else */
+		case 'l':
+			if (str[2] == 'i') return keywordcmp(3, "f", TOKEN_ELIF); /* elif */
+			return keywordcmp(2, "se", TOKEN_ELSE); /* else */
 		case 'n': return keywordcmp(2, "um", TOKEN_ENUM); /* enum */
 		default: return TOKEN_IDENTIFIER;
 		}
@@ -345,17 +369,23 @@ static enum token_type get_keyword_type(const char *str) {
 		switch (str[1]) {
 		case 'a': return keywordcmp(2, "lse", TOKEN_FALSE); /* false */
 		case 'l': return keywordcmp(2, "oat", TOKEN_FLOAT); /* float */
+		case 'o': return keywordcmp(2, "r", TOKEN_FOR); /* for */
 		case 'u': return keywordcmp(2, "nc", TOKEN_FUNC); /* func */
 		default: return TOKEN_IDENTIFIER;
 		}
 	case 'i':
 		switch (str[1]) {
-		case 'n': return keywordcmp(2, "t", TOKEN_FUNC); /* int */
+		case 'n': if (str[2] == '\0') return TOKEN_IN; /* in */
+			return keywordcmp(2, "t", TOKEN_INT); /* int */
 		case 'f': if (str[2] == '\0') return TOKEN_IF; /* if */
 			 /* fall through */
 		default: return TOKEN_IDENTIFIER;
 		}
-	case 'm': return keywordcmp(1, "ap", TOKEN_MAP); /* map */
+	case 'm':
+		if (str[1] == 'a' && str[2] == 't')
+			return keywordcmp(3, "ch", TOKEN_MATCH); /* match */
+		return keywordcmp(1, "ap", TOKEN_MAP); /* map */
+	case 'n': return keywordcmp(1, "ot", TOKEN_NOT); /* not */
 	case 'o': return keywordcmp(1, "r", TOKEN_OR);	 /* or */
 	case 'p':
 		switch (str[1]) {
@@ -378,7 +408,7 @@ static enum token_type get_keyword_type(const char *str) {
 		}
 	case 's':
 		switch (str[1]) {
-		case 'b': return keywordcmp(2, "yte", TOKEN_BYTE); /* sbyte */
+		case 'b': return keywordcmp(2, "yte", TOKEN_SBYTE); /* sbyte */
 		case 't': return keywordcmp(2, "r", TOKEN_STR); /* str */
 		default: return TOKEN_IDENTIFIER;
 		}
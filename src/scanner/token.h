@@ -45,9 +45,10 @@ enum token_type{
 
 	/* keywords */
 	TOKEN_AND, TOKEN_ARRAY, TOKEN_AS, TOKEN_BOOL, TOKEN_BREAK,
-	TOKEN_BYTE, TOKEN_CONST, TOKEN_CONTINUE, TOKEN_ELSE,
-	TOKEN_ENUM, TOKEN_FALSE, TOKEN_FLOAT, TOKEN_FUNC, TOKEN_IF,
-	TOKEN_INT, TOKEN_MAP, TOKEN_OR, TOKEN_PASS, TOKEN_PRINT,
+	TOKEN_BYTE, TOKEN_CASE, TOKEN_CONST, TOKEN_CONTINUE, TOKEN_ELIF,
+	TOKEN_ELSE, TOKEN_ENUM, TOKEN_FALSE, TOKEN_FLOAT, TOKEN_FOR, TOKEN_FUNC,
+	TOKEN_IF, TOKEN_IN, TOKEN_INT, TOKEN_MAP, TOKEN_MATCH, TOKEN_NOT,
+	TOKEN_OR, TOKEN_PASS, TOKEN_PRINT,
 	TOKEN_PRINT_ERR, TOKEN_RECIPE, TOKEN_REF, TOKEN_RETURN,
 	TOKEN_SBYTE, TOKEN_STR, TOKEN_TRUE, TOKEN_UINT, TOKEN_WHILE,
 
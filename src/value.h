@@ -40,11 +40,44 @@
 		.as.bool = !!(boolean),				\
 		.type = VALUE_BOOL				\
 	})
+#define GET_VALUE_RECIPE(obj)					\
+	((struct value) {					\
+		.as.structure = (obj),				\
+		.type = VALUE_RECIPE				\
+	})
+#define GET_VALUE_ARRAY(arr)					\
+	((struct value) {					\
+		.as.structure = (arr),				\
+		.type = VALUE_ARRAY				\
+	})
+#define GET_VALUE_MAP(map)					\
+	((struct value) {					\
+		.as.structure = (map),				\
+		.type = VALUE_MAP				\
+	})
+#define GET_VALUE_STRING(word)					\
+	((struct value) {					\
+		.as.string = (word),				\
+		.type = VALUE_STRING				\
+	})
+#define GET_VALUE_REF(slot)					\
+	((struct value) {					\
+		.as.ref = (slot),				\
+		.type = VALUE_REF				\
+	})
 
 enum value_type {
 	VALUE_INT = 0,
 	VALUE_FLOAT,
 	VALUE_BOOL,
+	/* references to heap objects, see src/vm/object.h */
+	VALUE_RECIPE,
+	VALUE_ARRAY,
+	VALUE_MAP,
+	/* stored in the value when short, see src/vm/str.h */
+	VALUE_STRING,
+	/* the slot of the variable passed to a ref parameter */
+	VALUE_REF,
 };
 
 struct value {
@@ -52,7 +85,9 @@ struct value {
 		int integer;
 		double float_p;
 		uint8_t bool;
-		void *structure; /* used for later */
+		void *structure;
+		uint64_t string;
+		struct value *ref;
 	} as;
 	enum value_type type;
 };
@@ -0,0 +1,448 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "object.h"
+#include "opcode.h"
+#include "operation.h"
+#include "str.h"
+#include "src/value.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Bulk operations on arrays, shared by the VM and the C emitted by
+ * `emit_c()`. Typed arrays are processed 16 bytes at a time with GCC
+ * vector extensions, the elements following the array's header being
+ * aligned for it. Boxed arrays fall back on the generic operations of
+ * operation.h, one element at a time. Like those, the kernels return
+ * NULL on success or an error message on failure.
+ */
+
+typedef uint32_t array_v4su __attribute__((vector_size(16)));
+typedef int32_t array_v4si __attribute__((vector_size(16)));
+typedef int64_t array_v2di __attribute__((vector_size(16)));
+typedef double array_v2df __attribute__((vector_size(16)));
+typedef uint8_t array_v16qu __attribute__((vector_size(16)));
+typedef int8_t array_v16qs __attribute__((vector_size(16)));
+typedef int32_t array_v16si __attribute__((vector_size(64)));
+
+#define ARRAY_VECTOR(data, index, vtype) (*(const vtype *)((data) + (index)))
+#define ARRAY_LANES(vtype, ctype) ((int)(sizeof(vtype) / sizeof(ctype)))
+
+static inline const char *array_check_index(const struct array *arr, int index)
+{
+	if ((unsigned)index >= (unsigned)arr->length)
+		return "Index out of bounds.";
+	return NULL;
+}
+
+static inline void array_fill(struct array *arr, const struct value *val)
+{
+	int i = 0;
+
+	switch (arr->kind) {
+	case ARRAY_INT: {
+		int32_t *data = ARRAY_DATA(arr, int32_t);
+		array_v4si splat = (array_v4si){0} + val->as.integer;
+
+		for (; i + 4 <= arr->length; i += 4)
+			*(array_v4si *)(data + i) = splat;
+		for (; i < arr->length; i++)
+			data[i] = val->as.integer;
+		break;
+	}
+	case ARRAY_FLOAT: {
+		double *data = ARRAY_DATA(arr, double);
+		array_v2df splat = (array_v2df){0} + val->as.float_p;
+
+		for (; i + 2 <= arr->length; i += 2)
+			*(array_v2df *)(data + i) = splat;
+		for (; i < arr->length; i++)
+			data[i] = val->as.float_p;
+		break;
+	}
+	case ARRAY_BYTE:
+	case ARRAY_SBYTE:
+		memset(arr->data, (uint8_t)val->as.integer, arr->length);
+		break;
+	case ARRAY_BOOL:
+		memset(arr->data, val->as.bool, arr->length);
+		break;
+	case ARRAY_VALUE:
+	case ARRAY_STRING:
+		for (; i < arr->length; i++)
+			ARRAY_DATA(arr, struct value)[i] = *val;
+		break;
+	}
+}
+
+/* The object an element refers to, or NULL. */
+static inline struct object *array_element_object(const struct value *val)
+{
+	switch (val->type) {
+	case VALUE_RECIPE:
+	case VALUE_ARRAY:
+	case VALUE_MAP:
+		return val->as.structure;
+	case VALUE_STRING:
+		return STRING_IS_SHORT(val) ? NULL : STRING_HEAP(val);
+	default:
+		return NULL;
+	}
+}
+
+/* Called before the element `*slot` of `arr` is replaced by `val`.
+ * While the old generation is marked, what an old array loses is
+ * marked. An old array now referring to the nursery is remembered for
+ * the next minor collection. */
+static inline const char *array_barrier(struct heap *heap, struct array *arr,
+					const struct value *slot,
+					const struct value *val)
+{
+	struct object *obj;
+
+	if (arr->object.space != SPACE_OLD) return NULL;
+
+	if (heap->phase == HEAP_MARKING
+	    && (obj = array_element_object(slot)) != NULL
+	    && !heap_shade(heap, obj))
+		return "Out of memory.";
+
+	if (arr->object.is_remembered
+	    || (obj = array_element_object(val)) == NULL
+	    || obj->space != SPACE_NURSERY)
+		return NULL;
+	return heap_remember(heap, &arr->object) ? NULL : "Out of memory.";
+}
+
+/* Copy as many elements of `src` as fit in `dst`, both of the same kind. */
+static inline void array_copy(struct array *dst, const struct array *src)
+{
+	int length = dst->length < src->length ? dst->length : src->length;
+
+	memmove(dst->data, src->data, (size_t)length * array_width(dst->kind));
+}
+
+/* Store in `result` a new array of the elements from `from` up to `to`. */
+static inline const char *array_slice(const struct array *arr, int from, int to,
+				      struct heap *heap, struct value *result)
+{
+	struct array *slice;
+	int width = array_width(arr->kind);
+
+	if (from < 0 || to > arr->length || from > to)
+		return "Slice out of bounds.";
+
+	slice = object_new_array(arr->kind, to - from, heap);
+	if (slice == NULL) return "Out of memory.";
+
+	memcpy(slice->data, arr->data + (size_t)from * width,
+	       (size_t)(to - from) * width);
+	*result = GET_VALUE_ARRAY(slice);
+	return NULL;
+}
+
+#define ARRAY_MATH(function)						\
+	do {								\
+		for (int i = 0; i < arr->length; i++)			\
+			out[i] = function(in[i]);			\
+	} while (0)
+
+/* Store in `result` a new array of the unary math function `code`,
+ * an OP_MATH_ code, applied to each element of the float array `arr`.
+ * The function is chosen once, outside of the loop. */
+static inline const char *array_math(const struct array *arr, int code,
+				     struct heap *heap, struct value *result)
+{
+	struct array *mapped = object_new_array(ARRAY_FLOAT, arr->length, heap);
+	const double *in = ARRAY_DATA(arr, double);
+	double *out;
+
+	if (mapped == NULL) return "Out of memory.";
+	out = ARRAY_DATA(mapped, double);
+
+	switch (code) {
+	case OP_MATH_SQRT: ARRAY_MATH(sqrt); break;
+	case OP_MATH_FLOOR: ARRAY_MATH(floor); break;
+	case OP_MATH_CEIL: ARRAY_MATH(ceil); break;
+	case OP_MATH_SIN: ARRAY_MATH(sin); break;
+	case OP_MATH_COS: ARRAY_MATH(cos); break;
+	case OP_MATH_EXP: ARRAY_MATH(exp); break;
+	case OP_MATH_LOG: ARRAY_MATH(log); break;
+	default: return "Not a unary math function.";
+	}
+	*result = GET_VALUE_ARRAY(mapped);
+	return NULL;
+}
+
+/* Bytes, signed bytes and bools are widened to 32 bits before being
+ * summed, 16 at a time. */
+#define ARRAY_SUM_NARROW(vtype, ctype)					\
+	do {								\
+		const ctype *data = ARRAY_DATA(arr, ctype);		\
+		array_v16si acc = {0};					\
+		int32_t sum = 0;					\
+		int i = 0;						\
+									\
+		for (; i + 16 <= arr->length; i += 16)			\
+			acc += __builtin_convertvector(			\
+				ARRAY_VECTOR(data, i, vtype), array_v16si); \
+		for (int lane = 0; lane < 16; lane++)			\
+			sum += acc[lane];				\
+		for (; i < arr->length; i++)				\
+			sum += data[i];					\
+		*result = GET_VALUE_INT(sum);				\
+	} while (0)
+
+static inline const char *array_sum(const struct array *arr,
+				    struct value *result)
+{
+	int i = 0;
+
+	switch (arr->kind) {
+	case ARRAY_INT: {
+		const uint32_t *data = ARRAY_DATA(arr, uint32_t);
+		array_v4su acc0 = {0}, acc1 = {0};
+		uint32_t sum;
+
+		for (; i + 8 <= arr->length; i += 8) {
+			acc0 += ARRAY_VECTOR(data, i, array_v4su);
+			acc1 += ARRAY_VECTOR(data, i + 4, array_v4su);
+		}
+		acc0 += acc1;
+		sum = acc0[0] + acc0[1] + acc0[2] + acc0[3];
+		for (; i < arr->length; i++)
+			sum += data[i];
+		*result = GET_VALUE_INT((int32_t)sum);
+		return NULL;
+	}
+	case ARRAY_FLOAT: {
+		const double *data = ARRAY_DATA(arr, double);
+		array_v2df acc0 = {0}, acc1 = {0};
+		double sum;
+
+		for (; i + 4 <= arr->length; i += 4) {
+			acc0 += ARRAY_VECTOR(data, i, array_v2df);
+			acc1 += ARRAY_VECTOR(data, i + 2, array_v2df);
+		}
+		acc0 += acc1;
+		sum = acc0[0] + acc0[1];
+		for (; i < arr->length; i++)
+			sum += data[i];
+		*result = GET_VALUE_FLOAT(sum);
+		return NULL;
+	}
+	case ARRAY_BYTE:
+	case ARRAY_BOOL:
+		ARRAY_SUM_NARROW(array_v16qu, uint8_t);
+		return NULL;
+	case ARRAY_SBYTE:
+		ARRAY_SUM_NARROW(array_v16qs, int8_t);
+		return NULL;
+	default: {
+		const struct value *data = ARRAY_DATA(arr, struct value);
+		const char *error;
+
+		*result = GET_VALUE_INT(0);
+		for (; i < arr->length; i++)
+			if ((error = operation_add(result, &data[i])) != NULL)
+				return error;
+		return NULL;
+	}
+	}
+}
+
+/* Keep the lanes of `v` that compare `op` to `acc`, with `mtype` the
+ * type of the comparison's result. */
+#define ARRAY_EXTREMUM(vtype, mtype, ctype, make_value, op)		\
+	do {								\
+		const ctype *data = ARRAY_DATA(arr, ctype);		\
+		const int lanes = ARRAY_LANES(vtype, ctype);		\
+		ctype best = data[0];					\
+		int i = 0;						\
+									\
+		if (arr->length >= lanes) {				\
+			vtype acc = ARRAY_VECTOR(data, 0, vtype);	\
+									\
+			for (i = lanes; i + lanes <= arr->length; i += lanes) { \
+				vtype v = ARRAY_VECTOR(data, i, vtype);	\
+				mtype take = (mtype)(v op acc);		\
+				acc = (vtype)(((mtype)v & take)		\
+					      | ((mtype)acc & ~take));	\
+			}						\
+			best = acc[0];					\
+			for (int lane = 1; lane < lanes; lane++)	\
+				if (acc[lane] op best) best = acc[lane]; \
+		}							\
+		for (; i < arr->length; i++)				\
+			if (data[i] op best) best = data[i];		\
+		*result = make_value(best);				\
+	} while (0)
+
+#define ARRAY_EXTREMUM_KINDS(op, operation)				\
+	do {								\
+		if (arr->length == 0)					\
+			return "Empty array.";				\
+									\
+		switch (arr->kind) {					\
+		case ARRAY_INT:						\
+			ARRAY_EXTREMUM(array_v4si, array_v4si, int32_t,	\
+				       GET_VALUE_INT, op);		\
+			return NULL;					\
+		case ARRAY_BYTE:					\
+			ARRAY_EXTREMUM(array_v16qu, array_v16qs, uint8_t, \
+				       GET_VALUE_INT, op);		\
+			return NULL;					\
+		case ARRAY_SBYTE:					\
+			ARRAY_EXTREMUM(array_v16qs, array_v16qs, int8_t, \
+				       GET_VALUE_INT, op);		\
+			return NULL;					\
+		case ARRAY_FLOAT:					\
+			ARRAY_EXTREMUM(array_v2df, array_v2di, double,	\
+				       GET_VALUE_FLOAT, op);		\
+			return NULL;					\
+		case ARRAY_VALUE: {					\
+			const struct value *data = ARRAY_DATA(arr, struct value); \
+			const char *error;				\
+			struct value take;				\
+									\
+			*result = data[0];				\
+			for (int i = 1; i < arr->length; i++) {		\
+				take = data[i];				\
+				if ((error = operation(&take, result)) != NULL) \
+					return error;			\
+				if (take.as.bool) *result = data[i];	\
+			}						\
+			return NULL;					\
+		}							\
+		default:						\
+			return "Elements must be numbers.";		\
+		}							\
+	} while (0)
+
+static inline const char *array_min(const struct array *arr,
+				    struct value *result)
+{
+	ARRAY_EXTREMUM_KINDS(<, operation_less);
+}
+
+static inline const char *array_max(const struct array *arr,
+				    struct value *result)
+{
+	ARRAY_EXTREMUM_KINDS(>, operation_greater);
+}
+
+#define ARRAY_DOT_NARROW(vtype, ctype)					\
+	do {								\
+		const ctype *x = ARRAY_DATA(a, ctype);			\
+		const ctype *y = ARRAY_DATA(b, ctype);			\
+		array_v16si acc = {0};					\
+		int32_t dot = 0;					\
+		int i = 0;						\
+									\
+		for (; i + 16 <= a->length; i += 16)			\
+			acc += __builtin_convertvector(			\
+				ARRAY_VECTOR(x, i, vtype), array_v16si)	\
+				* __builtin_convertvector(		\
+					ARRAY_VECTOR(y, i, vtype), array_v16si); \
+		for (int lane = 0; lane < 16; lane++)			\
+			dot += acc[lane];				\
+		for (; i < a->length; i++)				\
+			dot += x[i] * y[i];				\
+		*result = GET_VALUE_INT(dot);				\
+	} while (0)
+
+/* Both arrays are of the same kind. */
+static inline const char *array_dot(const struct array *a,
+				    const struct array *b,
+				    struct value *result)
+{
+	int i = 0;
+
+	if (a->length != b->length)
+		return "Arrays must have the same length.";
+
+	switch (a->kind) {
+	case ARRAY_INT: {
+		const uint32_t *x = ARRAY_DATA(a, uint32_t);
+		const uint32_t *y = ARRAY_DATA(b, uint32_t);
+		array_v4su acc = {0};
+		uint32_t dot;
+
+		for (; i + 4 <= a->length; i += 4)
+			acc += ARRAY_VECTOR(x, i, array_v4su)
+				* ARRAY_VECTOR(y, i, array_v4su);
+		dot = acc[0] + acc[1] + acc[2] + acc[3];
+		for (; i < a->length; i++)
+			dot += x[i] * y[i];
+		*result = GET_VALUE_INT((int32_t)dot);
+		return NULL;
+	}
+	case ARRAY_FLOAT: {
+		const double *x = ARRAY_DATA(a, double);
+		const double *y = ARRAY_DATA(b, double);
+		array_v2df acc0 = {0}, acc1 = {0};
+		double dot;
+
+		for (; i + 4 <= a->length; i += 4) {
+			acc0 += ARRAY_VECTOR(x, i, array_v2df)
+				* ARRAY_VECTOR(y, i, array_v2df);
+			acc1 += ARRAY_VECTOR(x, i + 2, array_v2df)
+				* ARRAY_VECTOR(y, i + 2, array_v2df);
+		}
+		acc0 += acc1;
+		dot = acc0[0] + acc0[1];
+		for (; i < a->length; i++)
+			dot += x[i] * y[i];
+		*result = GET_VALUE_FLOAT(dot);
+		return NULL;
+	}
+	case ARRAY_BYTE:
+		ARRAY_DOT_NARROW(array_v16qu, uint8_t);
+		return NULL;
+	case ARRAY_SBYTE:
+		ARRAY_DOT_NARROW(array_v16qs, int8_t);
+		return NULL;
+	case ARRAY_VALUE: {
+		const struct value *x = ARRAY_DATA(a, struct value);
+		const struct value *y = ARRAY_DATA(b, struct value);
+		const char *error;
+		struct value product;
+
+		*result = GET_VALUE_INT(0);
+		for (; i < a->length; i++) {
+			product = x[i];
+			if ((error = operation_multiply(&product, &y[i])) != NULL
+			    || (error = operation_add(result, &product)) != NULL)
+				return error;
+		}
+		return NULL;
+	}
+	default:
+		return "Elements must be numbers.";
+	}
+}
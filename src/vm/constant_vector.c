@@ -27,6 +27,7 @@
 #include <stdlib.h>
 
 static void constant_vector_grow(struct constant_vector *ca);
+static int constant_equal(const struct value *val1, const struct value *val2);
 
 struct constant_vector *constant_vector_init()
 {
@@ -35,7 +36,7 @@ struct constant_vector *constant_vector_init()
 	ASSERT(ca != NULL, "Unable to allocate memory for constant_vector.");
 
 	ca->count = 0;
-	ca->size = CONSTANT_VECTOR_BUFFER_COUNT * sizeof(double);
+	ca->size = CONSTANT_VECTOR_BUFFER_COUNT * sizeof(struct value);
 	ca->array = malloc(ca->size);
 
 	ASSERT(ca->array != NULL, "Unable to allocate memory for constant_vector.");
@@ -50,14 +51,14 @@ void constant_vector_free(struct constant_vector *ca)
 	ca = NULL;
 }
 
-int constant_vector_add(struct constant_vector *ca, double d)
+int constant_vector_add(struct constant_vector *ca, struct value d)
 {
 	/* No duplicates */
 	for (int i = 0; i < ca->count; i++) {
-		if (ca->array[i] == d) return i;
+		if (constant_equal(&ca->array[i], &d)) return i;
 	}
 		
-	if (ca->count == (ca->size / sizeof(double))) {
+	if (ca->count == (ca->size / sizeof(struct value))) {
 		constant_vector_grow(ca);
 	}
 
@@ -68,8 +69,26 @@ int constant_vector_add(struct constant_vector *ca, double d)
 
 static void constant_vector_grow(struct constant_vector *ca)
 {
-	ca->size += CONSTANT_VECTOR_BUFFER_COUNT * sizeof(double);
+	ca->size += CONSTANT_VECTOR_BUFFER_COUNT * sizeof(struct value);
 	ca->array = realloc(ca->array, ca->size);
 
 	ASSERT(ca->array != NULL, "Unable to grow constant_vector.");
 }
+
+static int constant_equal(const struct value *val1, const struct value *val2)
+{
+	if (val1->type != val2->type) return 0;
+
+	switch (val1->type) {
+	case VALUE_INT: return val1->as.integer == val2->as.integer;
+	case VALUE_FLOAT: return val1->as.float_p == val2->as.float_p;
+	case VALUE_BOOL: return val1->as.bool == val2->as.bool;
+	case VALUE_RECIPE:
+	case VALUE_ARRAY:
+	case VALUE_MAP: return val1->as.structure == val2->as.structure;
+	/* literals are interned, equal ones have the same word */
+	case VALUE_STRING: return val1->as.string == val2->as.string;
+	case VALUE_REF: return val1->as.ref == val2->as.ref;
+	}
+	return 0;
+}
@@ -23,10 +23,12 @@
 
 #pragma once
 
+#include "src/value.h"
+
 #define CONSTANT_VECTOR_BUFFER_COUNT 8
 
 struct constant_vector {
-	double *array;
+	struct value *array;
 	int size;
 	int count;
 };
@@ -34,6 +36,6 @@ struct constant_vector {
 /* Allocates a `constant_vector` and returns its pointer. */
 struct constant_vector *constant_vector_init();
 /* Return the constant's index. */
-int constant_vector_add(struct constant_vector *ca, double value);
+int constant_vector_add(struct constant_vector *ca, struct value value);
 /* Free the array and set `ca` to NULL. */
 void constant_vector_free(struct constant_vector *ca);
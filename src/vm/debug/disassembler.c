@@ -22,44 +22,47 @@
  */
 
 #include "disassembler.h"
+#include "src/vm/operation.h"
+#include "src/vm/match_vector.h"
 
 #include <stdio.h>
 
-static void print_code(struct lump *lmp, int *offset, int *line);
+static void print_code(struct lump *lmp, int *offset);
 static void print_op_constant(struct lump *lmp, int *offset);
 static void print_op_constant_long(struct lump *lmp, int *offset);
+/* Print a code followed by a one or two byte slot. */
+static void print_op_slot(struct lump *lmp, int *offset,
+			  const char *name, int is_long);
+/* Print a jump and the offset it lands on. */
+static void print_op_jump(struct lump *lmp, int *offset, const char *name);
+/* Print a loop's code, its first slot and the offset it lands on. */
+static void print_op_for(struct lump *lmp, int *offset, const char *name);
 
 void disassemble(struct lump *lmp)
 {
-	int cur_line = 0, prev_line = -1;
+	int prev_line = -1;
 	for (int offset = 0; offset < lmp->count; offset++) {
+		int line = lump_line_at(lmp, offset);
+
 		printf("%04d\t", offset);
 
-		if (cur_line == prev_line) {
+		if (line == prev_line) {
 			printf("|\t");
 		} else {
-			printf("%04d\t", cur_line);
-			prev_line = cur_line;
+			printf("%04d\t", line);
+			prev_line = line;
 		}
 
-		print_code(lmp, &offset, &cur_line);
+		print_code(lmp, &offset);
 	}
 }
 
 void disassemble_instruction(struct lump *lmp, int offset)
 {
-	/* TODO, fill up a static table to avoid reading the whole
-	 * code array every function call. */
-	int line = 0;
-	for(int i = 0; i < offset; i++) {
-		if (lmp->array[i] == OP_LINE_INC)
-			line++;
-	}
-
-	print_code(lmp, &offset, &line);
+	print_code(lmp, &offset);
 }
 
-static void print_code(struct lump *lmp, int *offset, int *line)
+static void print_code(struct lump *lmp, int *offset)
 {
 	switch (lmp->array[*offset]) {
 	case OP_GREATER:
@@ -114,6 +117,611 @@ static void print_code(struct lump *lmp, int *offset, int *line)
 		printf("OP_NEGATE\n");
                 break;
 
+	case OP_EQUAL_INT:
+		printf("OP_EQUAL_INT\n");
+		break;
+
+	case OP_EQUAL_FLOAT:
+		printf("OP_EQUAL_FLOAT\n");
+		break;
+
+	case OP_NOT_EQUAL_INT:
+		printf("OP_NOT_EQUAL_INT\n");
+		break;
+
+	case OP_NOT_EQUAL_FLOAT:
+		printf("OP_NOT_EQUAL_FLOAT\n");
+		break;
+
+	case OP_GREATER_INT:
+		printf("OP_GREATER_INT\n");
+		break;
+
+	case OP_GREATER_FLOAT:
+		printf("OP_GREATER_FLOAT\n");
+		break;
+
+	case OP_GREATER_EQUAL_INT:
+		printf("OP_GREATER_EQUAL_INT\n");
+		break;
+
+	case OP_GREATER_EQUAL_FLOAT:
+		printf("OP_GREATER_EQUAL_FLOAT\n");
+		break;
+
+	case OP_LESS_INT:
+		printf("OP_LESS_INT\n");
+		break;
+
+	case OP_LESS_FLOAT:
+		printf("OP_LESS_FLOAT\n");
+		break;
+
+	case OP_LESS_EQUAL_INT:
+		printf("OP_LESS_EQUAL_INT\n");
+		break;
+
+	case OP_LESS_EQUAL_FLOAT:
+		printf("OP_LESS_EQUAL_FLOAT\n");
+		break;
+
+	case OP_ADD_INT:
+		printf("OP_ADD_INT\n");
+		break;
+
+	case OP_ADD_FLOAT:
+		printf("OP_ADD_FLOAT\n");
+		break;
+
+	case OP_SUBSTRACT_INT:
+		printf("OP_SUBSTRACT_INT\n");
+		break;
+
+	case OP_SUBSTRACT_FLOAT:
+		printf("OP_SUBSTRACT_FLOAT\n");
+		break;
+
+	case OP_MULTIPLY_INT:
+		printf("OP_MULTIPLY_INT\n");
+		break;
+
+	case OP_MULTIPLY_FLOAT:
+		printf("OP_MULTIPLY_FLOAT\n");
+		break;
+
+	case OP_MODULO_INT:
+		printf("OP_MODULO_INT\n");
+		break;
+
+	case OP_DIVIDE_INT:
+		printf("OP_DIVIDE_INT\n");
+		break;
+
+	case OP_DIVIDE_FLOAT:
+		printf("OP_DIVIDE_FLOAT\n");
+		break;
+
+	case OP_NEGATE_INT:
+		printf("OP_NEGATE_INT\n");
+		break;
+
+	case OP_NEGATE_FLOAT:
+		printf("OP_NEGATE_FLOAT\n");
+		break;
+
+	case OP_TO_BOOL:
+		printf("OP_TO_BOOL\n");
+		break;
+
+	case OP_TO_FLOAT:
+		printf("%-16s %4d\n", "OP_TO_FLOAT", lmp->array[*offset + 1]);
+		*offset += 1;
+		break;
+
+	case OP_MATH_SQRT:
+		printf("OP_MATH_SQRT\n");
+		break;
+
+	case OP_MATH_POW:
+		printf("OP_MATH_POW\n");
+		break;
+
+	case OP_MATH_REMAINDER:
+		printf("OP_MATH_REMAINDER\n");
+		break;
+
+	case OP_MATH_FLOOR:
+		printf("OP_MATH_FLOOR\n");
+		break;
+
+	case OP_MATH_CEIL:
+		printf("OP_MATH_CEIL\n");
+		break;
+
+	case OP_MATH_SIN:
+		printf("OP_MATH_SIN\n");
+		break;
+
+	case OP_MATH_COS:
+		printf("OP_MATH_COS\n");
+		break;
+
+	case OP_MATH_EXP:
+		printf("OP_MATH_EXP\n");
+		break;
+
+	case OP_MATH_LOG:
+		printf("OP_MATH_LOG\n");
+		break;
+
+	case OP_ARRAY_MATH:
+		printf("%-16s %4d\n", "OP_ARRAY_MATH", lmp->array[*offset + 1]);
+		*offset += 1;
+		break;
+
+	case OP_GREATER_INT_Q:
+		printf("OP_GREATER_INT_Q\n");
+		break;
+
+	case OP_GREATER_FLOAT_Q:
+		printf("OP_GREATER_FLOAT_Q\n");
+		break;
+
+	case OP_GREATER_EQUAL_INT_Q:
+		printf("OP_GREATER_EQUAL_INT_Q\n");
+		break;
+
+	case OP_GREATER_EQUAL_FLOAT_Q:
+		printf("OP_GREATER_EQUAL_FLOAT_Q\n");
+		break;
+
+	case OP_LESS_INT_Q:
+		printf("OP_LESS_INT_Q\n");
+		break;
+
+	case OP_LESS_FLOAT_Q:
+		printf("OP_LESS_FLOAT_Q\n");
+		break;
+
+	case OP_LESS_EQUAL_INT_Q:
+		printf("OP_LESS_EQUAL_INT_Q\n");
+		break;
+
+	case OP_LESS_EQUAL_FLOAT_Q:
+		printf("OP_LESS_EQUAL_FLOAT_Q\n");
+		break;
+
+	case OP_ADD_INT_Q:
+		printf("OP_ADD_INT_Q\n");
+		break;
+
+	case OP_ADD_FLOAT_Q:
+		printf("OP_ADD_FLOAT_Q\n");
+		break;
+
+	case OP_SUBSTRACT_INT_Q:
+		printf("OP_SUBSTRACT_INT_Q\n");
+		break;
+
+	case OP_SUBSTRACT_FLOAT_Q:
+		printf("OP_SUBSTRACT_FLOAT_Q\n");
+		break;
+
+	case OP_MULTIPLY_INT_Q:
+		printf("OP_MULTIPLY_INT_Q\n");
+		break;
+
+	case OP_MULTIPLY_FLOAT_Q:
+		printf("OP_MULTIPLY_FLOAT_Q\n");
+		break;
+
+	/* The next byte is the distance of the value from the stack's top. */
+	case OP_INT_TO_FLOAT:
+		printf("%-16s %4d\n", "OP_INT_TO_FLOAT", lmp->array[*offset + 1]);
+		*offset += 1;
+		break;
+
+	case OP_POP:
+		printf("OP_POP\n");
+		break;
+
+	/* The next two bytes are the jump's distance. */
+	case OP_JUMP:
+		print_op_jump(lmp, offset, "OP_JUMP");
+		break;
+
+	case OP_JUMP_IF_FALSE:
+		print_op_jump(lmp, offset, "OP_JUMP_IF_FALSE");
+		break;
+
+	case OP_JUMP_IF_TRUE:
+		print_op_jump(lmp, offset, "OP_JUMP_IF_TRUE");
+		break;
+
+	case OP_JUMP_IF_FALSE_OR_POP:
+		print_op_jump(lmp, offset, "OP_JUMP_IF_FALSE_OR_POP");
+		break;
+
+	case OP_JUMP_IF_TRUE_OR_POP:
+		print_op_jump(lmp, offset, "OP_JUMP_IF_TRUE_OR_POP");
+		break;
+
+	case OP_JUMP_IF_EQUAL_INT:
+		print_op_jump(lmp, offset, "OP_JUMP_IF_EQUAL_INT");
+		break;
+
+	case OP_JUMP_IF_NOT_EQUAL_INT:
+		print_op_jump(lmp, offset, "OP_JUMP_IF_NOT_EQUAL_INT");
+		break;
+
+	case OP_JUMP_IF_GREATER_INT:
+		print_op_jump(lmp, offset, "OP_JUMP_IF_GREATER_INT");
+		break;
+
+	case OP_JUMP_IF_GREATER_EQUAL_INT:
+		print_op_jump(lmp, offset, "OP_JUMP_IF_GREATER_EQUAL_INT");
+		break;
+
+	case OP_JUMP_IF_LESS_INT:
+		print_op_jump(lmp, offset, "OP_JUMP_IF_LESS_INT");
+		break;
+
+	case OP_JUMP_IF_LESS_EQUAL_INT:
+		print_op_jump(lmp, offset, "OP_JUMP_IF_LESS_EQUAL_INT");
+		break;
+
+	case OP_LOOP:
+		print_op_jump(lmp, offset, "OP_LOOP");
+		break;
+
+	/* The next four bytes are the minimum, the next two the count,
+	 * then the entries and the default's distance. */
+	case OP_JUMP_TABLE: {
+		int count = LUMP_JUMP_TABLE_COUNT(lmp, *offset);
+
+		printf("%-16s %4d %4d ->", "OP_JUMP_TABLE",
+		       LUMP_JUMP_TABLE_MIN(lmp, *offset), count);
+		for (int i = 0; i <= count; i++)
+			printf(" %04d", lump_jump_table_target(lmp, *offset, i));
+		printf("\n");
+		*offset = LUMP_JUMP_TABLE_END(lmp, *offset) - 1;
+		break;
+	}
+
+	/* The next two bytes are the match's index. */
+	case OP_MATCH: {
+		int index = lmp->array[*offset + 1] << 8 | lmp->array[*offset + 2];
+		struct match *match = &lmp->matches->array[index];
+
+		printf("%-16s %4d ->", "OP_MATCH", index);
+		for (int i = 0; i < match->count; i++)
+			printf(" %04d", match->targets[i]);
+		printf(" else %04d\n", match->otherwise);
+		*offset += 2;
+		break;
+	}
+
+	/* The next two bytes are the first slot, the next two the
+	 * distance. */
+	case OP_FOR_RANGE_PREP:
+		print_op_for(lmp, offset, "OP_FOR_RANGE_PREP");
+		break;
+
+	case OP_FOR_RANGE_STEP:
+		print_op_for(lmp, offset, "OP_FOR_RANGE_STEP");
+		break;
+
+	case OP_FOR_ARRAY_PREP:
+		print_op_for(lmp, offset, "OP_FOR_ARRAY_PREP");
+		break;
+
+	case OP_FOR_ARRAY_STEP:
+		print_op_for(lmp, offset, "OP_FOR_ARRAY_STEP");
+		break;
+
+	case OP_FOR_MAP_PREP:
+		print_op_for(lmp, offset, "OP_FOR_MAP_PREP");
+		break;
+
+	case OP_FOR_MAP_STEP:
+		print_op_for(lmp, offset, "OP_FOR_MAP_STEP");
+		break;
+
+	/* The next two bytes are the called function's index. */
+	case OP_CALL:
+		print_op_slot(lmp, offset, "OP_CALL", 1);
+		break;
+
+	case OP_TAIL_CALL:
+		print_op_slot(lmp, offset, "OP_TAIL_CALL", 1);
+		break;
+
+	case OP_RETURN_VOID:
+		printf("OP_RETURN_VOID\n");
+		break;
+
+	/* The next two bytes are the instance's size, or the field's
+	 * offset. */
+	case OP_NEW_RECIPE:
+		print_op_slot(lmp, offset, "OP_NEW_RECIPE", 1);
+		break;
+
+	/* The instance's offset in the frame and its size, in blocks. */
+	case OP_NEW_RECIPE_FRAME:
+		printf("%-16s %4d %4d\n", "OP_NEW_RECIPE_FRAME",
+		       lmp->array[*offset + 1], lmp->array[*offset + 2]);
+		*offset += 2;
+		break;
+
+	case OP_GET_FIELD_INT:
+		print_op_slot(lmp, offset, "OP_GET_FIELD_INT", 1);
+		break;
+
+	case OP_GET_FIELD_BYTE:
+		print_op_slot(lmp, offset, "OP_GET_FIELD_BYTE", 1);
+		break;
+
+	case OP_GET_FIELD_SBYTE:
+		print_op_slot(lmp, offset, "OP_GET_FIELD_SBYTE", 1);
+		break;
+
+	case OP_GET_FIELD_FLOAT:
+		print_op_slot(lmp, offset, "OP_GET_FIELD_FLOAT", 1);
+		break;
+
+	case OP_GET_FIELD_BOOL:
+		print_op_slot(lmp, offset, "OP_GET_FIELD_BOOL", 1);
+		break;
+
+	case OP_SET_FIELD_INT:
+		print_op_slot(lmp, offset, "OP_SET_FIELD_INT", 1);
+		break;
+
+	case OP_SET_FIELD_BYTE:
+		print_op_slot(lmp, offset, "OP_SET_FIELD_BYTE", 1);
+		break;
+
+	case OP_SET_FIELD_SBYTE:
+		print_op_slot(lmp, offset, "OP_SET_FIELD_SBYTE", 1);
+		break;
+
+	case OP_SET_FIELD_FLOAT:
+		print_op_slot(lmp, offset, "OP_SET_FIELD_FLOAT", 1);
+		break;
+
+	case OP_SET_FIELD_BOOL:
+		print_op_slot(lmp, offset, "OP_SET_FIELD_BOOL", 1);
+		break;
+
+	/* The next byte is the elements' kind. */
+	case OP_NEW_ARRAY:
+		print_op_slot(lmp, offset, "OP_NEW_ARRAY", 0);
+		break;
+
+	/* The next byte is the elements' kind, the next two their count. */
+	case OP_ARRAY_LITERAL:
+		printf("%-16s %4d %04d\n", "OP_ARRAY_LITERAL", lmp->array[*offset + 1],
+		       lmp->array[*offset + 2] << 8 | lmp->array[*offset + 3]);
+		*offset += 3;
+		break;
+
+	case OP_GET_INDEX_INT:
+		printf("OP_GET_INDEX_INT\n");
+		break;
+
+	case OP_GET_INDEX_BYTE:
+		printf("OP_GET_INDEX_BYTE\n");
+		break;
+
+	case OP_GET_INDEX_SBYTE:
+		printf("OP_GET_INDEX_SBYTE\n");
+		break;
+
+	case OP_GET_INDEX_FLOAT:
+		printf("OP_GET_INDEX_FLOAT\n");
+		break;
+
+	case OP_GET_INDEX_BOOL:
+		printf("OP_GET_INDEX_BOOL\n");
+		break;
+
+	case OP_GET_INDEX_VALUE:
+		printf("OP_GET_INDEX_VALUE\n");
+		break;
+
+	case OP_SET_INDEX_INT:
+		printf("OP_SET_INDEX_INT\n");
+		break;
+
+	case OP_SET_INDEX_BYTE:
+		printf("OP_SET_INDEX_BYTE\n");
+		break;
+
+	case OP_SET_INDEX_SBYTE:
+		printf("OP_SET_INDEX_SBYTE\n");
+		break;
+
+	case OP_SET_INDEX_FLOAT:
+		printf("OP_SET_INDEX_FLOAT\n");
+		break;
+
+	case OP_SET_INDEX_BOOL:
+		printf("OP_SET_INDEX_BOOL\n");
+		break;
+
+	case OP_SET_INDEX_VALUE:
+		printf("OP_SET_INDEX_VALUE\n");
+		break;
+
+	/* The next two bytes are the slot of the index. */
+	case OP_GET_INDEX_INT_UNCHECKED:
+		print_op_slot(lmp, offset, "OP_GET_INDEX_INT_UNCHECKED", 1);
+		break;
+
+	case OP_GET_INDEX_BYTE_UNCHECKED:
+		print_op_slot(lmp, offset, "OP_GET_INDEX_BYTE_UNCHECKED", 1);
+		break;
+
+	case OP_GET_INDEX_SBYTE_UNCHECKED:
+		print_op_slot(lmp, offset, "OP_GET_INDEX_SBYTE_UNCHECKED", 1);
+		break;
+
+	case OP_GET_INDEX_FLOAT_UNCHECKED:
+		print_op_slot(lmp, offset, "OP_GET_INDEX_FLOAT_UNCHECKED", 1);
+		break;
+
+	case OP_GET_INDEX_BOOL_UNCHECKED:
+		print_op_slot(lmp, offset, "OP_GET_INDEX_BOOL_UNCHECKED", 1);
+		break;
+
+	case OP_GET_INDEX_VALUE_UNCHECKED:
+		print_op_slot(lmp, offset, "OP_GET_INDEX_VALUE_UNCHECKED", 1);
+		break;
+
+	case OP_SET_INDEX_INT_UNCHECKED:
+		print_op_slot(lmp, offset, "OP_SET_INDEX_INT_UNCHECKED", 1);
+		break;
+
+	case OP_SET_INDEX_BYTE_UNCHECKED:
+		print_op_slot(lmp, offset, "OP_SET_INDEX_BYTE_UNCHECKED", 1);
+		break;
+
+	case OP_SET_INDEX_SBYTE_UNCHECKED:
+		print_op_slot(lmp, offset, "OP_SET_INDEX_SBYTE_UNCHECKED", 1);
+		break;
+
+	case OP_SET_INDEX_FLOAT_UNCHECKED:
+		print_op_slot(lmp, offset, "OP_SET_INDEX_FLOAT_UNCHECKED", 1);
+		break;
+
+	case OP_SET_INDEX_BOOL_UNCHECKED:
+		print_op_slot(lmp, offset, "OP_SET_INDEX_BOOL_UNCHECKED", 1);
+		break;
+
+	case OP_SET_INDEX_VALUE_UNCHECKED:
+		print_op_slot(lmp, offset, "OP_SET_INDEX_VALUE_UNCHECKED", 1);
+		break;
+
+	case OP_ARRAY_LENGTH:
+		printf("OP_ARRAY_LENGTH\n");
+		break;
+
+	case OP_ARRAY_FILL:
+		printf("OP_ARRAY_FILL\n");
+		break;
+
+	case OP_ARRAY_COPY:
+		printf("OP_ARRAY_COPY\n");
+		break;
+
+	case OP_ARRAY_SLICE:
+		printf("OP_ARRAY_SLICE\n");
+		break;
+
+	case OP_ARRAY_SUM:
+		printf("OP_ARRAY_SUM\n");
+		break;
+
+	case OP_ARRAY_MIN:
+		printf("OP_ARRAY_MIN\n");
+		break;
+
+	case OP_ARRAY_MAX:
+		printf("OP_ARRAY_MAX\n");
+		break;
+
+	case OP_ARRAY_DOT:
+		printf("OP_ARRAY_DOT\n");
+		break;
+
+	/* The next two bytes are the count of keys. */
+	case OP_MAP_LITERAL:
+		print_op_slot(lmp, offset, "OP_MAP_LITERAL", 1);
+		break;
+
+	case OP_GET_KEY:
+		printf("OP_GET_KEY\n");
+		break;
+
+	case OP_SET_KEY:
+		printf("OP_SET_KEY\n");
+		break;
+
+	case OP_MAP_LENGTH:
+		printf("OP_MAP_LENGTH\n");
+		break;
+
+	case OP_MAP_HAS:
+		printf("OP_MAP_HAS\n");
+		break;
+
+	case OP_CONCAT:
+		print_op_slot(lmp, offset, "OP_CONCAT", 1);
+		break;
+
+	case OP_PRINT:
+		print_op_slot(lmp, offset, "OP_PRINT", 0);
+		break;
+
+	case OP_PRINT_FORMAT:
+		printf("%-16s %4d %04d\n", "OP_PRINT_FORMAT", lmp->array[*offset + 1],
+		       lmp->array[*offset + 2] << 8 | lmp->array[*offset + 3]);
+		*offset += 3;
+		break;
+
+	case OP_FORMAT:
+		print_op_slot(lmp, offset, "OP_FORMAT", 1);
+		break;
+
+	/* The next byte, or two bytes for _LONG codes, is the slot. */
+	case OP_GET_GLOBAL:
+		print_op_slot(lmp, offset, "OP_GET_GLOBAL", 0);
+		break;
+
+	case OP_GET_GLOBAL_LONG:
+		print_op_slot(lmp, offset, "OP_GET_GLOBAL_LONG", 1);
+		break;
+
+	case OP_SET_GLOBAL:
+		print_op_slot(lmp, offset, "OP_SET_GLOBAL", 0);
+		break;
+
+	case OP_SET_GLOBAL_LONG:
+		print_op_slot(lmp, offset, "OP_SET_GLOBAL_LONG", 1);
+		break;
+
+	case OP_GET_LOCAL:
+		print_op_slot(lmp, offset, "OP_GET_LOCAL", 0);
+		break;
+
+	case OP_GET_LOCAL_LONG:
+		print_op_slot(lmp, offset, "OP_GET_LOCAL_LONG", 1);
+		break;
+
+	case OP_SET_LOCAL:
+		print_op_slot(lmp, offset, "OP_SET_LOCAL", 0);
+		break;
+
+	case OP_SET_LOCAL_LONG:
+		print_op_slot(lmp, offset, "OP_SET_LOCAL_LONG", 1);
+		break;
+
+	case OP_REF_LOCAL:
+		print_op_slot(lmp, offset, "OP_REF_LOCAL", 1);
+		break;
+
+	case OP_REF_GLOBAL:
+		print_op_slot(lmp, offset, "OP_REF_GLOBAL", 1);
+		break;
+
+	case OP_GET_REF:
+		print_op_slot(lmp, offset, "OP_GET_REF", 1);
+		break;
+
+	case OP_SET_REF:
+		print_op_slot(lmp, offset, "OP_SET_REF", 1);
+		break;
+
 	/* The next byte is the constant's address. */
 	case OP_CONSTANT:
 		print_op_constant(lmp, offset);
@@ -130,9 +738,8 @@ static void print_code(struct lump *lmp, int *offset, int *line)
 		printf("OP_RETURN\n");
 		break;
 
-	case OP_LINE_INC:
-		printf("OP_LINE_INC\n");
-		(*line)++;
+	case OP_END_PROGRAM:
+		printf("OP_END_PROGRAM\n");
 		break;
 
 	default:
@@ -144,10 +751,8 @@ static void print_op_constant(struct lump *lmp, int *offset)
 {
 	int const_offset = lmp->array[*offset + 1];
 
-	printf("%-16s %04d %g\n", \
-	       "OP_CONSTANT",
-	       const_offset,
-	       lmp->constants->array[const_offset]);
+	printf("%-16s %04d ", "OP_CONSTANT", const_offset);
+	operation_print(&lmp->constants->array[const_offset]);
 }
 
 static void print_op_constant_long(struct lump *lmp, int *offset)
@@ -156,8 +761,36 @@ static void print_op_constant_long(struct lump *lmp, int *offset)
 	uint8_t byte2 = lmp->array[*offset + 2];
 	int const_offset = byte1 << 8 | byte2;
 
-	printf("%-16s %04d %g\n", \
-	       "OP_CONSTANT_LONG",
-	       const_offset,
-	       lmp->constants->array[const_offset]);
+	printf("%-16s %04d ", "OP_CONSTANT_LONG", const_offset);
+	operation_print(&lmp->constants->array[const_offset]);
+}
+
+static void print_op_slot(struct lump *lmp, int *offset,
+			  const char *name, int is_long)
+{
+	int slot = lmp->array[*offset + 1];
+
+	if (is_long)
+		slot = slot << 8 | lmp->array[*offset + 2];
+
+	printf("%-16s %04d\n", name, slot);
+	*offset += is_long ? 2 : 1;
+}
+
+static void print_op_jump(struct lump *lmp, int *offset, const char *name)
+{
+	int distance = lmp->array[*offset + 1] << 8 | lmp->array[*offset + 2];
+
+	printf("%-16s %04d -> %04d\n", name, distance,
+	       lump_jump_target(lmp, *offset));
+	*offset += 2;
+}
+
+static void print_op_for(struct lump *lmp, int *offset, const char *name)
+{
+	int slot = lmp->array[*offset + 1] << 8 | lmp->array[*offset + 2];
+
+	printf("%-16s %04d -> %04d\n", name, slot,
+	       lump_jump_target(lmp, *offset));
+	*offset += 4;
 }
@@ -0,0 +1,1223 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "emit_c.h"
+#include "vm.h"
+#include "str.h"
+#include "match_vector.h"
+
+#include "src/macros.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Every function becomes a C function taking its first slot and the
+ * stack's top, and returning the stack's top after its return, or NULL
+ * after a runtime error. */
+static void emit_prologue(struct lump *lmp, FILE *out);
+static void emit_epilogue(FILE *out);
+static void emit_function(struct lump *lmp, int index,
+			  const uint8_t *targets, FILE *out);
+/* Emit the codes from `start` to `end`, skipping function bodies. The
+ * codes belong to the function at `function`, or to the top level when
+ * it is -1. */
+static void emit_codes(struct lump *lmp, int start, int end, int function,
+		       const uint8_t *targets, FILE *out);
+/* Emit the C statements for the instruction at `offset`.
+ * Return the offset of the next instruction. */
+static int emit_instruction(struct lump *lmp, int offset, int function,
+			    FILE *out);
+static void emit_call(struct lump *lmp, int offset, FILE *out);
+/* Declare the C array holding a function's frame instances. */
+static void emit_instances(FILE *out, int frame_size);
+/* Emit the access to a field stored as `ctype`, converted from or to
+ * a value by `make_value` or its union `member`. */
+static void emit_get_field(struct lump *lmp, int offset, const char *ctype,
+			   const char *make_value, FILE *out);
+static void emit_set_field(struct lump *lmp, int offset, const char *ctype,
+			   const char *member, FILE *out);
+static void emit_tail_call(struct lump *lmp, int offset, int function,
+			   FILE *out);
+/* Emit the access to an array element stored as `ctype`, converted
+ * to a value by `make_value` or from the value's `element`. */
+static void emit_get_index(FILE *out, const char *ctype,
+			   const char *make_value);
+static void emit_set_index(FILE *out, const char *ctype, const char *element);
+/* Emit an unchecked index code, indexing by the slot following it. */
+static void emit_get_index_unchecked(struct lump *lmp, int offset,
+				     const char *ctype, const char *make_value,
+				     FILE *out);
+static void emit_set_index_unchecked(struct lump *lmp, int offset,
+				     const char *ctype, const char *element,
+				     FILE *out);
+/* Emit a call to a runtime function returning an error, such as the
+ * kernels of array.h. */
+static void emit_array_kernel(FILE *out, const char *call);
+/* Emit a loop's code, jumping when `condition` holds on its slots. */
+static void emit_for(struct lump *lmp, int offset, const char *condition,
+		     FILE *out);
+/* Emit a jump table as a C switch, leaving out the entries which land
+ * on its default. */
+static void emit_jump_table(struct lump *lmp, int offset, FILE *out);
+/* Emit a jump taken when the two ints on top compare so. */
+static void emit_jump_if_int(struct lump *lmp, int offset, FILE *out);
+/* Emit a match over ints as a C switch, over strings as a switch on
+ * their hash. */
+static void emit_match(const struct match *match, FILE *out);
+/* Return a table flagging the offsets jumps land on, which get a
+ * label. */
+static uint8_t *find_jump_targets(struct lump *lmp);
+static int read_jump(struct lump *lmp, int offset);
+static void emit_unary(FILE *out, const char *operation);
+static void emit_binary(FILE *out, const char *operation);
+static void emit_constant(struct lump *lmp, FILE *out, int const_offset);
+/* Emit the bytes of a string as a C string literal. */
+static void emit_string_literal(FILE *out, const char *chars, int length);
+/* Emit the parsed format `fmt` as the static `format_<index>`. */
+static void emit_format(FILE *out, const struct format *fmt, int index);
+/* Emit running format `index` on its arguments into `text`. */
+static void emit_format_run(FILE *out, int index, int argc);
+/* Return the one or two byte slot following the code at `offset`. */
+static int read_slot(struct lump *lmp, int offset, int is_long);
+/* Emit an operation on two values whose type is known, `member` being
+ * the union member they are read from. */
+static void emit_typed(FILE *out, const char *member, const char *op,
+		       int is_comparison);
+/* Emit the wrapping `operation` on the two ints on top. */
+static void emit_int(FILE *out, const char *operation);
+/* Emit a call of the libm `function` on the floats on top. */
+static void emit_math(FILE *out, const char *function, int arity);
+
+void emit_c(struct lump *lmp, FILE *out)
+{
+	uint8_t *targets = find_jump_targets(lmp);
+
+	emit_prologue(lmp, out);
+	emit_codes(lmp, 0, lmp->count, -1, targets, out);
+	emit_epilogue(out);
+
+	for (int i = 0; i < lmp->functions->count; i++)
+		emit_function(lmp, i, targets, out);
+
+	free(targets);
+}
+
+static void emit_prologue(struct lump *lmp, FILE *out)
+{
+	fprintf(out,
+		"/* Generated by avalanche --emit-c. */\n"
+		"#include \"src/value.h\"\n"
+		"#include \"src/vm/operation.h\"\n"
+		"#include \"src/vm/object.h\"\n"
+		"#include \"src/vm/array.h\"\n"
+		"#include \"src/vm/str.h\"\n"
+		"#include \"src/vm/format.h\"\n"
+		"#include \"src/vm/output.h\"\n"
+		"#include \"src/vm/iterator.h\"\n"
+		"#include \"src/vm/map.h\"\n"
+		"#include \"src/vm/match.h\"\n"
+		"\n"
+		"#include <math.h>\n"
+		"#include <stdio.h>\n"
+		"#include <string.h>\n"
+		"#include <sysexits.h>\n"
+		"\n"
+		"static struct value stack[%d];\n"
+		"static struct value globals[%d] __attribute__((unused));\n"
+		"static int frame_count __attribute__((unused));\n"
+		"static struct heap heap __attribute__((unused));\n"
+		"static const char *error __attribute__((unused));\n"
+		"static int line __attribute__((unused));\n"
+		"static struct format_buffer text __attribute__((unused));\n"
+		"static struct output out;\n"
+		"static struct output err;\n"
+		"\n"
+		"static void flush_output(void)\n"
+		"{\n"
+		"\toutput_flush(&out);\n"
+		"\toutput_flush(&err);\n"
+		"}\n"
+		"\n",
+		VM_STACK_SIZE,
+		lmp->global_count > 0 ? lmp->global_count : 1);
+
+	for (int i = 0; i < lmp->functions->count; i++)
+		fprintf(out,
+			"static struct value *function_%d(struct value *slots,"
+			" struct value *stack_top);\n", i);
+
+	/* Heap strings among the constants are made once, before the
+	 * program runs. They were interned by the compiler, no two have
+	 * the same bytes. */
+	struct constant_vector *constants = lmp->constants;
+	for (int i = 0; i < constants->count; i++) {
+		if (constants->array[i].type == VALUE_STRING
+		    && !STRING_IS_SHORT(&constants->array[i]))
+			fprintf(out, "static struct value constant_%d;\n", i);
+	}
+
+	for (int i = 0; i < lmp->formats->count; i++)
+		emit_format(out, &lmp->formats->array[i], i);
+
+	fprintf(out,
+		"\n"
+		"int main(void)\n"
+		"{\n"
+		"\tstruct value *slots __attribute__((unused)) = stack;\n"
+		"\tstruct value *stack_top = stack;\n"
+		"\n"
+		"\toutput_init(&out, STDOUT_FILENO);\n"
+		"\toutput_init(&err, STDERR_FILENO);\n"
+		"\tatexit(flush_output);\n"
+		"\n");
+	emit_instances(out, lmp->frame_size);
+
+	for (int i = 0; i < constants->count; i++) {
+		struct value *val = &constants->array[i];
+
+		if (val->type != VALUE_STRING || STRING_IS_SHORT(val))
+			continue;
+		fprintf(out, "\tif ((error = string_new(");
+		emit_string_literal(out, STRING_OBJECT(val)->chars,
+				    STRING_OBJECT(val)->length);
+		fprintf(out,
+			", %d, NULL, &constant_%d)) != NULL)\n"
+			"\t\tgoto runtime_error;\n"
+			"\tSTRING_OBJECT(&constant_%d)->is_interned = 1;\n",
+			STRING_OBJECT(val)->length, i, i);
+	}
+	fprintf(out, "\n");
+}
+
+static void emit_epilogue(FILE *out)
+{
+	fprintf(out,
+		"\treturn 0;\n"
+		"\n"
+		"runtime_error: __attribute__((unused));\n"
+		"\tflush_output();\n"
+		"\tfprintf(stderr, \"[line %%d] runtime error: %%s\\n\", line, error);\n"
+		"\treturn EX_SOFTWARE;\n"
+		"}\n");
+}
+
+static void emit_function(struct lump *lmp, int index,
+			  const uint8_t *targets, FILE *out)
+{
+	struct function *fn = &lmp->functions->array[index];
+
+	fprintf(out,
+		"\n"
+		"static struct value *function_%d(struct value *slots,"
+		" struct value *stack_top)\n"
+		"{\n"
+		"entry: __attribute__((unused));\n",
+		index);
+	emit_instances(out, fn->frame_size);
+	emit_codes(lmp, fn->offset, fn->end, index, targets, out);
+	fprintf(out,
+		"\n"
+		"runtime_error: __attribute__((unused));\n"
+		"\treturn NULL;\n"
+		"}\n");
+}
+
+static void emit_codes(struct lump *lmp, int start, int end, int function,
+		       const uint8_t *targets, FILE *out)
+{
+	struct function_vector *fa = lmp->functions;
+	/* The line set last, -1 where it is unknown: after a label, whose
+	 * jumps come from other lines, and after a call, which sets the
+	 * callee's lines. */
+	int next = 0, line = -1;
+
+	while (next < fa->count && fa->array[next].offset <= start)
+		next++;
+
+	for (int offset = start; offset < end;) {
+		if (next < fa->count && offset == fa->array[next].offset) {
+			offset = fa->array[next++].end;
+			line = -1;
+			continue;
+		}
+
+		if (targets[offset]) {
+			fprintf(out, "op_%04d:;\n", offset);
+			line = -1;
+		}
+		if (lump_line_at(lmp, offset) != line) {
+			line = lump_line_at(lmp, offset);
+			fprintf(out, "\tline = %d;\n", line);
+		}
+		if (lmp->array[offset] == OP_CALL) line = -1;
+		offset = emit_instruction(lmp, offset, function, out);
+	}
+
+	/* Only the top level jumps past a function's last code. */
+	if (function == -1 && targets[end])
+		fprintf(out, "op_%04d:;\n", end);
+}
+
+static int emit_instruction(struct lump *lmp, int offset, int function,
+			    FILE *out)
+{
+	switch (lmp->array[offset]) {
+	case OP_RETURN:
+		if (function == -1)
+			fprintf(out,
+				"\ttext.length = 0;\n"
+				"\tif ((error = format_append_value(&text, &stack_top[-1]))"
+				" != NULL\n"
+				"\t    || (error = format_append(&text, \"\\n\", 1)) != NULL\n"
+				"\t    || (error = output_write(&out, text.chars,"
+				" text.length)) != NULL)\n"
+				"\t\tgoto runtime_error;\n"
+				"\treturn 0;\n");
+		else
+			fprintf(out,
+				"\tslots[0] = stack_top[-1];\n"
+				"\treturn slots + 1;\n");
+		return offset + 1;
+	case OP_RETURN_VOID:
+		fprintf(out, function == -1 ? "\treturn 0;\n" : "\treturn slots;\n");
+		return offset + 1;
+	case OP_END_PROGRAM:
+		fprintf(out, "\treturn 0;\n");
+		return offset + 1;
+	case OP_JUMP:
+		fprintf(out, "\tgoto op_%04d;\n", read_jump(lmp, offset));
+		return offset + 3;
+	case OP_JUMP_IF_FALSE:
+		fprintf(out,
+			"\tif (!(--stack_top)->as.bool)\n"
+			"\t\tgoto op_%04d;\n",
+			read_jump(lmp, offset));
+		return offset + 3;
+	case OP_JUMP_IF_TRUE:
+		fprintf(out,
+			"\tif ((--stack_top)->as.bool)\n"
+			"\t\tgoto op_%04d;\n",
+			read_jump(lmp, offset));
+		return offset + 3;
+	case OP_JUMP_IF_FALSE_OR_POP:
+	case OP_JUMP_IF_TRUE_OR_POP:
+		fprintf(out,
+			"\tif (%sstack_top[-1].as.bool)\n"
+			"\t\tgoto op_%04d;\n"
+			"\tstack_top--;\n",
+			lmp->array[offset] == OP_JUMP_IF_FALSE_OR_POP ? "!" : "",
+			read_jump(lmp, offset));
+		return offset + 3;
+	case OP_JUMP_IF_EQUAL_INT:
+	case OP_JUMP_IF_NOT_EQUAL_INT:
+	case OP_JUMP_IF_GREATER_INT:
+	case OP_JUMP_IF_GREATER_EQUAL_INT:
+	case OP_JUMP_IF_LESS_INT:
+	case OP_JUMP_IF_LESS_EQUAL_INT:
+		emit_jump_if_int(lmp, offset, out);
+		return offset + 3;
+	case OP_LOOP:
+		fprintf(out, "\tgoto op_%04d;\n", read_jump(lmp, offset));
+		return offset + 3;
+	case OP_JUMP_TABLE:
+		emit_jump_table(lmp, offset, out);
+		return LUMP_JUMP_TABLE_END(lmp, offset);
+	case OP_MATCH:
+		emit_match(&lmp->matches->array[read_slot(lmp, offset, 1)], out);
+		return offset + 3;
+	case OP_FOR_RANGE_PREP:
+		fprintf(out,
+			"\tif ((error = iterator_range_check(&slots[%d])) != NULL)\n"
+			"\t\tgoto runtime_error;\n",
+			read_slot(lmp, offset, 1));
+		emit_for(lmp, offset, "!iterator_range_first", out);
+		return offset + 5;
+	case OP_FOR_RANGE_STEP:
+		emit_for(lmp, offset, "iterator_range_next", out);
+		return offset + 5;
+	case OP_FOR_ARRAY_PREP:
+		emit_for(lmp, offset, "!iterator_array_first", out);
+		return offset + 5;
+	case OP_FOR_ARRAY_STEP:
+		emit_for(lmp, offset, "iterator_array_next", out);
+		return offset + 5;
+	case OP_FOR_MAP_PREP:
+		emit_for(lmp, offset, "!iterator_map_first", out);
+		return offset + 5;
+	case OP_FOR_MAP_STEP:
+		emit_for(lmp, offset, "iterator_map_next", out);
+		return offset + 5;
+	case OP_CALL:
+		emit_call(lmp, offset, out);
+		return offset + 3;
+	case OP_TAIL_CALL:
+		emit_tail_call(lmp, offset, function, out);
+		return offset + 3;
+	case OP_NEW_RECIPE:
+		fprintf(out,
+			"\tstack_top->as.structure = object_new_recipe(%d, &heap);\n"
+			"\tif ((stack_top++)->as.structure == NULL) {\n"
+			"\t\terror = \"Out of memory.\";\n"
+			"\t\tgoto runtime_error;\n"
+			"\t}\n"
+			"\tstack_top[-1].type = VALUE_RECIPE;\n",
+			read_slot(lmp, offset, 1));
+		return offset + 3;
+	case OP_NEW_RECIPE_FRAME:
+		fprintf(out,
+			"\tstack_top->as.structure ="
+			" object_frame_recipe(instances + %d, %d);\n"
+			"\t(stack_top++)->type = VALUE_RECIPE;\n",
+			lmp->array[offset + 1] * HEAP_ALIGN,
+			lmp->array[offset + 2]);
+		return offset + 3;
+	case OP_GET_FIELD_INT:
+		emit_get_field(lmp, offset, "int32_t", "GET_VALUE_INT", out);
+		return offset + 3;
+	case OP_GET_FIELD_BYTE:
+		emit_get_field(lmp, offset, "uint8_t", "GET_VALUE_INT", out);
+		return offset + 3;
+	case OP_GET_FIELD_SBYTE:
+		emit_get_field(lmp, offset, "int8_t", "GET_VALUE_INT", out);
+		return offset + 3;
+	case OP_GET_FIELD_FLOAT:
+		emit_get_field(lmp, offset, "double", "GET_VALUE_FLOAT", out);
+		return offset + 3;
+	case OP_GET_FIELD_BOOL:
+		emit_get_field(lmp, offset, "uint8_t", "GET_VALUE_BOOL", out);
+		return offset + 3;
+	case OP_SET_FIELD_INT:
+		emit_set_field(lmp, offset, "int32_t", "integer", out);
+		return offset + 3;
+	case OP_SET_FIELD_BYTE:
+		emit_set_field(lmp, offset, "uint8_t", "integer", out);
+		return offset + 3;
+	case OP_SET_FIELD_SBYTE:
+		emit_set_field(lmp, offset, "int8_t", "integer", out);
+		return offset + 3;
+	case OP_SET_FIELD_FLOAT:
+		emit_set_field(lmp, offset, "double", "float_p", out);
+		return offset + 3;
+	case OP_SET_FIELD_BOOL:
+		emit_set_field(lmp, offset, "uint8_t", "bool", out);
+		return offset + 3;
+	case OP_NEW_ARRAY:
+		fprintf(out,
+			"\tif (stack_top[-1].as.integer < 0) {\n"
+			"\t\terror = \"Negative array length.\";\n"
+			"\t\tgoto runtime_error;\n"
+			"\t}\n"
+			"\tstack_top[-1].as.structure = object_new_array(%d,"
+			" stack_top[-1].as.integer, &heap);\n"
+			"\tif (stack_top[-1].as.structure == NULL) {\n"
+			"\t\terror = \"Out of memory.\";\n"
+			"\t\tgoto runtime_error;\n"
+			"\t}\n"
+			"\tstack_top[-1].type = VALUE_ARRAY;\n",
+			lmp->array[offset + 1]);
+		return offset + 2;
+	case OP_ARRAY_LITERAL: {
+		int count = lmp->array[offset + 2] << 8 | lmp->array[offset + 3];
+		fprintf(out,
+			"\t{\n"
+			"\t\tstruct array *arr = object_new_array(%d, %d, &heap);\n"
+			"\t\tif (arr == NULL) {\n"
+			"\t\t\terror = \"Out of memory.\";\n"
+			"\t\t\tgoto runtime_error;\n"
+			"\t\t}\n"
+			"\t\tstack_top -= %d;\n"
+			"\t\tfor (int i = 0; i < %d; i++)\n"
+			"\t\t\tarray_set(arr, i, &stack_top[i]);\n"
+			"\t\t*stack_top++ = GET_VALUE_ARRAY(arr);\n"
+			"\t}\n",
+			lmp->array[offset + 1], count, count, count);
+		return offset + 4;
+	}
+	case OP_GET_INDEX_INT:
+		emit_get_index(out, "int32_t", "GET_VALUE_INT");
+		return offset + 1;
+	case OP_GET_INDEX_BYTE:
+		emit_get_index(out, "uint8_t", "GET_VALUE_INT");
+		return offset + 1;
+	case OP_GET_INDEX_SBYTE:
+		emit_get_index(out, "int8_t", "GET_VALUE_INT");
+		return offset + 1;
+	case OP_GET_INDEX_FLOAT:
+		emit_get_index(out, "double", "GET_VALUE_FLOAT");
+		return offset + 1;
+	case OP_GET_INDEX_BOOL:
+		emit_get_index(out, "uint8_t", "GET_VALUE_BOOL");
+		return offset + 1;
+	case OP_GET_INDEX_VALUE:
+		emit_get_index(out, "struct value", "");
+		return offset + 1;
+	case OP_SET_INDEX_INT:
+		emit_set_index(out, "int32_t", "stack_top[-1].as.integer");
+		return offset + 1;
+	case OP_SET_INDEX_BYTE:
+		emit_set_index(out, "uint8_t", "stack_top[-1].as.integer");
+		return offset + 1;
+	case OP_SET_INDEX_SBYTE:
+		emit_set_index(out, "int8_t", "stack_top[-1].as.integer");
+		return offset + 1;
+	case OP_SET_INDEX_FLOAT:
+		emit_set_index(out, "double", "stack_top[-1].as.float_p");
+		return offset + 1;
+	case OP_SET_INDEX_BOOL:
+		emit_set_index(out, "uint8_t", "stack_top[-1].as.bool");
+		return offset + 1;
+	case OP_SET_INDEX_VALUE:
+		emit_set_index(out, "struct value", "stack_top[-1]");
+		return offset + 1;
+	case OP_GET_INDEX_INT_UNCHECKED:
+		emit_get_index_unchecked(lmp, offset, "int32_t", "GET_VALUE_INT", out);
+		return offset + 3;
+	case OP_GET_INDEX_BYTE_UNCHECKED:
+		emit_get_index_unchecked(lmp, offset, "uint8_t", "GET_VALUE_INT", out);
+		return offset + 3;
+	case OP_GET_INDEX_SBYTE_UNCHECKED:
+		emit_get_index_unchecked(lmp, offset, "int8_t", "GET_VALUE_INT", out);
+		return offset + 3;
+	case OP_GET_INDEX_FLOAT_UNCHECKED:
+		emit_get_index_unchecked(lmp, offset, "double", "GET_VALUE_FLOAT", out);
+		return offset + 3;
+	case OP_GET_INDEX_BOOL_UNCHECKED:
+		emit_get_index_unchecked(lmp, offset, "uint8_t", "GET_VALUE_BOOL", out);
+		return offset + 3;
+	case OP_GET_INDEX_VALUE_UNCHECKED:
+		emit_get_index_unchecked(lmp, offset, "struct value", "", out);
+		return offset + 3;
+	case OP_SET_INDEX_INT_UNCHECKED:
+		emit_set_index_unchecked(lmp, offset, "int32_t", "stack_top[-1].as.integer", out);
+		return offset + 3;
+	case OP_SET_INDEX_BYTE_UNCHECKED:
+		emit_set_index_unchecked(lmp, offset, "uint8_t", "stack_top[-1].as.integer", out);
+		return offset + 3;
+	case OP_SET_INDEX_SBYTE_UNCHECKED:
+		emit_set_index_unchecked(lmp, offset, "int8_t", "stack_top[-1].as.integer", out);
+		return offset + 3;
+	case OP_SET_INDEX_FLOAT_UNCHECKED:
+		emit_set_index_unchecked(lmp, offset, "double", "stack_top[-1].as.float_p", out);
+		return offset + 3;
+	case OP_SET_INDEX_BOOL_UNCHECKED:
+		emit_set_index_unchecked(lmp, offset, "uint8_t", "stack_top[-1].as.bool", out);
+		return offset + 3;
+	case OP_SET_INDEX_VALUE_UNCHECKED:
+		emit_set_index_unchecked(lmp, offset, "struct value", "stack_top[-1]", out);
+		return offset + 3;
+	case OP_ARRAY_LENGTH:
+		fprintf(out,
+			"\tstack_top[-1] = GET_VALUE_INT(((struct array *)"
+			"stack_top[-1].as.structure)->length);\n");
+		return offset + 1;
+	case OP_ARRAY_FILL:
+		fprintf(out,
+			"\tarray_fill(stack_top[-2].as.structure, &stack_top[-1]);\n"
+			"\tstack_top -= 2;\n");
+		return offset + 1;
+	case OP_ARRAY_COPY:
+		fprintf(out,
+			"\tarray_copy(stack_top[-2].as.structure,"
+			" stack_top[-1].as.structure);\n"
+			"\tstack_top -= 2;\n");
+		return offset + 1;
+	case OP_ARRAY_SLICE:
+		emit_array_kernel(out, "array_slice(stack_top[-3].as.structure,"
+				  " stack_top[-2].as.integer, stack_top[-1].as.integer,"
+				  " &heap, &stack_top[-3])");
+		fprintf(out, "\tstack_top -= 2;\n");
+		return offset + 1;
+	case OP_ARRAY_SUM:
+		emit_array_kernel(out, "array_sum(stack_top[-1].as.structure,"
+				  " &stack_top[-1])");
+		return offset + 1;
+	case OP_ARRAY_MIN:
+		emit_array_kernel(out, "array_min(stack_top[-1].as.structure,"
+				  " &stack_top[-1])");
+		return offset + 1;
+	case OP_ARRAY_MAX:
+		emit_array_kernel(out, "array_max(stack_top[-1].as.structure,"
+				  " &stack_top[-1])");
+		return offset + 1;
+	case OP_ARRAY_DOT:
+		emit_array_kernel(out, "array_dot(stack_top[-2].as.structure,"
+				  " stack_top[-1].as.structure, &stack_top[-2])");
+		fprintf(out, "\tstack_top--;\n");
+		return offset + 1;
+	case OP_MAP_LITERAL: {
+		int count = lmp->array[offset + 1] << 8 | lmp->array[offset + 2];
+		fprintf(out,
+			"\tstack_top -= %d;\n"
+			"\tif ((error = map_literal(stack_top, %d, &heap,"
+			" stack_top)) != NULL)\n"
+			"\t\tgoto runtime_error;\n"
+			"\tstack_top++;\n",
+			count * 2, count);
+		return offset + 3;
+	}
+	case OP_GET_KEY:
+		emit_array_kernel(out, "map_get(stack_top[-2].as.structure,"
+				  " &stack_top[-1], &stack_top[-2])");
+		fprintf(out, "\tstack_top--;\n");
+		return offset + 1;
+	case OP_SET_KEY:
+		emit_array_kernel(out, "map_set(stack_top[-3].as.structure,"
+				  " &stack_top[-2], &stack_top[-1], &heap)");
+		fprintf(out, "\tstack_top -= 3;\n");
+		return offset + 1;
+	case OP_MAP_LENGTH:
+		fprintf(out,
+			"\tstack_top[-1] = GET_VALUE_INT(((struct map *)"
+			"stack_top[-1].as.structure)->count);\n");
+		return offset + 1;
+	case OP_MAP_HAS:
+		emit_array_kernel(out, "map_has(stack_top[-2].as.structure,"
+				  " &stack_top[-1], &stack_top[-2])");
+		fprintf(out, "\tstack_top--;\n");
+		return offset + 1;
+	case OP_CONCAT: {
+		int count = lmp->array[offset + 1] << 8 | lmp->array[offset + 2];
+		fprintf(out,
+			"\tif ((error = string_concat(stack_top - %d, %d, &heap))"
+			" != NULL)\n"
+			"\t\tgoto runtime_error;\n"
+			"\tstack_top -= %d;\n",
+			count, count, count - 1);
+		return offset + 3;
+	}
+	case OP_PRINT:
+		fprintf(out,
+			"\ttext.length = 0;\n"
+			"\tif ((error = format_append_value(&text, &stack_top[-1]))"
+			" != NULL)\n"
+			"\t\tgoto runtime_error;\n"
+			"\tif ((error = output_write(%s, text.chars, text.length))"
+			" != NULL)\n"
+			"\t\tgoto runtime_error;\n"
+			"\tstack_top--;\n",
+			lmp->array[offset + 1] ? "&err" : "&out");
+		return offset + 2;
+	case OP_PRINT_FORMAT: {
+		int index = lmp->array[offset + 2] << 8 | lmp->array[offset + 3];
+		int argc = lmp->formats->array[index].argc;
+		emit_format_run(out, index, argc);
+		fprintf(out,
+			"\tif ((error = output_write(%s, text.chars, text.length))"
+			" != NULL)\n"
+			"\t\tgoto runtime_error;\n"
+			"\tstack_top -= %d;\n",
+			lmp->array[offset + 1] ? "&err" : "&out", argc);
+		return offset + 4;
+	}
+	case OP_FORMAT: {
+		int index = read_slot(lmp, offset, 1);
+		int argc = lmp->formats->array[index].argc;
+		emit_format_run(out, index, argc);
+		fprintf(out,
+			"\tif ((error = string_new(text.chars, text.length,"
+			" &heap, stack_top - %d)) != NULL)\n"
+			"\t\tgoto runtime_error;\n"
+			"\tstack_top -= %d;\n",
+			argc, argc - 1);
+		return offset + 3;
+	}
+	case OP_CONSTANT:
+		emit_constant(lmp, out, lmp->array[offset + 1]);
+		return offset + 2;
+	case OP_CONSTANT_LONG:
+		emit_constant(lmp, out,
+			      lmp->array[offset + 1] << 8 | lmp->array[offset + 2]);
+		return offset + 3;
+	case OP_POP:
+		fprintf(out, "\tstack_top--;\n");
+		return offset + 1;
+	case OP_GET_GLOBAL:
+	case OP_GET_GLOBAL_LONG: {
+		int is_long = lmp->array[offset] == OP_GET_GLOBAL_LONG;
+		fprintf(out, "\t*stack_top++ = globals[%d];\n",
+			read_slot(lmp, offset, is_long));
+		return offset + 2 + is_long;
+	}
+	case OP_SET_GLOBAL:
+	case OP_SET_GLOBAL_LONG: {
+		int is_long = lmp->array[offset] == OP_SET_GLOBAL_LONG;
+		fprintf(out, "\tglobals[%d] = *--stack_top;\n",
+			read_slot(lmp, offset, is_long));
+		return offset + 2 + is_long;
+	}
+	case OP_GET_LOCAL:
+	case OP_GET_LOCAL_LONG: {
+		int is_long = lmp->array[offset] == OP_GET_LOCAL_LONG;
+		fprintf(out, "\t*stack_top++ = slots[%d];\n",
+			read_slot(lmp, offset, is_long));
+		return offset + 2 + is_long;
+	}
+	case OP_SET_LOCAL:
+	case OP_SET_LOCAL_LONG: {
+		int is_long = lmp->array[offset] == OP_SET_LOCAL_LONG;
+		fprintf(out, "\tslots[%d] = *--stack_top;\n",
+			read_slot(lmp, offset, is_long));
+		return offset + 2 + is_long;
+	}
+	case OP_REF_LOCAL:
+		fprintf(out, "\t*stack_top++ = GET_VALUE_REF(&slots[%d]);\n",
+			read_slot(lmp, offset, 1));
+		return offset + 3;
+	case OP_REF_GLOBAL:
+		fprintf(out, "\t*stack_top++ = GET_VALUE_REF(&globals[%d]);\n",
+			read_slot(lmp, offset, 1));
+		return offset + 3;
+	case OP_GET_REF:
+		fprintf(out, "\t*stack_top++ = *slots[%d].as.ref;\n",
+			read_slot(lmp, offset, 1));
+		return offset + 3;
+	case OP_SET_REF:
+		fprintf(out, "\t*slots[%d].as.ref = *--stack_top;\n",
+			read_slot(lmp, offset, 1));
+		return offset + 3;
+	case OP_EQUAL: emit_binary(out, "operation_equal"); break;
+	case OP_NOT_EQUAL: emit_binary(out, "operation_not_equal"); break;
+	case OP_GREATER: emit_binary(out, "operation_greater"); break;
+	case OP_GREATER_EQUAL: emit_binary(out, "operation_greater_equal"); break;
+	case OP_LESS: emit_binary(out, "operation_less"); break;
+	case OP_LESS_EQUAL: emit_binary(out, "operation_less_equal"); break;
+	/* strings the compiler could not type are appended */
+	case OP_ADD:
+		fprintf(out,
+			"\tif (stack_top[-2].type == VALUE_STRING"
+			" && stack_top[-1].type == VALUE_STRING)\n"
+			"\t\terror = string_concat(&stack_top[-2], 2, &heap);\n"
+			"\telse\n"
+			"\t\terror = operation_add(&stack_top[-2], &stack_top[-1]);\n"
+			"\tif (error != NULL)\n"
+			"\t\tgoto runtime_error;\n"
+			"\tstack_top--;\n");
+		break;
+	case OP_SUBSTRACT: emit_binary(out, "operation_substract"); break;
+	case OP_MULTIPLY: emit_binary(out, "operation_multiply"); break;
+	case OP_MODULO: emit_binary(out, "operation_modulo"); break;
+	case OP_DIVIDE: emit_binary(out, "operation_divide"); break;
+	case OP_LOGICAL_NOT: emit_unary(out, "operation_logical_not"); break;
+	case OP_TO_BOOL: emit_unary(out, "operation_to_bool"); break;
+	case OP_NEGATE: emit_unary(out, "operation_negate"); break;
+	case OP_EQUAL_INT: emit_typed(out, "integer", "==", 1); break;
+	case OP_EQUAL_FLOAT: emit_typed(out, "float_p", "==", 1); break;
+	case OP_NOT_EQUAL_INT: emit_typed(out, "integer", "!=", 1); break;
+	case OP_NOT_EQUAL_FLOAT: emit_typed(out, "float_p", "!=", 1); break;
+	case OP_GREATER_INT: emit_typed(out, "integer", ">", 1); break;
+	case OP_GREATER_FLOAT: emit_typed(out, "float_p", ">", 1); break;
+	case OP_GREATER_EQUAL_INT: emit_typed(out, "integer", ">=", 1); break;
+	case OP_GREATER_EQUAL_FLOAT: emit_typed(out, "float_p", ">=", 1); break;
+	case OP_LESS_INT: emit_typed(out, "integer", "<", 1); break;
+	case OP_LESS_FLOAT: emit_typed(out, "float_p", "<", 1); break;
+	case OP_LESS_EQUAL_INT: emit_typed(out, "integer", "<=", 1); break;
+	case OP_LESS_EQUAL_FLOAT: emit_typed(out, "float_p", "<=", 1); break;
+	case OP_ADD_INT: emit_int(out, "operation_int_add"); break;
+	case OP_ADD_FLOAT: emit_typed(out, "float_p", "+", 0); break;
+	case OP_SUBSTRACT_INT: emit_int(out, "operation_int_substract"); break;
+	case OP_SUBSTRACT_FLOAT: emit_typed(out, "float_p", "-", 0); break;
+	case OP_MULTIPLY_INT: emit_int(out, "operation_int_multiply"); break;
+	case OP_MULTIPLY_FLOAT: emit_typed(out, "float_p", "*", 0); break;
+	case OP_DIVIDE_FLOAT: emit_typed(out, "float_p", "/", 0); break;
+	case OP_DIVIDE_INT:
+	case OP_MODULO_INT:
+		fprintf(out,
+			"\tif (stack_top[-1].as.integer == 0) {\n"
+			"\t\terror = \"Integer %s by zero.\";\n"
+			"\t\tgoto runtime_error;\n"
+			"\t}\n",
+			lmp->array[offset] == OP_DIVIDE_INT ? "division" : "modulo");
+		emit_int(out, lmp->array[offset] == OP_DIVIDE_INT
+			 ? "operation_int_divide" : "operation_int_modulo");
+		break;
+	case OP_NEGATE_INT:
+		fprintf(out,
+			"\tstack_top[-1].as.integer ="
+			" operation_int_negate(stack_top[-1].as.integer);\n");
+		break;
+	case OP_NEGATE_FLOAT:
+		fprintf(out, "\tstack_top[-1].as.float_p = -stack_top[-1].as.float_p;\n");
+		break;
+	case OP_INT_TO_FLOAT:
+		fprintf(out,
+			"\tstack_top[%d] = GET_VALUE_FLOAT(stack_top[%d].as.integer);\n",
+			-1 - lmp->array[offset + 1], -1 - lmp->array[offset + 1]);
+		return offset + 2;
+	case OP_TO_FLOAT:
+		fprintf(out,
+			"\tif ((error = operation_to_float(&stack_top[%d])) != NULL)\n"
+			"\t\tgoto runtime_error;\n",
+			-1 - lmp->array[offset + 1]);
+		return offset + 2;
+	case OP_MATH_SQRT: emit_math(out, "sqrt", 1); break;
+	case OP_MATH_POW: emit_math(out, "pow", 2); break;
+	case OP_MATH_REMAINDER: emit_math(out, "remainder", 2); break;
+	case OP_MATH_FLOOR: emit_math(out, "floor", 1); break;
+	case OP_MATH_CEIL: emit_math(out, "ceil", 1); break;
+	case OP_MATH_SIN: emit_math(out, "sin", 1); break;
+	case OP_MATH_COS: emit_math(out, "cos", 1); break;
+	case OP_MATH_EXP: emit_math(out, "exp", 1); break;
+	case OP_MATH_LOG: emit_math(out, "log", 1); break;
+	case OP_ARRAY_MATH: {
+		char call[128];
+
+		snprintf(call, sizeof(call), "array_math(stack_top[-1].as.structure,"
+			 " %d, &heap, &stack_top[-1])", lmp->array[offset + 1]);
+		emit_array_kernel(out, call);
+		return offset + 2;
+	}
+	default:
+		fprintf(stderr, "Cannot emit C for opcode %d.\n",
+			lmp->array[offset]);
+		fprintf(out, "#error \"unsupported opcode %d\"\n",
+			lmp->array[offset]);
+	}
+
+	return offset + 1;
+}
+
+static void emit_unary(FILE *out, const char *operation)
+{
+	fprintf(out,
+		"\tif ((error = %s(&stack_top[-1])) != NULL)\n"
+		"\t\tgoto runtime_error;\n",
+		operation);
+}
+
+static void emit_binary(FILE *out, const char *operation)
+{
+	fprintf(out,
+		"\tif ((error = %s(&stack_top[-2], &stack_top[-1])) != NULL)\n"
+		"\t\tgoto runtime_error;\n"
+		"\tstack_top--;\n",
+		operation);
+}
+
+static void emit_typed(FILE *out, const char *member, const char *op,
+		       int is_comparison)
+{
+	if (is_comparison)
+		fprintf(out,
+			"\tstack_top[-2] = GET_VALUE_BOOL(stack_top[-2].as.%s"
+			" %s stack_top[-1].as.%s);\n",
+			member, op, member);
+	else
+		fprintf(out,
+			"\tstack_top[-2].as.%s = stack_top[-2].as.%s"
+			" %s stack_top[-1].as.%s;\n",
+			member, member, op, member);
+	fprintf(out, "\tstack_top--;\n");
+}
+
+static void emit_int(FILE *out, const char *operation)
+{
+	fprintf(out,
+		"\tstack_top[-2].as.integer = %s(stack_top[-2].as.integer,"
+		" stack_top[-1].as.integer);\n"
+		"\tstack_top--;\n",
+		operation);
+}
+
+static void emit_math(FILE *out, const char *function, int arity)
+{
+	if (arity == 1) {
+		fprintf(out,
+			"\tstack_top[-1].as.float_p = %s(stack_top[-1].as.float_p);\n",
+			function);
+		return;
+	}
+	fprintf(out,
+		"\tstack_top[-2].as.float_p = %s(stack_top[-2].as.float_p,"
+		" stack_top[-1].as.float_p);\n"
+		"\tstack_top--;\n",
+		function);
+}
+
+static void emit_constant(struct lump *lmp, FILE *out, int const_offset)
+{
+	struct value *val = &lmp->constants->array[const_offset];
+
+	switch (val->type) {
+	case VALUE_INT:
+		fprintf(out, "\t*stack_top++ = GET_VALUE_INT(%d);\n",
+			val->as.integer);
+		break;
+	case VALUE_FLOAT:
+		/* %a round-trips the double exactly, but has no literal for
+		 * infinities and NaN. */
+		if (isnan(val->as.float_p))
+			fprintf(out, "\t*stack_top++ = GET_VALUE_FLOAT(NAN);\n");
+		else if (isinf(val->as.float_p))
+			fprintf(out, "\t*stack_top++ = GET_VALUE_FLOAT(%sINFINITY);\n",
+				val->as.float_p < 0 ? "-" : "");
+		else
+			fprintf(out, "\t*stack_top++ = GET_VALUE_FLOAT(%a);\n",
+				val->as.float_p);
+		break;
+	case VALUE_BOOL:
+		fprintf(out, "\t*stack_top++ = GET_VALUE_BOOL(%d);\n",
+			val->as.bool);
+		break;
+	/* short strings are their word, heap ones made by the prologue */
+	case VALUE_STRING:
+		if (STRING_IS_SHORT(val))
+			fprintf(out, "\t*stack_top++ = GET_VALUE_STRING(%#llxu);\n",
+				(unsigned long long)val->as.string);
+		else
+			fprintf(out, "\t*stack_top++ = constant_%d;\n",
+				const_offset);
+		break;
+	case VALUE_RECIPE:	/* never constants */
+	case VALUE_ARRAY:
+	case VALUE_MAP:
+	case VALUE_REF:
+		break;
+	}
+}
+
+static void emit_string_literal(FILE *out, const char *chars, int length)
+{
+	fputc('"', out);
+	for (int i = 0; i < length; i++) {
+		uint8_t c = chars[i];
+
+		/* octal escapes take at most three digits, so the next
+		 * character cannot extend them */
+		if (c == '"' || c == '\\' || c == '?')
+			fprintf(out, "\\%c", c);
+		else if (c < ' ' || c > '~')
+			fprintf(out, "\\%03o", c);
+		else
+			fputc(c, out);
+	}
+	fputc('"', out);
+}
+
+static void emit_format(FILE *out, const struct format *fmt, int index)
+{
+	fprintf(out, "static const struct format_segment format_%d_segments[] = {\n",
+		index);
+	for (int i = 0; i < fmt->count; i++) {
+		fprintf(out, "\t{%d, %d, ", fmt->segments[i].conversion,
+			fmt->segments[i].length);
+		emit_string_literal(out, fmt->segments[i].text,
+				    fmt->segments[i].length);
+		fprintf(out, "},\n");
+	}
+	fprintf(out,
+		"\t{0},\n"
+		"};\n"
+		"static const struct format format_%d = {format_%d_segments, %d, %d};\n",
+		index, index, fmt->count, fmt->argc);
+}
+
+static void emit_format_run(FILE *out, int index, int argc)
+{
+	fprintf(out,
+		"\ttext.length = 0;\n"
+		"\tif ((error = format_run(&format_%d, stack_top - %d, &text))"
+		" != NULL)\n"
+		"\t\tgoto runtime_error;\n",
+		index, argc);
+}
+
+static int read_slot(struct lump *lmp, int offset, int is_long)
+{
+	if (is_long)
+		return lmp->array[offset + 1] << 8 | lmp->array[offset + 2];
+	return lmp->array[offset + 1];
+}
+
+static void emit_call(struct lump *lmp, int offset, FILE *out)
+{
+	int index = read_slot(lmp, offset, 1);
+	struct function *fn = &lmp->functions->array[index];
+
+	fprintf(out,
+		"\tif (frame_count == %d\n"
+		"\t    || stack_top - %d + %d > stack + %d) {\n"
+		"\t\terror = \"Stack overflow.\";\n"
+		"\t\tgoto runtime_error;\n"
+		"\t}\n"
+		"\tframe_count++;\n"
+		"\tstack_top = function_%d(stack_top - %d, stack_top);\n"
+		"\tframe_count--;\n"
+		"\tif (stack_top == NULL)\n"
+		"\t\tgoto runtime_error;\n",
+		VM_FRAME_MAX, fn->arity, fn->max_stack, VM_STACK_SIZE,
+		index, fn->arity);
+}
+
+static void emit_instances(FILE *out, int frame_size)
+{
+	if (frame_size > 0)
+		fprintf(out, "\t_Alignas(%d) uint8_t instances[%d];\n\n",
+			HEAP_ALIGN, frame_size);
+}
+
+static void emit_get_field(struct lump *lmp, int offset, const char *ctype,
+			   const char *make_value, FILE *out)
+{
+	fprintf(out,
+		"\tstack_top[-1] = %s(RECIPE_FIELD(stack_top[-1].as.structure,"
+		" %d, %s));\n",
+		make_value, read_slot(lmp, offset, 1), ctype);
+}
+
+static void emit_set_field(struct lump *lmp, int offset, const char *ctype,
+			   const char *member, FILE *out)
+{
+	fprintf(out,
+		"\tRECIPE_FIELD(stack_top[-2].as.structure, %d, %s)"
+		" = stack_top[-1].as.%s;\n"
+		"\tstack_top -= 2;\n",
+		read_slot(lmp, offset, 1), ctype, member);
+}
+
+static void emit_get_index(FILE *out, const char *ctype,
+			   const char *make_value)
+{
+	emit_array_kernel(out, "array_check_index(stack_top[-2].as.structure,"
+			  " stack_top[-1].as.integer)");
+	fprintf(out,
+		"\tstack_top[-2] = %s(ARRAY_DATA((struct array *)"
+		"stack_top[-2].as.structure, %s)[stack_top[-1].as.integer]);\n"
+		"\tstack_top--;\n",
+		make_value, ctype);
+}
+
+static void emit_set_index(FILE *out, const char *ctype, const char *element)
+{
+	emit_array_kernel(out, "array_check_index(stack_top[-3].as.structure,"
+			  " stack_top[-2].as.integer)");
+	fprintf(out,
+		"\tARRAY_DATA((struct array *)stack_top[-3].as.structure,"
+		" %s)[stack_top[-2].as.integer] = %s;\n"
+		"\tstack_top -= 3;\n",
+		ctype, element);
+}
+
+static void emit_get_index_unchecked(struct lump *lmp, int offset,
+				     const char *ctype, const char *make_value,
+				     FILE *out)
+{
+	fprintf(out,
+		"\tstack_top[-1] = %s(ARRAY_DATA((struct array *)"
+		"stack_top[-1].as.structure, %s)[slots[%d].as.integer]);\n",
+		make_value, ctype, read_slot(lmp, offset, 1));
+}
+
+static void emit_set_index_unchecked(struct lump *lmp, int offset,
+				     const char *ctype, const char *element,
+				     FILE *out)
+{
+	fprintf(out,
+		"\tARRAY_DATA((struct array *)stack_top[-2].as.structure,"
+		" %s)[slots[%d].as.integer] = %s;\n"
+		"\tstack_top -= 2;\n",
+		ctype, read_slot(lmp, offset, 1), element);
+}
+
+static void emit_array_kernel(FILE *out, const char *call)
+{
+	fprintf(out,
+		"\tif ((error = %s) != NULL)\n"
+		"\t\tgoto runtime_error;\n",
+		call);
+}
+
+static void emit_for(struct lump *lmp, int offset, const char *condition,
+		     FILE *out)
+{
+	fprintf(out,
+		"\tif (%s(&slots[%d]))\n"
+		"\t\tgoto op_%04d;\n",
+		condition, read_slot(lmp, offset, 1), read_jump(lmp, offset));
+}
+
+static void emit_jump_table(struct lump *lmp, int offset, FILE *out)
+{
+	int32_t min = LUMP_JUMP_TABLE_MIN(lmp, offset);
+	int count = LUMP_JUMP_TABLE_COUNT(lmp, offset);
+	int otherwise = lump_jump_table_target(lmp, offset, count);
+
+	fprintf(out, "\tswitch ((--stack_top)->as.integer) {\n");
+	for (int i = 0; i < count; i++) {
+		int target = lump_jump_table_target(lmp, offset, i);
+		if (target != otherwise)
+			fprintf(out, "\tcase %lld: goto op_%04d;\n",
+				(long long)min + i, target);
+	}
+	fprintf(out,
+		"\tdefault: goto op_%04d;\n"
+		"\t}\n",
+		otherwise);
+}
+
+static void emit_jump_if_int(struct lump *lmp, int offset, FILE *out)
+{
+	const char *op = "==";
+
+	switch (lmp->array[offset]) {
+	case OP_JUMP_IF_NOT_EQUAL_INT: op = "!="; break;
+	case OP_JUMP_IF_GREATER_INT: op = ">"; break;
+	case OP_JUMP_IF_GREATER_EQUAL_INT: op = ">="; break;
+	case OP_JUMP_IF_LESS_INT: op = "<"; break;
+	case OP_JUMP_IF_LESS_EQUAL_INT: op = "<="; break;
+	}
+	fprintf(out,
+		"\tstack_top -= 2;\n"
+		"\tif (stack_top[0].as.integer %s stack_top[1].as.integer)\n"
+		"\t\tgoto op_%04d;\n",
+		op, read_jump(lmp, offset));
+}
+
+static void emit_match(const struct match *match, FILE *out)
+{
+	if (match->count > 0 && match->keys[0].type == VALUE_INT) {
+		fprintf(out, "\tswitch ((--stack_top)->as.integer) {\n");
+		for (int i = 0; i < match->count; i++)
+			fprintf(out, "\tcase %d: goto op_%04d;\n",
+				match->keys[i].as.integer, match->targets[i]);
+		fprintf(out,
+			"\tdefault: goto op_%04d;\n"
+			"\t}\n",
+			match->otherwise);
+		return;
+	}
+
+	fprintf(out,
+		"\t{\n"
+		"\tuint32_t hash;\n"
+		"\tif ((error = map_hash(--stack_top, &hash)) != NULL)\n"
+		"\t\tgoto runtime_error;\n"
+		"\tswitch (hash) {\n");
+	for (int i = 0; i < match->count; i++) {
+		const struct value *key = &match->keys[i];
+		int is_first = 1;
+
+		/* keys of the same hash share their case */
+		for (int j = 0; j < i; j++)
+			is_first &= match->hashes[j] != match->hashes[i];
+		if (!is_first) continue;
+
+		fprintf(out, "\tcase %#xu:\n", match->hashes[i]);
+		for (int j = i; j < match->count; j++) {
+			key = &match->keys[j];
+			if (match->hashes[j] != match->hashes[i])
+				continue;
+			if (STRING_IS_SHORT(key)) {
+				fprintf(out, "\t\tif (stack_top->as.string == %#llxu)\n",
+					(unsigned long long)key->as.string);
+			} else {
+				fprintf(out, "\t\tif (match_string_is(stack_top, ");
+				emit_string_literal(out, STRING_OBJECT(key)->chars,
+						    STRING_OBJECT(key)->length);
+				fprintf(out, ", %d))\n", STRING_OBJECT(key)->length);
+			}
+			fprintf(out, "\t\t\tgoto op_%04d;\n", match->targets[j]);
+		}
+		fprintf(out, "\t\tbreak;\n");
+	}
+	fprintf(out,
+		"\t}\n"
+		"\t}\n"
+		"\tgoto op_%04d;\n",
+		match->otherwise);
+}
+
+static void emit_tail_call(struct lump *lmp, int offset, int function,
+			   FILE *out)
+{
+	int index = read_slot(lmp, offset, 1);
+	struct function *fn = &lmp->functions->array[index];
+
+	fprintf(out,
+		"\tmemmove(slots, stack_top - %d, %d * sizeof(struct value));\n"
+		"\tstack_top = slots + %d;\n"
+		"\tif (slots + %d > stack + %d) {\n"
+		"\t\terror = \"Stack overflow.\";\n"
+		"\t\tgoto runtime_error;\n"
+		"\t}\n",
+		fn->arity, fn->arity, fn->arity, fn->max_stack, VM_STACK_SIZE);
+
+	/* The C compiler is left to turn other tail calls into jumps. */
+	if (index == function)
+		fprintf(out, "\tgoto entry;\n");
+	else
+		fprintf(out, "\treturn function_%d(slots, stack_top);\n", index);
+}
+
+static uint8_t *find_jump_targets(struct lump *lmp)
+{
+	uint8_t *targets = calloc(lmp->count + 1, sizeof(uint8_t));
+
+	ASSERT(targets != NULL, "Unable to allocate the jump targets.");
+
+	for (int offset = 0; offset < lmp->count;) {
+		switch (lmp->array[offset]) {
+		case OP_JUMP:
+		case OP_JUMP_IF_FALSE:
+		case OP_JUMP_IF_TRUE:
+		case OP_JUMP_IF_FALSE_OR_POP:
+		case OP_JUMP_IF_TRUE_OR_POP:
+		case OP_JUMP_IF_EQUAL_INT:
+		case OP_JUMP_IF_NOT_EQUAL_INT:
+		case OP_JUMP_IF_GREATER_INT:
+		case OP_JUMP_IF_GREATER_EQUAL_INT:
+		case OP_JUMP_IF_LESS_INT:
+		case OP_JUMP_IF_LESS_EQUAL_INT:
+		case OP_LOOP:
+		case OP_FOR_RANGE_PREP:
+		case OP_FOR_RANGE_STEP:
+		case OP_FOR_ARRAY_PREP:
+		case OP_FOR_ARRAY_STEP:
+		case OP_FOR_MAP_PREP:
+		case OP_FOR_MAP_STEP:
+			targets[read_jump(lmp, offset)] = 1;
+			break;
+		case OP_JUMP_TABLE:
+			for (int i = 0; i <= LUMP_JUMP_TABLE_COUNT(lmp, offset); i++)
+				targets[lump_jump_table_target(lmp, offset, i)] = 1;
+			break;
+		case OP_MATCH: {
+			struct match *match =
+				&lmp->matches->array[read_slot(lmp, offset, 1)];
+
+			for (int i = 0; i < match->count; i++)
+				targets[match->targets[i]] = 1;
+			targets[match->otherwise] = 1;
+			break;
+		}
+		}
+		offset = lump_next_code(lmp, offset);
+	}
+
+	return targets;
+}
+
+static int read_jump(struct lump *lmp, int offset)
+{
+	return lump_jump_target(lmp, offset);
+}
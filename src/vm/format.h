@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "object.h"
+#include "str.h"
+#include "src/value.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Formats are parsed by the compiler into segments: literal text, and
+ * conversions each taking the next argument. Running one only converts
+ * the arguments, into a growable text buffer.
+ *
+ * Shared by the VM and the C emitted by `emit_c()`.
+ */
+
+enum format_conversion {
+	FORMAT_TEXT,		/* literal bytes */
+	FORMAT_INT,		/* %d %i %c */
+	FORMAT_UINT,		/* %u %o %x %X */
+	FORMAT_FLOAT,		/* %f %F %e %E %g %G %a */
+	FORMAT_STRING,		/* %s */
+	FORMAT_VALUE		/* %v, any value as the VM prints it */
+};
+
+/* The bytes of a FORMAT_TEXT, or the C conversion spec a conversion
+ * passes to snprintf(), such as "%5.2f". */
+struct format_segment {
+	uint8_t conversion;
+	int length;
+	const char *text;
+};
+
+struct format {
+	const struct format_segment *segments;
+	int count;
+	/* number of conversions */
+	int argc;
+};
+
+struct format_buffer {
+	char *chars;
+	int length;
+	int size;
+};
+
+/* Make room for `length` more bytes. Return 0 when out of memory. */
+static inline int format_reserve(struct format_buffer *buffer, int length)
+{
+	char *chars;
+	int size = buffer->size ? buffer->size : 256;
+
+	if (buffer->length + length <= buffer->size) return 1;
+	if (length > INT32_MAX / 2 - buffer->length) return 0;
+
+	while (size < buffer->length + length)
+		size *= 2;
+	chars = realloc(buffer->chars, size);
+	if (chars == NULL) return 0;
+
+	buffer->chars = chars;
+	buffer->size = size;
+	return 1;
+}
+
+static inline const char *format_append(struct format_buffer *buffer,
+					const char *chars, int length)
+{
+	if (!format_reserve(buffer, length)) return "Out of memory.";
+
+	memcpy(buffer->chars + buffer->length, chars, length);
+	buffer->length += length;
+	return NULL;
+}
+
+/* snprintf() `arg` with `spec`, growing the buffer when it is short. */
+#define FORMAT_PRINTF(buffer, spec, arg)				\
+	do {								\
+		int room = (buffer)->size - (buffer)->length;		\
+		int length = snprintf((buffer)->chars + (buffer)->length, \
+				      room, (spec), (arg));		\
+									\
+		if (length < 0) return "Invalid format.";		\
+		if (length >= room) {					\
+			if (!format_reserve((buffer), length + 1))	\
+				return "Out of memory.";		\
+			snprintf((buffer)->chars + (buffer)->length,	\
+				 length + 1, (spec), (arg));		\
+		}							\
+		(buffer)->length += length;				\
+	} while (0)
+
+static inline const char *format_append_value(struct format_buffer *buffer,
+					      const struct value *val)
+{
+	char bytes[STRING_SHORT_MAX];
+	const char *chars, *error;
+	const struct array *arr;
+	const struct map *map;
+	const struct value *pair;
+	struct value element;
+	int length;
+
+	/* the buffer has room for the terminating '\0' of snprintf() */
+	if (!format_reserve(buffer, 1)) return "Out of memory.";
+
+	switch (val->type) {
+	case VALUE_INT: FORMAT_PRINTF(buffer, "%d", val->as.integer); break;
+	case VALUE_FLOAT: FORMAT_PRINTF(buffer, "%g", val->as.float_p); break;
+	case VALUE_BOOL:
+		return val->as.bool ? format_append(buffer, "true", 4)
+			: format_append(buffer, "false", 5);
+	case VALUE_RECIPE:
+		FORMAT_PRINTF(buffer, "<recipe %p>", val->as.structure);
+		break;
+	case VALUE_ARRAY:
+		arr = val->as.structure;
+		if ((error = format_append(buffer, "{", 1)) != NULL)
+			return error;
+		for (int i = 0; i < arr->length; i++) {
+			element = array_get(arr, i);
+			if ((i > 0 && (error = format_append(buffer, ", ", 2)))
+			    || (error = format_append_value(buffer, &element)))
+				return error;
+		}
+		return format_append(buffer, "}", 1);
+	case VALUE_MAP:
+		map = val->as.structure;
+		if ((error = format_append(buffer, "{", 1)) != NULL)
+			return error;
+		for (int i = 0; i < map->count; i++) {
+			pair = &ARRAY_DATA(map->entries, struct value)[i * 2];
+			if ((i > 0 && (error = format_append(buffer, ", ", 2)))
+			    || (error = format_append_value(buffer, &pair[0]))
+			    || (error = format_append(buffer, ": ", 2))
+			    || (error = format_append_value(buffer, &pair[1])))
+				return error;
+		}
+		return format_append(buffer, "}", 1);
+	case VALUE_STRING:
+		if ((length = string_bytes(val, bytes, &chars)) < 0)
+			return "Out of memory.";
+		return format_append(buffer, chars, length);
+	/* held by ref parameters only, printed as the variable */
+	case VALUE_REF:
+		return format_append_value(buffer, val->as.ref);
+	}
+	return NULL;
+}
+
+/* A string conversion with flags, width or precision goes through
+ * snprintf(), which wants it '\0' terminated. */
+static inline const char *format_append_string(struct format_buffer *buffer,
+					       const struct format_segment *seg,
+					       const struct value *val)
+{
+	char bytes[STRING_SHORT_MAX + 1];
+	const char *chars;
+	int length;
+
+	if ((length = string_bytes(val, bytes, &chars)) < 0)
+		return "Out of memory.";
+	if (seg->length == 2)
+		return format_append(buffer, chars, length);
+
+	bytes[length < STRING_SHORT_MAX ? length : STRING_SHORT_MAX] = '\0';
+	FORMAT_PRINTF(buffer, seg->text, chars);
+	return NULL;
+}
+
+/* Append `fmt` applied to the `fmt->argc` arguments at `args`. Their
+ * types are only checked here when the compiler did not know them. */
+static inline const char *format_run(const struct format *fmt,
+				     const struct value *args,
+				     struct format_buffer *buffer)
+{
+	const char *error;
+
+	for (int i = 0; i < fmt->count; i++) {
+		const struct format_segment *seg = &fmt->segments[i];
+
+		if (!format_reserve(buffer, 1)) return "Out of memory.";
+
+		switch (seg->conversion) {
+		case FORMAT_TEXT:
+			error = format_append(buffer, seg->text, seg->length);
+			if (error != NULL) return error;
+			continue;
+		case FORMAT_INT:
+			if (args->type != VALUE_INT)
+				return "Format expects an int.";
+			FORMAT_PRINTF(buffer, seg->text, args->as.integer);
+			break;
+		case FORMAT_UINT:
+			if (args->type != VALUE_INT)
+				return "Format expects an int.";
+			FORMAT_PRINTF(buffer, seg->text,
+				      (unsigned)args->as.integer);
+			break;
+		case FORMAT_FLOAT:
+			if (args->type == VALUE_INT)
+				FORMAT_PRINTF(buffer, seg->text,
+					      (double)args->as.integer);
+			else if (args->type == VALUE_FLOAT)
+				FORMAT_PRINTF(buffer, seg->text, args->as.float_p);
+			else
+				return "Format expects a float.";
+			break;
+		case FORMAT_STRING:
+			if (args->type != VALUE_STRING)
+				return "Format expects a str.";
+			error = format_append_string(buffer, seg, args);
+			if (error != NULL) return error;
+			break;
+		case FORMAT_VALUE:
+			error = format_append_value(buffer, args);
+			if (error != NULL) return error;
+			break;
+		}
+		args++;
+	}
+	return NULL;
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "format_vector.h"
+#include "src/macros.h"
+
+#include <stdlib.h>
+
+static void format_vector_grow(struct format_vector *fa);
+
+struct format_vector *format_vector_init()
+{
+	struct format_vector *fa = malloc(sizeof(struct format_vector));
+
+	ASSERT(fa != NULL, "Unable to allocate memory for format_vector.");
+
+	fa->count = 0;
+	fa->size = FORMAT_VECTOR_BUFFER_COUNT * sizeof(struct format);
+	fa->array = malloc(fa->size);
+
+	ASSERT(fa->array != NULL, "Unable to allocate memory for format_vector.");
+
+	return fa;
+}
+
+void format_vector_free(struct format_vector *fa)
+{
+	for (int i = 0; i < fa->count; i++) {
+		for (int j = 0; j < fa->array[i].count; j++)
+			free((char *)fa->array[i].segments[j].text);
+		free((struct format_segment *)fa->array[i].segments);
+	}
+	free(fa->array);
+	free(fa);
+	fa = NULL;
+}
+
+int format_vector_add(struct format_vector *fa, struct format fmt)
+{
+	if (fa->count == (fa->size / sizeof(struct format)))
+		format_vector_grow(fa);
+
+	fa->array[fa->count] = fmt;
+
+	return fa->count++;
+}
+
+static void format_vector_grow(struct format_vector *fa)
+{
+	fa->size += FORMAT_VECTOR_BUFFER_COUNT * sizeof(struct format);
+	fa->array = realloc(fa->array, fa->size);
+
+	ASSERT(fa->array != NULL, "Unable to grow format_vector.");
+}
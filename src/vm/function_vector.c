@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "function_vector.h"
+#include "src/macros.h"
+
+#include <stdlib.h>
+
+static void function_vector_grow(struct function_vector *fa);
+
+struct function_vector *function_vector_init()
+{
+	struct function_vector *fa = malloc(sizeof(struct function_vector));
+
+	ASSERT(fa != NULL, "Unable to allocate memory for function_vector.");
+
+	fa->count = 0;
+	fa->size = FUNCTION_VECTOR_BUFFER_COUNT * sizeof(struct function);
+	fa->array = malloc(fa->size);
+
+	ASSERT(fa->array != NULL, "Unable to allocate memory for function_vector.");
+
+	return fa;
+}
+
+void function_vector_free(struct function_vector *fa)
+{
+	free(fa->array);
+	free(fa);
+	fa = NULL;
+}
+
+int function_vector_add(struct function_vector *fa, struct function fn)
+{
+	if (fa->count == (fa->size / sizeof(struct function)))
+		function_vector_grow(fa);
+
+	fa->array[fa->count] = fn;
+
+	return fa->count++;
+}
+
+static void function_vector_grow(struct function_vector *fa)
+{
+	fa->size += FUNCTION_VECTOR_BUFFER_COUNT * sizeof(struct function);
+	fa->array = realloc(fa->array, fa->size);
+
+	ASSERT(fa->array != NULL, "Unable to grow function_vector.");
+}
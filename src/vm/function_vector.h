@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define FUNCTION_VECTOR_BUFFER_COUNT 8
+/* Most bytes of recipe instances a function keeps in its frame. The C
+ * emitted by `emit_c()` keeps them on the C stack. */
+#define FUNCTION_FRAME_MAX 1024
+
+/* A function compiled into a lump. Its index in the vector is the
+ * operand of the codes calling it. */
+struct function {
+	/* entry point, and offset past the last code of the body */
+	int offset;
+	int end;
+	/* Deepest the function pushes the stack above its first slot, set
+	 * by `lump_compute_max_stack()`. */
+	int max_stack;
+	/* bytes of the recipe instances made in the function's frame */
+	int frame_size;
+	uint8_t arity;
+	uint8_t returns_value;
+};
+
+struct function_vector {
+	struct function *array;
+	int size;
+	int count;
+};
+
+struct function_vector *function_vector_init();
+/* Return the function's index. */
+int function_vector_add(struct function_vector *fa, struct function fn);
+void function_vector_free(struct function_vector *fa);
@@ -0,0 +1,441 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "heap.h"
+#include "array.h"
+#include "object.h"
+#include "str.h"
+#include "src/macros.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/*
+ * A collection is a minor one, copying the nursery's live objects to
+ * the old generation, then a slice of the major one under way. The
+ * major collection starts once the old bytes went past their limit,
+ * right after a minor one, by marking what the roots refer to: the
+ * snapshot of the old objects reachable then. The program then runs
+ * between slices marking the gray objects, those whose references are
+ * not marked yet, then between slices freeing the unmarked ones. Each
+ * slice takes about `budget_ns`, and the nursery is collected only
+ * when nearly full, the next slice being due every HEAP_SLICE_BYTES
+ * allocated.
+ */
+
+/* elements of an array marked between two looks at the clock */
+#define MARK_STEP 256
+
+static uint64_t now_ns();
+static void minor_collection(struct heap *heap, struct value *stack,
+			     int stack_count, struct value *globals,
+			     int global_count);
+/* Mark until no object is gray, return 0 if the deadline came first. */
+static int mark_slice(struct heap *heap, uint64_t deadline);
+/* Sweep until no object is left, return 0 if the deadline came first. */
+static int sweep_slice(struct heap *heap, uint64_t deadline);
+static void promote_values(struct heap *heap, struct value *values,
+			   int count);
+static void promote_value(struct heap *heap, struct value *val);
+static void promote_references(struct heap *heap, struct object *obj);
+/* Copy a nursery object to the old generation. */
+static struct object *promote(struct heap *heap, struct object *obj);
+static void shade_values(struct heap *heap, const struct value *values,
+			 int count);
+static void shade_string(struct heap *heap, uint64_t word);
+static void shade_map(struct heap *heap, const struct map *map);
+static int has_references(const struct object *obj);
+/* Free the bytes of the ropes which died in the nursery. */
+static void free_nursery_ropes(struct heap *heap);
+static void free_objects(struct object *obj);
+static void free_object(struct object *obj);
+static void count_pause(int *buckets, uint64_t pause);
+
+void heap_init(struct heap *heap)
+{
+	*heap = (struct heap){0};
+	heap->nursery = aligned_alloc(HEAP_ALIGN, HEAP_NURSERY_SIZE);
+	ASSERT(heap->nursery != NULL, "Unable to allocate the nursery.");
+
+	heap->top = heap->nursery;
+	heap->nursery_end = heap->nursery + HEAP_NURSERY_SIZE;
+	heap->end = heap->nursery_end;
+	heap->old_limit = HEAP_OLD_MIN;
+	heap->budget_ns = (uint64_t)HEAP_SLICE_BUDGET_US * 1000;
+	heap->started_ns = now_ns();
+}
+
+void heap_collect(struct heap *heap, struct value *stack, int stack_count,
+		  struct value *globals, int global_count)
+{
+	uint64_t start = now_ns(), pause;
+	int is_slice = heap->phase != HEAP_IDLE;
+
+	if (heap->phase == HEAP_IDLE
+	    || heap->nursery_end - heap->top < HEAP_SLICE_BYTES)
+		minor_collection(heap, stack, stack_count, globals,
+				 global_count);
+
+	if (heap->phase == HEAP_IDLE && heap->old_bytes > heap->old_limit) {
+		heap->phase = HEAP_MARKING;
+		shade_values(heap, stack, stack_count);
+		shade_values(heap, globals, global_count);
+	}
+
+	if (heap->phase != HEAP_IDLE) {
+		uint64_t deadline = start + heap->budget_ns;
+
+		/* the program allocates faster than the slices free */
+		if (heap->old_bytes > heap->old_limit * 2) {
+			deadline = UINT64_MAX;
+			heap->stats.finished++;
+		}
+		if (heap->phase == HEAP_MARKING && mark_slice(heap, deadline)) {
+			heap->phase = HEAP_SWEEPING;
+			heap->unswept = heap->old;
+			heap->old = NULL;
+		}
+		if (heap->phase == HEAP_SWEEPING
+		    && sweep_slice(heap, deadline)) {
+			heap->phase = HEAP_IDLE;
+			heap->old_limit = heap->old_bytes * 2 > HEAP_OLD_MIN
+				? heap->old_bytes * 2 : HEAP_OLD_MIN;
+			heap->stats.major++;
+		}
+	}
+
+	heap->end = heap->phase == HEAP_IDLE
+		|| heap->nursery_end - heap->top <= HEAP_SLICE_BYTES
+		? heap->nursery_end : heap->top + HEAP_SLICE_BYTES;
+	heap->is_collect_pending = 0;
+
+	pause = now_ns() - start;
+	count_pause(heap->stats.pauses, pause);
+	heap->stats.pause_total_ns += pause;
+	if (pause > heap->stats.pause_max_ns)
+		heap->stats.pause_max_ns = pause;
+	if (is_slice) {
+		count_pause(heap->stats.slices, pause);
+		if (pause > heap->stats.slice_max_ns)
+			heap->stats.slice_max_ns = pause;
+	}
+}
+
+void heap_free(struct heap *heap)
+{
+	free_nursery_ropes(heap);
+	free_objects(heap->old);
+	free_objects(heap->unswept);
+	free(heap->nursery);
+	free(heap->remembered);
+	free(heap->copied);
+	free(heap->gray);
+	*heap = (struct heap){0};
+}
+
+void heap_report(const struct heap *heap, FILE *out)
+{
+	const struct heap_stats *stats = &heap->stats;
+	double seconds = (now_ns() - heap->started_ns) / 1e9;
+	int count = 0, seen = 0, p99 = 0;
+
+	fprintf(out, "gc minor collections: %d\n", stats->minor);
+	fprintf(out, "gc major collections: %d, %d finished at once\n",
+		stats->major, stats->finished);
+	fprintf(out, "gc allocated: %llu bytes, %.1f MB/s\n",
+		(unsigned long long)stats->allocated,
+		seconds > 0 ? stats->allocated / seconds / 1e6 : 0);
+	fprintf(out, "gc promoted: %llu bytes\n",
+		(unsigned long long)stats->promoted);
+	fprintf(out, "gc freed: %llu bytes\n", (unsigned long long)stats->freed);
+	fprintf(out, "gc pauses: %.3f ms total, %.3f ms max\n",
+		stats->pause_total_ns / 1e6, stats->pause_max_ns / 1e6);
+	fprintf(out, "gc slices: %.3f ms max, %llu us budget\n",
+		stats->slice_max_ns / 1e6,
+		(unsigned long long)heap->budget_ns / 1000);
+
+	for (int i = 0; i < HEAP_PAUSE_BUCKETS; i++)
+		count += stats->pauses[i];
+	/* the bucket holding the 99th percentile pause */
+	while (p99 < HEAP_PAUSE_BUCKETS - 1
+	       && (seen += stats->pauses[p99]) * 100 < count * 99)
+		p99++;
+	if (count > 0)
+		fprintf(out, "gc pause p99: under %d us\n", 1 << p99);
+
+	for (int i = 0; i < HEAP_PAUSE_BUCKETS; i++) {
+		if (stats->pauses[i] == 0) continue;
+		if (i < HEAP_PAUSE_BUCKETS - 1)
+			fprintf(out, "gc pauses under %d us: %d, %d slices\n",
+				1 << i, stats->pauses[i], stats->slices[i]);
+		else
+			fprintf(out, "gc pauses longer: %d, %d slices\n",
+				stats->pauses[i], stats->slices[i]);
+	}
+}
+
+static uint64_t now_ns()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void minor_collection(struct heap *heap, struct value *stack,
+			     int stack_count, struct value *globals,
+			     int global_count)
+{
+	uint64_t promoted = heap->stats.promoted;
+
+	promote_values(heap, stack, stack_count);
+	promote_values(heap, globals, global_count);
+	for (int i = 0; i < heap->remembered_count; i++) {
+		heap->remembered[i]->is_remembered = 0;
+		promote_references(heap, heap->remembered[i]);
+	}
+	heap->remembered_count = 0;
+	while (heap->copied_count > 0)
+		promote_references(heap, heap->copied[--heap->copied_count]);
+
+	free_nursery_ropes(heap);
+	heap->stats.freed += (heap->top - heap->nursery)
+		- (heap->stats.promoted - promoted);
+	heap->top = heap->nursery;
+	heap->has_ropes = 0;
+	heap->stats.minor++;
+}
+
+static int mark_slice(struct heap *heap, uint64_t deadline)
+{
+	for (int steps = 1;; steps++) {
+		struct object *obj;
+
+		if (steps % 64 == 0 && now_ns() >= deadline) return 0;
+
+		if (heap->scanning == NULL) {
+			if (heap->gray_count == 0) return 1;
+			heap->scanning = heap->gray[--heap->gray_count];
+			heap->scan_index = 0;
+		}
+		obj = heap->scanning;
+
+		if (obj->type == OBJECT_ROPE) {
+			shade_string(heap, ((struct rope *)obj)->left);
+			shade_string(heap, ((struct rope *)obj)->right);
+			heap->scanning = NULL;
+		} else if (obj->type == OBJECT_MAP) {
+			shade_map(heap, (struct map *)obj);
+			heap->scanning = NULL;
+		} else if (has_references(obj)) {
+			/* large arrays are marked a step at a time */
+			struct array *arr = (struct array *)obj;
+			int from = heap->scan_index;
+			int to = arr->length - from > MARK_STEP
+				? from + MARK_STEP : arr->length;
+
+			shade_values(heap, ARRAY_DATA(arr, struct value) + from,
+				     to - from);
+			heap->scan_index = to;
+			if (to == arr->length) heap->scanning = NULL;
+		} else {
+			heap->scanning = NULL;
+		}
+	}
+}
+
+static int sweep_slice(struct heap *heap, uint64_t deadline)
+{
+	for (int steps = 1; heap->unswept != NULL; steps++) {
+		struct object *obj = heap->unswept;
+
+		if (steps % 256 == 0 && now_ns() >= deadline) return 0;
+
+		heap->unswept = obj->next;
+		if (obj->is_marked) {
+			obj->is_marked = 0;
+			obj->next = heap->old;
+			heap->old = obj;
+			continue;
+		}
+		heap->old_bytes -= (size_t)obj->blocks * HEAP_ALIGN;
+		heap->stats.freed += (size_t)obj->blocks * HEAP_ALIGN;
+		free_object(obj);
+	}
+	return 1;
+}
+
+static void promote_values(struct heap *heap, struct value *values,
+			   int count)
+{
+	for (int i = 0; i < count; i++)
+		promote_value(heap, &values[i]);
+}
+
+static void promote_value(struct heap *heap, struct value *val)
+{
+	struct object *obj = array_element_object(val);
+
+	if (obj == NULL
+	    || (obj->space != SPACE_NURSERY && obj->space != SPACE_MOVED))
+		return;
+
+	if (val->type == VALUE_STRING)
+		val->as.string = (uintptr_t)promote(heap, obj);
+	else
+		val->as.structure = promote(heap, obj);
+}
+
+static void promote_references(struct heap *heap, struct object *obj)
+{
+	if (obj->type == OBJECT_ROPE) {
+		struct rope *rope = (struct rope *)obj;
+		struct value left = GET_VALUE_STRING(rope->left);
+		struct value right = GET_VALUE_STRING(rope->right);
+
+		promote_value(heap, &left);
+		promote_value(heap, &right);
+		rope->left = left.as.string;
+		rope->right = right.as.string;
+	} else if (obj->type == OBJECT_MAP) {
+		struct map *map = (struct map *)obj;
+		struct value entries = GET_VALUE_ARRAY(map->entries);
+		struct value table = GET_VALUE_ARRAY(map->table);
+
+		promote_value(heap, &entries);
+		promote_value(heap, &table);
+		map->entries = entries.as.structure;
+		map->table = table.as.structure;
+	} else if (has_references(obj)) {
+		struct array *arr = (struct array *)obj;
+		promote_values(heap, ARRAY_DATA(arr, struct value),
+			       arr->length);
+	}
+}
+
+static struct object *promote(struct heap *heap, struct object *obj)
+{
+	size_t size = (size_t)obj->blocks * HEAP_ALIGN;
+	struct object *copy;
+
+	if (obj->space == SPACE_MOVED) return obj->next;
+
+	copy = malloc(size);
+	ASSERT(copy != NULL, "Unable to promote an object.");
+
+	memcpy(copy, obj, size);
+	copy->space = SPACE_OLD;
+	/* made old while marking, it is not part of the snapshot */
+	copy->is_marked = heap->phase == HEAP_MARKING;
+	copy->next = heap->old;
+	heap->old = copy;
+	heap->old_bytes += size;
+	heap->stats.promoted += size;
+
+	obj->space = SPACE_MOVED;
+	obj->next = copy;
+
+	if (has_references(copy))
+		ASSERT(heap_push(&heap->copied, &heap->copied_count,
+				 &heap->copied_size, copy),
+		       "Unable to grow the copied objects.");
+	return copy;
+}
+
+static void shade_values(struct heap *heap, const struct value *values,
+			 int count)
+{
+	for (int i = 0; i < count; i++) {
+		struct object *obj = array_element_object(&values[i]);
+
+		if (obj != NULL)
+			ASSERT(heap_shade(heap, obj),
+			       "Unable to grow the gray objects.");
+	}
+}
+
+static void shade_string(struct heap *heap, uint64_t word)
+{
+	struct value val = GET_VALUE_STRING(word);
+
+	shade_values(heap, &val, 1);
+}
+
+static void shade_map(struct heap *heap, const struct map *map)
+{
+	struct value arrays[] = {
+		GET_VALUE_ARRAY(map->entries),
+		GET_VALUE_ARRAY(map->table)
+	};
+
+	shade_values(heap, arrays, 2);
+}
+
+static int has_references(const struct object *obj)
+{
+	if (obj->type == OBJECT_ROPE || obj->type == OBJECT_MAP) return 1;
+	if (obj->type != OBJECT_ARRAY) return 0;
+
+	uint8_t kind = ((const struct array *)obj)->kind;
+	return kind == ARRAY_VALUE || kind == ARRAY_STRING;
+}
+
+static void free_nursery_ropes(struct heap *heap)
+{
+	if (!heap->has_ropes) return;
+
+	for (uint8_t *p = heap->nursery; p < heap->top;) {
+		struct object *obj = (struct object *)p;
+
+		if (obj->type == OBJECT_ROPE && obj->space == SPACE_NURSERY)
+			free(((struct rope *)obj)->flat);
+		p += (size_t)obj->blocks * HEAP_ALIGN;
+	}
+}
+
+static void free_objects(struct object *obj)
+{
+	while (obj != NULL) {
+		struct object *next = obj->next;
+		free_object(obj);
+		obj = next;
+	}
+}
+
+static void free_object(struct object *obj)
+{
+	if (obj->type == OBJECT_ROPE)
+		free(((struct rope *)obj)->flat);
+	free(obj);
+}
+
+static void count_pause(int *buckets, uint64_t pause)
+{
+	int bucket = 0;
+
+	while (bucket < HEAP_PAUSE_BUCKETS - 1
+	       && pause >= (uint64_t)1000 << bucket)
+		bucket++;
+	buckets[bucket]++;
+}
@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "src/value.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The heap has two generations. Objects are bump allocated in the
+ * nursery, and copied to the old generation when a minor collection
+ * finds them alive. Old objects are allocated one by one, linked, and
+ * collected once their bytes double, by a major collection marking
+ * then sweeping them in slices of bounded length between which the
+ * program runs.
+ *
+ * Allocating never collects, a full nursery only marks the collection
+ * pending. The VM collects at its next safe point, when every
+ * reference is on its stack or in its globals, see src/vm/heap.c. The
+ * C emitted by `emit_c()` has no nursery and never collects.
+ *
+ * Only arrays of values, ropes and maps refer to other objects. An old
+ * one referring to the nursery is remembered, by `heap_alloc()` when it
+ * is allocated old, by `array_barrier()` when it is stored to and by
+ * `map_barrier()` when its storage is replaced. While
+ * marking, the barrier also marks the references old arrays lose, so
+ * that what was reachable when the marking started is marked, and
+ * objects made old meanwhile are marked from the start.
+ */
+
+#define HEAP_ALIGN 16
+#define HEAP_NURSERY_SIZE (2 << 20)
+/* objects larger than this are allocated old */
+#define HEAP_LARGE_OBJECT (HEAP_NURSERY_SIZE / 8)
+/* old bytes past which a major collection is first pending */
+#define HEAP_OLD_MIN (8 << 20)
+/* pause times are counted by power of two microseconds */
+#define HEAP_PAUSE_BUCKETS 16
+/* bytes allocated between two slices of a major collection */
+#define HEAP_SLICE_BYTES (256 << 10)
+#ifndef HEAP_SLICE_BUDGET_US
+#define HEAP_SLICE_BUDGET_US 500
+#endif
+
+enum object_type {
+	OBJECT_RECIPE,
+	OBJECT_ARRAY,
+	OBJECT_STRING,
+	OBJECT_ROPE,
+	OBJECT_MAP
+};
+
+enum heap_phase {
+	HEAP_IDLE,
+	HEAP_MARKING,
+	HEAP_SWEEPING
+};
+
+enum object_space {
+	SPACE_NONE,	/* allocated outside the heap, never collected */
+	SPACE_NURSERY,
+	SPACE_OLD,
+	SPACE_MOVED	/* copied out of the nursery, to `next` */
+};
+
+/* Header of the values allocated on the heap. */
+struct object {
+	/* the next old object, or the copy of a moved one */
+	struct object *next;
+	uint8_t type;
+	uint8_t space;
+	uint8_t is_marked;
+	uint8_t is_remembered;
+	/* the object's size in HEAP_ALIGN byte blocks */
+	uint32_t blocks;
+};
+
+/* Counters reported when built with DEBUG_PROFILE_EXECUTION. */
+struct heap_stats {
+	uint64_t allocated;
+	uint64_t promoted;
+	uint64_t freed;
+	int minor;
+	int major;
+	/* major collections which fell behind and were finished at once */
+	int finished;
+	uint64_t pause_total_ns;
+	uint64_t pause_max_ns;
+	/* pauses under 1, 2, 4... microseconds */
+	int pauses[HEAP_PAUSE_BUCKETS];
+	/* the marking and sweeping slices among them */
+	int slices[HEAP_PAUSE_BUCKETS];
+	uint64_t slice_max_ns;
+};
+
+struct heap {
+	uint8_t *nursery;
+	uint8_t *top;
+	/* where allocating makes a collection pending, before the
+	 * nursery's end while a major collection is under way */
+	uint8_t *end;
+	uint8_t *nursery_end;
+	/* set when the nursery holds a rope, whose bytes are freed
+	 * apart from it */
+	int has_ropes;
+	struct object *old;
+	size_t old_bytes;
+	size_t old_limit;
+	int is_collect_pending;
+	uint8_t phase;
+	/* the old objects left to sweep */
+	struct object *unswept;
+	/* old objects which may refer to the nursery */
+	struct object **remembered;
+	int remembered_count;
+	int remembered_size;
+	/* objects copied by a minor collection, their references left
+	 * to visit */
+	struct object **copied;
+	int copied_count;
+	int copied_size;
+	/* objects marked by a major collection, their references left
+	 * to visit */
+	struct object **gray;
+	int gray_count;
+	int gray_size;
+	/* the gray object being visited, a large array taking several
+	 * slices, from its element at `scan_index` */
+	struct object *scanning;
+	int scan_index;
+	/* the longest a marking or sweeping slice should take */
+	uint64_t budget_ns;
+	uint64_t started_ns;
+	struct heap_stats stats;
+};
+
+/* Reserve the nursery. */
+void heap_init(struct heap *heap);
+/* Collect the objects unreachable from the values of `stack` and
+ * `globals`. */
+void heap_collect(struct heap *heap, struct value *stack, int stack_count,
+		  struct value *globals, int global_count);
+/* Free every object. */
+void heap_free(struct heap *heap);
+void heap_report(const struct heap *heap, FILE *out);
+
+/* Push `obj` on a growable array of objects. Return 0 when out of
+ * memory. */
+static inline int heap_push(struct object ***array, int *count, int *size,
+			    struct object *obj)
+{
+	if (*count == *size) {
+		int new_size = *size ? *size * 2 : 64;
+		struct object **grown =
+			realloc(*array, new_size * sizeof(struct object *));
+
+		if (grown == NULL) return 0;
+		*array = grown;
+		*size = new_size;
+	}
+	(*array)[(*count)++] = obj;
+	return 1;
+}
+
+/* Return 0 when out of memory. */
+static inline int heap_remember(struct heap *heap, struct object *obj)
+{
+	obj->is_remembered = 1;
+	return heap_push(&heap->remembered, &heap->remembered_count,
+			 &heap->remembered_size, obj);
+}
+
+/* Mark `obj` if it is an old object the marking has not reached yet.
+ * Return 0 when out of memory. */
+static inline int heap_shade(struct heap *heap, struct object *obj)
+{
+	if (obj->space != SPACE_OLD || obj->is_marked) return 1;
+
+	obj->is_marked = 1;
+	return heap_push(&heap->gray, &heap->gray_count, &heap->gray_size, obj);
+}
+
+static inline struct object *heap_alloc_old(struct heap *heap, uint8_t type,
+					    size_t size)
+{
+	struct object *obj = calloc(1, size);
+
+	if (obj == NULL) return NULL;
+
+	obj->space = SPACE_OLD;
+	obj->is_marked = heap->phase == HEAP_MARKING;
+	obj->next = heap->old;
+	heap->old = obj;
+	heap->old_bytes += size;
+	/* starts a major collection, or paces the one under way */
+	if (heap->old_bytes > heap->old_limit && heap->nursery != NULL)
+		heap->is_collect_pending = 1;
+
+	/* what it refers to may be in the nursery */
+	if ((type == OBJECT_ARRAY || type == OBJECT_ROPE || type == OBJECT_MAP)
+	    && heap->nursery != NULL && !heap_remember(heap, obj)) {
+		heap->old = obj->next;
+		free(obj);
+		return NULL;
+	}
+	return obj;
+}
+
+/* Allocate a zeroed object of `size` bytes. Without a heap, it is left
+ * to the caller to free. Return NULL when out of memory. */
+static inline struct object *heap_alloc(struct heap *heap, uint8_t type,
+					size_t size)
+{
+	struct object *obj;
+
+	size = (size + HEAP_ALIGN - 1) & ~(size_t)(HEAP_ALIGN - 1);
+	if (heap == NULL) {
+		obj = calloc(1, size);
+	} else if (size <= (size_t)(heap->end - heap->top)
+		   || (size <= HEAP_LARGE_OBJECT
+		       && size <= (size_t)(heap->nursery_end - heap->top))) {
+		/* past `end`, the next slice is due */
+		if (heap->top + size > heap->end)
+			heap->is_collect_pending = 1;
+		obj = (struct object *)heap->top;
+		heap->top += size;
+		memset(obj, 0, size);
+		obj->space = SPACE_NURSERY;
+		heap->has_ropes |= type == OBJECT_ROPE;
+	} else {
+		if (size <= HEAP_LARGE_OBJECT && heap->nursery != NULL)
+			heap->is_collect_pending = 1;
+		obj = heap_alloc_old(heap, type, size);
+	}
+	if (obj == NULL) return NULL;
+
+	if (heap != NULL) heap->stats.allocated += size;
+	obj->type = type;
+	obj->blocks = size / HEAP_ALIGN;
+	return obj;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "map.h"
+#include "object.h"
+#include "src/value.h"
+
+#include <stdint.h>
+
+/*
+ * Counted loops, shared by the VM and the C emitted by `emit_c()`.
+ * They walk their locals in place: a range is never materialized and
+ * an array is read where it is stored. The `_first` functions return
+ * 1 and set the loop variable when there is a first element, the
+ * `_next` functions advance to the next element the same way.
+ */
+
+/* `range` is the counter, the stop, the step and the loop variable.
+ * The compiler rejects a constant step of zero, others are checked
+ * beforehand with `iterator_range_check()`. */
+static inline const char *iterator_range_check(const struct value *range)
+{
+	return range[2].as.integer == 0 ? "Range step cannot be zero." : NULL;
+}
+
+static inline int iterator_range_first(struct value *range)
+{
+	int counter = range[0].as.integer, stop = range[1].as.integer;
+
+	if (range[2].as.integer > 0 ? counter >= stop : counter <= stop)
+		return 0;
+	range[3] = range[0];
+	return 1;
+}
+
+static inline int iterator_range_next(struct value *range)
+{
+	/* widened so the counter cannot overflow past the stop */
+	int64_t next = (int64_t)range[0].as.integer + range[2].as.integer;
+	int stop = range[1].as.integer;
+
+	if (range[2].as.integer > 0 ? next >= stop : next <= stop)
+		return 0;
+	range[0].as.integer = range[3].as.integer = (int)next;
+	return 1;
+}
+
+/* `iter` is the array, the index and the loop variable. */
+static inline int iterator_array_first(struct value *iter)
+{
+	const struct array *arr = iter[0].as.structure;
+
+	if (arr->length == 0) return 0;
+	iter[2] = array_get(arr, 0);
+	return 1;
+}
+
+static inline int iterator_array_next(struct value *iter)
+{
+	const struct array *arr = iter[0].as.structure;
+
+	if (++iter[1].as.integer >= arr->length) return 0;
+	iter[2] = array_get(arr, iter[1].as.integer);
+	return 1;
+}
+
+/* `iter` is the map, the entry and the loop variable, the keys taken
+ * in insertion order. */
+static inline int iterator_map_first(struct value *iter)
+{
+	const struct map *map = iter[0].as.structure;
+
+	if (map->count == 0) return 0;
+	iter[2] = MAP_ENTRIES(map)[0];
+	return 1;
+}
+
+static inline int iterator_map_next(struct value *iter)
+{
+	const struct map *map = iter[0].as.structure;
+
+	if (++iter[1].as.integer >= map->count) return 0;
+	iter[2] = MAP_ENTRIES(map)[iter[1].as.integer * 2];
+	return 1;
+}
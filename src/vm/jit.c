@@ -0,0 +1,1120 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "jit.h"
+#include "object.h"
+#include "src/macros.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(VM_JIT) && defined(__x86_64__) && defined(__linux__)
+
+#include <sys/mman.h>
+#include <math.h>
+#include <unistd.h>
+
+/* Registers, numbered as they are encoded. */
+enum reg {
+	RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+	R12 = 12, R13 = 13, R14 = 14, R15 = 15
+};
+
+/* What native code keeps in callee-saved registers. */
+#define STACK RBX
+#define SLOTS R12
+#define GLOBALS R13
+#define FRAME R15
+
+/* The low nibble of the jcc and setcc opcodes. */
+enum condition {
+	CC_ALWAYS = -1,
+	CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6,
+	CC_A = 0x7, CC_P = 0xA, CC_NP = 0xB, CC_L = 0xC, CC_GE = 0xD,
+	CC_LE = 0xE, CC_G = 0xF
+};
+
+/* Displacements from STACK of the values on top, and of their type. */
+#define TOP(distance) (-(int)sizeof(struct value) * ((distance) + 1))
+#define TYPE(distance) (TOP(distance) + (int)offsetof(struct value, type))
+/* Displacement from SLOTS or GLOBALS of a slot. */
+#define SLOT(slot) ((int)sizeof(struct value) * (slot))
+#define FIELDS ((int)sizeof(struct object))
+#define ARRAY_LENGTH_AT ((int)offsetof(struct array, length))
+#define ARRAY_DATA_AT ((int)offsetof(struct array, data))
+
+/* A rel32 landing on the code at `target`, or on the exit to it. */
+struct fixup {
+	int at;
+	int target;
+	int is_exit;
+};
+
+struct assembler {
+	uint8_t *bytes;
+	int count;
+	int size;
+	struct fixup *fixups;
+	int fixup_count;
+	int fixup_size;
+};
+
+#define EMIT(as, bytes)							\
+	emit(as, (const uint8_t *)(bytes), sizeof(bytes) - 1)
+
+static void emit(struct assembler *as, const uint8_t *bytes, int count);
+static void emit_byte(struct assembler *as, uint8_t byte);
+static void emit_dword(struct assembler *as, uint32_t dword);
+static void emit_qword(struct assembler *as, uint64_t qword);
+/* Emit `opcode` on the register `reg` and the memory at `base` plus
+ * `disp`, or plus `index` times `scale` and `disp` when `index` is not
+ * -1. `prefix`, when not 0, comes before the REX prefix, which is
+ * REX.W when `is_wide`. */
+static void emit_mem(struct assembler *as, uint8_t prefix, int is_wide,
+		     const char *opcode, int reg, int base, int index,
+		     int scale, int32_t disp);
+#define MEM(as, prefix, is_wide, opcode, reg, base, disp)		\
+	emit_mem(as, prefix, is_wide, opcode, reg, base, -1, 1, disp)
+/* Emit a rel32 jump, taken on `cc`, to the code at `target` or, when
+ * `is_exit`, to the exit handing it to the interpreter. */
+static void emit_jump(struct assembler *as, enum condition cc, int target,
+		      int is_exit);
+/* Emit a rel8 jump taken on `cc` and return where `land()` patches
+ * it. */
+static int emit_short_jump(struct assembler *as, enum condition cc);
+static void land(struct assembler *as, int at);
+static void emit_adjust(struct assembler *as, int count);
+static void emit_set_type(struct assembler *as, int disp,
+			  enum value_type type);
+/* Store the bool in AL as the value at `disp`. */
+static void emit_store_bool(struct assembler *as, int disp);
+static void emit_push_slot(struct assembler *as, int base, int disp);
+static void emit_pop_slot(struct assembler *as, int base, int disp);
+/* Exit to the code at `offset` unless both values on top are of
+ * `type`. */
+static void emit_guard(struct assembler *as, int offset, enum value_type type);
+static void emit_int_arithmetic(struct assembler *as, enum op_code code);
+static void emit_int_division(struct assembler *as, int offset,
+			      int is_modulo);
+static void emit_float_arithmetic(struct assembler *as, const char *opcode);
+static void emit_int_comparison(struct assembler *as, enum condition cc);
+static void emit_float_comparison(struct assembler *as, enum op_code code);
+static void emit_math(struct assembler *as, uintptr_t function, int arity);
+/* Emit an array element's load or store, its address being RAX plus
+ * RCX times the width of `kind`, from or to the value at `disp`. */
+static void emit_get_element(struct assembler *as, enum array_kind kind,
+			     int disp);
+static void emit_set_element(struct assembler *as, enum array_kind kind,
+			     int disp);
+static void emit_get_field(struct assembler *as, enum array_kind kind,
+			   int offset);
+static void emit_set_field(struct assembler *as, enum array_kind kind,
+			   int offset);
+static void emit_for_range(struct assembler *as, struct lump *lmp,
+			   int offset, int is_step);
+/* Emit the template of the code at `offset`. Return 0, having emitted
+ * nothing, when it has none. */
+static int emit_code(struct assembler *as, struct lump *lmp, int offset);
+static int read_short(const struct lump *lmp, int offset);
+/* Map `as` executable, writable only while it is copied. Return NULL
+ * when the system refuses. */
+static uint8_t *map_code(struct jit *jit, const struct assembler *as);
+static void make_enter(struct jit *jit);
+
+void jit_init(struct jit *jit, struct lump *lmp, int is_enabled)
+{
+	*jit = (struct jit){.lump = lmp};
+#ifdef DEBUG_TRACE_EXECUTION
+	is_enabled = 0;
+#endif
+	if (!is_enabled) return;
+
+	make_enter(jit);
+	if (jit->enter == NULL) return;
+
+	jit->entries = calloc(lmp->count + 1, sizeof(void *));
+	jit->counters = calloc(lmp->count + 1, sizeof(uint32_t));
+	jit->is_tried = calloc(lmp->functions->count + 1, sizeof(uint8_t));
+	ASSERT(jit->entries != NULL && jit->counters != NULL
+	       && jit->is_tried != NULL, "Unable to allocate the JIT tables.");
+}
+
+void jit_free(struct jit *jit)
+{
+	for (int i = 0; i < jit->region_count; i++)
+		munmap(jit->regions[i].code, jit->regions[i].size);
+	free(jit->regions);
+	free(jit->entries);
+	free(jit->counters);
+	free(jit->is_tried);
+	*jit = (struct jit){0};
+}
+
+void *jit_compile(struct jit *jit, int offset)
+{
+	struct lump *lmp = jit->lump;
+	struct function_vector *fa = lmp->functions;
+	int function = -1, start = 0, end = lmp->count;
+
+	/* the innermost function holding `offset`, they are sorted */
+	for (int i = 0; i < fa->count; i++) {
+		if (fa->array[i].offset <= offset && offset < fa->array[i].end) {
+			function = i;
+			start = fa->array[i].offset;
+			end = fa->array[i].end;
+		}
+	}
+	if (jit->is_tried[function + 1]) return NULL;
+	jit->is_tried[function + 1] = 1;
+
+	struct assembler as = {0};
+	int *native = malloc((lmp->count + 1) * sizeof(int));
+	int *exits = malloc((lmp->count + 1) * sizeof(int));
+	int next = function + 1, epilogue;
+
+	ASSERT(native != NULL && exits != NULL,
+	       "Unable to allocate the JIT offsets.");
+	for (int i = 0; i <= lmp->count; i++)
+		native[i] = exits[i] = -1;
+
+	/* Every exit ends here, the offset to continue from in EAX. */
+	epilogue = as.count;
+	MEM(&as, 0, 1, "\x89", STACK, FRAME,
+	    (int)offsetof(struct jit_frame, stack_top));
+	EMIT(&as, "\x41\x5F\x41\x5E\x41\x5D\x41\x5C\x5B\xC3");
+
+	while (next < fa->count && fa->array[next].offset <= start)
+		next++;
+
+	for (int at = start; at < end;) {
+		if (next < fa->count && at == fa->array[next].offset) {
+			at = fa->array[next++].end;
+			continue;
+		}
+
+		native[at] = as.count;
+		if (!emit_code(&as, lmp, at)) {
+			native[at] = -1;
+			exits[at] = as.count;
+			EMIT(&as, "\xB8");
+			emit_dword(&as, at);
+			emit_byte(&as, 0xE9);
+			emit_dword(&as, epilogue - (as.count + 4));
+		}
+		at = lump_next_code(lmp, at);
+	}
+	emit_jump(&as, CC_ALWAYS, end, 1);
+
+	/* Land the jumps, on the native code of their target when it has
+	 * some, on an exit to it otherwise. */
+	for (int i = 0; i < as.fixup_count; i++) {
+		struct fixup *fixup = &as.fixups[i];
+		int target = fixup->target, landing = -1;
+
+		if (!fixup->is_exit && target >= start && target < end)
+			landing = native[target];
+		if (landing == -1) {
+			if (exits[target] == -1) {
+				exits[target] = as.count;
+				EMIT(&as, "\xB8");
+				emit_dword(&as, target);
+				emit_byte(&as, 0xE9);
+				emit_dword(&as, epilogue - (as.count + 4));
+			}
+			landing = exits[target];
+		}
+		int32_t rel = landing - (fixup->at + 4);
+		memcpy(&as.bytes[fixup->at], &rel, sizeof(rel));
+	}
+
+	uint8_t *code = map_code(jit, &as);
+
+	for (int at = start; code != NULL && at < end; at++) {
+		if (native[at] != -1)
+			jit->entries[at] = code + native[at];
+	}
+
+	free(as.bytes);
+	free(as.fixups);
+	free(native);
+	free(exits);
+	return jit->entries[offset];
+}
+
+void jit_report(const struct jit *jit, FILE *out)
+{
+	fprintf(out, "jit mapped regions: %d, %zu bytes\n",
+		jit->region_count, jit->native_bytes);
+	fprintf(out, "jit native runs: %ld\n", jit->runs);
+}
+
+static int emit_code(struct assembler *as, struct lump *lmp, int offset)
+{
+	const uint8_t *code = &lmp->array[offset];
+
+	switch (code[0]) {
+	case OP_CONSTANT:
+	case OP_CONSTANT_LONG: {
+		int index = (code[0] == OP_CONSTANT) ? code[1]
+			: read_short(lmp, offset);
+
+		EMIT(as, "\x48\xB8");
+		emit_qword(as, (uintptr_t)&lmp->constants->array[index]);
+		emit_push_slot(as, RAX, 0);
+		return 1;
+	}
+	case OP_POP:
+		emit_adjust(as, -1);
+		return 1;
+	case OP_GET_LOCAL:
+		emit_push_slot(as, SLOTS, SLOT(code[1]));
+		return 1;
+	case OP_GET_LOCAL_LONG:
+		emit_push_slot(as, SLOTS, SLOT(read_short(lmp, offset)));
+		return 1;
+	case OP_SET_LOCAL:
+		emit_pop_slot(as, SLOTS, SLOT(code[1]));
+		return 1;
+	case OP_SET_LOCAL_LONG:
+		emit_pop_slot(as, SLOTS, SLOT(read_short(lmp, offset)));
+		return 1;
+	case OP_GET_GLOBAL:
+		emit_push_slot(as, GLOBALS, SLOT(code[1]));
+		return 1;
+	case OP_GET_GLOBAL_LONG:
+		emit_push_slot(as, GLOBALS, SLOT(read_short(lmp, offset)));
+		return 1;
+	case OP_SET_GLOBAL:
+		emit_pop_slot(as, GLOBALS, SLOT(code[1]));
+		return 1;
+	case OP_SET_GLOBAL_LONG:
+		emit_pop_slot(as, GLOBALS, SLOT(read_short(lmp, offset)));
+		return 1;
+	case OP_REF_LOCAL:
+	case OP_REF_GLOBAL:
+		/* lea rax, [slot] */
+		MEM(as, 0, 1, "\x8D", RAX,
+		    code[0] == OP_REF_LOCAL ? SLOTS : GLOBALS,
+		    SLOT(read_short(lmp, offset)));
+		MEM(as, 0, 1, "\x89", RAX, STACK, 0);
+		emit_set_type(as, (int)offsetof(struct value, type), VALUE_REF);
+		emit_adjust(as, 1);
+		return 1;
+	case OP_GET_REF:
+		MEM(as, 0, 1, "\x8B", RAX, SLOTS, SLOT(read_short(lmp, offset)));
+		emit_push_slot(as, RAX, 0);
+		return 1;
+	case OP_SET_REF:
+		emit_adjust(as, -1);
+		MEM(as, 0, 0, "\x0F\x10", 0, STACK, 0);
+		MEM(as, 0, 1, "\x8B", RAX, SLOTS, SLOT(read_short(lmp, offset)));
+		MEM(as, 0, 0, "\x0F\x11", 0, RAX, 0);
+		return 1;
+
+	case OP_JUMP:
+	case OP_LOOP:
+		emit_jump(as, CC_ALWAYS, lump_jump_target(lmp, offset), 0);
+		return 1;
+	case OP_JUMP_IF_FALSE:
+	case OP_JUMP_IF_TRUE:
+		emit_adjust(as, -1);
+		/* cmp byte [stack], 0 */
+		MEM(as, 0, 0, "\x80", 7, STACK, 0);
+		emit_byte(as, 0);
+		emit_jump(as, code[0] == OP_JUMP_IF_FALSE ? CC_E : CC_NE,
+			  lump_jump_target(lmp, offset), 0);
+		return 1;
+	case OP_JUMP_IF_FALSE_OR_POP:
+	case OP_JUMP_IF_TRUE_OR_POP:
+		MEM(as, 0, 0, "\x80", 7, STACK, TOP(0));
+		emit_byte(as, 0);
+		emit_jump(as, code[0] == OP_JUMP_IF_FALSE_OR_POP ? CC_E : CC_NE,
+			  lump_jump_target(lmp, offset), 0);
+		emit_adjust(as, -1);
+		return 1;
+	case OP_JUMP_IF_EQUAL_INT:
+	case OP_JUMP_IF_NOT_EQUAL_INT:
+	case OP_JUMP_IF_GREATER_INT:
+	case OP_JUMP_IF_GREATER_EQUAL_INT:
+	case OP_JUMP_IF_LESS_INT:
+	case OP_JUMP_IF_LESS_EQUAL_INT: {
+		static const enum condition conditions[] = {
+			CC_E, CC_NE, CC_G, CC_GE, CC_L, CC_LE
+		};
+
+		emit_adjust(as, -2);
+		MEM(as, 0, 0, "\x8B", RAX, STACK, 0);
+		MEM(as, 0, 0, "\x3B", RAX, STACK, (int)sizeof(struct value));
+		emit_jump(as, conditions[code[0] - OP_JUMP_IF_EQUAL_INT],
+			  lump_jump_target(lmp, offset), 0);
+		return 1;
+	}
+	case OP_TO_BOOL:
+		/* cmp dword [type], VALUE_BOOL */
+		MEM(as, 0, 0, "\x83", 7, STACK, TYPE(0));
+		emit_byte(as, VALUE_BOOL);
+		emit_jump(as, CC_NE, offset, 1);
+		return 1;
+	case OP_LOGICAL_NOT:
+		/* ints and floats are left to the interpreter */
+		MEM(as, 0, 0, "\x83", 7, STACK, TYPE(0));
+		emit_byte(as, VALUE_BOOL);
+		emit_jump(as, CC_NE, offset, 1);
+		MEM(as, 0, 0, "\x80", 7, STACK, TOP(0));
+		emit_byte(as, 0);
+		EMIT(as, "\x0F\x94\xC0");
+		emit_store_bool(as, TOP(0));
+		return 1;
+	case OP_FOR_RANGE_PREP:
+		emit_for_range(as, lmp, offset, 0);
+		return 1;
+	case OP_FOR_RANGE_STEP:
+		emit_for_range(as, lmp, offset, 1);
+		return 1;
+
+	case OP_ADD_INT_Q:
+	case OP_SUBSTRACT_INT_Q:
+	case OP_MULTIPLY_INT_Q:
+		emit_guard(as, offset, VALUE_INT);
+		emit_int_arithmetic(as, code[0] == OP_ADD_INT_Q ? OP_ADD_INT
+				    : code[0] == OP_SUBSTRACT_INT_Q
+				    ? OP_SUBSTRACT_INT : OP_MULTIPLY_INT);
+		return 1;
+	case OP_ADD_INT:
+	case OP_SUBSTRACT_INT:
+	case OP_MULTIPLY_INT:
+		emit_int_arithmetic(as, code[0]);
+		return 1;
+	case OP_DIVIDE_INT:
+		emit_int_division(as, offset, 0);
+		return 1;
+	case OP_MODULO_INT:
+		emit_int_division(as, offset, 1);
+		return 1;
+	case OP_NEGATE_INT:
+		/* neg dword [top] */
+		MEM(as, 0, 0, "\xF7", 3, STACK, TOP(0));
+		return 1;
+	case OP_ADD_FLOAT_Q:
+	case OP_SUBSTRACT_FLOAT_Q:
+	case OP_MULTIPLY_FLOAT_Q:
+		emit_guard(as, offset, VALUE_FLOAT);
+		emit_float_arithmetic(as, code[0] == OP_ADD_FLOAT_Q ? "\x0F\x58"
+				      : code[0] == OP_SUBSTRACT_FLOAT_Q
+				      ? "\x0F\x5C" : "\x0F\x59");
+		return 1;
+	case OP_ADD_FLOAT:
+		emit_float_arithmetic(as, "\x0F\x58");
+		return 1;
+	case OP_SUBSTRACT_FLOAT:
+		emit_float_arithmetic(as, "\x0F\x5C");
+		return 1;
+	case OP_MULTIPLY_FLOAT:
+		emit_float_arithmetic(as, "\x0F\x59");
+		return 1;
+	case OP_DIVIDE_FLOAT:
+		emit_float_arithmetic(as, "\x0F\x5E");
+		return 1;
+	case OP_NEGATE_FLOAT:
+		/* btc qword [top], 63 */
+		MEM(as, 0, 1, "\x0F\xBA", 7, STACK, TOP(0));
+		emit_byte(as, 63);
+		return 1;
+	case OP_INT_TO_FLOAT:
+		/* cvtsi2sd xmm0, dword [value] */
+		MEM(as, 0xF2, 0, "\x0F\x2A", 0, STACK, TOP(code[1]));
+		MEM(as, 0xF2, 0, "\x0F\x11", 0, STACK, TOP(code[1]));
+		emit_set_type(as, TYPE(code[1]), VALUE_FLOAT);
+		return 1;
+	case OP_TO_FLOAT: {
+		MEM(as, 0, 0, "\x83", 7, STACK, TYPE(code[1]));
+		emit_byte(as, VALUE_FLOAT);
+		int done = emit_short_jump(as, CC_E);
+
+		MEM(as, 0, 0, "\x83", 7, STACK, TYPE(code[1]));
+		emit_byte(as, VALUE_INT);
+		emit_jump(as, CC_NE, offset, 1);
+		MEM(as, 0xF2, 0, "\x0F\x2A", 0, STACK, TOP(code[1]));
+		MEM(as, 0xF2, 0, "\x0F\x11", 0, STACK, TOP(code[1]));
+		emit_set_type(as, TYPE(code[1]), VALUE_FLOAT);
+		land(as, done);
+		return 1;
+	}
+
+	case OP_GREATER_INT_Q:
+	case OP_GREATER_EQUAL_INT_Q:
+	case OP_LESS_INT_Q:
+	case OP_LESS_EQUAL_INT_Q: {
+		static const enum condition conditions[] = {
+			CC_G, CC_GE, CC_L, CC_LE
+		};
+
+		emit_guard(as, offset, VALUE_INT);
+		emit_int_comparison(as,
+				    conditions[(code[0] - OP_GREATER_INT_Q) / 2]);
+		return 1;
+	}
+	case OP_GREATER_FLOAT_Q:
+	case OP_GREATER_EQUAL_FLOAT_Q:
+	case OP_LESS_FLOAT_Q:
+	case OP_LESS_EQUAL_FLOAT_Q: {
+		static const enum op_code codes[] = {
+			OP_GREATER_FLOAT, OP_GREATER_EQUAL_FLOAT,
+			OP_LESS_FLOAT, OP_LESS_EQUAL_FLOAT
+		};
+
+		emit_guard(as, offset, VALUE_FLOAT);
+		emit_float_comparison(as,
+				      codes[(code[0] - OP_GREATER_FLOAT_Q) / 2]);
+		return 1;
+	}
+	case OP_EQUAL_INT:
+		emit_int_comparison(as, CC_E);
+		return 1;
+	case OP_NOT_EQUAL_INT:
+		emit_int_comparison(as, CC_NE);
+		return 1;
+	case OP_GREATER_INT:
+		emit_int_comparison(as, CC_G);
+		return 1;
+	case OP_GREATER_EQUAL_INT:
+		emit_int_comparison(as, CC_GE);
+		return 1;
+	case OP_LESS_INT:
+		emit_int_comparison(as, CC_L);
+		return 1;
+	case OP_LESS_EQUAL_INT:
+		emit_int_comparison(as, CC_LE);
+		return 1;
+	case OP_EQUAL_FLOAT:
+	case OP_NOT_EQUAL_FLOAT:
+	case OP_GREATER_FLOAT:
+	case OP_GREATER_EQUAL_FLOAT:
+	case OP_LESS_FLOAT:
+	case OP_LESS_EQUAL_FLOAT:
+		emit_float_comparison(as, code[0]);
+		return 1;
+
+	case OP_MATH_SQRT:
+		/* sqrtsd xmm0, [top] */
+		MEM(as, 0xF2, 0, "\x0F\x51", 0, STACK, TOP(0));
+		MEM(as, 0xF2, 0, "\x0F\x11", 0, STACK, TOP(0));
+		return 1;
+	case OP_MATH_POW:
+		emit_math(as, (uintptr_t)pow, 2);
+		return 1;
+	case OP_MATH_REMAINDER:
+		emit_math(as, (uintptr_t)remainder, 2);
+		return 1;
+	case OP_MATH_FLOOR:
+		emit_math(as, (uintptr_t)floor, 1);
+		return 1;
+	case OP_MATH_CEIL:
+		emit_math(as, (uintptr_t)ceil, 1);
+		return 1;
+	case OP_MATH_SIN:
+		emit_math(as, (uintptr_t)sin, 1);
+		return 1;
+	case OP_MATH_COS:
+		emit_math(as, (uintptr_t)cos, 1);
+		return 1;
+	case OP_MATH_EXP:
+		emit_math(as, (uintptr_t)exp, 1);
+		return 1;
+	case OP_MATH_LOG:
+		emit_math(as, (uintptr_t)log, 1);
+		return 1;
+
+	case OP_GET_FIELD_INT:
+		emit_get_field(as, ARRAY_INT, read_short(lmp, offset));
+		return 1;
+	case OP_GET_FIELD_BYTE:
+		emit_get_field(as, ARRAY_BYTE, read_short(lmp, offset));
+		return 1;
+	case OP_GET_FIELD_SBYTE:
+		emit_get_field(as, ARRAY_SBYTE, read_short(lmp, offset));
+		return 1;
+	case OP_GET_FIELD_FLOAT:
+		emit_get_field(as, ARRAY_FLOAT, read_short(lmp, offset));
+		return 1;
+	case OP_GET_FIELD_BOOL:
+		emit_get_field(as, ARRAY_BOOL, read_short(lmp, offset));
+		return 1;
+	case OP_SET_FIELD_INT:
+		emit_set_field(as, ARRAY_INT, read_short(lmp, offset));
+		return 1;
+	case OP_SET_FIELD_BYTE:
+		emit_set_field(as, ARRAY_BYTE, read_short(lmp, offset));
+		return 1;
+	case OP_SET_FIELD_SBYTE:
+		emit_set_field(as, ARRAY_SBYTE, read_short(lmp, offset));
+		return 1;
+	case OP_SET_FIELD_FLOAT:
+		emit_set_field(as, ARRAY_FLOAT, read_short(lmp, offset));
+		return 1;
+	case OP_SET_FIELD_BOOL:
+		emit_set_field(as, ARRAY_BOOL, read_short(lmp, offset));
+		return 1;
+
+	case OP_GET_INDEX_INT:
+	case OP_GET_INDEX_BYTE:
+	case OP_GET_INDEX_SBYTE:
+	case OP_GET_INDEX_FLOAT:
+	case OP_GET_INDEX_BOOL:
+	case OP_GET_INDEX_VALUE:
+		MEM(as, 0, 1, "\x8B", RAX, STACK, TOP(1));
+		MEM(as, 0, 0, "\x8B", RCX, STACK, TOP(0));
+		/* an unsigned compare also sends negative indexes back */
+		MEM(as, 0, 0, "\x3B", RCX, RAX, ARRAY_LENGTH_AT);
+		emit_jump(as, CC_AE, offset, 1);
+		emit_get_element(as, code[0] - OP_GET_INDEX_INT, TOP(1));
+		emit_adjust(as, -1);
+		return 1;
+	case OP_SET_INDEX_INT:
+	case OP_SET_INDEX_BYTE:
+	case OP_SET_INDEX_SBYTE:
+	case OP_SET_INDEX_FLOAT:
+	case OP_SET_INDEX_BOOL:
+		MEM(as, 0, 1, "\x8B", RAX, STACK, TOP(2));
+		MEM(as, 0, 0, "\x8B", RCX, STACK, TOP(1));
+		MEM(as, 0, 0, "\x3B", RCX, RAX, ARRAY_LENGTH_AT);
+		emit_jump(as, CC_AE, offset, 1);
+		emit_set_element(as, code[0] - OP_SET_INDEX_INT, TOP(0));
+		emit_adjust(as, -3);
+		return 1;
+	case OP_GET_INDEX_INT_UNCHECKED:
+	case OP_GET_INDEX_BYTE_UNCHECKED:
+	case OP_GET_INDEX_SBYTE_UNCHECKED:
+	case OP_GET_INDEX_FLOAT_UNCHECKED:
+	case OP_GET_INDEX_BOOL_UNCHECKED:
+	case OP_GET_INDEX_VALUE_UNCHECKED:
+		MEM(as, 0, 1, "\x8B", RAX, STACK, TOP(0));
+		MEM(as, 0, 0, "\x8B", RCX, SLOTS, SLOT(read_short(lmp, offset)));
+		emit_get_element(as, code[0] - OP_GET_INDEX_INT_UNCHECKED,
+				 TOP(0));
+		return 1;
+	case OP_SET_INDEX_INT_UNCHECKED:
+	case OP_SET_INDEX_BYTE_UNCHECKED:
+	case OP_SET_INDEX_SBYTE_UNCHECKED:
+	case OP_SET_INDEX_FLOAT_UNCHECKED:
+	case OP_SET_INDEX_BOOL_UNCHECKED:
+		MEM(as, 0, 1, "\x8B", RAX, STACK, TOP(1));
+		MEM(as, 0, 0, "\x8B", RCX, SLOTS, SLOT(read_short(lmp, offset)));
+		emit_set_element(as, code[0] - OP_SET_INDEX_INT_UNCHECKED,
+				 TOP(0));
+		emit_adjust(as, -2);
+		return 1;
+	case OP_ARRAY_LENGTH:
+		MEM(as, 0, 1, "\x8B", RAX, STACK, TOP(0));
+		MEM(as, 0, 0, "\x8B", RAX, RAX, ARRAY_LENGTH_AT);
+		MEM(as, 0, 1, "\x89", RAX, STACK, TOP(0));
+		emit_set_type(as, TYPE(0), VALUE_INT);
+		return 1;
+
+	default:
+		/* calls, returns, allocations, the untyped codes, ... */
+		return 0;
+	}
+}
+
+static void emit_int_arithmetic(struct assembler *as, enum op_code code)
+{
+	if (code == OP_MULTIPLY_INT) {
+		/* imul eax, [b] */
+		MEM(as, 0, 0, "\x8B", RAX, STACK, TOP(1));
+		MEM(as, 0, 0, "\x0F\xAF", RAX, STACK, TOP(0));
+		MEM(as, 0, 0, "\x89", RAX, STACK, TOP(1));
+	} else {
+		/* add or sub [a], eax, wrapping as the interpreter does */
+		MEM(as, 0, 0, "\x8B", RAX, STACK, TOP(0));
+		MEM(as, 0, 0, code == OP_ADD_INT ? "\x01" : "\x29",
+		    RAX, STACK, TOP(1));
+	}
+	emit_adjust(as, -1);
+}
+
+static void emit_int_division(struct assembler *as, int offset,
+			      int is_modulo)
+{
+	/* the interpreter reports the division by zero */
+	MEM(as, 0, 0, "\x8B", RCX, STACK, TOP(0));
+	EMIT(as, "\x85\xC9");
+	emit_jump(as, CC_E, offset, 1);
+
+	/* by -1, which idiv traps on for INT_MIN */
+	EMIT(as, "\x83\xF9\xFF");
+	int divide = emit_short_jump(as, CC_NE);
+
+	if (is_modulo) {
+		MEM(as, 0, 0, "\xC7", 0, STACK, TOP(1));
+		emit_dword(as, 0);
+	} else {
+		MEM(as, 0, 0, "\xF7", 3, STACK, TOP(1));
+	}
+	int done = emit_short_jump(as, CC_ALWAYS);
+
+	land(as, divide);
+	MEM(as, 0, 0, "\x8B", RAX, STACK, TOP(1));
+	/* cdq, idiv ecx */
+	EMIT(as, "\x99\xF7\xF9");
+	MEM(as, 0, 0, "\x89", is_modulo ? RDX : RAX, STACK, TOP(1));
+	land(as, done);
+	emit_adjust(as, -1);
+}
+
+static void emit_float_arithmetic(struct assembler *as, const char *opcode)
+{
+	MEM(as, 0xF2, 0, "\x0F\x10", 0, STACK, TOP(1));
+	MEM(as, 0xF2, 0, opcode, 0, STACK, TOP(0));
+	MEM(as, 0xF2, 0, "\x0F\x11", 0, STACK, TOP(1));
+	emit_adjust(as, -1);
+}
+
+static void emit_int_comparison(struct assembler *as, enum condition cc)
+{
+	MEM(as, 0, 0, "\x8B", RAX, STACK, TOP(1));
+	MEM(as, 0, 0, "\x3B", RAX, STACK, TOP(0));
+	/* setcc al */
+	emit_byte(as, 0x0F);
+	emit_byte(as, 0x90 | cc);
+	emit_byte(as, 0xC0);
+	emit_store_bool(as, TOP(1));
+	emit_adjust(as, -1);
+}
+
+static void emit_float_comparison(struct assembler *as, enum op_code code)
+{
+	/* Less is greater with the operands swapped, ucomisd setting the
+	 * flags of an unsigned comparison, which NaN leaves unordered. */
+	int is_swapped = code == OP_LESS_FLOAT || code == OP_LESS_EQUAL_FLOAT;
+	enum condition cc = (code == OP_GREATER_FLOAT || code == OP_LESS_FLOAT)
+		? CC_A : CC_AE;
+
+	MEM(as, 0xF2, 0, "\x0F\x10", 0, STACK, TOP(is_swapped ? 0 : 1));
+	MEM(as, 0x66, 0, "\x0F\x2E", 0, STACK, TOP(is_swapped ? 1 : 0));
+	if (code == OP_EQUAL_FLOAT) {
+		/* sete al, setnp cl, and al, cl */
+		EMIT(as, "\x0F\x94\xC0\x0F\x9B\xC1\x20\xC8");
+	} else if (code == OP_NOT_EQUAL_FLOAT) {
+		/* setne al, setp cl, or al, cl */
+		EMIT(as, "\x0F\x95\xC0\x0F\x9A\xC1\x08\xC8");
+	} else {
+		emit_byte(as, 0x0F);
+		emit_byte(as, 0x90 | cc);
+		emit_byte(as, 0xC0);
+	}
+	emit_store_bool(as, TOP(1));
+	emit_adjust(as, -1);
+}
+
+static void emit_math(struct assembler *as, uintptr_t function, int arity)
+{
+	/* The stack pointer is kept 16 byte aligned for the call, which
+	 * saves STACK, SLOTS, GLOBALS and FRAME. */
+	MEM(as, 0xF2, 0, "\x0F\x10", 0, STACK, TOP(arity - 1));
+	if (arity == 2)
+		MEM(as, 0xF2, 0, "\x0F\x10", 1, STACK, TOP(0));
+	EMIT(as, "\x48\xB8");
+	emit_qword(as, function);
+	/* call rax */
+	EMIT(as, "\xFF\xD0");
+	MEM(as, 0xF2, 0, "\x0F\x11", 0, STACK, TOP(arity - 1));
+	emit_adjust(as, 1 - arity);
+}
+
+static void emit_get_element(struct assembler *as, enum array_kind kind,
+			     int disp)
+{
+	switch (kind) {
+	case ARRAY_INT:
+		emit_mem(as, 0, 0, "\x8B", RAX, RAX, RCX, 4, ARRAY_DATA_AT);
+		MEM(as, 0, 1, "\x89", RAX, STACK, disp);
+		emit_set_type(as, disp + (int)offsetof(struct value, type),
+			      VALUE_INT);
+		break;
+	case ARRAY_BYTE:
+	case ARRAY_SBYTE:
+	case ARRAY_BOOL:
+		/* movzx or movsx eax, byte [element] */
+		emit_mem(as, 0, 0, kind == ARRAY_SBYTE ? "\x0F\xBE" : "\x0F\xB6",
+			 RAX, RAX, RCX, 1, ARRAY_DATA_AT);
+		MEM(as, 0, 1, "\x89", RAX, STACK, disp);
+		emit_set_type(as, disp + (int)offsetof(struct value, type),
+			      kind == ARRAY_BOOL ? VALUE_BOOL : VALUE_INT);
+		break;
+	case ARRAY_FLOAT:
+		emit_mem(as, 0xF2, 0, "\x0F\x10", 0, RAX, RCX, 8, ARRAY_DATA_AT);
+		MEM(as, 0xF2, 0, "\x0F\x11", 0, STACK, disp);
+		emit_set_type(as, disp + (int)offsetof(struct value, type),
+			      VALUE_FLOAT);
+		break;
+	default:
+		/* shl rcx, 4, to index whole values */
+		EMIT(as, "\x48\xC1\xE1\x04");
+		emit_mem(as, 0, 0, "\x0F\x10", 0, RAX, RCX, 1, ARRAY_DATA_AT);
+		MEM(as, 0, 0, "\x0F\x11", 0, STACK, disp);
+		break;
+	}
+}
+
+static void emit_set_element(struct assembler *as, enum array_kind kind,
+			     int disp)
+{
+	switch (kind) {
+	case ARRAY_INT:
+		MEM(as, 0, 0, "\x8B", RDX, STACK, disp);
+		emit_mem(as, 0, 0, "\x89", RDX, RAX, RCX, 4, ARRAY_DATA_AT);
+		break;
+	case ARRAY_FLOAT:
+		MEM(as, 0xF2, 0, "\x0F\x10", 0, STACK, disp);
+		emit_mem(as, 0xF2, 0, "\x0F\x11", 0, RAX, RCX, 8, ARRAY_DATA_AT);
+		break;
+	default:
+		/* mov byte [element], dl */
+		MEM(as, 0, 0, "\x8B", RDX, STACK, disp);
+		emit_mem(as, 0, 0, "\x88", RDX, RAX, RCX, 1, ARRAY_DATA_AT);
+		break;
+	}
+}
+
+static void emit_get_field(struct assembler *as, enum array_kind kind,
+			   int offset)
+{
+	MEM(as, 0, 1, "\x8B", RAX, STACK, TOP(0));
+	switch (kind) {
+	case ARRAY_INT:
+		MEM(as, 0, 0, "\x8B", RAX, RAX, FIELDS + offset);
+		MEM(as, 0, 1, "\x89", RAX, STACK, TOP(0));
+		emit_set_type(as, TYPE(0), VALUE_INT);
+		break;
+	case ARRAY_FLOAT:
+		MEM(as, 0xF2, 0, "\x0F\x10", 0, RAX, FIELDS + offset);
+		MEM(as, 0xF2, 0, "\x0F\x11", 0, STACK, TOP(0));
+		emit_set_type(as, TYPE(0), VALUE_FLOAT);
+		break;
+	default:
+		MEM(as, 0, 0, kind == ARRAY_SBYTE ? "\x0F\xBE" : "\x0F\xB6",
+		    RAX, RAX, FIELDS + offset);
+		MEM(as, 0, 1, "\x89", RAX, STACK, TOP(0));
+		emit_set_type(as, TYPE(0),
+			      kind == ARRAY_BOOL ? VALUE_BOOL : VALUE_INT);
+		break;
+	}
+}
+
+static void emit_set_field(struct assembler *as, enum array_kind kind,
+			   int offset)
+{
+	MEM(as, 0, 1, "\x8B", RAX, STACK, TOP(1));
+	switch (kind) {
+	case ARRAY_INT:
+		MEM(as, 0, 0, "\x8B", RDX, STACK, TOP(0));
+		MEM(as, 0, 0, "\x89", RDX, RAX, FIELDS + offset);
+		break;
+	case ARRAY_FLOAT:
+		MEM(as, 0xF2, 0, "\x0F\x10", 0, STACK, TOP(0));
+		MEM(as, 0xF2, 0, "\x0F\x11", 0, RAX, FIELDS + offset);
+		break;
+	default:
+		MEM(as, 0, 0, "\x8B", RDX, STACK, TOP(0));
+		MEM(as, 0, 0, "\x88", RDX, RAX, FIELDS + offset);
+		break;
+	}
+	emit_adjust(as, -2);
+}
+
+static void emit_for_range(struct assembler *as, struct lump *lmp,
+			   int offset, int is_step)
+{
+	/* the counter, stop, step and variable slots, see iterator.h */
+	int counter = SLOT(read_short(lmp, offset));
+	int stop = counter + SLOT(1), step = counter + SLOT(2);
+	int variable = counter + SLOT(3);
+	int target = lump_jump_target(lmp, offset);
+
+	if (!is_step) {
+		/* the interpreter reports a zero step */
+		MEM(as, 0, 0, "\x83", 7, SLOTS, step);
+		emit_byte(as, 0);
+		emit_jump(as, CC_E, offset, 1);
+
+		/* the flags are still the step's, mov leaves them */
+		MEM(as, 0, 0, "\x8B", RAX, SLOTS, counter);
+		int down = emit_short_jump(as, CC_LE);
+		MEM(as, 0, 0, "\x3B", RAX, SLOTS, stop);
+		emit_jump(as, CC_GE, target, 0);
+		int first = emit_short_jump(as, CC_ALWAYS);
+		land(as, down);
+		MEM(as, 0, 0, "\x3B", RAX, SLOTS, stop);
+		emit_jump(as, CC_LE, target, 0);
+		land(as, first);
+		MEM(as, 0, 0, "\x0F\x10", 0, SLOTS, counter);
+		MEM(as, 0, 0, "\x0F\x11", 0, SLOTS, variable);
+		return;
+	}
+
+	/* movsxd, the next counter being widened past the stop */
+	MEM(as, 0, 1, "\x63", RAX, SLOTS, counter);
+	MEM(as, 0, 1, "\x63", RCX, SLOTS, step);
+	MEM(as, 0, 1, "\x63", RDX, SLOTS, stop);
+	/* add rax, rcx, test ecx, ecx */
+	EMIT(as, "\x48\x01\xC8\x85\xC9");
+	int down = emit_short_jump(as, CC_LE);
+	/* cmp rax, rdx */
+	EMIT(as, "\x48\x39\xD0");
+	int done_up = emit_short_jump(as, CC_GE);
+	int next = emit_short_jump(as, CC_ALWAYS);
+	land(as, down);
+	EMIT(as, "\x48\x39\xD0");
+	int done_down = emit_short_jump(as, CC_LE);
+	land(as, next);
+	MEM(as, 0, 0, "\x89", RAX, SLOTS, counter);
+	MEM(as, 0, 0, "\x89", RAX, SLOTS, variable);
+	emit_jump(as, CC_ALWAYS, target, 0);
+	land(as, done_up);
+	land(as, done_down);
+}
+
+static void emit_guard(struct assembler *as, int offset, enum value_type type)
+{
+	for (int distance = 0; distance < 2; distance++) {
+		MEM(as, 0, 0, "\x83", 7, STACK, TYPE(distance));
+		emit_byte(as, type);
+		emit_jump(as, CC_NE, offset, 1);
+	}
+}
+
+static void emit_store_bool(struct assembler *as, int disp)
+{
+	/* movzx eax, al */
+	EMIT(as, "\x0F\xB6\xC0");
+	MEM(as, 0, 1, "\x89", RAX, STACK, disp);
+	emit_set_type(as, disp + (int)offsetof(struct value, type), VALUE_BOOL);
+}
+
+static void emit_set_type(struct assembler *as, int disp,
+			  enum value_type type)
+{
+	/* mov dword [type], imm32 */
+	MEM(as, 0, 0, "\xC7", 0, STACK, disp);
+	emit_dword(as, type);
+}
+
+static void emit_push_slot(struct assembler *as, int base, int disp)
+{
+	/* movups xmm0, [slot], movups [stack], xmm0 */
+	MEM(as, 0, 0, "\x0F\x10", 0, base, disp);
+	MEM(as, 0, 0, "\x0F\x11", 0, STACK, 0);
+	emit_adjust(as, 1);
+}
+
+static void emit_pop_slot(struct assembler *as, int base, int disp)
+{
+	emit_adjust(as, -1);
+	MEM(as, 0, 0, "\x0F\x10", 0, STACK, 0);
+	MEM(as, 0, 0, "\x0F\x11", 0, base, disp);
+}
+
+static void emit_adjust(struct assembler *as, int count)
+{
+	if (count == 0) return;
+
+	/* add or sub rbx, imm32 */
+	EMIT(as, "\x48\x81");
+	emit_byte(as, count > 0 ? 0xC3 : 0xEB);
+	emit_dword(as, (uint32_t)(abs(count) * (int)sizeof(struct value)));
+}
+
+static void emit_jump(struct assembler *as, enum condition cc, int target,
+		      int is_exit)
+{
+	if (cc == CC_ALWAYS) {
+		emit_byte(as, 0xE9);
+	} else {
+		emit_byte(as, 0x0F);
+		emit_byte(as, 0x80 | cc);
+	}
+
+	if (as->fixup_count == as->fixup_size) {
+		as->fixup_size = as->fixup_size == 0 ? 64 : as->fixup_size * 2;
+		as->fixups = realloc(as->fixups,
+				     as->fixup_size * sizeof(struct fixup));
+		ASSERT(as->fixups != NULL, "Unable to grow the JIT fixups.");
+	}
+	as->fixups[as->fixup_count++] = (struct fixup){
+		.at = as->count,
+		.target = target,
+		.is_exit = is_exit
+	};
+	emit_dword(as, 0);
+}
+
+static int emit_short_jump(struct assembler *as, enum condition cc)
+{
+	emit_byte(as, cc == CC_ALWAYS ? 0xEB : 0x70 | cc);
+	emit_byte(as, 0);
+	return as->count - 1;
+}
+
+static void land(struct assembler *as, int at)
+{
+	as->bytes[at] = (uint8_t)(as->count - (at + 1));
+}
+
+static void emit_mem(struct assembler *as, uint8_t prefix, int is_wide,
+		     const char *opcode, int reg, int base, int index,
+		     int scale, int32_t disp)
+{
+	uint8_t rex = 0x40 | (is_wide ? 8 : 0) | ((reg & 8) ? 4 : 0)
+		| ((base & 8) ? 1 : 0);
+
+	if (prefix != 0) emit_byte(as, prefix);
+	if (rex != 0x40) emit_byte(as, rex);
+	emit(as, (const uint8_t *)opcode, strlen(opcode));
+
+	/* always a disp32, with a SIB byte for an index or RSP and R12 */
+	if (index != -1) {
+		int ss = scale == 8 ? 3 : scale == 4 ? 2 : scale == 2 ? 1 : 0;
+
+		emit_byte(as, 0x80 | (reg & 7) << 3 | 4);
+		emit_byte(as, ss << 6 | (index & 7) << 3 | (base & 7));
+	} else {
+		emit_byte(as, 0x80 | (reg & 7) << 3 | (base & 7));
+		if ((base & 7) == RSP) emit_byte(as, 0x24);
+	}
+	emit_dword(as, (uint32_t)disp);
+}
+
+static void emit(struct assembler *as, const uint8_t *bytes, int count)
+{
+	if (as->count + count > as->size) {
+		while (as->count + count > as->size)
+			as->size = as->size == 0 ? 4096 : as->size * 2;
+		as->bytes = realloc(as->bytes, as->size);
+		ASSERT(as->bytes != NULL, "Unable to grow the JIT buffer.");
+	}
+	memcpy(&as->bytes[as->count], bytes, count);
+	as->count += count;
+}
+
+static void emit_byte(struct assembler *as, uint8_t byte)
+{
+	emit(as, &byte, 1);
+}
+
+static void emit_dword(struct assembler *as, uint32_t dword)
+{
+	emit(as, (const uint8_t *)&dword, sizeof(dword));
+}
+
+static void emit_qword(struct assembler *as, uint64_t qword)
+{
+	emit(as, (const uint8_t *)&qword, sizeof(qword));
+}
+
+static int read_short(const struct lump *lmp, int offset)
+{
+	return lmp->array[offset + 1] << 8 | lmp->array[offset + 2];
+}
+
+static uint8_t *map_code(struct jit *jit, const struct assembler *as)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	size_t size = (as->count + page_size - 1) / page_size * page_size;
+	uint8_t *code = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (code == MAP_FAILED) return NULL;
+
+	memcpy(code, as->bytes, as->count);
+	/* never writable and executable at once */
+	if (mprotect(code, size, PROT_READ | PROT_EXEC) == -1) {
+		munmap(code, size);
+		return NULL;
+	}
+
+	if (jit->region_count == jit->region_size) {
+		jit->region_size = jit->region_size == 0 ? 8
+			: jit->region_size * 2;
+		jit->regions = realloc(jit->regions, jit->region_size
+				       * sizeof(struct jit_region));
+		ASSERT(jit->regions != NULL, "Unable to grow the JIT regions.");
+	}
+	jit->regions[jit->region_count++] = (struct jit_region){code, size};
+	jit->native_bytes += as->count;
+	return code;
+}
+
+static void make_enter(struct jit *jit)
+{
+	struct assembler as = {0};
+
+	/* Save the callee-saved registers, five pushes leaving the stack
+	 * pointer 16 byte aligned, and load the frame. The exit of each
+	 * region restores them. */
+	EMIT(&as, "\x53\x41\x54\x41\x55\x41\x56\x41\x57");
+	/* mov r15, rdi */
+	EMIT(&as, "\x49\x89\xFF");
+	MEM(&as, 0, 1, "\x8B", STACK, FRAME,
+	    (int)offsetof(struct jit_frame, stack_top));
+	MEM(&as, 0, 1, "\x8B", SLOTS, FRAME,
+	    (int)offsetof(struct jit_frame, slots));
+	MEM(&as, 0, 1, "\x8B", GLOBALS, FRAME,
+	    (int)offsetof(struct jit_frame, globals));
+	/* jmp rsi */
+	EMIT(&as, "\xFF\xE6");
+
+	uint8_t *code = map_code(jit, &as);
+
+	free(as.bytes);
+	if (code != NULL)
+		jit->enter = (int (*)(struct jit_frame *, void *))code;
+}
+
+#else
+
+void jit_init(struct jit *jit, struct lump *lmp, int is_enabled)
+{
+	(void)is_enabled;
+	*jit = (struct jit){.lump = lmp};
+}
+
+void jit_free(struct jit *jit)
+{
+	*jit = (struct jit){0};
+}
+
+void *jit_compile(struct jit *jit, int offset)
+{
+	(void)jit;
+	(void)offset;
+	return NULL;
+}
+
+void jit_report(const struct jit *jit, FILE *out)
+{
+	(void)jit;
+	fprintf(out, "jit compiled regions: 0, not built\n");
+}
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "lump.h"
+#include "src/value.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * A baseline template JIT for x86-64 Linux, built when VM_JIT is
+ * defined. A function, or the top level, is compiled once the
+ * interpreter entered it, looped back in it or returned to it
+ * JIT_THRESHOLD times. Each of its codes is copied from a machine code
+ * template into a buffer mapped writable, then executable only.
+ *
+ * The native code works on the interpreter's value stack and slots, so
+ * it can hand back at any code: it returns the offset of the first one
+ * it does not run, which the interpreter runs and continues from. It
+ * does so for the codes without a template, calls, returns and
+ * allocations among them, and for a template's slow path: an error, a
+ * failed guard of a quickened code. Nothing it runs allocates, so the
+ * collector never runs under it.
+ *
+ * Builds tracing execution leave it disabled, the trace following the
+ * interpreted codes only.
+ */
+
+/* Entries of a function or a loop before it is compiled. */
+#define JIT_THRESHOLD 1000
+
+/* What native code reads of the interpreter, and the stack it leaves. */
+struct jit_frame {
+	struct value *stack_top;
+	struct value *slots;
+	struct value *globals;
+};
+
+/* A buffer of native code, mapped on its own. */
+struct jit_region {
+	uint8_t *code;
+	size_t size;
+};
+
+struct jit {
+	struct lump *lump;
+	/* Native code of each code offset, NULL when not compiled. NULL
+	 * itself when the JIT is disabled. */
+	void **entries;
+	/* entries counted at each offset towards JIT_THRESHOLD */
+	uint32_t *counters;
+	/* whether the top level, then each function, was compiled */
+	uint8_t *is_tried;
+	/* saves the interpreter's registers and jumps to native code */
+	int (*enter)(struct jit_frame *frame, void *native);
+	struct jit_region *regions;
+	int region_count;
+	int region_size;
+	/* reported when built with DEBUG_PROFILE_EXECUTION */
+	size_t native_bytes;
+	long runs;
+};
+
+/* Prepare to compile the codes of `lmp`, unless `is_enabled` is 0 or
+ * the JIT is not built, which leaves `entries` NULL. */
+void jit_init(struct jit *jit, struct lump *lmp, int is_enabled);
+void jit_free(struct jit *jit);
+/* Compile the function holding the code at `offset`, or the top level.
+ * Return the native code of `offset`, or NULL when it has none. */
+void *jit_compile(struct jit *jit, int offset);
+void jit_report(const struct jit *jit, FILE *out);
+
+/* Run the native code of the code at `pc`, counting the entry towards
+ * compiling it when there is none. Return where the interpreter
+ * continues, `pc` itself when nothing ran. */
+static inline uint8_t *jit_run(struct jit *jit, uint8_t *pc,
+			       struct value **stack_top, struct value *slots,
+			       struct value *globals)
+{
+	int offset = (int)(pc - jit->lump->array);
+	void *native = jit->entries[offset];
+
+	if (native == NULL) {
+		if (++jit->counters[offset] != JIT_THRESHOLD) return pc;
+		native = jit_compile(jit, offset);
+		if (native == NULL) return pc;
+	}
+
+	struct jit_frame frame = {*stack_top, slots, globals};
+
+	offset = jit->enter(&frame, native);
+	jit->runs++;
+	*stack_top = frame.stack_top;
+	return jit->lump->array + offset;
+}
@@ -23,21 +23,34 @@
 
 #include "lump.h"
 #include "constant_vector.h"
+#include "match_vector.h"
+#include "heap.h"
 #include "src/macros.h"
 
 #include <stdlib.h>
 
+/* Return how deep the codes from `start` to `end` push the stack, from
+ * an initial `depth`. Function bodies in between are skipped, they only
+ * run through calls. */
+static int stack_depth(struct lump *lmp, int start, int end, int depth);
+/* Return how many values the code at `offset` pushes on the stack,
+ * negative when it pops more than it pushes. Set `operand_size` to the
+ * number of operand bytes following the code. */
+static int code_stack_effect(struct lump *lmp, int offset, int *operand_size);
 static void lump_grow(struct lump *lmp);
+/* Return the size of the jump code `code` with its operands, its
+ * distance being the last two bytes. */
+static int jump_size(enum op_code code);
+/* Add a loop's code taking a two byte slot and a two byte distance.
+ * Return the code's offset. */
+static int add_for_code(struct lump *lmp, enum op_code code, uint16_t slot,
+			uint16_t distance);
 /* Add a code to a lump that does not take arguments. */
 static void lump_add_code_niladic(struct lump *l,
 				  enum op_code code);
-/* Add a code to a lump that takes one byte argument. */
-static void lump_add_code_monadic(struct lump *l,
-				  enum op_code code, uint8_t val);
-/* Add a code to a lump that takes two byte arguments. `val` is stored
- * as a big-endian sequence. */
-static void lump_add_code_dyladic(struct lump *l,
-				  enum op_code code, uint16_t val);
+/* Record the current line for the code about to be added at `offset`,
+ * when it differs from the previous code's. */
+static void add_line(struct lump *lmp, int offset);
 
 struct lump *lump_init()
 {
@@ -49,6 +62,18 @@ struct lump *lump_init()
 	lmp->size = LUMP_BUFFER_COUNT * sizeof(uint8_t);
 	lmp->array = malloc(lmp->size);
 	lmp->constants = constant_vector_init();
+	lmp->functions = function_vector_init();
+	lmp->strings = string_table_init();
+	lmp->formats = format_vector_init();
+	lmp->matches = match_vector_init();
+	lmp->lines = NULL;
+	lmp->line_count = 0;
+	lmp->line_size = 0;
+	lmp->line = 0;
+	lmp->max_stack = 0;
+	lmp->global_count = 0;
+	lmp->frame_size = 0;
+	lmp->elided_count = 0;
 
 	ASSERT(lmp->array != NULL, "Unable to allocate memory for lump.");
 
@@ -58,25 +83,238 @@ struct lump *lump_init()
 void lump_free(struct lump *lmp)
 {
 	constant_vector_free(lmp->constants);
+	function_vector_free(lmp->functions);
+	string_table_free(lmp->strings);
+	format_vector_free(lmp->formats);
+	match_vector_free(lmp->matches);
+	free(lmp->lines);
 	free(lmp->array);
 	free(lmp);
 	lmp = NULL;
 }
 
+void lump_set_line(struct lump *lmp, int line)
+{
+	lmp->line = line;
+}
+
+int lump_line_at(const struct lump *lmp, int offset)
+{
+	int low = 0, high = lmp->line_count - 1, line = 0;
+
+	/* the last entry at or before `offset` */
+	while (low <= high) {
+		int mid = (low + high) / 2;
+
+		if (lmp->lines[mid].offset <= offset) {
+			line = lmp->lines[mid].line;
+			low = mid + 1;
+		} else {
+			high = mid - 1;
+		}
+	}
+	return line;
+}
+
 int lump_add_code(struct lump *lmp, enum op_code code)
 {
 	lump_add_code_niladic(lmp, code);
 	return lmp->count - 1;
 }
 
-int lump_add_constant(struct lump *lmp, double d)
+int lump_add_code_monadic(struct lump *lmp, enum op_code code, uint8_t val)
+{
+	add_line(lmp, lmp->count);
+	if (lmp->count + 1 >= (lmp->size / sizeof(uint8_t)))
+		lump_grow(lmp);
+
+	lmp->array[lmp->count] = code;
+	lmp->array[lmp->count + 1] = val;
+	lmp->count += 2;
+
+	return lmp->count - 2;
+}
+
+int lump_add_code_dyladic(struct lump *lmp, enum op_code code, uint16_t val)
+{
+	add_line(lmp, lmp->count);
+	if (lmp->count + 2 >= (lmp->size / sizeof(uint8_t)))
+		lump_grow(lmp);
+
+	lmp->array[lmp->count] = code;
+	lmp->array[lmp->count + 1] = val >> 8;
+	lmp->array[lmp->count + 2] = val & 0x00FF;
+	lmp->count += 3;
+
+	return lmp->count - 3;
+}
+
+int lump_add_code_triadic(struct lump *lmp, enum op_code code, uint8_t val1,
+			  uint16_t val2)
+{
+	add_line(lmp, lmp->count);
+	if (lmp->count + 3 >= (lmp->size / sizeof(uint8_t)))
+		lump_grow(lmp);
+
+	lmp->array[lmp->count] = code;
+	lmp->array[lmp->count + 1] = val1;
+	lmp->array[lmp->count + 2] = val2 >> 8;
+	lmp->array[lmp->count + 3] = val2 & 0x00FF;
+	lmp->count += 4;
+
+	return lmp->count - 4;
+}
+
+void lump_rewind(struct lump *lmp, int offset)
+{
+	if (offset >= 0 && offset < lmp->count)
+		lmp->count = offset;
+	while (lmp->line_count > 0
+	       && lmp->lines[lmp->line_count - 1].offset >= lmp->count)
+		lmp->line_count--;
+}
+
+int lump_add_jump(struct lump *lmp, enum op_code code)
+{
+	return lump_add_code_dyladic(lmp, code, 0xFFFF);
+}
+
+int lump_add_for_prep(struct lump *lmp, enum op_code code, uint16_t slot)
+{
+	return add_for_code(lmp, code, slot, 0xFFFF);
+}
+
+int lump_add_loop(struct lump *lmp, enum op_code code, uint16_t slot,
+		  int target)
+{
+	int size = (code == OP_LOOP) ? 3 : 5;
+	int distance = lmp->count + size - target;
+
+	if (distance > 0xFFFF) return 0;
+
+	if (code == OP_LOOP)
+		lump_add_code_dyladic(lmp, code, distance);
+	else
+		add_for_code(lmp, code, slot, distance);
+	return 1;
+}
+
+int lump_patch_jump(struct lump *lmp, int offset)
+{
+	int size = jump_size(lmp->array[offset]);
+	/* the distance is counted from the code after the jump */
+	int distance = lmp->count - offset - size;
+
+	if (distance > 0xFFFF) return 0;
+
+	lmp->array[offset + size - 2] = distance >> 8;
+	lmp->array[offset + size - 1] = distance & 0x00FF;
+	return 1;
+}
+
+int lump_add_jump_table(struct lump *lmp, int32_t min, uint16_t count)
+{
+	int offset = lmp->count;
+
+	lump_add_code_niladic(lmp, OP_JUMP_TABLE);
+	for (int shift = 24; shift >= 0; shift -= 8)
+		lump_add_code_niladic(lmp, (uint32_t)min >> shift & 0xFF);
+	lump_add_code_niladic(lmp, count >> 8);
+	lump_add_code_niladic(lmp, count & 0xFF);
+	for (int i = 0; i <= count; i++) {
+		lump_add_code_niladic(lmp, 0xFF);
+		lump_add_code_niladic(lmp, 0xFF);
+	}
+	return offset;
+}
+
+int lump_patch_jump_table(struct lump *lmp, int offset, int entry)
+{
+	int distance = lmp->count - LUMP_JUMP_TABLE_END(lmp, offset);
+
+	if (distance > 0xFFFF) return 0;
+
+	lmp->array[offset + 7 + 2 * entry] = distance >> 8;
+	lmp->array[offset + 8 + 2 * entry] = distance & 0x00FF;
+	return 1;
+}
+
+int lump_jump_table_target(struct lump *lmp, int offset, int entry)
+{
+	return LUMP_JUMP_TABLE_END(lmp, offset)
+		+ (lmp->array[offset + 7 + 2 * entry] << 8
+		   | lmp->array[offset + 8 + 2 * entry]);
+}
+
+int lump_jump_target(struct lump *lmp, int offset)
+{
+	int size = jump_size(lmp->array[offset]);
+	int distance = lmp->array[offset + size - 2] << 8
+		| lmp->array[offset + size - 1];
+
+	switch (lmp->array[offset]) {
+	case OP_LOOP:
+	case OP_FOR_RANGE_STEP:
+	case OP_FOR_ARRAY_STEP:
+	case OP_FOR_MAP_STEP:
+		return offset + size - distance;
+	default:
+		return offset + size + distance;
+	}
+}
+
+void lump_patch_code(struct lump *lmp, int offset, enum op_code code)
+{
+	lmp->array[offset] = code;
+}
+
+int lump_frame_recipe(struct lump *lmp, int function, int offset)
+{
+	int *frame_size = (function == -1) ? &lmp->frame_size
+		: &lmp->functions->array[function].frame_size;
+	int size = lmp->array[offset + 1] << 8 | lmp->array[offset + 2];
+	int blocks = (sizeof(struct object) + size + HEAP_ALIGN - 1)
+		/ HEAP_ALIGN;
+
+	if (*frame_size + blocks * HEAP_ALIGN > FUNCTION_FRAME_MAX) return 0;
+
+	lmp->array[offset] = OP_NEW_RECIPE_FRAME;
+	lmp->array[offset + 1] = *frame_size / HEAP_ALIGN;
+	lmp->array[offset + 2] = blocks;
+	*frame_size += blocks * HEAP_ALIGN;
+	lmp->elided_count++;
+	return 1;
+}
+
+int lump_next_code(struct lump *lmp, int offset)
+{
+	int operand_size = 0;
+	code_stack_effect(lmp, offset, &operand_size);
+	return offset + 1 + operand_size;
+}
+
+int lump_compute_max_stack(struct lump *lmp)
+{
+	struct function_vector *fa = lmp->functions;
+
+	/* A function's arguments are its first slots. */
+	for (int i = 0; i < fa->count; i++) {
+		struct function *fn = &fa->array[i];
+		fn->max_stack = stack_depth(lmp, fn->offset, fn->end, fn->arity);
+	}
+
+	lmp->max_stack = stack_depth(lmp, 0, lmp->count, 0);
+	return lmp->max_stack;
+}
+
+int lump_add_constant(struct lump *lmp, struct value d)
 {
 	int const_offset = constant_vector_add(lmp->constants, d);
 
         /* OP_CONSTANT_LONG holds two bytes for the constant's offset
 	 * above two bytes, the constants are dropped */
 	if (const_offset >= 0xFFFF) {
-		fprintf(stderr, "Max constant count reached. Dropping %f.\n", d);
+		fprintf(stderr, "Max constant count reached. Dropping constant.\n");
 		return const_offset;
 	}
 
@@ -98,6 +336,7 @@ static void lump_grow(struct lump *lmp)
 
 static void lump_add_code_niladic(struct lump *lmp, enum op_code code)
 {
+	add_line(lmp, lmp->count);
 	if (lmp->count == (lmp->size / sizeof(uint8_t)))
 		lump_grow(lmp);
 	
@@ -105,25 +344,341 @@ static void lump_add_code_niladic(struct lump *lmp, enum op_code code)
 	lmp->count++;
 }
 
-static void lump_add_code_monadic(struct lump *lmp,
-				  enum op_code code, uint8_t val)
+static int stack_depth(struct lump *lmp, int start, int end, int depth)
 {
-	if (lmp->count + 1 >= (lmp->size / sizeof(uint8_t)))
-		lump_grow(lmp);
+	struct function_vector *fa = lmp->functions;
+	int max = depth, next = 0, is_jumped_over = 0;
+	/* The depth forward jumps land at, plus one, 0 when none does.
+	 * Code following an unconditional jump is only reached through
+	 * them, a break having popped the locals it jumps out of. */
+	int *landings = calloc(end - start + 1, sizeof(int));
 
-	lmp->array[lmp->count] = code;
-	lmp->array[lmp->count + 1] = val;
-	lmp->count += 2;
+	ASSERT(landings != NULL, "Unable to allocate the jump landings.");
+
+	while (next < fa->count && fa->array[next].offset <= start)
+		next++;
+
+	for (int offset = start; offset < end; offset++) {
+		if (next < fa->count && offset == fa->array[next].offset) {
+			offset = fa->array[next++].end - 1;
+			continue;
+		}
+
+		if (is_jumped_over && landings[offset - start] > 0)
+			depth = landings[offset - start] - 1;
+
+		int code = lmp->array[offset], operand_size = 0;
+		depth += code_stack_effect(lmp, offset, &operand_size);
+
+		switch (code) {
+		case OP_JUMP:
+		case OP_JUMP_IF_FALSE:
+		case OP_JUMP_IF_TRUE:
+		case OP_JUMP_IF_EQUAL_INT:
+		case OP_JUMP_IF_NOT_EQUAL_INT:
+		case OP_JUMP_IF_GREATER_INT:
+		case OP_JUMP_IF_GREATER_EQUAL_INT:
+		case OP_JUMP_IF_LESS_INT:
+		case OP_JUMP_IF_LESS_EQUAL_INT:
+		case OP_FOR_RANGE_PREP:
+		case OP_FOR_ARRAY_PREP:
+		case OP_FOR_MAP_PREP: {
+			int target = lump_jump_target(lmp, offset);
+			if (target <= end) landings[target - start] = depth + 1;
+			break;
+		}
+		/* jumping with the value it pops otherwise */
+		case OP_JUMP_IF_FALSE_OR_POP:
+		case OP_JUMP_IF_TRUE_OR_POP: {
+			int target = lump_jump_target(lmp, offset);
+			if (target <= end) landings[target - start] = depth + 2;
+			break;
+		}
+		case OP_JUMP_TABLE:
+			for (int i = 0; i <= LUMP_JUMP_TABLE_COUNT(lmp, offset); i++) {
+				int target = lump_jump_table_target(lmp, offset, i);
+				if (target <= end)
+					landings[target - start] = depth + 1;
+			}
+			break;
+		case OP_MATCH: {
+			struct match *match = &lmp->matches->array[
+				lmp->array[offset + 1] << 8 | lmp->array[offset + 2]];
+
+			for (int i = 0; i <= match->count; i++) {
+				int target = i < match->count ? match->targets[i]
+					: match->otherwise;
+				if (target <= end)
+					landings[target - start] = depth + 1;
+			}
+			break;
+		}
+		}
+
+		is_jumped_over = (code == OP_JUMP || code == OP_LOOP
+				  || code == OP_JUMP_TABLE || code == OP_MATCH
+				  || code == OP_RETURN || code == OP_RETURN_VOID
+				  || code == OP_TAIL_CALL);
+		offset += operand_size;
+
+		if (depth > max) max = depth;
+	}
+
+	free(landings);
+	return max;
 }
 
-static void lump_add_code_dyladic(struct lump *lmp,
-				  enum op_code code, uint16_t val)
+static int code_stack_effect(struct lump *lmp, int offset, int *operand_size)
 {
-	if (lmp->count + 2 >= (lmp->size / sizeof(uint8_t)))
+	*operand_size = 0;
+
+	switch (lmp->array[offset]) {
+	case OP_CONSTANT:
+		*operand_size = 1;
+		return 1;
+	case OP_CONSTANT_LONG:
+		*operand_size = 2;
+		return 1;
+	case OP_INT_TO_FLOAT:
+	case OP_TO_FLOAT:
+	case OP_ARRAY_MATH:
+		*operand_size = 1;
+		return 0;
+	case OP_GET_GLOBAL:
+	case OP_GET_LOCAL:
+		*operand_size = 1;
+		return 1;
+	case OP_GET_GLOBAL_LONG:
+	case OP_GET_LOCAL_LONG:
+	case OP_REF_LOCAL:
+	case OP_REF_GLOBAL:
+	case OP_GET_REF:
+		*operand_size = 2;
+		return 1;
+	case OP_SET_GLOBAL:
+	case OP_SET_LOCAL:
+		*operand_size = 1;
+		return -1;
+	case OP_SET_GLOBAL_LONG:
+	case OP_SET_LOCAL_LONG:
+	case OP_SET_REF:
+		*operand_size = 2;
+		return -1;
+	case OP_JUMP:
+		*operand_size = 2;
+		return 0;
+	case OP_JUMP_IF_FALSE:
+	case OP_JUMP_IF_TRUE:
+	case OP_JUMP_IF_FALSE_OR_POP:
+	case OP_JUMP_IF_TRUE_OR_POP:
+		*operand_size = 2;
+		return -1;
+	case OP_JUMP_IF_EQUAL_INT:
+	case OP_JUMP_IF_NOT_EQUAL_INT:
+	case OP_JUMP_IF_GREATER_INT:
+	case OP_JUMP_IF_GREATER_EQUAL_INT:
+	case OP_JUMP_IF_LESS_INT:
+	case OP_JUMP_IF_LESS_EQUAL_INT:
+		*operand_size = 2;
+		return -2;
+	case OP_LOOP:
+		*operand_size = 2;
+		return 0;
+	/* pops the index */
+	case OP_JUMP_TABLE:
+		*operand_size = LUMP_JUMP_TABLE_END(lmp, offset) - offset - 1;
+		return -1;
+	case OP_MATCH:
+		*operand_size = 2;
+		return -1;
+	case OP_FOR_RANGE_PREP:
+	case OP_FOR_RANGE_STEP:
+	case OP_FOR_ARRAY_PREP:
+	case OP_FOR_ARRAY_STEP:
+	case OP_FOR_MAP_PREP:
+	case OP_FOR_MAP_STEP:
+		*operand_size = 4;
+		return 0;
+	/* The arguments are replaced by the returned value, if any. */
+	case OP_CALL:
+	case OP_TAIL_CALL: {
+		*operand_size = 2;
+		struct function *fn = &lmp->functions->array[
+			lmp->array[offset + 1] << 8 | lmp->array[offset + 2]];
+		if (lmp->array[offset] == OP_TAIL_CALL)
+			return -fn->arity;
+		return fn->returns_value - fn->arity;
+	}
+	case OP_NEW_RECIPE:
+	case OP_NEW_RECIPE_FRAME:
+		*operand_size = 2;
+		return 1;
+	case OP_GET_FIELD_INT:
+	case OP_GET_FIELD_BYTE:
+	case OP_GET_FIELD_SBYTE:
+	case OP_GET_FIELD_FLOAT:
+	case OP_GET_FIELD_BOOL:
+		*operand_size = 2;
+		return 0;
+	/* pops the value and the instance */
+	case OP_SET_FIELD_INT:
+	case OP_SET_FIELD_BYTE:
+	case OP_SET_FIELD_SBYTE:
+	case OP_SET_FIELD_FLOAT:
+	case OP_SET_FIELD_BOOL:
+		*operand_size = 2;
+		return -2;
+	/* pops the length */
+	case OP_NEW_ARRAY:
+		*operand_size = 1;
+		return 0;
+	/* pops the elements */
+	case OP_ARRAY_LITERAL:
+		*operand_size = 3;
+		return 1 - (lmp->array[offset + 2] << 8 | lmp->array[offset + 3]);
+	/* pops the index */
+	case OP_GET_INDEX_INT:
+	case OP_GET_INDEX_BYTE:
+	case OP_GET_INDEX_SBYTE:
+	case OP_GET_INDEX_FLOAT:
+	case OP_GET_INDEX_BOOL:
+	case OP_GET_INDEX_VALUE:
+		return -1;
+	/* pops the value, the index and the array */
+	case OP_SET_INDEX_INT:
+	case OP_SET_INDEX_BYTE:
+	case OP_SET_INDEX_SBYTE:
+	case OP_SET_INDEX_FLOAT:
+	case OP_SET_INDEX_BOOL:
+	case OP_SET_INDEX_VALUE:
+		return -3;
+	/* the index is read from its slot */
+	case OP_GET_INDEX_INT_UNCHECKED:
+	case OP_GET_INDEX_BYTE_UNCHECKED:
+	case OP_GET_INDEX_SBYTE_UNCHECKED:
+	case OP_GET_INDEX_FLOAT_UNCHECKED:
+	case OP_GET_INDEX_BOOL_UNCHECKED:
+	case OP_GET_INDEX_VALUE_UNCHECKED:
+		*operand_size = 2;
+		return 0;
+	case OP_SET_INDEX_INT_UNCHECKED:
+	case OP_SET_INDEX_BYTE_UNCHECKED:
+	case OP_SET_INDEX_SBYTE_UNCHECKED:
+	case OP_SET_INDEX_FLOAT_UNCHECKED:
+	case OP_SET_INDEX_BOOL_UNCHECKED:
+	case OP_SET_INDEX_VALUE_UNCHECKED:
+		*operand_size = 2;
+		return -2;
+	case OP_ARRAY_LENGTH:
+	case OP_ARRAY_SUM:
+	case OP_ARRAY_MIN:
+	case OP_ARRAY_MAX:
+		return 0;
+	case OP_ARRAY_FILL:
+	case OP_ARRAY_COPY:
+		return -2;
+	case OP_ARRAY_SLICE:
+		return -2;
+	/* pops the keys and values */
+	case OP_MAP_LITERAL:
+		*operand_size = 2;
+		return 1 - 2 * (lmp->array[offset + 1] << 8
+				| lmp->array[offset + 2]);
+	/* pops the key */
+	case OP_GET_KEY:
+	case OP_MAP_HAS:
+		return -1;
+	/* pops the value, the key and the map */
+	case OP_SET_KEY:
+		return -3;
+	case OP_MAP_LENGTH:
+		return 0;
+	case OP_PRINT:
+		*operand_size = 1;
+		return -1;
+	case OP_PRINT_FORMAT:
+		*operand_size = 3;
+		return -lmp->formats->array[lmp->array[offset + 2] << 8
+					    | lmp->array[offset + 3]].argc;
+	case OP_FORMAT:
+		*operand_size = 2;
+		return 1 - lmp->formats->array[lmp->array[offset + 1] << 8
+					       | lmp->array[offset + 2]].argc;
+	/* pops the strings but the first, replaced by the result */
+	case OP_CONCAT:
+		*operand_size = 2;
+		return 1 - (lmp->array[offset + 1] << 8 | lmp->array[offset + 2]);
+	case OP_RETURN:
+	case OP_POP:
+		return -1;
+	case OP_RETURN_VOID:
+	case OP_END_PROGRAM:
+	case OP_LOGICAL_NOT:
+	case OP_TO_BOOL:
+	case OP_NEGATE:
+	case OP_NEGATE_INT:
+	case OP_NEGATE_FLOAT:
+	case OP_MATH_SQRT:
+	case OP_MATH_FLOOR:
+	case OP_MATH_CEIL:
+	case OP_MATH_SIN:
+	case OP_MATH_COS:
+	case OP_MATH_EXP:
+	case OP_MATH_LOG:
+		return 0;
+	/* every other code is a binary operation */
+	default:
+		return -1;
+	}
+}
+
+static int jump_size(enum op_code code)
+{
+	switch (code) {
+	case OP_FOR_RANGE_PREP:
+	case OP_FOR_RANGE_STEP:
+	case OP_FOR_ARRAY_PREP:
+	case OP_FOR_ARRAY_STEP:
+	case OP_FOR_MAP_PREP:
+	case OP_FOR_MAP_STEP:
+		return 5;
+	default:
+		return 3;
+	}
+}
+
+static int add_for_code(struct lump *lmp, enum op_code code, uint16_t slot,
+			uint16_t distance)
+{
+	add_line(lmp, lmp->count);
+	if (lmp->count + 4 >= (lmp->size / sizeof(uint8_t)))
 		lump_grow(lmp);
 
 	lmp->array[lmp->count] = code;
-	lmp->array[lmp->count + 1] = val >> 8;
-	lmp->array[lmp->count + 2] = val & 0x00FF;
-	lmp->count += 3;
+	lmp->array[lmp->count + 1] = slot >> 8;
+	lmp->array[lmp->count + 2] = slot & 0x00FF;
+	lmp->array[lmp->count + 3] = distance >> 8;
+	lmp->array[lmp->count + 4] = distance & 0x00FF;
+	lmp->count += 5;
+
+	return lmp->count - 5;
+}
+
+static void add_line(struct lump *lmp, int offset)
+{
+	if (lmp->line_count > 0
+	    && lmp->lines[lmp->line_count - 1].line == lmp->line)
+		return;
+
+	if (lmp->line_count == lmp->line_size) {
+		lmp->line_size = lmp->line_size == 0 ? LUMP_BUFFER_COUNT
+			: lmp->line_size * 2;
+		lmp->lines = realloc(lmp->lines,
+				     lmp->line_size * sizeof(struct lump_line));
+		ASSERT(lmp->lines != NULL, "Unable to grow the lump's lines.");
+	}
+	lmp->lines[lmp->line_count++] = (struct lump_line){
+		.offset = offset,
+		.line = lmp->line
+	};
 }
@@ -25,22 +25,123 @@
 
 #include "opcode.h"
 #include "constant_vector.h"
+#include "function_vector.h"
+#include "string_table.h"
+#include "format_vector.h"
+#include "src/value.h"
 
 #include <stdint.h>
 
+/* see match_vector.h, kept out of the compiler's includes */
+struct match_vector;
+
+/* The codes from `offset` come from the source's `line`. */
+struct lump_line {
+	int offset;
+	int line;
+};
+
 struct lump {
 	uint8_t *array;
 	int size;
 	int count;
 	struct constant_vector *constants;
+	struct function_vector *functions;
+	/* the string literals, interned so equal ones are one object */
+	struct string_table *strings;
+	/* the formats of print and str.fmt, parsed by the compiler */
+	struct format_vector *formats;
+	/* the cases of the OP_MATCH codes */
+	struct match_vector *matches;
+	/* An entry where the line of the codes changes, runtime errors
+	 * being reported at the line of their code. */
+	struct lump_line *lines;
+	int line_count;
+	int line_size;
+	/* line of the codes being added, set by `lump_set_line()` */
+	int line;
+	/* Deepest the value stack gets while running the lump, set by
+	 * `lump_compute_max_stack()`. */
+	int max_stack;
+	/* number of global slots the lump uses */
+	int global_count;
+	/* the top level's `frame_size`, see `struct function` */
+	int frame_size;
+	/* recipe allocations the compiler moved to frames */
+	int elided_count;
 };
 
 #define LUMP_BUFFER_COUNT 8
 
+/* The operands of the OP_JUMP_TABLE at `offset`. */
+#define LUMP_JUMP_TABLE_MIN(lmp, offset)				\
+	((int32_t)((uint32_t)(lmp)->array[(offset) + 1] << 24		\
+		   | (uint32_t)(lmp)->array[(offset) + 2] << 16		\
+		   | (uint32_t)(lmp)->array[(offset) + 3] << 8		\
+		   | (uint32_t)(lmp)->array[(offset) + 4]))
+#define LUMP_JUMP_TABLE_COUNT(lmp, offset)				\
+	((lmp)->array[(offset) + 5] << 8 | (lmp)->array[(offset) + 6])
+/* the offset of the code following the table */
+#define LUMP_JUMP_TABLE_END(lmp, offset)				\
+	((offset) + 9 + 2 * LUMP_JUMP_TABLE_COUNT(lmp, offset))
+
 struct lump *lump_init();
 void lump_free(struct lump *lmp);
 
+/* Make the codes added from now on come from `line`. */
+void lump_set_line(struct lump *lmp, int line);
+/* Return the source line of the code at `offset`, 0 when unknown. */
+int lump_line_at(const struct lump *lmp, int offset);
 /* Return the code's offset. */
 int lump_add_code(struct lump *lmp, enum op_code code);
+/* Add a code that takes a one byte operand. Return the code's offset. */
+int lump_add_code_monadic(struct lump *lmp, enum op_code code, uint8_t val);
+/* Add a code that takes a two byte operand, stored as a big-endian
+ * sequence. Return the code's offset. */
+int lump_add_code_dyladic(struct lump *lmp, enum op_code code, uint16_t val);
+/* Add a code that takes a one byte operand followed by a two byte
+ * one. Return the code's offset. */
+int lump_add_code_triadic(struct lump *lmp, enum op_code code, uint8_t val1,
+			  uint16_t val2);
+/* Add a jump whose distance is set later by `lump_patch_jump()`.
+ * Return the code's offset. */
+int lump_add_jump(struct lump *lmp, enum op_code code);
+/* Add a loop's _PREP code over the slots from `slot`. Its distance is
+ * set later by `lump_patch_jump()`. Return the code's offset. */
+int lump_add_for_prep(struct lump *lmp, enum op_code code, uint16_t slot);
+/* Add OP_LOOP, or a loop's _STEP code over the slots from `slot`,
+ * jumping back to `target`. Return 0 if it is too far to be encoded. */
+int lump_add_loop(struct lump *lmp, enum op_code code, uint16_t slot,
+		  int target);
+/* Make the jump at `offset` land on the next code to be added. Return 0
+ * if it is too far to be encoded. */
+int lump_patch_jump(struct lump *lmp, int offset);
+/* Return the offset the jump at `offset` lands on. */
+int lump_jump_target(struct lump *lmp, int offset);
+/* Add an OP_JUMP_TABLE for the ints from `min`, its `count` entries
+ * and the last one set later by `lump_patch_jump_table()`. Return the
+ * code's offset. */
+int lump_add_jump_table(struct lump *lmp, int32_t min, uint16_t count);
+/* Make the entry `entry` of the table at `offset` land on the next
+ * code to be added. Return 0 if it is too far to be encoded. */
+int lump_patch_jump_table(struct lump *lmp, int offset, int entry);
+/* Return the offset the entry `entry` of the table at `offset` lands
+ * on. */
+int lump_jump_table_target(struct lump *lmp, int offset, int entry);
+/* Replace the code at `offset` with one taking the same operands. */
+void lump_patch_code(struct lump *lmp, int offset, enum op_code code);
+/* Make the instance of the OP_NEW_RECIPE at `offset` in the frame of
+ * `function`, or of the top level when -1. Return 0 if the frame is
+ * full. */
+int lump_frame_recipe(struct lump *lmp, int function, int offset);
 /* Return the constant's offset. */
-int lump_add_constant(struct lump *lmp, double value);
+int lump_add_constant(struct lump *lmp, struct value value);
+/* Drop every code from `offset` onwards. */
+void lump_rewind(struct lump *lmp, int offset);
+/* Return the offset of the code following the one at `offset`. */
+int lump_next_code(struct lump *lmp, int offset);
+/* Walk the codes to find how deep they push the value stack, so the
+ * VM can make room once instead of checking every push. Return the
+ * depth, also stored in `max_stack`, after setting the `max_stack` of
+ * every function. */
+int lump_compute_max_stack(struct lump *lmp);
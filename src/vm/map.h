@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "array.h"
+#include "object.h"
+#include "str.h"
+#include "src/value.h"
+
+#include <stdint.h>
+
+/*
+ * Maps keep their entries in insertion order, the key then the value
+ * of each packed in `entries`. `table` holds a sparse index, the
+ * entry of each slot or MAP_EMPTY, probed in CPython's order, then
+ * the hash of each entry, read before heap strings are compared.
+ * Entries are never removed, a full map grows by rebuilding its index
+ * twice as large. Keys are ints, strings and bools. Like CPython, ints
+ * and bools are their own hash, so consecutive keys fill consecutive
+ * slots. A short string is hashed from its word and a heap string has
+ * its hash cached, so interned keys compare without reading their
+ * bytes.
+ *
+ * Shared by the VM and the C emitted by `emit_c()`. Like the kernels
+ * of array.h, the functions return NULL on success or an error
+ * message on failure.
+ */
+
+#define MAP_MIN_SLOTS 8
+#define MAP_EMPTY -1
+#define MAP_PERTURB_SHIFT 5
+/* the entries a map holds before its index is grown */
+#define MAP_USABLE(slots) ((slots) * 2 / 3)
+
+#define MAP_SLOTS(map) ARRAY_DATA((map)->table, int32_t)
+#define MAP_HASHES(map) (MAP_SLOTS(map) + (map)->mask + 1)
+#define MAP_ENTRIES(map) ARRAY_DATA((map)->entries, struct value)
+
+static inline uint32_t map_mix(uint64_t word)
+{
+	word ^= word >> 33;
+	word *= 0xff51afd7ed558ccdULL;
+	word ^= word >> 33;
+	return (uint32_t)word;
+}
+
+static inline const char *map_hash(const struct value *key, uint32_t *hash)
+{
+	const struct string *str;
+
+	switch (key->type) {
+	case VALUE_INT:
+		*hash = key->as.integer;
+		return NULL;
+	case VALUE_BOOL:
+		*hash = key->as.bool;
+		return NULL;
+	case VALUE_STRING:
+		if (STRING_IS_SHORT(key)) {
+			*hash = map_mix(key->as.string);
+			return NULL;
+		}
+		if ((str = string_flat(key)) == NULL) return "Out of memory.";
+		*hash = str->hash;
+		return NULL;
+	default:
+		return "Map keys must be ints, strings or bools.";
+	}
+}
+
+/* Only heap strings of the same hash have bytes to compare. Keys were
+ * flattened when hashed, comparing them allocates nothing. */
+static inline int map_key_equal(const struct map *map, int entry,
+				const struct value *key, uint32_t hash)
+{
+	const struct value *other = &MAP_ENTRIES(map)[entry * 2];
+
+	if (other->type != key->type) return 0;
+
+	switch (key->type) {
+	case VALUE_INT: return other->as.integer == key->as.integer;
+	case VALUE_BOOL: return other->as.bool == key->as.bool;
+	default:
+		if (other->as.string == key->as.string) return 1;
+		if (STRING_IS_SHORT(key) || STRING_IS_SHORT(other)
+		    || (uint32_t)MAP_HASHES(map)[entry] != hash)
+			return 0;
+		return string_equal(other, key) == 1;
+	}
+}
+
+/* Return the slot of the index holding `key`, or the empty one where
+ * it would be added. */
+static inline int map_probe(const struct map *map, const struct value *key,
+			    uint32_t hash)
+{
+	const int32_t *slots = MAP_SLOTS(map);
+	uint32_t perturb = hash, i = hash & map->mask;
+
+	for (;;) {
+		int entry = slots[i];
+
+		if (entry == MAP_EMPTY || map_key_equal(map, entry, key, hash))
+			return i;
+		perturb >>= MAP_PERTURB_SHIFT;
+		i = (i * 5 + 1 + perturb) & map->mask;
+	}
+}
+
+/* Called before `entries` and `table` replace those of `map`, like
+ * `array_barrier()` before an element is replaced. */
+static inline const char *map_barrier(struct heap *heap, struct map *map,
+				      struct array *entries,
+				      struct array *table)
+{
+	if (map->object.space != SPACE_OLD) return NULL;
+
+	if (heap->phase == HEAP_MARKING && map->entries != NULL
+	    && !heap_shade(heap, &map->entries->object))
+		return "Out of memory.";
+
+	if (map->object.is_remembered
+	    || (entries->object.space != SPACE_NURSERY
+		&& table->object.space != SPACE_NURSERY))
+		return NULL;
+	return heap_remember(heap, &map->object) ? NULL : "Out of memory.";
+}
+
+/* Double the slots of the index, copying the entries. */
+static inline const char *map_grow(struct map *map, struct heap *heap)
+{
+	int slots = map->table != NULL ? (map->mask + 1) * 2 : MAP_MIN_SLOTS;
+	int usable = MAP_USABLE(slots);
+	struct array *entries, *table;
+	int32_t *index, *hashes;
+	const char *error;
+
+	entries = object_new_array(ARRAY_VALUE, usable * 2, heap);
+	table = object_new_array(ARRAY_INT, slots + usable, heap);
+	if (entries == NULL || table == NULL) return "Out of memory.";
+
+	index = ARRAY_DATA(table, int32_t);
+	hashes = index + slots;
+	memset(index, 0xff, slots * sizeof(int32_t));
+
+	if (map->count > 0) {
+		memcpy(entries->data, map->entries->data,
+		       map->count * 2 * sizeof(struct value));
+		memcpy(hashes, MAP_HASHES(map), map->count * sizeof(int32_t));
+	}
+	/* the keys are distinct, only empty slots are looked for */
+	for (int entry = 0; entry < map->count; entry++) {
+		uint32_t perturb = hashes[entry];
+		uint32_t i = perturb & (slots - 1);
+
+		while (index[i] != MAP_EMPTY) {
+			perturb >>= MAP_PERTURB_SHIFT;
+			i = (i * 5 + 1 + perturb) & (slots - 1);
+		}
+		index[i] = entry;
+	}
+
+	if ((error = map_barrier(heap, map, entries, table)) != NULL) return error;
+	map->entries = entries;
+	map->table = table;
+	map->mask = slots - 1;
+	return NULL;
+}
+
+/* Store in `result` the value of `key`. */
+static inline const char *map_get(const struct map *map,
+				  const struct value *key,
+				  struct value *result)
+{
+	const char *error;
+	uint32_t hash;
+	int entry;
+
+	if ((error = map_hash(key, &hash)) != NULL) return error;
+	if (map->count == 0
+	    || (entry = MAP_SLOTS(map)[map_probe(map, key, hash)])
+	       == MAP_EMPTY)
+		return "Key not found.";
+
+	*result = MAP_ENTRIES(map)[entry * 2 + 1];
+	return NULL;
+}
+
+/* Store in `result` whether `map` holds `key`. */
+static inline const char *map_has(const struct map *map,
+				  const struct value *key,
+				  struct value *result)
+{
+	const char *error;
+	uint32_t hash;
+
+	if ((error = map_hash(key, &hash)) != NULL) return error;
+	*result = GET_VALUE_BOOL(
+		map->count > 0
+		&& MAP_SLOTS(map)[map_probe(map, key, hash)] != MAP_EMPTY);
+	return NULL;
+}
+
+/* Replace the value of `key`, or add it last. */
+static inline const char *map_set(struct map *map, const struct value *key,
+				  const struct value *val, struct heap *heap)
+{
+	struct value *pair;
+	const char *error;
+	uint32_t hash;
+	int slot, entry;
+
+	if ((error = map_hash(key, &hash)) != NULL) return error;
+	if (map->table == NULL && (error = map_grow(map, heap)) != NULL)
+		return error;
+
+	slot = map_probe(map, key, hash);
+	entry = MAP_SLOTS(map)[slot];
+	if (entry != MAP_EMPTY) {
+		pair = &MAP_ENTRIES(map)[entry * 2];
+		if ((error = array_barrier(heap, map->entries, &pair[1], val))
+		    != NULL)
+			return error;
+		pair[1] = *val;
+		return NULL;
+	}
+
+	if (map->count == MAP_USABLE(map->mask + 1)) {
+		if ((error = map_grow(map, heap)) != NULL) return error;
+		slot = map_probe(map, key, hash);
+	}
+
+	entry = map->count++;
+	MAP_SLOTS(map)[slot] = entry;
+	MAP_HASHES(map)[entry] = hash;
+	pair = &MAP_ENTRIES(map)[entry * 2];
+	if ((error = array_barrier(heap, map->entries, &pair[0], key)) != NULL
+	    || (error = array_barrier(heap, map->entries, &pair[1], val))
+	       != NULL)
+		return error;
+	pair[0] = *key;
+	pair[1] = *val;
+	return NULL;
+}
+
+/* Store in `result` a map of the `count` pairs of keys and values at
+ * `values`. */
+static inline const char *map_literal(const struct value *values, int count,
+				      struct heap *heap, struct value *result)
+{
+	struct map *map = object_new_map(heap);
+	const char *error;
+
+	if (map == NULL) return "Out of memory.";
+
+	for (int i = 0; i < count; i++)
+		if ((error = map_set(map, &values[i * 2], &values[i * 2 + 1],
+				     heap)) != NULL)
+			return error;
+	*result = GET_VALUE_MAP(map);
+	return NULL;
+}
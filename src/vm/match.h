@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "map.h"
+#include "str.h"
+#include "src/value.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * The cases of a match too sparse for a jump table, or over strings.
+ * Like a map's, the index is probed in CPython's order from the hash
+ * of the matched value, so finding a case costs the same however many
+ * there are. The keys are ints or strings interned by the compiler.
+ */
+
+#define MATCH_EMPTY -1
+
+struct match {
+	struct value *keys;
+	uint32_t *hashes;
+	/* the offset each key's case starts at */
+	int *targets;
+	int count;
+	/* the key of each slot, or MATCH_EMPTY */
+	int32_t *slots;
+	uint32_t mask;
+	/* the offset landed on when no key matches */
+	int otherwise;
+};
+
+/* Set `target` to the offset `key` lands on. Return NULL on success or
+ * an error message on failure. */
+static inline const char *match_find(const struct match *match,
+				     const struct value *key, int *target)
+{
+	uint32_t hash, perturb, i;
+	const char *error = map_hash(key, &hash);
+
+	if (error != NULL) return error;
+
+	/* hashing flattened the key, comparing it allocates nothing */
+	for (perturb = hash, i = hash & match->mask;;) {
+		int entry = match->slots[i];
+
+		if (entry == MATCH_EMPTY) {
+			*target = match->otherwise;
+			return NULL;
+		}
+		if (match->hashes[entry] == hash
+		    && (key->type == VALUE_INT
+			? match->keys[entry].as.integer == key->as.integer
+			: string_equal(&match->keys[entry], key) == 1)) {
+			*target = match->targets[entry];
+			return NULL;
+		}
+		perturb >>= MAP_PERTURB_SHIFT;
+		i = (i * 5 + 1 + perturb) & match->mask;
+	}
+}
+
+/* Whether the heap string `key`, hashed by `map_hash()`, holds the
+ * `length` bytes at `chars`. For the C emitted by `emit_c()`. */
+static inline int match_string_is(const struct value *key, const char *chars,
+				  int length)
+{
+	const struct string *str;
+
+	if (STRING_IS_SHORT(key)) return 0;
+	str = string_flat(key);
+	return str->length == length && memcmp(str->chars, chars, length) == 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "match_vector.h"
+#include "src/macros.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void match_vector_grow(struct match_vector *ma);
+
+struct match_vector *match_vector_init()
+{
+	struct match_vector *ma = malloc(sizeof(struct match_vector));
+
+	ASSERT(ma != NULL, "Unable to allocate memory for match_vector.");
+
+	ma->count = 0;
+	ma->size = MATCH_VECTOR_BUFFER_COUNT * sizeof(struct match);
+	ma->array = malloc(ma->size);
+
+	ASSERT(ma->array != NULL, "Unable to allocate memory for match_vector.");
+
+	return ma;
+}
+
+void match_vector_free(struct match_vector *ma)
+{
+	for (int i = 0; i < ma->count; i++) {
+		free(ma->array[i].keys);
+		free(ma->array[i].hashes);
+		free(ma->array[i].targets);
+		free(ma->array[i].slots);
+	}
+	free(ma->array);
+	free(ma);
+	ma = NULL;
+}
+
+int match_vector_add(struct match_vector *ma)
+{
+	if (ma->count == (ma->size / sizeof(struct match)))
+		match_vector_grow(ma);
+
+	ma->array[ma->count] = (struct match){0};
+
+	return ma->count++;
+}
+
+void match_vector_set(struct match_vector *ma, int index,
+		      const struct value *keys, const int *targets, int count,
+		      int otherwise)
+{
+	struct match *match = &ma->array[index];
+	uint32_t slots = MAP_MIN_SLOTS;
+
+	/* as sparse as a map's index */
+	while (MAP_USABLE(slots) < (uint32_t)count)
+		slots *= 2;
+
+	match->keys = malloc(count * sizeof(struct value));
+	match->hashes = malloc(count * sizeof(uint32_t));
+	match->targets = malloc(count * sizeof(int));
+	match->slots = malloc(slots * sizeof(int32_t));
+
+	ASSERT(match->keys != NULL && match->hashes != NULL
+	       && match->targets != NULL && match->slots != NULL,
+	       "Unable to allocate memory for match.");
+
+	memcpy(match->keys, keys, count * sizeof(struct value));
+	memcpy(match->targets, targets, count * sizeof(int));
+	match->count = count;
+	match->mask = slots - 1;
+	match->otherwise = otherwise;
+
+	for (uint32_t i = 0; i < slots; i++)
+		match->slots[i] = MATCH_EMPTY;
+
+	/* The keys are distinct, each is added to an empty slot. Interned
+	 * strings are flat, hashing them allocates nothing. */
+	for (int entry = 0; entry < count; entry++) {
+		uint32_t hash = 0, perturb, i;
+
+		/* the compiler only lets int and string keys through */
+		ASSERT(map_hash(&keys[entry], &hash) == NULL,
+		       "Unable to hash a case of match.");
+		match->hashes[entry] = hash;
+		for (perturb = hash, i = hash & match->mask;
+		     match->slots[i] != MATCH_EMPTY;) {
+			perturb >>= MAP_PERTURB_SHIFT;
+			i = (i * 5 + 1 + perturb) & match->mask;
+		}
+		match->slots[i] = entry;
+	}
+}
+
+static void match_vector_grow(struct match_vector *ma)
+{
+	ma->size += MATCH_VECTOR_BUFFER_COUNT * sizeof(struct match);
+	ma->array = realloc(ma->array, ma->size);
+
+	ASSERT(ma->array != NULL, "Unable to grow match_vector.");
+}
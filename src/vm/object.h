@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "heap.h"
+#include "src/value.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* How an array stores its elements. Only ARRAY_VALUE boxes them. */
+enum array_kind {
+	ARRAY_INT,	/* int32_t, for int and uint */
+	ARRAY_BYTE,	/* uint8_t */
+	ARRAY_SBYTE,	/* int8_t */
+	ARRAY_FLOAT,	/* double */
+	ARRAY_BOOL,	/* uint8_t */
+	ARRAY_VALUE,	/* struct value */
+	ARRAY_STRING	/* struct value, always a string */
+};
+
+/* An array of fixed length, its elements stored unboxed right after
+ * the header unless it is an ARRAY_VALUE or ARRAY_STRING. */
+struct array {
+	struct object object;
+	int length;
+	uint8_t kind;
+	/* aligned for the SIMD kernels of array.h */
+	_Alignas(16) uint8_t data[];
+};
+
+#define ARRAY_DATA(arr, ctype) ((ctype *)(arr)->data)
+
+/* A map, its entries and their index stored in arrays of its own,
+ * NULL while it is empty. See map.h. */
+struct map {
+	struct object object;
+	int count;
+	/* slots of the index, minus one */
+	int mask;
+	/* the key then the value of each entry, in insertion order */
+	struct array *entries;
+	/* the slots of the index, then the hash of each entry */
+	struct array *table;
+};
+
+/* A recipe instance is its header followed by its fields, whose
+ * offsets and widths are resolved by the compiler, C struct style. */
+#define RECIPE_FIELD(obj, offset, ctype)				\
+	(*(ctype *)((uint8_t *)((struct object *)(obj) + 1) + (offset)))
+
+/* Allocate a zeroed recipe instance of `size` bytes. Return NULL when
+ * out of memory. */
+static inline struct object *object_new_recipe(int size, struct heap *heap)
+{
+	return heap_alloc(heap, OBJECT_RECIPE, sizeof(struct object) + size);
+}
+
+/* Make a zeroed recipe instance of `blocks` HEAP_ALIGN byte blocks,
+ * header included, at `bytes` in the frame of the function it never
+ * escapes. It is left out of the heap. */
+static inline struct object *object_frame_recipe(uint8_t *bytes, int blocks)
+{
+	struct object *obj = (struct object *)bytes;
+
+	*obj = (struct object){.type = OBJECT_RECIPE, .blocks = blocks};
+	memset(obj + 1, 0, (size_t)(blocks - 1) * HEAP_ALIGN);
+	return obj;
+}
+
+static inline int array_width(enum array_kind kind)
+{
+	switch (kind) {
+	case ARRAY_INT: return sizeof(int32_t);
+	case ARRAY_FLOAT: return sizeof(double);
+	case ARRAY_VALUE:
+	case ARRAY_STRING: return sizeof(struct value);
+	default: return sizeof(uint8_t);
+	}
+}
+
+/* Allocate an array of `length` zeroed elements. Return NULL when out
+ * of memory. */
+static inline struct array *object_new_array(enum array_kind kind, int length,
+					     struct heap *heap)
+{
+	struct array *arr = (struct array *)
+		heap_alloc(heap, OBJECT_ARRAY, sizeof(struct array)
+			   + (size_t)length * array_width(kind));
+
+	if (arr == NULL) return NULL;
+
+	arr->length = length;
+	arr->kind = kind;
+	return arr;
+}
+
+/* Allocate an empty map. Return NULL when out of memory. */
+static inline struct map *object_new_map(struct heap *heap)
+{
+	return (struct map *)heap_alloc(heap, OBJECT_MAP, sizeof(struct map));
+}
+
+static inline struct value array_get(const struct array *arr, int index)
+{
+	switch (arr->kind) {
+	case ARRAY_INT: return GET_VALUE_INT(ARRAY_DATA(arr, int32_t)[index]);
+	case ARRAY_BYTE: return GET_VALUE_INT(ARRAY_DATA(arr, uint8_t)[index]);
+	case ARRAY_SBYTE: return GET_VALUE_INT(ARRAY_DATA(arr, int8_t)[index]);
+	case ARRAY_FLOAT: return GET_VALUE_FLOAT(ARRAY_DATA(arr, double)[index]);
+	case ARRAY_BOOL: return GET_VALUE_BOOL(ARRAY_DATA(arr, uint8_t)[index]);
+	default: return ARRAY_DATA(arr, struct value)[index];
+	}
+}
+
+/* Typed arrays expect `val` to already have the type of their
+ * elements, the compiler coerces it beforehand. */
+static inline void array_set(struct array *arr, int index,
+			     const struct value *val)
+{
+	switch (arr->kind) {
+	case ARRAY_INT: ARRAY_DATA(arr, int32_t)[index] = val->as.integer; break;
+	case ARRAY_BYTE: ARRAY_DATA(arr, uint8_t)[index] = val->as.integer; break;
+	case ARRAY_SBYTE: ARRAY_DATA(arr, int8_t)[index] = val->as.integer; break;
+	case ARRAY_FLOAT: ARRAY_DATA(arr, double)[index] = val->as.float_p; break;
+	case ARRAY_BOOL: ARRAY_DATA(arr, uint8_t)[index] = val->as.bool; break;
+	default: ARRAY_DATA(arr, struct value)[index] = *val; break;
+	}
+}
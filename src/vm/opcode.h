@@ -25,9 +25,162 @@
 
 enum op_code {
 	OP_RETURN = 0,
-	OP_LINE_INC,
 	OP_CONSTANT,
 	OP_CONSTANT_LONG,
+	OP_POP,
+
+	/* Jumps take a two byte distance, counted from the next code.
+	 * OP_LOOP jumps backward. */
+	OP_JUMP,
+	OP_JUMP_IF_FALSE,
+	OP_JUMP_IF_TRUE,
+	/* The operands of and and or, jumping with the value when it
+	 * decides the result, popping it otherwise. */
+	OP_JUMP_IF_FALSE_OR_POP,
+	OP_JUMP_IF_TRUE_OR_POP,
+	/* Check that the untyped value on top, a condition or an operand
+	 * of and, or and not, is a bool. */
+	OP_TO_BOOL,
+	/* Pop two ints and jump when they compare so, a comparison and
+	 * the branch on it in one code. */
+	OP_JUMP_IF_EQUAL_INT,
+	OP_JUMP_IF_NOT_EQUAL_INT,
+	OP_JUMP_IF_GREATER_INT,
+	OP_JUMP_IF_GREATER_EQUAL_INT,
+	OP_JUMP_IF_LESS_INT,
+	OP_JUMP_IF_LESS_EQUAL_INT,
+	OP_LOOP,
+	/* Pops an int and jumps by the entry of a table indexed by its
+	 * difference with a four byte minimum, or by the table's last
+	 * entry when past it. Takes the minimum, the two byte count of
+	 * entries before the last one, and the entries, each a two byte
+	 * distance counted from the code after the table. */
+	OP_JUMP_TABLE,
+	/* Pops an int or a string and jumps to the case it has in the
+	 * match of a two byte index, see match.h. */
+	OP_MATCH,
+
+	/* Counted loops over the locals from a two byte slot, followed
+	 * by a two byte distance. A _PREP code jumps forward past the
+	 * loop when it has no element, a _STEP code back to the body
+	 * while it has more. A range loop's slots are its counter, stop,
+	 * step and variable, an array loop's the array, the index and
+	 * the variable, a map loop's the map, the entry and the key. */
+	OP_FOR_RANGE_PREP,
+	OP_FOR_RANGE_STEP,
+	OP_FOR_ARRAY_PREP,
+	OP_FOR_ARRAY_STEP,
+	OP_FOR_MAP_PREP,
+	OP_FOR_MAP_STEP,
+
+	/* Calls take the two byte index of the function called. A tail
+	 * call reuses the frame of the function making it. */
+	OP_CALL,
+	OP_TAIL_CALL,
+	OP_RETURN_VOID,
+
+	/* Recipe instances. OP_NEW_RECIPE takes the instance's size and
+	 * the field codes the field's offset, on two bytes. Each field
+	 * code reads or writes a field of one width. OP_NEW_RECIPE_FRAME
+	 * makes an instance which never escapes its function in the
+	 * function's frame, and takes its offset there and its size, in
+	 * HEAP_ALIGN byte blocks, on one byte each. */
+	OP_NEW_RECIPE,
+	OP_NEW_RECIPE_FRAME,
+	OP_GET_FIELD_INT,
+	OP_GET_FIELD_BYTE,
+	OP_GET_FIELD_SBYTE,
+	OP_GET_FIELD_FLOAT,
+	OP_GET_FIELD_BOOL,
+	OP_SET_FIELD_INT,
+	OP_SET_FIELD_BYTE,
+	OP_SET_FIELD_SBYTE,
+	OP_SET_FIELD_FLOAT,
+	OP_SET_FIELD_BOOL,
+
+	/* Arrays. OP_NEW_ARRAY takes the kind of the elements and pops
+	 * the length, OP_ARRAY_LITERAL takes the kind and the two byte
+	 * count of elements it pops. The index codes check their index
+	 * against the array's bounds and read or write one kind of
+	 * element. The other codes are the arrays' bulk methods. */
+	OP_NEW_ARRAY,
+	OP_ARRAY_LITERAL,
+	OP_GET_INDEX_INT,
+	OP_GET_INDEX_BYTE,
+	OP_GET_INDEX_SBYTE,
+	OP_GET_INDEX_FLOAT,
+	OP_GET_INDEX_BOOL,
+	OP_GET_INDEX_VALUE,
+	OP_SET_INDEX_INT,
+	OP_SET_INDEX_BYTE,
+	OP_SET_INDEX_SBYTE,
+	OP_SET_INDEX_FLOAT,
+	OP_SET_INDEX_BOOL,
+	OP_SET_INDEX_VALUE,
+	/* The unchecked index codes take the two byte slot of the
+	 * variable of a range the compiler proved within the array's
+	 * bounds, and index by it without checking. */
+	OP_GET_INDEX_INT_UNCHECKED,
+	OP_GET_INDEX_BYTE_UNCHECKED,
+	OP_GET_INDEX_SBYTE_UNCHECKED,
+	OP_GET_INDEX_FLOAT_UNCHECKED,
+	OP_GET_INDEX_BOOL_UNCHECKED,
+	OP_GET_INDEX_VALUE_UNCHECKED,
+	OP_SET_INDEX_INT_UNCHECKED,
+	OP_SET_INDEX_BYTE_UNCHECKED,
+	OP_SET_INDEX_SBYTE_UNCHECKED,
+	OP_SET_INDEX_FLOAT_UNCHECKED,
+	OP_SET_INDEX_BOOL_UNCHECKED,
+	OP_SET_INDEX_VALUE_UNCHECKED,
+	OP_ARRAY_LENGTH,
+	OP_ARRAY_FILL,
+	OP_ARRAY_COPY,
+	OP_ARRAY_SLICE,
+	OP_ARRAY_SUM,
+	OP_ARRAY_MIN,
+	OP_ARRAY_MAX,
+	OP_ARRAY_DOT,
+
+	/* Maps. OP_MAP_LITERAL takes the two byte count of the keys and
+	 * values it pops, in pairs. OP_GET_KEY and OP_SET_KEY read and
+	 * write the value of a key, the other codes are the maps'
+	 * methods. */
+	OP_MAP_LITERAL,
+	OP_GET_KEY,
+	OP_SET_KEY,
+	OP_MAP_LENGTH,
+	OP_MAP_HAS,
+
+	/* Appends the strings on top of the stack, taking their two byte
+	 * count. */
+	OP_CONCAT,
+
+	/* Output. OP_PRINT takes the stream it writes the value popped
+	 * to, 0 for stdout and 1 for stderr. OP_PRINT_FORMAT takes the
+	 * stream and the two byte index of a format, whose arguments it
+	 * pops, OP_FORMAT the index of a format whose result it pushes. */
+	OP_PRINT,
+	OP_PRINT_FORMAT,
+	OP_FORMAT,
+
+	/* Variables are read from and written to slots resolved by the
+	 * compiler. The _LONG codes take a two byte slot. */
+	OP_GET_GLOBAL,
+	OP_GET_GLOBAL_LONG,
+	OP_SET_GLOBAL,
+	OP_SET_GLOBAL_LONG,
+	OP_GET_LOCAL,
+	OP_GET_LOCAL_LONG,
+	OP_SET_LOCAL,
+	OP_SET_LOCAL_LONG,
+	/* Ref parameters hold the slot of the variable passed, pushed by
+	 * OP_REF_LOCAL or OP_REF_GLOBAL. OP_GET_REF and OP_SET_REF read
+	 * and write that variable through the parameter's slot. All take
+	 * a two byte slot. */
+	OP_REF_LOCAL,
+	OP_REF_GLOBAL,
+	OP_GET_REF,
+	OP_SET_REF,
 
 	OP_EQUAL,
 	OP_NOT_EQUAL,
@@ -47,5 +200,72 @@ enum op_code {
 	OP_LOGICAL_NOT,
 	OP_NEGATE,
 
+	/* Emitted when the compiler knows the operand types. They skip
+	 * the tag checks of the generic codes above. */
+	OP_INT_TO_FLOAT,
+
+	OP_EQUAL_INT,
+	OP_EQUAL_FLOAT,
+	OP_NOT_EQUAL_INT,
+	OP_NOT_EQUAL_FLOAT,
+
+	OP_GREATER_INT,
+	OP_GREATER_FLOAT,
+	OP_GREATER_EQUAL_INT,
+	OP_GREATER_EQUAL_FLOAT,
+	OP_LESS_INT,
+	OP_LESS_FLOAT,
+	OP_LESS_EQUAL_INT,
+	OP_LESS_EQUAL_FLOAT,
+
+	OP_ADD_INT,
+	OP_ADD_FLOAT,
+	OP_SUBSTRACT_INT,
+	OP_SUBSTRACT_FLOAT,
+
+	OP_MULTIPLY_INT,
+	OP_MULTIPLY_FLOAT,
+	OP_MODULO_INT,
+	OP_DIVIDE_INT,
+	OP_DIVIDE_FLOAT,
+
+	OP_NEGATE_INT,
+	OP_NEGATE_FLOAT,
+
+	/* The functions of math, on floats. OP_TO_FLOAT converts the
+	 * untyped number at the one byte depth it takes before them.
+	 * OP_ARRAY_MATH takes a one byte unary OP_MATH_ code, and
+	 * replaces the float array on top with a new array of the
+	 * results. */
+	OP_TO_FLOAT,
+	OP_MATH_SQRT,
+	OP_MATH_POW,
+	OP_MATH_REMAINDER,
+	OP_MATH_FLOOR,
+	OP_MATH_CEIL,
+	OP_MATH_SIN,
+	OP_MATH_COS,
+	OP_MATH_EXP,
+	OP_MATH_LOG,
+	OP_ARRAY_MATH,
+
+	/* Generic codes rewrite themselves into these once they have
+	 * seen the types of their operands. They guard on those types
+	 * and rewrite themselves back to the generic code otherwise. */
+	OP_GREATER_INT_Q,
+	OP_GREATER_FLOAT_Q,
+	OP_GREATER_EQUAL_INT_Q,
+	OP_GREATER_EQUAL_FLOAT_Q,
+	OP_LESS_INT_Q,
+	OP_LESS_FLOAT_Q,
+	OP_LESS_EQUAL_INT_Q,
+	OP_LESS_EQUAL_FLOAT_Q,
+	OP_ADD_INT_Q,
+	OP_ADD_FLOAT_Q,
+	OP_SUBSTRACT_INT_Q,
+	OP_SUBSTRACT_FLOAT_Q,
+	OP_MULTIPLY_INT_Q,
+	OP_MULTIPLY_FLOAT_Q,
+
 	OP_END_PROGRAM
 };
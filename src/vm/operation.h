@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "object.h"
+#include "str.h"
+#include "format.h"
+#include "src/value.h"
+
+#include <stdio.h>
+
+/*
+ * Runtime operations on values, shared by the VM and the C emitted by
+ * `emit_c()`. Binary operations store their result in `a`, and
+ * return NULL on success or an error message on failure.
+ */
+
+/* Integer arithmetic wraps around on overflow: it is done on unsigned
+ * ints, and `INT_MIN / -1` gives `INT_MIN` as `INT_MIN % -1` gives 0
+ * instead of trapping. The divisor must not be zero. */
+static inline int operation_int_add(int a, int b)
+{
+	return (int)((unsigned)a + (unsigned)b);
+}
+
+static inline int operation_int_substract(int a, int b)
+{
+	return (int)((unsigned)a - (unsigned)b);
+}
+
+static inline int operation_int_multiply(int a, int b)
+{
+	return (int)((unsigned)a * (unsigned)b);
+}
+
+static inline int operation_int_negate(int a)
+{
+	return (int)(0u - (unsigned)a);
+}
+
+static inline int operation_int_divide(int a, int b)
+{
+	return b == -1 ? operation_int_negate(a) : a / b;
+}
+
+static inline int operation_int_modulo(int a, int b)
+{
+	return b == -1 ? 0 : a % b;
+}
+
+#define OPERATION_IS_NUMBER(val)					\
+	((val)->type == VALUE_INT || (val)->type == VALUE_FLOAT)
+#define OPERATION_AS_FLOAT(val)						\
+	((val)->type == VALUE_INT ? (double)(val)->as.integer : (val)->as.float_p)
+
+/* The result is an integer from `int_operation` only when both
+ * operands are integers, otherwise it is promoted to a float. */
+#define OPERATION_ARITHMETIC(a, op, int_operation, b)			\
+	do {								\
+		if (!OPERATION_IS_NUMBER(a) || !OPERATION_IS_NUMBER(b))	\
+			return "Operands must be numbers.";		\
+		if ((a)->type == VALUE_INT && (b)->type == VALUE_INT)	\
+			*(a) = GET_VALUE_INT(int_operation((a)->as.integer, \
+							   (b)->as.integer)); \
+		else							\
+			*(a) = GET_VALUE_FLOAT(OPERATION_AS_FLOAT(a)	\
+					       op OPERATION_AS_FLOAT(b)); \
+		return NULL;						\
+	} while (0)
+
+#define OPERATION_COMPARISON(a, op, b)					\
+	do {								\
+		if (!OPERATION_IS_NUMBER(a) || !OPERATION_IS_NUMBER(b))	\
+			return "Operands must be numbers.";		\
+		*(a) = GET_VALUE_BOOL(OPERATION_AS_FLOAT(a)		\
+				      op OPERATION_AS_FLOAT(b));	\
+		return NULL;						\
+	} while (0)
+
+static inline const char *operation_add(struct value *a, const struct value *b)
+{
+	OPERATION_ARITHMETIC(a, +, operation_int_add, b);
+}
+
+static inline const char *operation_substract(struct value *a,
+					      const struct value *b)
+{
+	OPERATION_ARITHMETIC(a, -, operation_int_substract, b);
+}
+
+static inline const char *operation_multiply(struct value *a,
+					     const struct value *b)
+{
+	OPERATION_ARITHMETIC(a, *, operation_int_multiply, b);
+}
+
+static inline const char *operation_divide(struct value *a,
+					   const struct value *b)
+{
+	if (a->type == VALUE_INT && b->type == VALUE_INT && b->as.integer == 0)
+		return "Integer division by zero.";
+	OPERATION_ARITHMETIC(a, /, operation_int_divide, b);
+}
+
+static inline const char *operation_modulo(struct value *a,
+					   const struct value *b)
+{
+	if (a->type != VALUE_INT || b->type != VALUE_INT)
+		return "Modulo operands must be integers.";
+	if (b->as.integer == 0)
+		return "Integer modulo by zero.";
+	a->as.integer = operation_int_modulo(a->as.integer, b->as.integer);
+	return NULL;
+}
+
+static inline const char *operation_greater(struct value *a,
+					    const struct value *b)
+{
+	OPERATION_COMPARISON(a, >, b);
+}
+
+static inline const char *operation_greater_equal(struct value *a,
+						  const struct value *b)
+{
+	OPERATION_COMPARISON(a, >=, b);
+}
+
+static inline const char *operation_less(struct value *a, const struct value *b)
+{
+	OPERATION_COMPARISON(a, <, b);
+}
+
+static inline const char *operation_less_equal(struct value *a,
+					       const struct value *b)
+{
+	OPERATION_COMPARISON(a, <=, b);
+}
+
+/* Values of different types are never equal. */
+static inline const char *operation_equal(struct value *a, const struct value *b)
+{
+	if (OPERATION_IS_NUMBER(a) && OPERATION_IS_NUMBER(b))
+		*a = GET_VALUE_BOOL(OPERATION_AS_FLOAT(a) == OPERATION_AS_FLOAT(b));
+	else if (a->type == VALUE_BOOL && b->type == VALUE_BOOL)
+		*a = GET_VALUE_BOOL(a->as.bool == b->as.bool);
+	/* recipe instances, arrays and maps are only equal to themselves */
+	else if (a->type == b->type
+		 && (a->type == VALUE_RECIPE || a->type == VALUE_ARRAY
+		     || a->type == VALUE_MAP))
+		*a = GET_VALUE_BOOL(a->as.structure == b->as.structure);
+	else if (a->type == VALUE_STRING && b->type == VALUE_STRING) {
+		int equal = string_equal(a, b);
+
+		if (equal < 0) return "Out of memory.";
+		*a = GET_VALUE_BOOL(equal);
+	} else
+		*a = GET_VALUE_BOOL(0);
+	return NULL;
+}
+
+static inline const char *operation_not_equal(struct value *a,
+					      const struct value *b)
+{
+	const char *error = operation_equal(a, b);
+
+	if (error != NULL) return error;
+	a->as.bool = !a->as.bool;
+	return NULL;
+}
+
+static inline const char *operation_logical_not(struct value *a)
+{
+	switch (a->type) {
+	case VALUE_INT: *a = GET_VALUE_BOOL(!a->as.integer); break;
+	case VALUE_FLOAT: *a = GET_VALUE_BOOL(!a->as.float_p); break;
+	case VALUE_BOOL: *a = GET_VALUE_BOOL(!a->as.bool); break;
+	default: return "Operand must be a number or a bool.";
+	}
+	return NULL;
+}
+
+static inline const char *operation_negate(struct value *a)
+{
+	switch (a->type) {
+	case VALUE_INT:
+		a->as.integer = operation_int_negate(a->as.integer);
+		return NULL;
+	case VALUE_FLOAT: a->as.float_p = -a->as.float_p; return NULL;
+	default: return "Operand must be a number.";
+	}
+}
+
+static inline const char *operation_to_float(struct value *a)
+{
+	if (!OPERATION_IS_NUMBER(a)) return "Operand must be a number.";
+	*a = GET_VALUE_FLOAT(OPERATION_AS_FLOAT(a));
+	return NULL;
+}
+
+static inline const char *operation_to_bool(const struct value *a)
+{
+	return a->type == VALUE_BOOL ? NULL : "Operand must be a bool.";
+}
+
+/* Print `val` the way format_append_value() writes it. */
+static inline void operation_print_value(const struct value *val)
+{
+	struct format_buffer buffer = {0};
+
+	if (format_append_value(&buffer, val) == NULL)
+		fwrite(buffer.chars, 1, buffer.length, stdout);
+	free(buffer.chars);
+}
+
+static inline void operation_print(const struct value *val)
+{
+	operation_print_value(val);
+	putchar('\n');
+}
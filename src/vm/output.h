@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <errno.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define OUTPUT_BUFFER_SIZE 65536
+
+/*
+ * Buffered writes to a file descriptor, so that printing many lines
+ * costs few system calls. A terminal is flushed at each new line,
+ * anything else once its buffer is full, the buffered bytes and those
+ * overflowing it written by a single writev().
+ *
+ * Shared by the VM and the C emitted by `emit_c()`.
+ */
+
+struct output {
+	int fd;
+	/* set when the descriptor is a terminal */
+	int is_line_buffered;
+	int length;
+	char chars[OUTPUT_BUFFER_SIZE];
+};
+
+static inline void output_init(struct output *out, int fd)
+{
+	out->fd = fd;
+	out->is_line_buffered = isatty(fd);
+	out->length = 0;
+}
+
+/* Write the `count` buffers of `iov` whole, retrying short writes.
+ * Return 0 on an error. */
+static inline int output_writev(int fd, struct iovec *iov, int count)
+{
+	while (count > 0) {
+		ssize_t written = writev(fd, iov, count);
+
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			return 0;
+		}
+		for (; count > 0 && (size_t)written >= iov->iov_len; count--)
+			written -= (iov++)->iov_len;
+		if (count > 0) {
+			iov->iov_base = (char *)iov->iov_base + written;
+			iov->iov_len -= written;
+		}
+	}
+	return 1;
+}
+
+static inline const char *output_flush(struct output *out)
+{
+	struct iovec iov = {out->chars, out->length};
+	int is_written = output_writev(out->fd, &iov, 1);
+
+	out->length = 0;
+	return is_written ? NULL : "Unable to write the output.";
+}
+
+static inline const char *output_write(struct output *out, const char *chars,
+				       int length)
+{
+	if (length <= OUTPUT_BUFFER_SIZE - out->length) {
+		memcpy(out->chars + out->length, chars, length);
+		out->length += length;
+		if (out->is_line_buffered && memchr(chars, '\n', length) != NULL)
+			return output_flush(out);
+		return NULL;
+	}
+
+	struct iovec iov[2] = {
+		{out->chars, out->length},
+		{(char *)chars, length}
+	};
+	int is_written = output_writev(out->fd, iov, 2);
+
+	out->length = 0;
+	return is_written ? NULL : "Unable to write the output.";
+}
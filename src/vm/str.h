@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "object.h"
+#include "src/value.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Strings are immutable. Up to STRING_SHORT_MAX bytes, a string is
+ * stored in its value's word, above a tag byte holding its length and
+ * a set low bit, which no heap address has. Longer strings are heap
+ * objects: flat strings holding their bytes, length and hash, or
+ * ropes joining two strings, flattened when first read.
+ *
+ * Every string short enough is stored short, so short strings are
+ * equal when their words are. The compiler interns the literals, equal
+ * interned strings are the same object.
+ *
+ * Shared by the VM and the C emitted by `emit_c()`.
+ */
+
+#define STRING_SHORT_MAX 7
+/* Appending to a string at least this long makes a rope rather than
+ * copying it. */
+#define STRING_ROPE_MIN 64
+
+#define STRING_IS_SHORT(val) ((val)->as.string & 1)
+#define STRING_HEAP(val) ((struct object *)(uintptr_t)(val)->as.string)
+/* the heap string of `val`, which must be flat */
+#define STRING_OBJECT(val) ((struct string *)STRING_HEAP(val))
+
+struct string {
+	struct object object;
+	int length;
+	/* FNV-1a of the bytes, computed once */
+	uint32_t hash;
+	uint8_t is_interned;
+	/* followed by a '\0' for C's sake */
+	char chars[];
+};
+
+/* `left` followed by `right`, both string words. */
+struct rope {
+	struct object object;
+	int length;
+	uint64_t left;
+	uint64_t right;
+	/* the bytes, once read */
+	struct string *flat;
+};
+
+static inline uint32_t string_hash(const char *chars, int length)
+{
+	uint32_t hash = 2166136261u;
+
+	for (int i = 0; i < length; i++) {
+		hash ^= (uint8_t)chars[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static inline struct value string_short(const char *chars, int length)
+{
+	uint64_t word = (uint64_t)length << 1 | 1;
+
+	for (int i = 0; i < length; i++)
+		word |= (uint64_t)(uint8_t)chars[i] << 8 * (i + 1);
+	return GET_VALUE_STRING(word);
+}
+
+/* Allocate a flat string of `length` bytes to be filled, outside the
+ * heap when it is NULL. Return NULL when out of memory. */
+static inline struct string *string_alloc(int length, struct heap *heap)
+{
+	struct string *str = (struct string *)
+		heap_alloc(heap, OBJECT_STRING, offsetof(struct string, chars)
+			   + (size_t)length + 1);
+
+	if (str == NULL) return NULL;
+
+	str->length = length;
+	return str;
+}
+
+static inline int string_length(const struct value *val)
+{
+	if (STRING_IS_SHORT(val)) return (val->as.string & 0xFF) >> 1;
+	if (STRING_HEAP(val)->type == OBJECT_ROPE)
+		return ((struct rope *)STRING_HEAP(val))->length;
+	return STRING_OBJECT(val)->length;
+}
+
+/* Copy the bytes of `rope` into a flat string it keeps. The ropes are
+ * walked from their right end, so the left-leaning ones appending
+ * builds only need one pending word at a time. Return NULL when out of
+ * memory. */
+static inline const struct string *string_flatten(struct rope *rope)
+{
+	uint64_t word = (uintptr_t)rope, *pending = NULL;
+	int count = 0, size = 0;
+	struct string *flat;
+	char *end;
+
+	if (rope->flat != NULL) return rope->flat;
+
+	flat = string_alloc(rope->length, NULL);
+	if (flat == NULL) return NULL;
+	end = flat->chars + rope->length;
+
+	for (;;) {
+		struct value val = GET_VALUE_STRING(word);
+		struct rope *node = NULL;
+
+		if (!STRING_IS_SHORT(&val))
+			node = (struct rope *)STRING_HEAP(&val);
+
+		if (node == NULL) {
+			for (int i = string_length(&val); i > 0; i--)
+				*--end = word >> 8 * i;
+		} else if (node->object.type == OBJECT_ROPE && node->flat == NULL) {
+			if (count == size) {
+				uint64_t *grown;
+
+				size = size ? 2 * size : 16;
+				grown = realloc(pending, size * sizeof(uint64_t));
+				if (grown == NULL) {
+					free(pending);
+					free(flat);
+					return NULL;
+				}
+				pending = grown;
+			}
+			pending[count++] = node->left;
+			word = node->right;
+			continue;
+		} else {
+			const struct string *str = (node->object.type == OBJECT_ROPE)
+				? node->flat : STRING_OBJECT(&val);
+
+			end -= str->length;
+			memcpy(end, str->chars, str->length);
+		}
+
+		if (count == 0) break;
+		word = pending[--count];
+	}
+
+	free(pending);
+	flat->hash = string_hash(flat->chars, flat->length);
+	rope->flat = flat;
+	return flat;
+}
+
+/* Return the flat string of the heap string `val`, or NULL when out of
+ * memory. */
+static inline const struct string *string_flat(const struct value *val)
+{
+	if (STRING_HEAP(val)->type == OBJECT_ROPE)
+		return string_flatten((struct rope *)STRING_HEAP(val));
+	return STRING_OBJECT(val);
+}
+
+/* Point `chars` at the bytes of `val`, unpacked into `buffer` when it
+ * is short. Return its length, or -1 when out of memory. */
+static inline int string_bytes(const struct value *val,
+			       char buffer[STRING_SHORT_MAX],
+			       const char **chars)
+{
+	const struct string *str;
+
+	if (STRING_IS_SHORT(val)) {
+		int length = string_length(val);
+
+		for (int i = 0; i < length; i++)
+			buffer[i] = val->as.string >> 8 * (i + 1);
+		*chars = buffer;
+		return length;
+	}
+
+	if ((str = string_flat(val)) == NULL) return -1;
+	*chars = str->chars;
+	return str->length;
+}
+
+/* Store in `result` the string of `length` bytes at `chars`. */
+static inline const char *string_new(const char *chars, int length,
+				     struct heap *heap, struct value *result)
+{
+	if (length <= STRING_SHORT_MAX) {
+		*result = string_short(chars, length);
+		return NULL;
+	}
+
+	struct string *str = string_alloc(length, heap);
+	if (str == NULL) return "Out of memory.";
+
+	memcpy(str->chars, chars, length);
+	str->hash = string_hash(chars, length);
+	*result = GET_VALUE_STRING((uintptr_t)str);
+	return NULL;
+}
+
+/* Return the hash of `val`, only computed for short strings and ropes
+ * not read yet. Return 0 when out of memory. */
+static inline uint32_t string_value_hash(const struct value *val)
+{
+	char buffer[STRING_SHORT_MAX];
+	const char *chars;
+	const struct string *str;
+	int length;
+
+	if (STRING_IS_SHORT(val)) {
+		length = string_bytes(val, buffer, &chars);
+		return string_hash(chars, length);
+	}
+
+	str = string_flat(val);
+	return str != NULL ? str->hash : 0;
+}
+
+/* Only heap strings of the same length that are not both interned
+ * have bytes to compare, and only when their hashes match. Return -1
+ * when out of memory. */
+static inline int string_equal(const struct value *a, const struct value *b)
+{
+	const struct string *x, *y;
+
+	if (a->as.string == b->as.string) return 1;
+	if (STRING_IS_SHORT(a) || STRING_IS_SHORT(b)) return 0;
+	if (string_length(a) != string_length(b)) return 0;
+
+	x = string_flat(a);
+	y = string_flat(b);
+	if (x == NULL || y == NULL) return -1;
+	if (x == y) return 1;
+	if (x->is_interned && y->is_interned) return 0;
+	return x->hash == y->hash
+		&& memcmp(x->chars, y->chars, x->length) == 0;
+}
+
+/* Store in `strings[0]` the `count` strings from it appended, their
+ * total length known before anything is copied. */
+static inline const char *string_concat(struct value *strings, int count,
+					struct heap *heap)
+{
+	char buffer[STRING_SHORT_MAX];
+	const char *chars, *error;
+	int64_t total = 0;
+	int first, length;
+
+	for (int i = 0; i < count; i++) {
+		if (strings[i].type != VALUE_STRING)
+			return "Only strings can be appended to strings.";
+		total += string_length(&strings[i]);
+	}
+	if (total > INT32_MAX) return "String too long.";
+
+	/* then every string is short */
+	if (total <= STRING_SHORT_MAX) {
+		uint64_t word = (uint64_t)total << 1 | 1;
+		int shift = 8;
+
+		for (int i = 0; i < count; i++) {
+			if ((length = string_length(&strings[i])) == 0)
+				continue;
+			word |= strings[i].as.string >> 8 << shift;
+			shift += 8 * length;
+		}
+		strings[0] = GET_VALUE_STRING(word);
+		return NULL;
+	}
+
+	/* A long first string, usually one built in a loop, is kept by a
+	 * rope instead of being copied once more. */
+	first = string_length(&strings[0]);
+	if (first >= STRING_ROPE_MIN && count > 1) {
+		struct rope *rope;
+
+		if (first == total) return NULL;
+		if (count > 2
+		    && (error = string_concat(strings + 1, count - 1, heap)))
+			return error;
+
+		rope = (struct rope *)heap_alloc(heap, OBJECT_ROPE,
+						 sizeof(struct rope));
+		if (rope == NULL) return "Out of memory.";
+
+		rope->length = total;
+		rope->left = strings[0].as.string;
+		rope->right = strings[1].as.string;
+		strings[0] = GET_VALUE_STRING((uintptr_t)rope);
+		return NULL;
+	}
+
+	struct string *str = string_alloc(total, heap);
+	if (str == NULL) return "Out of memory.";
+
+	total = 0;
+	for (int i = 0; i < count; i++) {
+		if ((length = string_bytes(&strings[i], buffer, &chars)) < 0)
+			return "Out of memory.";
+		memcpy(str->chars + total, chars, length);
+		total += length;
+	}
+	str->hash = string_hash(str->chars, str->length);
+	strings[0] = GET_VALUE_STRING((uintptr_t)str);
+	return NULL;
+}
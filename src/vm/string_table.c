@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2022, Roland Marchand <roland.marchand@protonmail.com>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include "string_table.h"
+#include "src/macros.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void string_table_grow(struct string_table *st);
+/* Return the bucket holding the string of `length` bytes at `chars`,
+ * or the empty one it would go in. */
+static struct string **string_table_find(struct string **array, int size,
+					 const char *chars, int length,
+					 uint32_t hash);
+
+struct string_table *string_table_init()
+{
+	struct string_table *st = malloc(sizeof(struct string_table));
+
+	ASSERT(st != NULL, "Unable to allocate memory for string_table.");
+
+	st->count = 0;
+	st->size = STRING_TABLE_BUFFER_COUNT;
+	st->array = calloc(st->size, sizeof(struct string *));
+
+	ASSERT(st->array != NULL, "Unable to allocate memory for string_table.");
+
+	return st;
+}
+
+void string_table_free(struct string_table *st)
+{
+	for (int i = 0; i < st->size; i++)
+		free(st->array[i]);
+	free(st->array);
+	free(st);
+	st = NULL;
+}
+
+struct value string_table_intern(struct string_table *st, const char *chars,
+				 int length)
+{
+	if (length <= STRING_SHORT_MAX) return string_short(chars, length);
+
+	uint32_t hash = string_hash(chars, length);
+	struct string **bucket = string_table_find(st->array, st->size,
+						   chars, length, hash);
+
+	if (*bucket == NULL) {
+		/* kept at most half full */
+		if (2 * (st->count + 1) > st->size) {
+			string_table_grow(st);
+			bucket = string_table_find(st->array, st->size,
+						   chars, length, hash);
+		}
+
+		struct string *str = string_alloc(length, NULL);
+		ASSERT(str != NULL, "Unable to allocate memory for string.");
+
+		memcpy(str->chars, chars, length);
+		str->hash = hash;
+		str->is_interned = 1;
+		*bucket = str;
+		st->count++;
+	}
+
+	return GET_VALUE_STRING((uintptr_t)*bucket);
+}
+
+static void string_table_grow(struct string_table *st)
+{
+	int size = st->size * 2;
+	struct string **array = calloc(size, sizeof(struct string *));
+
+	ASSERT(array != NULL, "Unable to grow string_table.");
+
+	for (int i = 0; i < st->size; i++) {
+		struct string *str = st->array[i];
+
+		if (str == NULL) continue;
+		*string_table_find(array, size, str->chars, str->length,
+				   str->hash) = str;
+	}
+
+	free(st->array);
+	st->array = array;
+	st->size = size;
+}
+
+static struct string **string_table_find(struct string **array, int size,
+					 const char *chars, int length,
+					 uint32_t hash)
+{
+	for (int i = hash & (size - 1);; i = (i + 1) & (size - 1)) {
+		struct string *str = array[i];
+
+		if (str == NULL
+		    || (str->hash == hash && str->length == length
+			&& memcmp(str->chars, chars, length) == 0))
+			return &array[i];
+	}
+}
@@ -22,16 +22,43 @@
  */
 
 #include "vm.h"
+#include "operation.h"
+#include "array.h"
+#include "str.h"
+#include "iterator.h"
+#include "map.h"
+#include "match_vector.h"
+#include "emit_c.h"
 #include "src/compiler/compiler.h"
 #include "debug/debug.h"
+#include "src/macros.h"
 
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Computed gotos are a GNU extension. Without them, or when
+ * VM_THREADED_DISPATCH is not defined, `run()` falls back on a plain
+ * switch statement. */
+#if defined(VM_THREADED_DISPATCH) && defined(__GNUC__)
+#define VM_COMPUTED_GOTO
+#endif
 
 static struct vm vm;
 
 static enum interpret_result run();
+static void runtime_error(const char *format, ...);
+/* Reserve the stack's address range without committing memory. */
+static void stack_init();
+static void stack_free();
+/* Commit enough of the stack to hold `count` values. Return 0 if
+ * `count` goes past the reservation. */
+static int stack_commit(int count);
 
-enum interpret_result interpret(char *source) {
+enum interpret_result interpret(char *source, int use_jit) {
 	struct lump *lmp = lump_init();
 	vm.lump = lmp;
 
@@ -43,49 +70,1361 @@ enum interpret_result interpret(char *source) {
 		return INTERPRET_COMPILE_ERROR;
 	}
 
+	lump_compute_max_stack(lmp);
+	jit_init(&vm.jit, lmp, use_jit);
+	stack_init();
+	vm.globals = calloc(lmp->global_count > 0 ? lmp->global_count : 1,
+			    sizeof(struct value));
+	ASSERT(vm.globals != NULL, "Unable to allocate the VM globals.");
+
+	/* Nested calls each take at most the largest frame. */
+	size_t area = 0;
+	for (int i = 0; i < lmp->functions->count; i++) {
+		if (lmp->functions->array[i].frame_size > (int)area)
+			area = lmp->functions->array[i].frame_size;
+	}
+	area = area * VM_FRAME_MAX + lmp->frame_size;
+	vm.instance_area = (area > 0) ? aligned_alloc(HEAP_ALIGN, area) : NULL;
+	ASSERT(area == 0 || vm.instance_area != NULL,
+	       "Unable to allocate the VM frames.");
+
 	vm.pc = lmp->array;
-	vm.stack_top = vm.stack;
+	vm.stack_top = vm.slots = vm.stack;
+	vm.frame_count = 0;
+	vm.instances = vm.instance_area;
+	vm.instances_end = vm.instance_area + lmp->frame_size;
+	heap_init(&vm.heap);
+	vm.text = (struct format_buffer){0};
+	output_init(&vm.out, STDOUT_FILENO);
+	output_init(&vm.err, STDERR_FILENO);
+	vm.profile = (struct vm_profile){0};
+
+	enum interpret_result result;
+	/* The depth is known ahead of time, so `run()` never has to
+	 * check its pushes. */
+	if (stack_commit(lmp->max_stack)) {
+		result = run();
+	} else {
+		runtime_error("Stack overflow, %d values needed.",
+			      lmp->max_stack);
+		result = INTERPRET_RUNTIME_ERROR;
+	}
 
-	enum interpret_result result = run();
+#ifdef DEBUG_PROFILE_EXECUTION
+	fprintf(stderr, "quickened sites: %d\n", vm.profile.quickened);
+	fprintf(stderr, "de-quickened sites: %d\n", vm.profile.dequickened);
+	fprintf(stderr, "elided allocation sites: %d\n", lmp->elided_count);
+	heap_report(&vm.heap, stderr);
+	jit_report(&vm.jit, stderr);
+#endif
 
+	/* a failed flush has nowhere left to be reported */
+	output_flush(&vm.out);
+	output_flush(&vm.err);
+	heap_free(&vm.heap);
+	free(vm.text.chars);
+	free(vm.globals);
+	free(vm.instance_area);
+	stack_free();
+	jit_free(&vm.jit);
 	lump_free(lmp);
 	return result;
 }
 
+enum interpret_result compile_to_c(char *source, FILE *out)
+{
+	struct lump *lmp = lump_init();
+	vm.lump = lmp;
+
+	if (compile(source) != COMPILE_OK) {
+		lump_free(lmp);
+		return INTERPRET_COMPILE_ERROR;
+	}
+
+	lump_compute_max_stack(lmp);
+	emit_c(lmp, out);
+
+	lump_free(lmp);
+	return INTERPRET_OK;
+}
+
 static enum interpret_result run()
 {
 #define READ_BYTE() (*vm.pc++)
+#define READ_SHORT() (vm.pc += 2, (uint16_t)(vm.pc[-2] << 8 | vm.pc[-1]))
+#define PUSH(val) (*vm.stack_top++ = (val))
+#define POP() (*--vm.stack_top)
+#define PEEK(distance) (&vm.stack_top[-1 - (distance)])
+
+/* Apply `operation` to the stack's top value, or to the two top
+ * values with the result replacing the left operand. */
+#define UNARY_OPERATION(operation)					\
+	do {								\
+		const char *error = operation(PEEK(0));			\
+		if (error != NULL) {					\
+			runtime_error("%s", error);		\
+			return INTERPRET_RUNTIME_ERROR;			\
+		}							\
+	} while (0)
+#define BINARY_OPERATION(operation)					\
+	do {								\
+		const char *error = operation(PEEK(1), PEEK(0));	\
+		if (error != NULL) {					\
+			runtime_error("%s", error);		\
+			return INTERPRET_RUNTIME_ERROR;			\
+		}							\
+		vm.stack_top--;						\
+	} while (0)
+
+/* Operations on two values whose type is known by the compiler. */
+#define TYPED_ARITHMETIC(member, op)					\
+	do {								\
+		struct value *b = PEEK(0), *a = PEEK(1);		\
+		a->as.member = a->as.member op b->as.member;		\
+		vm.stack_top--;						\
+	} while (0)
+/* Operations on two ints, which wrap around as they do in C emitted by
+ * `emit_c()`. */
+#define INT_ARITHMETIC(operation)					\
+	do {								\
+		struct value *b = PEEK(0), *a = PEEK(1);		\
+		a->as.integer = operation(a->as.integer, b->as.integer); \
+		vm.stack_top--;						\
+	} while (0)
+#define MATH_UNARY(function)						\
+	(PEEK(0)->as.float_p = function(PEEK(0)->as.float_p))
+#define MATH_BINARY(function)						\
+	do {								\
+		struct value *b = PEEK(0), *a = PEEK(1);		\
+		a->as.float_p = function(a->as.float_p, b->as.float_p);	\
+		vm.stack_top--;						\
+	} while (0)
+#define TYPED_COMPARISON(member, op)					\
+	do {								\
+		struct value *b = PEEK(0), *a = PEEK(1);		\
+		*a = GET_VALUE_BOOL(a->as.member op b->as.member);	\
+		vm.stack_top--;						\
+	} while (0)
+
+/* Pop two ints and jump by the distance following the code when they
+ * compare with `op`. */
+#define JUMP_IF_INT(op)							\
+	do {								\
+		uint16_t distance = READ_SHORT();			\
+		vm.stack_top -= 2;					\
+		if (vm.stack_top[0].as.integer op vm.stack_top[1].as.integer) \
+			vm.pc += distance;				\
+	} while (0)
+
+/* Rewrite the generic code being executed into `int_code` or
+ * `float_code` when both operands share that type. */
+#define QUICKEN(int_code, float_code)					\
+	do {								\
+		enum value_type type = PEEK(0)->type;			\
+		if (type == PEEK(1)->type				\
+		    && (type == VALUE_INT || type == VALUE_FLOAT)) {	\
+			vm.pc[-1] = (type == VALUE_INT)			\
+				? int_code : float_code;		\
+			vm.profile.quickened++;				\
+		}							\
+	} while (0)
+/* Rewrite a quickened code whose guard failed back into the generic
+ * `code`. */
+#define DEQUICKEN(code)							\
+	do {								\
+		vm.pc[-1] = code;					\
+		vm.profile.dequickened++;				\
+	} while (0)
+#define GUARD(value_type)						\
+	(PEEK(0)->type == value_type && PEEK(1)->type == value_type)
+
+/* Replace the instance on the stack's top with its field at the next
+ * offset, or pop a value and the instance it is stored in. */
+#define GET_FIELD(ctype, make_value)					\
+	do {								\
+		uint16_t offset = READ_SHORT();				\
+		struct value *a = PEEK(0);				\
+		*a = make_value(RECIPE_FIELD(a->as.structure, offset, ctype)); \
+	} while (0)
+#define SET_FIELD(ctype, member)					\
+	do {								\
+		uint16_t offset = READ_SHORT();				\
+		struct value *b = PEEK(0), *a = PEEK(1);		\
+		RECIPE_FIELD(a->as.structure, offset, ctype) = b->as.member; \
+		vm.stack_top -= 2;					\
+	} while (0)
+
+/* Replace the array and the index on the stack's top with the element
+ * at that index, or pop a value, its index and the array it is stored
+ * in. */
+#define GET_INDEX(ctype, make_value)					\
+	do {								\
+		struct value *a = PEEK(1);				\
+		int index = PEEK(0)->as.integer;			\
+		CHECK(array_check_index(a->as.structure, index));	\
+		*a = make_value(ARRAY_DATA((struct array *)a->as.structure, \
+					   ctype)[index]);		\
+		vm.stack_top--;						\
+	} while (0)
+#define SET_INDEX(ctype, element)					\
+	do {								\
+		struct value *b = PEEK(0), *a = PEEK(2);		\
+		int index = PEEK(1)->as.integer;			\
+		CHECK(array_check_index(a->as.structure, index));	\
+		ARRAY_DATA((struct array *)a->as.structure,		\
+			   ctype)[index] = (element);			\
+		vm.stack_top -= 3;					\
+	} while (0)
+/* The same, the index being read from the slot following the code
+ * and proven within the array's bounds. */
+#define GET_INDEX_UNCHECKED(ctype, make_value)				\
+	do {								\
+		int index = vm.slots[READ_SHORT()].as.integer;		\
+		struct value *a = PEEK(0);				\
+		*a = make_value(ARRAY_DATA((struct array *)a->as.structure, \
+					   ctype)[index]);		\
+	} while (0)
+#define SET_INDEX_UNCHECKED(ctype, element)				\
+	do {								\
+		int index = vm.slots[READ_SHORT()].as.integer;		\
+		struct value *b = PEEK(0), *a = PEEK(1);		\
+		ARRAY_DATA((struct array *)a->as.structure,		\
+			   ctype)[index] = (element);			\
+		vm.stack_top -= 2;					\
+	} while (0)
+/* Collect when an allocation asked for it. Handlers which allocate
+ * start with it, every reference then being on the stack or in the
+ * globals. */
+#define SAFEPOINT()							\
+	do {								\
+		if (vm.heap.is_collect_pending)				\
+			heap_collect(&vm.heap, vm.stack,		\
+				     vm.stack_top - vm.stack, vm.globals, \
+				     vm.lump->global_count);		\
+	} while (0)
+#define CHECK(operation)						\
+	do {								\
+		const char *error = (operation);			\
+		if (error != NULL) {					\
+			runtime_error("%s", error);			\
+			return INTERPRET_RUNTIME_ERROR;			\
+		}							\
+	} while (0)
+
+/* Continue in the native code of `vm.pc` when it has some, see jit.h.
+ * Run where the interpreter enters a function, loops back or returns,
+ * which counts towards compiling the code there. */
+#define JIT_RUN()							\
+	do {								\
+		if (vm.jit.entries != NULL)				\
+			vm.pc = jit_run(&vm.jit, vm.pc, &vm.stack_top,	\
+					vm.slots, vm.globals);		\
+	} while (0)
 
-	while (1) {
 #ifdef DEBUG_TRACE_EXECUTION
-		disassemble_instruction(vm.lump, (int)(vm.pc - vm.lump->array));
+#define TRACE() disassemble_instruction(vm.lump, (int)(vm.pc - vm.lump->array))
+#else
+#define TRACE()
 #endif
-		uint8_t instruction;
-		switch (instruction = READ_BYTE()) {
-		case OP_RETURN:
+
+#ifdef VM_COMPUTED_GOTO
+	/* Every handler jumps straight to the next one, which gives each
+	 * opcode its own indirect branch to predict. */
+	static void *dispatch_table[] = {
+		[OP_RETURN] = &&TARGET_OP_RETURN,
+		[OP_CONSTANT] = &&TARGET_OP_CONSTANT,
+		[OP_CONSTANT_LONG] = &&TARGET_OP_CONSTANT_LONG,
+		[OP_POP] = &&TARGET_OP_POP,
+		[OP_JUMP] = &&TARGET_OP_JUMP,
+		[OP_JUMP_IF_FALSE] = &&TARGET_OP_JUMP_IF_FALSE,
+		[OP_JUMP_IF_TRUE] = &&TARGET_OP_JUMP_IF_TRUE,
+		[OP_JUMP_IF_FALSE_OR_POP] = &&TARGET_OP_JUMP_IF_FALSE_OR_POP,
+		[OP_JUMP_IF_TRUE_OR_POP] = &&TARGET_OP_JUMP_IF_TRUE_OR_POP,
+		[OP_JUMP_IF_EQUAL_INT] = &&TARGET_OP_JUMP_IF_EQUAL_INT,
+		[OP_JUMP_IF_NOT_EQUAL_INT] = &&TARGET_OP_JUMP_IF_NOT_EQUAL_INT,
+		[OP_JUMP_IF_GREATER_INT] = &&TARGET_OP_JUMP_IF_GREATER_INT,
+		[OP_JUMP_IF_GREATER_EQUAL_INT] = &&TARGET_OP_JUMP_IF_GREATER_EQUAL_INT,
+		[OP_JUMP_IF_LESS_INT] = &&TARGET_OP_JUMP_IF_LESS_INT,
+		[OP_JUMP_IF_LESS_EQUAL_INT] = &&TARGET_OP_JUMP_IF_LESS_EQUAL_INT,
+		[OP_LOOP] = &&TARGET_OP_LOOP,
+		[OP_JUMP_TABLE] = &&TARGET_OP_JUMP_TABLE,
+		[OP_MATCH] = &&TARGET_OP_MATCH,
+		[OP_FOR_RANGE_PREP] = &&TARGET_OP_FOR_RANGE_PREP,
+		[OP_FOR_RANGE_STEP] = &&TARGET_OP_FOR_RANGE_STEP,
+		[OP_FOR_ARRAY_PREP] = &&TARGET_OP_FOR_ARRAY_PREP,
+		[OP_FOR_ARRAY_STEP] = &&TARGET_OP_FOR_ARRAY_STEP,
+		[OP_FOR_MAP_PREP] = &&TARGET_OP_FOR_MAP_PREP,
+		[OP_FOR_MAP_STEP] = &&TARGET_OP_FOR_MAP_STEP,
+		[OP_CALL] = &&TARGET_OP_CALL,
+		[OP_TAIL_CALL] = &&TARGET_OP_TAIL_CALL,
+		[OP_RETURN_VOID] = &&TARGET_OP_RETURN_VOID,
+		[OP_NEW_RECIPE] = &&TARGET_OP_NEW_RECIPE,
+		[OP_NEW_RECIPE_FRAME] = &&TARGET_OP_NEW_RECIPE_FRAME,
+		[OP_GET_FIELD_INT] = &&TARGET_OP_GET_FIELD_INT,
+		[OP_GET_FIELD_BYTE] = &&TARGET_OP_GET_FIELD_BYTE,
+		[OP_GET_FIELD_SBYTE] = &&TARGET_OP_GET_FIELD_SBYTE,
+		[OP_GET_FIELD_FLOAT] = &&TARGET_OP_GET_FIELD_FLOAT,
+		[OP_GET_FIELD_BOOL] = &&TARGET_OP_GET_FIELD_BOOL,
+		[OP_SET_FIELD_INT] = &&TARGET_OP_SET_FIELD_INT,
+		[OP_SET_FIELD_BYTE] = &&TARGET_OP_SET_FIELD_BYTE,
+		[OP_SET_FIELD_SBYTE] = &&TARGET_OP_SET_FIELD_SBYTE,
+		[OP_SET_FIELD_FLOAT] = &&TARGET_OP_SET_FIELD_FLOAT,
+		[OP_SET_FIELD_BOOL] = &&TARGET_OP_SET_FIELD_BOOL,
+		[OP_NEW_ARRAY] = &&TARGET_OP_NEW_ARRAY,
+		[OP_ARRAY_LITERAL] = &&TARGET_OP_ARRAY_LITERAL,
+		[OP_GET_INDEX_INT] = &&TARGET_OP_GET_INDEX_INT,
+		[OP_GET_INDEX_BYTE] = &&TARGET_OP_GET_INDEX_BYTE,
+		[OP_GET_INDEX_SBYTE] = &&TARGET_OP_GET_INDEX_SBYTE,
+		[OP_GET_INDEX_FLOAT] = &&TARGET_OP_GET_INDEX_FLOAT,
+		[OP_GET_INDEX_BOOL] = &&TARGET_OP_GET_INDEX_BOOL,
+		[OP_GET_INDEX_VALUE] = &&TARGET_OP_GET_INDEX_VALUE,
+		[OP_SET_INDEX_INT] = &&TARGET_OP_SET_INDEX_INT,
+		[OP_SET_INDEX_BYTE] = &&TARGET_OP_SET_INDEX_BYTE,
+		[OP_SET_INDEX_SBYTE] = &&TARGET_OP_SET_INDEX_SBYTE,
+		[OP_SET_INDEX_FLOAT] = &&TARGET_OP_SET_INDEX_FLOAT,
+		[OP_SET_INDEX_BOOL] = &&TARGET_OP_SET_INDEX_BOOL,
+		[OP_SET_INDEX_VALUE] = &&TARGET_OP_SET_INDEX_VALUE,
+		[OP_GET_INDEX_INT_UNCHECKED] = &&TARGET_OP_GET_INDEX_INT_UNCHECKED,
+		[OP_GET_INDEX_BYTE_UNCHECKED] = &&TARGET_OP_GET_INDEX_BYTE_UNCHECKED,
+		[OP_GET_INDEX_SBYTE_UNCHECKED] = &&TARGET_OP_GET_INDEX_SBYTE_UNCHECKED,
+		[OP_GET_INDEX_FLOAT_UNCHECKED] = &&TARGET_OP_GET_INDEX_FLOAT_UNCHECKED,
+		[OP_GET_INDEX_BOOL_UNCHECKED] = &&TARGET_OP_GET_INDEX_BOOL_UNCHECKED,
+		[OP_GET_INDEX_VALUE_UNCHECKED] = &&TARGET_OP_GET_INDEX_VALUE_UNCHECKED,
+		[OP_SET_INDEX_INT_UNCHECKED] = &&TARGET_OP_SET_INDEX_INT_UNCHECKED,
+		[OP_SET_INDEX_BYTE_UNCHECKED] = &&TARGET_OP_SET_INDEX_BYTE_UNCHECKED,
+		[OP_SET_INDEX_SBYTE_UNCHECKED] = &&TARGET_OP_SET_INDEX_SBYTE_UNCHECKED,
+		[OP_SET_INDEX_FLOAT_UNCHECKED] = &&TARGET_OP_SET_INDEX_FLOAT_UNCHECKED,
+		[OP_SET_INDEX_BOOL_UNCHECKED] = &&TARGET_OP_SET_INDEX_BOOL_UNCHECKED,
+		[OP_SET_INDEX_VALUE_UNCHECKED] = &&TARGET_OP_SET_INDEX_VALUE_UNCHECKED,
+		[OP_ARRAY_LENGTH] = &&TARGET_OP_ARRAY_LENGTH,
+		[OP_ARRAY_FILL] = &&TARGET_OP_ARRAY_FILL,
+		[OP_ARRAY_COPY] = &&TARGET_OP_ARRAY_COPY,
+		[OP_ARRAY_SLICE] = &&TARGET_OP_ARRAY_SLICE,
+		[OP_ARRAY_SUM] = &&TARGET_OP_ARRAY_SUM,
+		[OP_ARRAY_MIN] = &&TARGET_OP_ARRAY_MIN,
+		[OP_ARRAY_MAX] = &&TARGET_OP_ARRAY_MAX,
+		[OP_ARRAY_DOT] = &&TARGET_OP_ARRAY_DOT,
+		[OP_MAP_LITERAL] = &&TARGET_OP_MAP_LITERAL,
+		[OP_GET_KEY] = &&TARGET_OP_GET_KEY,
+		[OP_SET_KEY] = &&TARGET_OP_SET_KEY,
+		[OP_MAP_LENGTH] = &&TARGET_OP_MAP_LENGTH,
+		[OP_MAP_HAS] = &&TARGET_OP_MAP_HAS,
+		[OP_CONCAT] = &&TARGET_OP_CONCAT,
+		[OP_PRINT] = &&TARGET_OP_PRINT,
+		[OP_PRINT_FORMAT] = &&TARGET_OP_PRINT_FORMAT,
+		[OP_FORMAT] = &&TARGET_OP_FORMAT,
+		[OP_GET_GLOBAL] = &&TARGET_OP_GET_GLOBAL,
+		[OP_GET_GLOBAL_LONG] = &&TARGET_OP_GET_GLOBAL_LONG,
+		[OP_SET_GLOBAL] = &&TARGET_OP_SET_GLOBAL,
+		[OP_SET_GLOBAL_LONG] = &&TARGET_OP_SET_GLOBAL_LONG,
+		[OP_GET_LOCAL] = &&TARGET_OP_GET_LOCAL,
+		[OP_GET_LOCAL_LONG] = &&TARGET_OP_GET_LOCAL_LONG,
+		[OP_SET_LOCAL] = &&TARGET_OP_SET_LOCAL,
+		[OP_SET_LOCAL_LONG] = &&TARGET_OP_SET_LOCAL_LONG,
+		[OP_REF_LOCAL] = &&TARGET_OP_REF_LOCAL,
+		[OP_REF_GLOBAL] = &&TARGET_OP_REF_GLOBAL,
+		[OP_GET_REF] = &&TARGET_OP_GET_REF,
+		[OP_SET_REF] = &&TARGET_OP_SET_REF,
+		[OP_EQUAL] = &&TARGET_OP_EQUAL,
+		[OP_NOT_EQUAL] = &&TARGET_OP_NOT_EQUAL,
+		[OP_GREATER] = &&TARGET_OP_GREATER,
+		[OP_GREATER_EQUAL] = &&TARGET_OP_GREATER_EQUAL,
+		[OP_LESS] = &&TARGET_OP_LESS,
+		[OP_LESS_EQUAL] = &&TARGET_OP_LESS_EQUAL,
+		[OP_ADD] = &&TARGET_OP_ADD,
+		[OP_SUBSTRACT] = &&TARGET_OP_SUBSTRACT,
+		[OP_MULTIPLY] = &&TARGET_OP_MULTIPLY,
+		[OP_MODULO] = &&TARGET_OP_MODULO,
+		[OP_DIVIDE] = &&TARGET_OP_DIVIDE,
+		[OP_LOGICAL_NOT] = &&TARGET_OP_LOGICAL_NOT,
+		[OP_NEGATE] = &&TARGET_OP_NEGATE,
+		[OP_INT_TO_FLOAT] = &&TARGET_OP_INT_TO_FLOAT,
+		[OP_EQUAL_INT] = &&TARGET_OP_EQUAL_INT,
+		[OP_EQUAL_FLOAT] = &&TARGET_OP_EQUAL_FLOAT,
+		[OP_NOT_EQUAL_INT] = &&TARGET_OP_NOT_EQUAL_INT,
+		[OP_NOT_EQUAL_FLOAT] = &&TARGET_OP_NOT_EQUAL_FLOAT,
+		[OP_GREATER_INT] = &&TARGET_OP_GREATER_INT,
+		[OP_GREATER_FLOAT] = &&TARGET_OP_GREATER_FLOAT,
+		[OP_GREATER_EQUAL_INT] = &&TARGET_OP_GREATER_EQUAL_INT,
+		[OP_GREATER_EQUAL_FLOAT] = &&TARGET_OP_GREATER_EQUAL_FLOAT,
+		[OP_LESS_INT] = &&TARGET_OP_LESS_INT,
+		[OP_LESS_FLOAT] = &&TARGET_OP_LESS_FLOAT,
+		[OP_LESS_EQUAL_INT] = &&TARGET_OP_LESS_EQUAL_INT,
+		[OP_LESS_EQUAL_FLOAT] = &&TARGET_OP_LESS_EQUAL_FLOAT,
+		[OP_ADD_INT] = &&TARGET_OP_ADD_INT,
+		[OP_ADD_FLOAT] = &&TARGET_OP_ADD_FLOAT,
+		[OP_SUBSTRACT_INT] = &&TARGET_OP_SUBSTRACT_INT,
+		[OP_SUBSTRACT_FLOAT] = &&TARGET_OP_SUBSTRACT_FLOAT,
+		[OP_MULTIPLY_INT] = &&TARGET_OP_MULTIPLY_INT,
+		[OP_MULTIPLY_FLOAT] = &&TARGET_OP_MULTIPLY_FLOAT,
+		[OP_MODULO_INT] = &&TARGET_OP_MODULO_INT,
+		[OP_DIVIDE_INT] = &&TARGET_OP_DIVIDE_INT,
+		[OP_DIVIDE_FLOAT] = &&TARGET_OP_DIVIDE_FLOAT,
+		[OP_NEGATE_INT] = &&TARGET_OP_NEGATE_INT,
+		[OP_NEGATE_FLOAT] = &&TARGET_OP_NEGATE_FLOAT,
+		[OP_TO_FLOAT] = &&TARGET_OP_TO_FLOAT,
+		[OP_TO_BOOL] = &&TARGET_OP_TO_BOOL,
+		[OP_MATH_SQRT] = &&TARGET_OP_MATH_SQRT,
+		[OP_MATH_POW] = &&TARGET_OP_MATH_POW,
+		[OP_MATH_REMAINDER] = &&TARGET_OP_MATH_REMAINDER,
+		[OP_MATH_FLOOR] = &&TARGET_OP_MATH_FLOOR,
+		[OP_MATH_CEIL] = &&TARGET_OP_MATH_CEIL,
+		[OP_MATH_SIN] = &&TARGET_OP_MATH_SIN,
+		[OP_MATH_COS] = &&TARGET_OP_MATH_COS,
+		[OP_MATH_EXP] = &&TARGET_OP_MATH_EXP,
+		[OP_MATH_LOG] = &&TARGET_OP_MATH_LOG,
+		[OP_ARRAY_MATH] = &&TARGET_OP_ARRAY_MATH,
+		[OP_GREATER_INT_Q] = &&TARGET_OP_GREATER_INT_Q,
+		[OP_GREATER_FLOAT_Q] = &&TARGET_OP_GREATER_FLOAT_Q,
+		[OP_GREATER_EQUAL_INT_Q] = &&TARGET_OP_GREATER_EQUAL_INT_Q,
+		[OP_GREATER_EQUAL_FLOAT_Q] = &&TARGET_OP_GREATER_EQUAL_FLOAT_Q,
+		[OP_LESS_INT_Q] = &&TARGET_OP_LESS_INT_Q,
+		[OP_LESS_FLOAT_Q] = &&TARGET_OP_LESS_FLOAT_Q,
+		[OP_LESS_EQUAL_INT_Q] = &&TARGET_OP_LESS_EQUAL_INT_Q,
+		[OP_LESS_EQUAL_FLOAT_Q] = &&TARGET_OP_LESS_EQUAL_FLOAT_Q,
+		[OP_ADD_INT_Q] = &&TARGET_OP_ADD_INT_Q,
+		[OP_ADD_FLOAT_Q] = &&TARGET_OP_ADD_FLOAT_Q,
+		[OP_SUBSTRACT_INT_Q] = &&TARGET_OP_SUBSTRACT_INT_Q,
+		[OP_SUBSTRACT_FLOAT_Q] = &&TARGET_OP_SUBSTRACT_FLOAT_Q,
+		[OP_MULTIPLY_INT_Q] = &&TARGET_OP_MULTIPLY_INT_Q,
+		[OP_MULTIPLY_FLOAT_Q] = &&TARGET_OP_MULTIPLY_FLOAT_Q,
+		[OP_END_PROGRAM] = &&TARGET_OP_END_PROGRAM,
+	};
+#define TARGET(code) case code: TARGET_##code
+#define DISPATCH()						\
+	do {							\
+		TRACE();					\
+		goto *dispatch_table[READ_BYTE()];		\
+	} while (0)
+#else
+#define TARGET(code) case code
+#define DISPATCH() continue
+#endif
+
+	while (1) {
+		TRACE();
+		switch (READ_BYTE()) {
+		TARGET(OP_RETURN): {
+			struct value val = POP();
+
+			/* The top level's value is the program's result. */
+			if (vm.frame_count == 0) {
+				vm.text.length = 0;
+				CHECK(format_append_value(&vm.text, &val));
+				CHECK(format_append(&vm.text, "\n", 1));
+				CHECK(output_write(&vm.out, vm.text.chars,
+						   vm.text.length));
+				return INTERPRET_OK;
+			}
+
+			struct call_frame *frame = &vm.frames[--vm.frame_count];
+			vm.stack_top = vm.slots;
+			PUSH(val);
+			vm.slots = frame->slots;
+			vm.pc = frame->pc;
+			vm.instances_end = vm.instances;
+			vm.instances = frame->instances;
+			JIT_RUN();
+			DISPATCH();
+		}
+		TARGET(OP_RETURN_VOID): {
+			if (vm.frame_count == 0) return INTERPRET_OK;
+
+			struct call_frame *frame = &vm.frames[--vm.frame_count];
+			vm.stack_top = vm.slots;
+			vm.slots = frame->slots;
+			vm.pc = frame->pc;
+			vm.instances_end = vm.instances;
+			vm.instances = frame->instances;
+			JIT_RUN();
+			DISPATCH();
+		}
+		TARGET(OP_CALL): {
+			struct function *fn = &vm.lump->functions->array[READ_SHORT()];
+			/* The arguments already on the stack become the
+			 * callee's first slots. */
+			struct value *slots = vm.stack_top - fn->arity;
+
+			/* Checking the callee's depth once lets its pushes go
+			 * unchecked. */
+			if (vm.frame_count == VM_FRAME_MAX
+			    || !stack_commit(slots - vm.stack + fn->max_stack)) {
+				runtime_error("Stack overflow.");
+				return INTERPRET_RUNTIME_ERROR;
+			}
+
+			vm.frames[vm.frame_count++] = (struct call_frame){
+				.pc = vm.pc,
+				.slots = vm.slots,
+				.instances = vm.instances
+			};
+			vm.slots = slots;
+			vm.pc = vm.lump->array + fn->offset;
+			vm.instances = vm.instances_end;
+			vm.instances_end += fn->frame_size;
+			JIT_RUN();
+			DISPATCH();
+		}
+		TARGET(OP_TAIL_CALL): {
+			struct function *fn = &vm.lump->functions->array[READ_SHORT()];
+
+			/* The arguments replace the caller's slots, whose
+			 * frame the callee returns through. */
+			memmove(vm.slots, vm.stack_top - fn->arity,
+				fn->arity * sizeof(struct value));
+			vm.stack_top = vm.slots + fn->arity;
+
+			if (!stack_commit(vm.slots - vm.stack + fn->max_stack)) {
+				runtime_error("Stack overflow.");
+				return INTERPRET_RUNTIME_ERROR;
+			}
+
+			vm.pc = vm.lump->array + fn->offset;
+			vm.instances_end = vm.instances + fn->frame_size;
+			JIT_RUN();
+			DISPATCH();
+		}
+		TARGET(OP_NEW_RECIPE): {
+			SAFEPOINT();
+			struct object *obj = object_new_recipe(READ_SHORT(),
+							       &vm.heap);
+			ASSERT(obj != NULL, "Unable to allocate a recipe instance.");
+			PUSH(GET_VALUE_RECIPE(obj));
+			DISPATCH();
+		}
+		TARGET(OP_NEW_RECIPE_FRAME): {
+			uint8_t *bytes = vm.instances + READ_BYTE() * HEAP_ALIGN;
+			struct object *obj = object_frame_recipe(bytes, READ_BYTE());
+
+			PUSH(GET_VALUE_RECIPE(obj));
+			DISPATCH();
+		}
+		TARGET(OP_GET_FIELD_INT):
+			GET_FIELD(int32_t, GET_VALUE_INT);
+			DISPATCH();
+		TARGET(OP_GET_FIELD_BYTE):
+			GET_FIELD(uint8_t, GET_VALUE_INT);
+			DISPATCH();
+		TARGET(OP_GET_FIELD_SBYTE):
+			GET_FIELD(int8_t, GET_VALUE_INT);
+			DISPATCH();
+		TARGET(OP_GET_FIELD_FLOAT):
+			GET_FIELD(double, GET_VALUE_FLOAT);
+			DISPATCH();
+		TARGET(OP_GET_FIELD_BOOL):
+			GET_FIELD(uint8_t, GET_VALUE_BOOL);
+			DISPATCH();
+		TARGET(OP_SET_FIELD_INT):
+			SET_FIELD(int32_t, integer);
+			DISPATCH();
+		TARGET(OP_SET_FIELD_BYTE):
+			SET_FIELD(uint8_t, integer);
+			DISPATCH();
+		TARGET(OP_SET_FIELD_SBYTE):
+			SET_FIELD(int8_t, integer);
+			DISPATCH();
+		TARGET(OP_SET_FIELD_FLOAT):
+			SET_FIELD(double, float_p);
+			DISPATCH();
+		TARGET(OP_SET_FIELD_BOOL):
+			SET_FIELD(uint8_t, bool);
+			DISPATCH();
+		TARGET(OP_NEW_ARRAY): {
+			SAFEPOINT();
+			uint8_t kind = READ_BYTE();
+			struct value *length = PEEK(0);
+
+			if (length->as.integer < 0) {
+				runtime_error("Negative array length.");
+				return INTERPRET_RUNTIME_ERROR;
+			}
+			struct array *arr = object_new_array(kind, length->as.integer,
+							     &vm.heap);
+			ASSERT(arr != NULL, "Unable to allocate an array.");
+			*length = GET_VALUE_ARRAY(arr);
+			DISPATCH();
+		}
+		TARGET(OP_ARRAY_LITERAL): {
+			SAFEPOINT();
+			uint8_t kind = READ_BYTE();
+			uint16_t count = READ_SHORT();
+			struct array *arr = object_new_array(kind, count, &vm.heap);
+
+			ASSERT(arr != NULL, "Unable to allocate an array.");
+			vm.stack_top -= count;
+			for (int i = 0; i < count; i++)
+				array_set(arr, i, &vm.stack_top[i]);
+			PUSH(GET_VALUE_ARRAY(arr));
+			DISPATCH();
+		}
+		TARGET(OP_GET_INDEX_INT):
+			GET_INDEX(int32_t, GET_VALUE_INT);
+			DISPATCH();
+		TARGET(OP_GET_INDEX_BYTE):
+			GET_INDEX(uint8_t, GET_VALUE_INT);
+			DISPATCH();
+		TARGET(OP_GET_INDEX_SBYTE):
+			GET_INDEX(int8_t, GET_VALUE_INT);
+			DISPATCH();
+		TARGET(OP_GET_INDEX_FLOAT):
+			GET_INDEX(double, GET_VALUE_FLOAT);
+			DISPATCH();
+		TARGET(OP_GET_INDEX_BOOL):
+			GET_INDEX(uint8_t, GET_VALUE_BOOL);
+			DISPATCH();
+		TARGET(OP_GET_INDEX_VALUE):
+			GET_INDEX(struct value, );
+			DISPATCH();
+		TARGET(OP_SET_INDEX_INT):
+			SET_INDEX(int32_t, b->as.integer);
+			DISPATCH();
+		TARGET(OP_SET_INDEX_BYTE):
+			SET_INDEX(uint8_t, b->as.integer);
+			DISPATCH();
+		TARGET(OP_SET_INDEX_SBYTE):
+			SET_INDEX(int8_t, b->as.integer);
+			DISPATCH();
+		TARGET(OP_SET_INDEX_FLOAT):
+			SET_INDEX(double, b->as.float_p);
+			DISPATCH();
+		TARGET(OP_SET_INDEX_BOOL):
+			SET_INDEX(uint8_t, b->as.bool);
+			DISPATCH();
+		TARGET(OP_SET_INDEX_VALUE): {
+			struct array *arr = PEEK(2)->as.structure;
+			int index = PEEK(1)->as.integer;
+
+			CHECK(array_check_index(arr, index));
+			CHECK(array_barrier(&vm.heap, arr,
+					    &ARRAY_DATA(arr, struct value)[index],
+					    PEEK(0)));
+			ARRAY_DATA(arr, struct value)[index] = *PEEK(0);
+			vm.stack_top -= 3;
+			DISPATCH();
+		}
+		TARGET(OP_GET_INDEX_INT_UNCHECKED):
+			GET_INDEX_UNCHECKED(int32_t, GET_VALUE_INT);
+			DISPATCH();
+		TARGET(OP_GET_INDEX_BYTE_UNCHECKED):
+			GET_INDEX_UNCHECKED(uint8_t, GET_VALUE_INT);
+			DISPATCH();
+		TARGET(OP_GET_INDEX_SBYTE_UNCHECKED):
+			GET_INDEX_UNCHECKED(int8_t, GET_VALUE_INT);
+			DISPATCH();
+		TARGET(OP_GET_INDEX_FLOAT_UNCHECKED):
+			GET_INDEX_UNCHECKED(double, GET_VALUE_FLOAT);
+			DISPATCH();
+		TARGET(OP_GET_INDEX_BOOL_UNCHECKED):
+			GET_INDEX_UNCHECKED(uint8_t, GET_VALUE_BOOL);
+			DISPATCH();
+		TARGET(OP_GET_INDEX_VALUE_UNCHECKED):
+			GET_INDEX_UNCHECKED(struct value, );
+			DISPATCH();
+		TARGET(OP_SET_INDEX_INT_UNCHECKED):
+			SET_INDEX_UNCHECKED(int32_t, b->as.integer);
+			DISPATCH();
+		TARGET(OP_SET_INDEX_BYTE_UNCHECKED):
+			SET_INDEX_UNCHECKED(uint8_t, b->as.integer);
+			DISPATCH();
+		TARGET(OP_SET_INDEX_SBYTE_UNCHECKED):
+			SET_INDEX_UNCHECKED(int8_t, b->as.integer);
+			DISPATCH();
+		TARGET(OP_SET_INDEX_FLOAT_UNCHECKED):
+			SET_INDEX_UNCHECKED(double, b->as.float_p);
+			DISPATCH();
+		TARGET(OP_SET_INDEX_BOOL_UNCHECKED):
+			SET_INDEX_UNCHECKED(uint8_t, b->as.bool);
+			DISPATCH();
+		TARGET(OP_SET_INDEX_VALUE_UNCHECKED): {
+			struct array *arr = PEEK(1)->as.structure;
+			int index = vm.slots[READ_SHORT()].as.integer;
+
+			CHECK(array_barrier(&vm.heap, arr,
+					    &ARRAY_DATA(arr, struct value)[index],
+					    PEEK(0)));
+			ARRAY_DATA(arr, struct value)[index] = *PEEK(0);
+			vm.stack_top -= 2;
+			DISPATCH();
+		}
+		TARGET(OP_ARRAY_LENGTH): {
+			struct value *a = PEEK(0);
+			*a = GET_VALUE_INT(((struct array *)a->as.structure)->length);
+			DISPATCH();
+		}
+		TARGET(OP_ARRAY_FILL): {
+			struct array *arr = PEEK(1)->as.structure;
+
+			/* only old boxed arrays need the barrier */
+			if (arr->object.space == SPACE_OLD
+			    && (arr->kind == ARRAY_VALUE || arr->kind == ARRAY_STRING))
+				for (int i = 0; i < arr->length; i++)
+					CHECK(array_barrier(&vm.heap, arr,
+							    &ARRAY_DATA(arr, struct value)[i],
+							    PEEK(0)));
+			array_fill(arr, PEEK(0));
+			vm.stack_top -= 2;
+			DISPATCH();
+		}
+		TARGET(OP_ARRAY_COPY): {
+			struct array *dst = PEEK(1)->as.structure;
+			struct array *src = PEEK(0)->as.structure;
+
+			if (dst->object.space == SPACE_OLD
+			    && (dst->kind == ARRAY_VALUE || dst->kind == ARRAY_STRING))
+				for (int i = 0; i < dst->length && i < src->length; i++)
+					CHECK(array_barrier(&vm.heap, dst,
+							    &ARRAY_DATA(dst, struct value)[i],
+							    &ARRAY_DATA(src, struct value)[i]));
+			array_copy(dst, src);
+			vm.stack_top -= 2;
+			DISPATCH();
+		}
+		TARGET(OP_ARRAY_SLICE):
+			SAFEPOINT();
+			CHECK(array_slice(PEEK(2)->as.structure, PEEK(1)->as.integer,
+					  PEEK(0)->as.integer, &vm.heap, PEEK(2)));
+			vm.stack_top -= 2;
+			DISPATCH();
+		TARGET(OP_ARRAY_SUM):
+			CHECK(array_sum(PEEK(0)->as.structure, PEEK(0)));
+			DISPATCH();
+		TARGET(OP_ARRAY_MIN):
+			CHECK(array_min(PEEK(0)->as.structure, PEEK(0)));
+			DISPATCH();
+		TARGET(OP_ARRAY_MAX):
+			CHECK(array_max(PEEK(0)->as.structure, PEEK(0)));
+			DISPATCH();
+		TARGET(OP_ARRAY_DOT):
+			CHECK(array_dot(PEEK(1)->as.structure, PEEK(0)->as.structure,
+					PEEK(1)));
+			vm.stack_top--;
+			DISPATCH();
+		TARGET(OP_MAP_LITERAL): {
+			uint16_t count = READ_SHORT();
+
+			SAFEPOINT();
+			vm.stack_top -= count * 2;
+			CHECK(map_literal(vm.stack_top, count, &vm.heap,
+					  vm.stack_top));
+			vm.stack_top++;
+			DISPATCH();
+		}
+		TARGET(OP_GET_KEY):
+			CHECK(map_get(PEEK(1)->as.structure, PEEK(0), PEEK(1)));
+			vm.stack_top--;
+			DISPATCH();
+		TARGET(OP_SET_KEY):
+			SAFEPOINT();
+			CHECK(map_set(PEEK(2)->as.structure, PEEK(1), PEEK(0),
+				      &vm.heap));
+			vm.stack_top -= 3;
+			DISPATCH();
+		TARGET(OP_MAP_LENGTH): {
+			struct value *a = PEEK(0);
+			*a = GET_VALUE_INT(((struct map *)a->as.structure)->count);
+			DISPATCH();
+		}
+		TARGET(OP_MAP_HAS):
+			CHECK(map_has(PEEK(1)->as.structure, PEEK(0), PEEK(1)));
+			vm.stack_top--;
+			DISPATCH();
+		TARGET(OP_CONCAT): {
+			uint16_t count = READ_SHORT();
+
+			SAFEPOINT();
+			CHECK(string_concat(vm.stack_top - count, count, &vm.heap));
+			vm.stack_top -= count - 1;
+			DISPATCH();
+		}
+		TARGET(OP_PRINT): {
+			struct output *stream = READ_BYTE() ? &vm.err : &vm.out;
+
+			vm.text.length = 0;
+			CHECK(format_append_value(&vm.text, PEEK(0)));
+			CHECK(output_write(stream, vm.text.chars, vm.text.length));
+			vm.stack_top--;
+			DISPATCH();
+		}
+		TARGET(OP_PRINT_FORMAT): {
+			struct output *stream = READ_BYTE() ? &vm.err : &vm.out;
+			struct format *fmt = &vm.lump->formats->array[READ_SHORT()];
+
+			vm.text.length = 0;
+			CHECK(format_run(fmt, vm.stack_top - fmt->argc, &vm.text));
+			CHECK(output_write(stream, vm.text.chars, vm.text.length));
+			vm.stack_top -= fmt->argc;
+			DISPATCH();
+		}
+		TARGET(OP_FORMAT): {
+			SAFEPOINT();
+			struct format *fmt = &vm.lump->formats->array[READ_SHORT()];
+			struct value *args = vm.stack_top - fmt->argc;
+
+			vm.text.length = 0;
+			CHECK(format_run(fmt, args, &vm.text));
+			CHECK(string_new(vm.text.chars, vm.text.length, &vm.heap,
+					 args));
+			vm.stack_top = args + 1;
+			DISPATCH();
+		}
+		TARGET(OP_JUMP): {
+			uint16_t distance = READ_SHORT();
+			vm.pc += distance;
+			DISPATCH();
+		}
+		TARGET(OP_TO_BOOL):
+			CHECK(operation_to_bool(PEEK(0)));
+			DISPATCH();
+		TARGET(OP_JUMP_IF_FALSE): {
+			/* a bool, checked by OP_TO_BOOL when untyped */
+			uint16_t distance = READ_SHORT();
+			if (!POP().as.bool) vm.pc += distance;
+			DISPATCH();
+		}
+		TARGET(OP_JUMP_IF_TRUE): {
+			uint16_t distance = READ_SHORT();
+			if (POP().as.bool) vm.pc += distance;
+			DISPATCH();
+		}
+		TARGET(OP_JUMP_IF_FALSE_OR_POP): {
+			uint16_t distance = READ_SHORT();
+			if (!PEEK(0)->as.bool)
+				vm.pc += distance;
+			else
+				vm.stack_top--;
+			DISPATCH();
+		}
+		TARGET(OP_JUMP_IF_TRUE_OR_POP): {
+			uint16_t distance = READ_SHORT();
+			if (PEEK(0)->as.bool)
+				vm.pc += distance;
+			else
+				vm.stack_top--;
+			DISPATCH();
+		}
+		TARGET(OP_JUMP_IF_EQUAL_INT):
+			JUMP_IF_INT(==);
+			DISPATCH();
+		TARGET(OP_JUMP_IF_NOT_EQUAL_INT):
+			JUMP_IF_INT(!=);
+			DISPATCH();
+		TARGET(OP_JUMP_IF_GREATER_INT):
+			JUMP_IF_INT(>);
+			DISPATCH();
+		TARGET(OP_JUMP_IF_GREATER_EQUAL_INT):
+			JUMP_IF_INT(>=);
+			DISPATCH();
+		TARGET(OP_JUMP_IF_LESS_INT):
+			JUMP_IF_INT(<);
+			DISPATCH();
+		TARGET(OP_JUMP_IF_LESS_EQUAL_INT):
+			JUMP_IF_INT(<=);
+			DISPATCH();
+		TARGET(OP_LOOP): {
+			uint16_t distance = READ_SHORT();
+			vm.pc -= distance;
+			JIT_RUN();
+			DISPATCH();
+		}
+		TARGET(OP_JUMP_TABLE): {
+			uint32_t min = (uint32_t)READ_SHORT() << 16;
+			min |= READ_SHORT();
+			uint16_t count = READ_SHORT();
+			/* below the minimum wraps around past the count */
+			uint32_t index = (uint32_t)POP().as.integer - min;
+			const uint8_t *entry;
+
+			if (index > count) index = count;
+			entry = vm.pc + 2 * index;
+			vm.pc += 2 * (count + 1) + (entry[0] << 8 | entry[1]);
+			DISPATCH();
+		}
+		TARGET(OP_MATCH): {
+			struct match *match = &vm.lump->matches->array[READ_SHORT()];
+			struct value key = POP();
+			int target;
+
+			CHECK(match_find(match, &key, &target));
+			vm.pc = vm.lump->array + target;
+			DISPATCH();
+		}
+		TARGET(OP_FOR_RANGE_PREP): {
+			struct value *range = &vm.slots[READ_SHORT()];
+			uint16_t distance = READ_SHORT();
+			CHECK(iterator_range_check(range));
+			if (!iterator_range_first(range)) vm.pc += distance;
+			DISPATCH();
+		}
+		TARGET(OP_FOR_RANGE_STEP): {
+			struct value *range = &vm.slots[READ_SHORT()];
+			uint16_t distance = READ_SHORT();
+			if (iterator_range_next(range)) {
+				vm.pc -= distance;
+				JIT_RUN();
+			}
+			DISPATCH();
+		}
+		TARGET(OP_FOR_ARRAY_PREP): {
+			struct value *iter = &vm.slots[READ_SHORT()];
+			uint16_t distance = READ_SHORT();
+			if (!iterator_array_first(iter)) vm.pc += distance;
+			DISPATCH();
+		}
+		TARGET(OP_FOR_ARRAY_STEP): {
+			struct value *iter = &vm.slots[READ_SHORT()];
+			uint16_t distance = READ_SHORT();
+			if (iterator_array_next(iter)) {
+				vm.pc -= distance;
+				JIT_RUN();
+			}
+			DISPATCH();
+		}
+		TARGET(OP_FOR_MAP_PREP): {
+			struct value *iter = &vm.slots[READ_SHORT()];
+			uint16_t distance = READ_SHORT();
+			if (!iterator_map_first(iter)) vm.pc += distance;
+			DISPATCH();
+		}
+		TARGET(OP_FOR_MAP_STEP): {
+			struct value *iter = &vm.slots[READ_SHORT()];
+			uint16_t distance = READ_SHORT();
+			if (iterator_map_next(iter)) {
+				vm.pc -= distance;
+				JIT_RUN();
+			}
+			DISPATCH();
+		}
+		TARGET(OP_END_PROGRAM):
 			return INTERPRET_OK;
-		case OP_CONSTANT:
-			READ_BYTE();
-			break;
-		case OP_CONSTANT_LONG: {
-			READ_BYTE();
-			READ_BYTE();
-			break;
+		TARGET(OP_CONSTANT):
+			PUSH(vm.lump->constants->array[READ_BYTE()]);
+			DISPATCH();
+		TARGET(OP_CONSTANT_LONG):
+			PUSH(vm.lump->constants->array[READ_SHORT()]);
+			DISPATCH();
+		TARGET(OP_POP):
+			vm.stack_top--;
+			DISPATCH();
+		TARGET(OP_GET_GLOBAL):
+			PUSH(vm.globals[READ_BYTE()]);
+			DISPATCH();
+		TARGET(OP_GET_GLOBAL_LONG):
+			PUSH(vm.globals[READ_SHORT()]);
+			DISPATCH();
+		TARGET(OP_SET_GLOBAL):
+			vm.globals[READ_BYTE()] = POP();
+			DISPATCH();
+		TARGET(OP_SET_GLOBAL_LONG):
+			vm.globals[READ_SHORT()] = POP();
+			DISPATCH();
+		TARGET(OP_GET_LOCAL):
+			PUSH(vm.slots[READ_BYTE()]);
+			DISPATCH();
+		TARGET(OP_GET_LOCAL_LONG):
+			PUSH(vm.slots[READ_SHORT()]);
+			DISPATCH();
+		TARGET(OP_SET_LOCAL):
+			vm.slots[READ_BYTE()] = POP();
+			DISPATCH();
+		TARGET(OP_SET_LOCAL_LONG):
+			vm.slots[READ_SHORT()] = POP();
+			DISPATCH();
+		TARGET(OP_REF_LOCAL):
+			PUSH(GET_VALUE_REF(&vm.slots[READ_SHORT()]));
+			DISPATCH();
+		TARGET(OP_REF_GLOBAL):
+			PUSH(GET_VALUE_REF(&vm.globals[READ_SHORT()]));
+			DISPATCH();
+		TARGET(OP_GET_REF):
+			PUSH(*vm.slots[READ_SHORT()].as.ref);
+			DISPATCH();
+		TARGET(OP_SET_REF):
+			*vm.slots[READ_SHORT()].as.ref = POP();
+			DISPATCH();
+		TARGET(OP_EQUAL):
+			BINARY_OPERATION(operation_equal);
+			DISPATCH();
+		TARGET(OP_NOT_EQUAL):
+			BINARY_OPERATION(operation_not_equal);
+			DISPATCH();
+		TARGET(OP_GREATER):
+			QUICKEN(OP_GREATER_INT_Q, OP_GREATER_FLOAT_Q);
+			BINARY_OPERATION(operation_greater);
+			DISPATCH();
+		TARGET(OP_GREATER_EQUAL):
+			QUICKEN(OP_GREATER_EQUAL_INT_Q, OP_GREATER_EQUAL_FLOAT_Q);
+			BINARY_OPERATION(operation_greater_equal);
+			DISPATCH();
+		TARGET(OP_LESS):
+			QUICKEN(OP_LESS_INT_Q, OP_LESS_FLOAT_Q);
+			BINARY_OPERATION(operation_less);
+			DISPATCH();
+		TARGET(OP_LESS_EQUAL):
+			QUICKEN(OP_LESS_EQUAL_INT_Q, OP_LESS_EQUAL_FLOAT_Q);
+			BINARY_OPERATION(operation_less_equal);
+			DISPATCH();
+		TARGET(OP_ADD):
+			QUICKEN(OP_ADD_INT_Q, OP_ADD_FLOAT_Q);
+			/* strings the compiler could not type are appended */
+			if (PEEK(1)->type == VALUE_STRING
+			    && PEEK(0)->type == VALUE_STRING) {
+				SAFEPOINT();
+				CHECK(string_concat(PEEK(1), 2, &vm.heap));
+				vm.stack_top--;
+				DISPATCH();
+			}
+			BINARY_OPERATION(operation_add);
+			DISPATCH();
+		TARGET(OP_SUBSTRACT):
+			QUICKEN(OP_SUBSTRACT_INT_Q, OP_SUBSTRACT_FLOAT_Q);
+			BINARY_OPERATION(operation_substract);
+			DISPATCH();
+		TARGET(OP_MULTIPLY):
+			QUICKEN(OP_MULTIPLY_INT_Q, OP_MULTIPLY_FLOAT_Q);
+			BINARY_OPERATION(operation_multiply);
+			DISPATCH();
+		TARGET(OP_DIVIDE):
+			BINARY_OPERATION(operation_divide);
+			DISPATCH();
+		TARGET(OP_MODULO):
+			BINARY_OPERATION(operation_modulo);
+			DISPATCH();
+		TARGET(OP_LOGICAL_NOT):
+			UNARY_OPERATION(operation_logical_not);
+			DISPATCH();
+		TARGET(OP_NEGATE):
+			UNARY_OPERATION(operation_negate);
+			DISPATCH();
+		TARGET(OP_INT_TO_FLOAT): {
+			struct value *a = PEEK(READ_BYTE());
+			*a = GET_VALUE_FLOAT(a->as.integer);
+			DISPATCH();
+		}
+		TARGET(OP_EQUAL_INT):
+			TYPED_COMPARISON(integer, ==);
+			DISPATCH();
+		TARGET(OP_EQUAL_FLOAT):
+			TYPED_COMPARISON(float_p, ==);
+			DISPATCH();
+		TARGET(OP_NOT_EQUAL_INT):
+			TYPED_COMPARISON(integer, !=);
+			DISPATCH();
+		TARGET(OP_NOT_EQUAL_FLOAT):
+			TYPED_COMPARISON(float_p, !=);
+			DISPATCH();
+		TARGET(OP_GREATER_INT):
+			TYPED_COMPARISON(integer, >);
+			DISPATCH();
+		TARGET(OP_GREATER_FLOAT):
+			TYPED_COMPARISON(float_p, >);
+			DISPATCH();
+		TARGET(OP_GREATER_EQUAL_INT):
+			TYPED_COMPARISON(integer, >=);
+			DISPATCH();
+		TARGET(OP_GREATER_EQUAL_FLOAT):
+			TYPED_COMPARISON(float_p, >=);
+			DISPATCH();
+		TARGET(OP_LESS_INT):
+			TYPED_COMPARISON(integer, <);
+			DISPATCH();
+		TARGET(OP_LESS_FLOAT):
+			TYPED_COMPARISON(float_p, <);
+			DISPATCH();
+		TARGET(OP_LESS_EQUAL_INT):
+			TYPED_COMPARISON(integer, <=);
+			DISPATCH();
+		TARGET(OP_LESS_EQUAL_FLOAT):
+			TYPED_COMPARISON(float_p, <=);
+			DISPATCH();
+		TARGET(OP_ADD_INT):
+			INT_ARITHMETIC(operation_int_add);
+			DISPATCH();
+		TARGET(OP_ADD_FLOAT):
+			TYPED_ARITHMETIC(float_p, +);
+			DISPATCH();
+		TARGET(OP_SUBSTRACT_INT):
+			INT_ARITHMETIC(operation_int_substract);
+			DISPATCH();
+		TARGET(OP_SUBSTRACT_FLOAT):
+			TYPED_ARITHMETIC(float_p, -);
+			DISPATCH();
+		TARGET(OP_MULTIPLY_INT):
+			INT_ARITHMETIC(operation_int_multiply);
+			DISPATCH();
+		TARGET(OP_MULTIPLY_FLOAT):
+			TYPED_ARITHMETIC(float_p, *);
+			DISPATCH();
+		TARGET(OP_DIVIDE_INT):
+			if (PEEK(0)->as.integer == 0) {
+				runtime_error("Integer division by zero.");
+				return INTERPRET_RUNTIME_ERROR;
+			}
+			INT_ARITHMETIC(operation_int_divide);
+			DISPATCH();
+		TARGET(OP_DIVIDE_FLOAT):
+			TYPED_ARITHMETIC(float_p, /);
+			DISPATCH();
+		TARGET(OP_MODULO_INT):
+			if (PEEK(0)->as.integer == 0) {
+				runtime_error("Integer modulo by zero.");
+				return INTERPRET_RUNTIME_ERROR;
+			}
+			INT_ARITHMETIC(operation_int_modulo);
+			DISPATCH();
+		TARGET(OP_NEGATE_INT):
+			PEEK(0)->as.integer = operation_int_negate(PEEK(0)->as.integer);
+			DISPATCH();
+		TARGET(OP_NEGATE_FLOAT):
+			PEEK(0)->as.float_p = -PEEK(0)->as.float_p;
+			DISPATCH();
+		TARGET(OP_TO_FLOAT):
+			CHECK(operation_to_float(PEEK(READ_BYTE())));
+			DISPATCH();
+		TARGET(OP_MATH_SQRT):
+			MATH_UNARY(sqrt);
+			DISPATCH();
+		TARGET(OP_MATH_POW):
+			MATH_BINARY(pow);
+			DISPATCH();
+		TARGET(OP_MATH_REMAINDER):
+			MATH_BINARY(remainder);
+			DISPATCH();
+		TARGET(OP_MATH_FLOOR):
+			MATH_UNARY(floor);
+			DISPATCH();
+		TARGET(OP_MATH_CEIL):
+			MATH_UNARY(ceil);
+			DISPATCH();
+		TARGET(OP_MATH_SIN):
+			MATH_UNARY(sin);
+			DISPATCH();
+		TARGET(OP_MATH_COS):
+			MATH_UNARY(cos);
+			DISPATCH();
+		TARGET(OP_MATH_EXP):
+			MATH_UNARY(exp);
+			DISPATCH();
+		TARGET(OP_MATH_LOG):
+			MATH_UNARY(log);
+			DISPATCH();
+		TARGET(OP_ARRAY_MATH): {
+			uint8_t code = READ_BYTE();
+
+			SAFEPOINT();
+			CHECK(array_math(PEEK(0)->as.structure, code, &vm.heap,
+					 PEEK(0)));
+			DISPATCH();
 		}
+		TARGET(OP_GREATER_INT_Q):
+			if (GUARD(VALUE_INT)) {
+				TYPED_COMPARISON(integer, >);
+				DISPATCH();
+			}
+			DEQUICKEN(OP_GREATER);
+			BINARY_OPERATION(operation_greater);
+			DISPATCH();
+		TARGET(OP_GREATER_FLOAT_Q):
+			if (GUARD(VALUE_FLOAT)) {
+				TYPED_COMPARISON(float_p, >);
+				DISPATCH();
+			}
+			DEQUICKEN(OP_GREATER);
+			BINARY_OPERATION(operation_greater);
+			DISPATCH();
+		TARGET(OP_GREATER_EQUAL_INT_Q):
+			if (GUARD(VALUE_INT)) {
+				TYPED_COMPARISON(integer, >=);
+				DISPATCH();
+			}
+			DEQUICKEN(OP_GREATER_EQUAL);
+			BINARY_OPERATION(operation_greater_equal);
+			DISPATCH();
+		TARGET(OP_GREATER_EQUAL_FLOAT_Q):
+			if (GUARD(VALUE_FLOAT)) {
+				TYPED_COMPARISON(float_p, >=);
+				DISPATCH();
+			}
+			DEQUICKEN(OP_GREATER_EQUAL);
+			BINARY_OPERATION(operation_greater_equal);
+			DISPATCH();
+		TARGET(OP_LESS_INT_Q):
+			if (GUARD(VALUE_INT)) {
+				TYPED_COMPARISON(integer, <);
+				DISPATCH();
+			}
+			DEQUICKEN(OP_LESS);
+			BINARY_OPERATION(operation_less);
+			DISPATCH();
+		TARGET(OP_LESS_FLOAT_Q):
+			if (GUARD(VALUE_FLOAT)) {
+				TYPED_COMPARISON(float_p, <);
+				DISPATCH();
+			}
+			DEQUICKEN(OP_LESS);
+			BINARY_OPERATION(operation_less);
+			DISPATCH();
+		TARGET(OP_LESS_EQUAL_INT_Q):
+			if (GUARD(VALUE_INT)) {
+				TYPED_COMPARISON(integer, <=);
+				DISPATCH();
+			}
+			DEQUICKEN(OP_LESS_EQUAL);
+			BINARY_OPERATION(operation_less_equal);
+			DISPATCH();
+		TARGET(OP_LESS_EQUAL_FLOAT_Q):
+			if (GUARD(VALUE_FLOAT)) {
+				TYPED_COMPARISON(float_p, <=);
+				DISPATCH();
+			}
+			DEQUICKEN(OP_LESS_EQUAL);
+			BINARY_OPERATION(operation_less_equal);
+			DISPATCH();
+		TARGET(OP_ADD_INT_Q):
+			if (GUARD(VALUE_INT)) {
+				INT_ARITHMETIC(operation_int_add);
+				DISPATCH();
+			}
+			DEQUICKEN(OP_ADD);
+			BINARY_OPERATION(operation_add);
+			DISPATCH();
+		TARGET(OP_ADD_FLOAT_Q):
+			if (GUARD(VALUE_FLOAT)) {
+				TYPED_ARITHMETIC(float_p, +);
+				DISPATCH();
+			}
+			DEQUICKEN(OP_ADD);
+			BINARY_OPERATION(operation_add);
+			DISPATCH();
+		TARGET(OP_SUBSTRACT_INT_Q):
+			if (GUARD(VALUE_INT)) {
+				INT_ARITHMETIC(operation_int_substract);
+				DISPATCH();
+			}
+			DEQUICKEN(OP_SUBSTRACT);
+			BINARY_OPERATION(operation_substract);
+			DISPATCH();
+		TARGET(OP_SUBSTRACT_FLOAT_Q):
+			if (GUARD(VALUE_FLOAT)) {
+				TYPED_ARITHMETIC(float_p, -);
+				DISPATCH();
+			}
+			DEQUICKEN(OP_SUBSTRACT);
+			BINARY_OPERATION(operation_substract);
+			DISPATCH();
+		TARGET(OP_MULTIPLY_INT_Q):
+			if (GUARD(VALUE_INT)) {
+				INT_ARITHMETIC(operation_int_multiply);
+				DISPATCH();
+			}
+			DEQUICKEN(OP_MULTIPLY);
+			BINARY_OPERATION(operation_multiply);
+			DISPATCH();
+		TARGET(OP_MULTIPLY_FLOAT_Q):
+			if (GUARD(VALUE_FLOAT)) {
+				TYPED_ARITHMETIC(float_p, *);
+				DISPATCH();
+			}
+			DEQUICKEN(OP_MULTIPLY);
+			BINARY_OPERATION(operation_multiply);
+			DISPATCH();
 		default:
-			break;
+			runtime_error("Unknown opcode %d.", vm.pc[-1]);
+			return INTERPRET_RUNTIME_ERROR;
 		}
 	}
 #undef READ_BYTE
+#undef READ_SHORT
+#undef PUSH
+#undef POP
+#undef PEEK
+#undef UNARY_OPERATION
+#undef BINARY_OPERATION
+#undef TYPED_ARITHMETIC
+#undef INT_ARITHMETIC
+#undef TYPED_COMPARISON
+#undef QUICKEN
+#undef DEQUICKEN
+#undef GUARD
+#undef GET_FIELD
+#undef SET_FIELD
+#undef GET_INDEX
+#undef SET_INDEX
+#undef SAFEPOINT
+#undef CHECK
+#undef JIT_RUN
+#undef TRACE
+#undef TARGET
+#undef DISPATCH
 }
 
-void vm_push_value(struct value v)
+static void stack_init()
 {
-	if (vm.stack_top >= vm.stack + VM_STACK_SIZE)
-		return;
+	long page_size = sysconf(_SC_PAGESIZE);
+	size_t size = VM_STACK_SIZE * sizeof(struct value) + page_size;
+
+	vm.stack = mmap(NULL, size, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	ASSERT(vm.stack != MAP_FAILED, "Unable to reserve the VM stack.");
+
+	vm.stack_end = vm.stack;
+}
+
+static void stack_free()
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	size_t size = VM_STACK_SIZE * sizeof(struct value) + page_size;
+
+	ASSERT(munmap(vm.stack, size) != -1, "Unable to free the VM stack.");
+	vm.stack = vm.stack_top = vm.stack_end = NULL;
+}
+
+static int stack_commit(int count)
+{
+	if (count > VM_STACK_SIZE) return 0;
+	if (vm.stack + count <= vm.stack_end) return 1;
+
+	long page_size = sysconf(_SC_PAGESIZE);
+	size_t size = count * sizeof(struct value);
+	size = (size + page_size - 1) / page_size * page_size;
+
+	ASSERT(mprotect(vm.stack, size, PROT_READ | PROT_WRITE) != -1,
+	       "Unable to commit the VM stack.");
+
+	vm.stack_end = vm.stack + size / sizeof(struct value);
+	return 1;
+}
+
+static void runtime_error(const char *format, ...)
+{
+	va_list args;
+
+	/* what the program printed comes before its error */
+	output_flush(&vm.out);
+	output_flush(&vm.err);
+
+	va_start(args, format);
+	/* the code running is the one before `pc` */
+	fprintf(stderr, "[line %d] runtime error: ",
+		lump_line_at(vm.lump, (int)(vm.pc - vm.lump->array) - 1));
+	vfprintf(stderr, format, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+
+	vm.stack_top = vm.slots = vm.stack;
+	vm.frame_count = 0;
+}
+
+enum interpret_result vm_push_value(struct value v)
+{
+	if (vm.stack_top >= vm.stack_end
+	    && !stack_commit(vm.stack_top - vm.stack + 1)) {
+		runtime_error("Stack overflow.");
+		return INTERPRET_RUNTIME_ERROR;
+	}
 
 	*vm.stack_top = v;
 	vm.stack_top++;
+	return INTERPRET_OK;
 }
 
 struct value *vm_pop_value()
@@ -94,15 +1433,136 @@ struct value *vm_pop_value()
 		return NULL;
 
 	vm.stack_top--;
-	return vm.stack_top + 1;
+	return vm.stack_top;
 }
 
-void vm_add_constant(double value)
+void vm_add_constant(struct value value)
 {
 	lump_add_constant(vm.lump, value);
 }
 
+int vm_add_format(struct format fmt)
+{
+	return format_vector_add(vm.lump->formats, fmt);
+}
+
+struct value vm_intern_string(const char *chars, int length)
+{
+	return string_table_intern(vm.lump->strings, chars, length);
+}
+
 void vm_add_code(enum op_code code)
 {
 	lump_add_code(vm.lump, code);
 }
+
+void vm_add_code_monadic(enum op_code code, uint8_t val)
+{
+	lump_add_code_monadic(vm.lump, code, val);
+}
+
+void vm_add_code_dyladic(enum op_code code, uint16_t val)
+{
+	lump_add_code_dyladic(vm.lump, code, val);
+}
+
+void vm_add_code_triadic(enum op_code code, uint8_t val1, uint16_t val2)
+{
+	lump_add_code_triadic(vm.lump, code, val1, val2);
+}
+
+int vm_add_jump(enum op_code code)
+{
+	return lump_add_jump(vm.lump, code);
+}
+
+int vm_patch_jump(int offset)
+{
+	return lump_patch_jump(vm.lump, offset);
+}
+
+int vm_add_jump_table(int32_t min, uint16_t count)
+{
+	return lump_add_jump_table(vm.lump, min, count);
+}
+
+int vm_patch_jump_table(int offset, int entry)
+{
+	return lump_patch_jump_table(vm.lump, offset, entry);
+}
+
+int vm_add_match()
+{
+	int index = match_vector_add(vm.lump->matches);
+
+	lump_add_code_dyladic(vm.lump, OP_MATCH, index);
+	return index;
+}
+
+void vm_set_match(int index, const struct value *keys, const int *targets,
+		  int count, int otherwise)
+{
+	match_vector_set(vm.lump->matches, index, keys, targets, count,
+			 otherwise);
+}
+
+int vm_add_for_prep(enum op_code code, uint16_t slot)
+{
+	return lump_add_for_prep(vm.lump, code, slot);
+}
+
+int vm_add_loop(enum op_code code, uint16_t slot, int target)
+{
+	return lump_add_loop(vm.lump, code, slot, target);
+}
+
+void vm_patch_code(int offset, enum op_code code)
+{
+	lump_patch_code(vm.lump, offset, code);
+}
+
+int vm_frame_recipe(int function, int offset)
+{
+	return lump_frame_recipe(vm.lump, function, offset);
+}
+
+int vm_add_function(uint8_t arity, uint8_t returns_value)
+{
+	struct function fn = {
+		.offset = vm.lump->count,
+		.end = vm.lump->count,
+		.arity = arity,
+		.returns_value = returns_value
+	};
+	return function_vector_add(vm.lump->functions, fn);
+}
+
+void vm_end_function(int index)
+{
+	vm.lump->functions->array[index].end = vm.lump->count;
+}
+
+int vm_add_global()
+{
+	return vm.lump->global_count++;
+}
+
+int vm_code_offset()
+{
+	return vm.lump->count;
+}
+
+uint8_t vm_code_at(int offset)
+{
+	return vm.lump->array[offset];
+}
+
+void vm_set_line(int line)
+{
+	lump_set_line(vm.lump, line);
+}
+
+void vm_rewind_code(int offset)
+{
+	lump_rewind(vm.lump, offset);
+}
@@ -25,18 +25,67 @@
 
 #include "opcode.h"
 #include "lump.h"
-#include "value.h"
+#include "object.h"
+#include "heap.h"
+#include "format.h"
+#include "output.h"
+#include "jit.h"
+#include "src/value.h"
 #include "src/scanner/scanner.h"
 
 #include <stdint.h>
+#include <stdio.h>
 
-#define VM_STACK_SIZE 256
+/* Number of values reserved for the stack. Only the pages the running
+ * lump needs are committed, and an inaccessible guard page follows the
+ * reservation. */
+#define VM_STACK_SIZE (1 << 20)
+
+/* Maximum depth of nested calls. Tail calls do not add to it. */
+#define VM_FRAME_MAX 4096
+
+/* What a call saves of its caller, restored when the callee returns. */
+struct call_frame {
+	uint8_t *pc;
+	struct value *slots;
+	uint8_t *instances;
+};
+
+/* Counters reported when built with DEBUG_PROFILE_EXECUTION. */
+struct vm_profile {
+	int quickened;
+	int dequickened;
+};
 
 struct vm {
 	struct lump *lump;
-	struct value stack[VM_STACK_SIZE];
+	struct value *stack;
 	struct value *stack_top;
+	/* end of the committed part of the stack */
+	struct value *stack_end;
+	/* one slot per global, resolved by the compiler */
+	struct value *globals;
+	/* First slot of the running function, holding its arguments. The
+	 * top level's slots start at the bottom of the stack. */
+	struct value *slots;
+	struct call_frame frames[VM_FRAME_MAX];
+	int frame_count;
+	/* Recipe instances the compiler kept out of the heap, in the
+	 * frames of the running calls: the running function's from
+	 * `instances` to `instances_end`, its callers' below. */
+	uint8_t *instance_area;
+	uint8_t *instances;
+	uint8_t *instances_end;
+	struct heap heap;
+	/* where print and str.fmt write before their output is taken */
+	struct format_buffer text;
+	/* stdout and stderr, flushed when the program ends or fails */
+	struct output out;
+	struct output err;
 	uint8_t *pc;
+	struct vm_profile profile;
+	/* native code of the hot functions and loops, see jit.h */
+	struct jit jit;
 };
 
 enum interpret_result {
@@ -45,10 +94,69 @@ enum interpret_result {
 	INTERPRET_RUNTIME_ERROR
 };
 
-enum interpret_result interpret(char *source);
+/* Run the program at `source`, compiling its hot code to machine code
+ * unless `use_jit` is 0. */
+enum interpret_result interpret(char *source, int use_jit);
+/* Compile `source` and write it to `out` as a standalone C program. */
+enum interpret_result compile_to_c(char *source, FILE *out);
 
-void vm_push_value(struct value val);
+/* Unlike the VM's own pushes, these check the stack's bounds. Return
+ * INTERPRET_RUNTIME_ERROR when the stack is full. */
+enum interpret_result vm_push_value(struct value val);
+/* Return the popped value, or NULL when the stack is empty. */
 struct value *vm_pop_value();
 
-void vm_add_constant(double value);
+void vm_add_constant(struct value value);
+/* Add a parsed format to the lump and return its index. */
+int vm_add_format(struct format fmt);
+/* Return the string of `length` bytes at `chars`, interned by the
+ * lump being compiled. */
+struct value vm_intern_string(const char *chars, int length);
 void vm_add_code(enum op_code code);
+void vm_add_code_monadic(enum op_code code, uint8_t val);
+void vm_add_code_dyladic(enum op_code code, uint16_t val);
+void vm_add_code_triadic(enum op_code code, uint8_t val1, uint16_t val2);
+/* Add a jump whose distance is set by `vm_patch_jump()`. Return its
+ * offset. */
+int vm_add_jump(enum op_code code);
+/* Make the jump at `offset` land on the next code. Return 0 if it is
+ * too far. */
+int vm_patch_jump(int offset);
+/* Add an OP_JUMP_TABLE whose entries are set by
+ * `vm_patch_jump_table()`. Return its offset. */
+int vm_add_jump_table(int32_t min, uint16_t count);
+/* Make the entry `entry` of the table at `offset` land on the next
+ * code. Return 0 if it is too far. */
+int vm_patch_jump_table(int offset, int entry);
+/* Add an OP_MATCH whose cases are set by `vm_set_match()`. Return the
+ * match's index. */
+int vm_add_match();
+/* Give the match `index` the `count` keys and the offsets of their
+ * cases, and the offset landed on without one. */
+void vm_set_match(int index, const struct value *keys, const int *targets,
+		  int count, int otherwise);
+/* Add a loop's _PREP code over the slots from `slot`, whose distance
+ * is set by `vm_patch_jump()`. Return its offset. */
+int vm_add_for_prep(enum op_code code, uint16_t slot);
+/* Add OP_LOOP, or a loop's _STEP code, jumping back to `target`.
+ * Return 0 if it is too far. */
+int vm_add_loop(enum op_code code, uint16_t slot, int target);
+void vm_patch_code(int offset, enum op_code code);
+/* Make the instance of the OP_NEW_RECIPE at `offset` in the frame of
+ * `function`, or of the top level when -1, instead of the heap. Return
+ * 0 if the frame is full. */
+int vm_frame_recipe(int function, int offset);
+/* Start a function at the next code and return its index. */
+int vm_add_function(uint8_t arity, uint8_t returns_value);
+/* End the function at `index` after the last code added. */
+void vm_end_function(int index);
+/* Reserve a global slot and return its index. */
+int vm_add_global();
+/* Return the offset of the next code to be added. */
+int vm_code_offset();
+/* Return the byte at `offset` of the code being compiled. */
+uint8_t vm_code_at(int offset);
+/* Drop every code from `offset` onwards. */
+void vm_rewind_code(int offset);
+/* Make the codes added from now on come from the source's `line`. */
+void vm_set_line(int line);
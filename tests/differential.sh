@@ -0,0 +1,70 @@
+#!/bin/sh
+#
+# Run every program of tests/ in the VM and as the C emitted by
+# --emit-c, and check that both print the same output and exit with the
+# same status. As both backends share the kernels of src/vm, the VM's
+# output is also compared with the expected `name.out`, and its errors
+# with `name.err` when the program fails. The VM runs a second time with
+# --no-jit, which must print the same as with its JIT.
+#
+# usage: differential.sh avalanche cc source_dir
+
+avalanche=$1
+cc=$2
+source_dir=$3
+work=$(mktemp -d)
+failed=0
+
+trap 'rm -rf "$work"' EXIT
+
+for program in "$source_dir"/tests/*.avl; do
+	name=$(basename "$program" .avl)
+
+	"$avalanche" "$program" >"$work/vm.out" 2>"$work/vm.err"
+	vm_status=$?
+	"$avalanche" --no-jit "$program" >"$work/interpreter.out" \
+		    2>"$work/interpreter.err"
+	interpreter_status=$?
+
+	if ! "$avalanche" --emit-c "$program" >"$work/$name.c" \
+	    || ! "$cc" -O1 -w -I"$source_dir" "$work/$name.c" \
+		 -o "$work/$name" -lm; then
+		echo "FAIL $name: the emitted C does not build"
+		failed=1
+		continue
+	fi
+	"$work/$name" >"$work/c.out" 2>"$work/c.err"
+	c_status=$?
+
+	if ! cmp -s "$work/vm.out" "${program%.avl}.out"; then
+		echo "FAIL $name: the output is not the expected one"
+		diff "${program%.avl}.out" "$work/vm.out" | head -n 10
+		failed=1
+	elif [ -f "${program%.avl}.err" ] \
+	    && ! cmp -s "$work/vm.err" "${program%.avl}.err"; then
+		echo "FAIL $name: the errors are not the expected ones"
+		diff "${program%.avl}.err" "$work/vm.err" | head -n 10
+		failed=1
+	elif [ "$vm_status" -ne "$interpreter_status" ] \
+	    || ! cmp -s "$work/vm.out" "$work/interpreter.out" \
+	    || ! cmp -s "$work/vm.err" "$work/interpreter.err"; then
+		echo "FAIL $name: the VM prints otherwise with --no-jit"
+		diff "$work/vm.out" "$work/interpreter.out" | head -n 10
+		failed=1
+	elif [ "$vm_status" -ne "$c_status" ]; then
+		echo "FAIL $name: the VM exits with $vm_status, the C with $c_status"
+		failed=1
+	elif ! cmp -s "$work/vm.out" "$work/c.out"; then
+		echo "FAIL $name: the output differs"
+		diff "$work/vm.out" "$work/c.out" | head -n 10
+		failed=1
+	elif ! cmp -s "$work/vm.err" "$work/c.err"; then
+		echo "FAIL $name: the errors differ"
+		diff "$work/vm.err" "$work/c.err" | head -n 10
+		failed=1
+	else
+		echo "ok   $name"
+	fi
+done
+
+exit $failed